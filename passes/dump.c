@@ -32,6 +32,7 @@
 #include "wldbg.h"
 #include "wldbg-pass.h"
 #include "wldbg-parse-message.h"
+#include "wldbg-capture.h"
 
 enum options {
 	SEPARATE		= 1 ,
@@ -49,7 +50,7 @@ enum options {
 struct dump {
 	uint64_t options;
 	const char *file;
-	int file_fd;
+	struct wldbg_capture *capture;
 
 	struct {
 		uint64_t in_msg;
@@ -62,10 +63,9 @@ struct dump {
 static void
 dump_to_file(struct wldbg_message *message, struct dump *dump)
 {
-	if (write(dump->file_fd, message->data, message->size)
-		!= (ssize_t) message->size) {
-		perror("Dumping to file failed");
-	}
+	/* the capture reports the first error itself
+	 * and then it ignores the messages */
+	wldbg_capture_write(dump->capture, message);
 }
 
 static void
@@ -87,6 +87,10 @@ dump_message(struct wldbg_message *message, struct dump *dump)
 	if (options & NOOUT)
 		return;
 
+	/* we run in the background and could not keep up */
+	if (message->dropped)
+		printf("... %lu messages dropped ...\n", message->dropped);
+
 	if (options & DECODE)
 		options |= SEPARATE;
 
@@ -182,7 +186,8 @@ print_help(void *user_data)
 	       "    statistics   -- gather and print statistics on exit\n"
 	       "    no-output    -- do not print anything (except stats at exit)\n"
 	       "    help         -- print this help\n"
-	       "    to-file      -- dump raw data into file\n");
+	       "    to-file FILE -- write messages into capture file,\n"
+	       "                    replay it with wldbg --replay FILE\n");
 }
 
 static int
@@ -190,7 +195,7 @@ dump_init(struct wldbg *wldbg, struct wldbg_pass *pass, int argc, const char *ar
 {
 	int i;
 	uint64_t flags = 0;
-	struct dump *dump = malloc(sizeof *dump);
+	struct dump *dump = calloc(1, sizeof *dump);
 	if (!dump)
 		return -1;
 
@@ -223,7 +228,8 @@ dump_init(struct wldbg *wldbg, struct wldbg_pass *pass, int argc, const char *ar
 			wldbg_exit(wldbg);
 		} else if (strcmp(argv[i], "to-file") == 0) {
 			flags |= TOFILE;
-			dump->file = argv[i + 1];
+			if (i + 1 < argc)
+				dump->file = argv[++i];
 		}
 	}
 
@@ -234,9 +240,14 @@ dump_init(struct wldbg *wldbg, struct wldbg_pass *pass, int argc, const char *ar
 		flags |= RAW;
 
 	if (flags & TOFILE) {
-		dump->file_fd = open(dump->file, O_WRONLY | O_CREAT | O_EXCL, 0755);
-		if (dump->file_fd == -1) {
-			perror("Opening file for dumping");
+		if (!dump->file) {
+			fprintf(stderr, "to-file needs name of the file\n");
+			free(dump);
+			return -1;
+		}
+
+		dump->capture = wldbg_capture_create(dump->file);
+		if (!dump->capture) {
 			free(dump);
 			return -1;
 		}
@@ -245,6 +256,15 @@ dump_init(struct wldbg *wldbg, struct wldbg_pass *pass, int argc, const char *ar
 	dump->options = flags;
 	pass->user_data = dump;
 
+	/* statistics count messages in both directions,
+	 * otherwise we do not need to see the other side at all */
+	if (!(flags & STATS)) {
+		if ((flags & CLIENTONLY) && !(flags & SERVERONLY))
+			pass->subscription.directions = WLDBG_SUBSCRIBE_CLIENT;
+		else if ((flags & SERVERONLY) && !(flags & CLIENTONLY))
+			pass->subscription.directions = WLDBG_SUBSCRIBE_SERVER;
+	}
+
 	return 0;
 }
 
@@ -264,7 +284,7 @@ dump_destroy(void *data)
 	}
 
 	if (dump->options & TOFILE) {
-		close(dump->file_fd);
+		wldbg_capture_destroy(dump->capture);
 	}
 
 	free(dump);
@@ -277,5 +297,5 @@ struct wldbg_pass wldbg_pass = {
 	.client_pass = dump_out,
 	.help = print_help,
 	.description = "Dump data going through the wire",
-	0
+	.flags = WLDBG_PASS_OBSERVER,
 };
@@ -0,0 +1,750 @@
+/*
+ * Copyright (c) 2015 Marek Chalupa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "wldbg.h"
+#include "wldbg-private.h"
+#include "wldbg-capture.h"
+#include "wldbg-parse-message.h"
+#include "wayland/wayland-util.h"
+
+/* connection and chunks in which it has messages */
+struct capture_connection {
+	uint32_t id;
+	struct wl_array chunks;
+};
+
+struct wldbg_capture {
+	int fd;
+	/* offset in the file where the current chunk goes */
+	uint64_t offset;
+
+	/* the current chunk, the header and its records */
+	char *chunk;
+	size_t chunk_size;
+
+	/* struct wldbg_capture_index_chunk */
+	struct wl_array chunks;
+	/* struct capture_connection */
+	struct wl_array connections;
+	struct capture_connection *last_connection;
+
+	int error;
+};
+
+#define CHUNK_BUFFER_SIZE						\
+	(sizeof(struct wldbg_capture_chunk) + WLDBG_CAPTURE_CHUNK_SIZE	\
+	 + sizeof(struct wldbg_capture_record) + WLDBG_CAPTURE_ALIGN(UINT16_MAX))
+
+/* how many fds the message carries, if we know its object */
+static uint8_t
+message_fds(struct wldbg_message *message, const uint32_t *data)
+{
+	const struct wl_interface *intf;
+	const struct wl_message *wl_message;
+	const struct wldbg_signature *sig;
+	uint32_t opcode = data[1] & 0xffff;
+	const char *s;
+	uint8_t n = 0;
+
+	intf = wldbg_message_get_object(message, data[0]);
+	if (!intf)
+		return 0;
+
+	/* registered interfaces have it precompiled */
+	sig = wldbg_interface_get_signature(intf, message->from, opcode);
+	if (sig)
+		return sig->fds_num;
+
+	if (message->from == SERVER) {
+		if (opcode >= (uint32_t) intf->event_count)
+			return 0;
+		wl_message = &intf->events[opcode];
+	} else {
+		if (opcode >= (uint32_t) intf->method_count)
+			return 0;
+		wl_message = &intf->methods[opcode];
+	}
+
+	if (!wl_message->signature)
+		return 0;
+
+	for (s = wl_message->signature; *s; ++s)
+		if (*s == 'h')
+			++n;
+
+	return n;
+}
+
+static struct wldbg_capture_chunk *
+current_chunk(struct wldbg_capture *capture)
+{
+	return (struct wldbg_capture_chunk *) capture->chunk;
+}
+
+static int
+write_all(int fd, const void *data, size_t size)
+{
+	ssize_t ret;
+
+	while (size > 0) {
+		ret = write(fd, data, size);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+
+		data = (const char *) data + ret;
+		size -= ret;
+	}
+
+	return 0;
+}
+
+struct wldbg_capture *
+wldbg_capture_create(const char *path)
+{
+	struct wldbg_capture *capture;
+	struct wldbg_capture_header header;
+
+	capture = calloc(1, sizeof *capture);
+	if (!capture)
+		return NULL;
+
+	capture->chunk = malloc(CHUNK_BUFFER_SIZE);
+	if (!capture->chunk) {
+		free(capture);
+		return NULL;
+	}
+
+	capture->fd = open(path, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC,
+			   0644);
+	if (capture->fd == -1) {
+		perror("Creating capture file");
+		free(capture->chunk);
+		free(capture);
+		return NULL;
+	}
+
+	memset(&header, 0, sizeof header);
+	memcpy(header.magic, WLDBG_CAPTURE_MAGIC, sizeof header.magic);
+	header.version = WLDBG_CAPTURE_VERSION;
+
+	if (write_all(capture->fd, &header, sizeof header) < 0) {
+		perror("Writing capture header");
+		close(capture->fd);
+		free(capture->chunk);
+		free(capture);
+		return NULL;
+	}
+
+	capture->offset = sizeof header;
+	wl_array_init(&capture->chunks);
+	wl_array_init(&capture->connections);
+
+	return capture;
+}
+
+/* write out the current chunk and put it into the index */
+static int
+flush_chunk(struct wldbg_capture *capture)
+{
+	struct wldbg_capture_chunk *chunk = current_chunk(capture);
+	struct wldbg_capture_index_chunk *entry;
+	size_t size;
+
+	if (capture->chunk_size == 0)
+		return 0;
+
+	size = sizeof *chunk + capture->chunk_size;
+	memcpy(chunk->magic, WLDBG_CAPTURE_CHUNK_MAGIC, sizeof chunk->magic);
+	chunk->size = capture->chunk_size;
+	chunk->reserved = 0;
+
+	entry = wl_array_add(&capture->chunks, sizeof *entry);
+	if (!entry) {
+		fprintf(stderr, "Out of memory for capture index\n");
+		return -1;
+	}
+
+	entry->offset = capture->offset;
+	entry->first_time = chunk->first_time;
+	entry->last_time = chunk->last_time;
+	entry->size = chunk->size;
+	entry->records = chunk->records;
+
+	if (write_all(capture->fd, capture->chunk, size) < 0) {
+		perror("Writing capture");
+		return -1;
+	}
+
+	capture->offset += size;
+	capture->chunk_size = 0;
+
+	return 0;
+}
+
+static struct capture_connection *
+get_connection(struct wldbg_capture *capture, uint32_t id)
+{
+	struct capture_connection *conn;
+
+	if (capture->last_connection && capture->last_connection->id == id)
+		return capture->last_connection;
+
+	wl_array_for_each(conn, &capture->connections) {
+		if (conn->id == id)
+			goto out;
+	}
+
+	conn = wl_array_add(&capture->connections, sizeof *conn);
+	if (!conn)
+		return NULL;
+
+	conn->id = id;
+	wl_array_init(&conn->chunks);
+out:
+	capture->last_connection = conn;
+	return conn;
+}
+
+/* remember that the connection has messages in the current chunk */
+static int
+index_connection(struct wldbg_capture *capture, uint32_t id)
+{
+	struct capture_connection *conn;
+	uint32_t chunk, *p;
+
+	conn = get_connection(capture, id);
+	if (!conn)
+		return -1;
+
+	chunk = capture->chunks.size / sizeof(struct wldbg_capture_index_chunk);
+	if (conn->chunks.size > 0) {
+		p = (uint32_t *)((char *) conn->chunks.data
+				 + conn->chunks.size) - 1;
+		if (*p == chunk)
+			return 0;
+	}
+
+	p = wl_array_add(&conn->chunks, sizeof *p);
+	if (!p)
+		return -1;
+
+	*p = chunk;
+	return 0;
+}
+
+uint64_t
+wldbg_capture_time(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void
+wldbg_capture_record_init(struct wldbg_capture_record *record,
+			  struct wldbg_message *message, uint64_t time,
+			  const void *data, uint16_t size)
+{
+	record->time = time;
+	record->connection = message->connection->id;
+	record->size = size;
+	record->from = message->from;
+	record->fds = message_fds(message, data);
+}
+
+int
+wldbg_capture_write_record(struct wldbg_capture *capture,
+			   const struct wldbg_capture_record *record,
+			   const void *data)
+{
+	struct wldbg_capture_chunk *chunk = current_chunk(capture);
+	char *p;
+
+	if (capture->error)
+		return -1;
+
+	if (capture->chunk_size == 0) {
+		chunk->records = 0;
+		chunk->first_time = record->time;
+	}
+
+	if (index_connection(capture, record->connection) < 0)
+		goto err;
+
+	p = capture->chunk + sizeof *chunk + capture->chunk_size;
+	memcpy(p, record, sizeof *record);
+	memcpy(p + sizeof *record, data, record->size);
+	memset(p + sizeof *record + record->size, 0,
+	       WLDBG_CAPTURE_ALIGN(record->size) - record->size);
+
+	capture->chunk_size += sizeof *record
+		+ WLDBG_CAPTURE_ALIGN(record->size);
+	++chunk->records;
+	chunk->last_time = record->time;
+
+	if (capture->chunk_size >= WLDBG_CAPTURE_CHUNK_SIZE
+	    && flush_chunk(capture) < 0)
+		goto err;
+
+	return 0;
+
+err:
+	capture->error = 1;
+	return -1;
+}
+
+static int
+write_record(struct wldbg_capture *capture, struct wldbg_message *message,
+	     uint64_t time, const void *data, size_t size)
+{
+	struct wldbg_capture_record record;
+
+	memset(&record, 0, sizeof record);
+	wldbg_capture_record_init(&record, message, time, data, size);
+
+	return wldbg_capture_write_record(capture, &record, data);
+}
+
+int
+wldbg_capture_write(struct wldbg_capture *capture,
+		    struct wldbg_message *message)
+{
+	const struct wldbg_frame *frame;
+	uint64_t time = wldbg_capture_time();
+	unsigned int i;
+
+	if (capture->error)
+		return -1;
+
+	if (message->frames_num == 0)
+		return write_record(capture, message, time,
+				    message->data, message->size);
+
+	/* with pass_whole_buffer every message gets its record */
+	for (i = 0; i < message->frames_num; ++i) {
+		frame = &message->frames[i];
+		if (write_record(capture, message, time,
+				 (char *) message->data + frame->offset,
+				 frame->size) < 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+static int
+write_index(struct wldbg_capture *capture)
+{
+	struct wldbg_capture_footer footer;
+	struct wldbg_capture_index_connection entry;
+	struct capture_connection *conn;
+	static const char padding[8];
+	uint32_t refs = 0;
+
+	memset(&footer, 0, sizeof footer);
+	footer.index = capture->offset;
+	footer.chunks_num = capture->chunks.size
+		/ sizeof(struct wldbg_capture_index_chunk);
+	footer.connections_num = capture->connections.size
+		/ sizeof(struct capture_connection);
+
+	if (write_all(capture->fd, capture->chunks.data,
+		      capture->chunks.size) < 0)
+		return -1;
+
+	wl_array_for_each(conn, &capture->connections) {
+		memset(&entry, 0, sizeof entry);
+		entry.id = conn->id;
+		entry.first = refs;
+		entry.chunks_num = conn->chunks.size / sizeof(uint32_t);
+		refs += entry.chunks_num;
+
+		if (write_all(capture->fd, &entry, sizeof entry) < 0)
+			return -1;
+	}
+
+	wl_array_for_each(conn, &capture->connections) {
+		if (write_all(capture->fd, conn->chunks.data,
+			      conn->chunks.size) < 0)
+			return -1;
+	}
+
+	if (refs % 2 && write_all(capture->fd, padding, 4) < 0)
+		return -1;
+
+	footer.refs_num = refs;
+	memcpy(footer.magic, WLDBG_CAPTURE_FOOTER_MAGIC, sizeof footer.magic);
+
+	return write_all(capture->fd, &footer, sizeof footer);
+}
+
+void
+wldbg_capture_destroy(struct wldbg_capture *capture)
+{
+	struct capture_connection *conn;
+
+	/* without the index the file can still be read,
+	 * just not so fast */
+	if (!capture->error
+	    && (flush_chunk(capture) < 0 || write_index(capture) < 0))
+		perror("Writing capture index");
+
+	wl_array_for_each(conn, &capture->connections)
+		wl_array_release(&conn->chunks);
+
+	wl_array_release(&capture->connections);
+	wl_array_release(&capture->chunks);
+	close(capture->fd);
+	free(capture->chunk);
+	free(capture);
+}
+
+/* the file has no index, find the chunks by walking them */
+static int
+scan_chunks(struct wldbg_capture_file *file, const char *path)
+{
+	const struct wldbg_capture_chunk *chunk;
+	struct wldbg_capture_index_chunk *entry;
+	struct wl_array chunks;
+	size_t off = sizeof(struct wldbg_capture_header);
+
+	wl_array_init(&chunks);
+
+	while (file->size - off >= sizeof *chunk) {
+		chunk = (const void *)((const char *) file->data + off);
+		if (memcmp(chunk->magic, WLDBG_CAPTURE_CHUNK_MAGIC,
+			   sizeof chunk->magic) != 0
+		    || file->size - off - sizeof *chunk < chunk->size)
+			break;
+
+		entry = wl_array_add(&chunks, sizeof *entry);
+		if (!entry) {
+			wl_array_release(&chunks);
+			return -1;
+		}
+
+		entry->offset = off;
+		entry->first_time = chunk->first_time;
+		entry->last_time = chunk->last_time;
+		entry->size = chunk->size;
+		entry->records = chunk->records;
+
+		off += sizeof *chunk + chunk->size;
+	}
+
+	if (off != file->size)
+		fprintf(stderr, "%s was not finished, ignoring last %lu bytes\n",
+			path, (unsigned long) (file->size - off));
+
+	file->chunks = chunks.data;
+	file->chunks_num = chunks.size / sizeof *entry;
+	file->unfinished = 1;
+
+	return 0;
+}
+
+/* set up the index from the end of the file. Returns 0 if
+ * the file has no index and -1 if the index is broken */
+static int
+read_index(struct wldbg_capture_file *file)
+{
+	const struct wldbg_capture_footer *footer;
+	const struct wldbg_capture_index_connection *conn;
+	size_t size;
+	uint32_t i;
+
+	if (file->size < sizeof(struct wldbg_capture_header) + sizeof *footer)
+		return 0;
+
+	footer = (const void *)((const char *) file->data
+				+ file->size - sizeof *footer);
+	if (memcmp(footer->magic, WLDBG_CAPTURE_FOOTER_MAGIC,
+		   sizeof footer->magic) != 0)
+		return 0;
+
+	size = footer->chunks_num * sizeof *file->chunks
+		+ footer->connections_num * sizeof *file->connections
+		+ WLDBG_CAPTURE_ALIGN(footer->refs_num * sizeof(uint32_t))
+		+ sizeof *footer;
+	if (footer->index < sizeof(struct wldbg_capture_header)
+	    || footer->index % 8 != 0
+	    || footer->index + size != file->size)
+		return -1;
+
+	file->chunks = (const void *)((const char *) file->data
+				      + footer->index);
+	file->chunks_num = footer->chunks_num;
+	file->connections = (const void *)(file->chunks + file->chunks_num);
+	file->connections_num = footer->connections_num;
+	file->refs = (const void *)(file->connections
+				    + file->connections_num);
+
+	/* chunks themselves are checked when they are read */
+	for (i = 0; i < file->chunks_num; ++i) {
+		if (file->chunks[i].offset > footer->index
+		    || footer->index - file->chunks[i].offset
+		       < sizeof(struct wldbg_capture_chunk)
+			 + file->chunks[i].size)
+			return -1;
+	}
+
+	for (i = 0; i < file->connections_num; ++i) {
+		conn = &file->connections[i];
+		if (conn->first > footer->refs_num
+		    || footer->refs_num - conn->first < conn->chunks_num)
+			return -1;
+	}
+
+	for (i = 0; i < footer->refs_num; ++i) {
+		if (file->refs[i] >= file->chunks_num)
+			return -1;
+	}
+
+	return 1;
+}
+
+int
+wldbg_capture_file_open(struct wldbg_capture_file *file, const char *path)
+{
+	const struct wldbg_capture_header *header;
+	struct stat st;
+	int fd, ret;
+
+	memset(file, 0, sizeof *file);
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd == -1) {
+		perror("Opening capture file");
+		return -1;
+	}
+
+	if (fstat(fd, &st) == -1) {
+		perror("Opening capture file");
+		close(fd);
+		return -1;
+	}
+
+	if ((size_t) st.st_size < sizeof *header) {
+		fprintf(stderr, "%s is not a capture file\n", path);
+		close(fd);
+		return -1;
+	}
+
+	file->size = st.st_size;
+	file->data = mmap(NULL, file->size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (file->data == MAP_FAILED) {
+		perror("Mapping capture file");
+		file->data = NULL;
+		return -1;
+	}
+
+	header = file->data;
+	if (memcmp(header->magic, WLDBG_CAPTURE_MAGIC,
+		   sizeof header->magic) != 0) {
+		fprintf(stderr, "%s is not a capture file\n", path);
+		wldbg_capture_file_close(file);
+		return -1;
+	}
+
+	if (header->version != WLDBG_CAPTURE_VERSION) {
+		fprintf(stderr, "Unsupported version of capture file: %u\n",
+			header->version);
+		wldbg_capture_file_close(file);
+		return -1;
+	}
+
+	ret = read_index(file);
+	if (ret == 0)
+		ret = scan_chunks(file, path);
+	else if (ret < 0)
+		fprintf(stderr, "Index of capture file %s is corrupted\n", path);
+
+	if (ret < 0) {
+		wldbg_capture_file_close(file);
+		return -1;
+	}
+
+	return 0;
+}
+
+void
+wldbg_capture_file_close(struct wldbg_capture_file *file)
+{
+	if (file->unfinished)
+		free((void *) file->chunks);
+
+	if (file->data)
+		munmap(file->data, file->size);
+
+	memset(file, 0, sizeof *file);
+}
+
+int
+wldbg_capture_file_next(struct wldbg_capture_file *file,
+			struct wldbg_capture_cursor *cursor,
+			const struct wldbg_capture_record **record,
+			const void **data)
+{
+	const struct wldbg_capture_index_chunk *chunk;
+	const struct wldbg_capture_chunk *header;
+	const struct wldbg_capture_record *rec;
+	const uint32_t *msg;
+	size_t off, end, size;
+
+	for (;;) {
+		if (cursor->chunk >= file->chunks_num)
+			return 0;
+
+		chunk = &file->chunks[cursor->chunk];
+		off = chunk->offset + sizeof *header;
+		end = off + chunk->size;
+
+		if (cursor->offset == 0) {
+			header = (const void *)((const char *) file->data
+						+ chunk->offset);
+			if (memcmp(header->magic, WLDBG_CAPTURE_CHUNK_MAGIC,
+				   sizeof header->magic) != 0
+			    || header->size != chunk->size) {
+				off = chunk->offset;
+				goto corrupted;
+			}
+
+			cursor->offset = off;
+		}
+
+		if (cursor->offset < end)
+			break;
+
+		++cursor->chunk;
+		cursor->offset = 0;
+	}
+
+	off = cursor->offset;
+	if (end - off < sizeof *rec)
+		goto corrupted;
+
+	rec = (const void *)((const char *) file->data + off);
+	size = WLDBG_CAPTURE_ALIGN(rec->size);
+	if (rec->size < 8 || rec->size % 4 != 0
+	    || end - off - sizeof *rec < size)
+		goto corrupted;
+
+	/* the size in the record and in the message must match */
+	msg = (const uint32_t *)(rec + 1);
+	if (msg[1] >> 16 != rec->size)
+		goto corrupted;
+
+	*record = rec;
+	*data = msg;
+	cursor->offset = off + sizeof *rec + size;
+
+	return 1;
+
+corrupted:
+	fprintf(stderr, "Capture file is corrupted at offset %lu\n",
+		(unsigned long) off);
+	return -1;
+}
+
+int
+wldbg_capture_file_seek(struct wldbg_capture_file *file,
+			struct wldbg_capture_cursor *cursor, uint64_t time)
+{
+	const struct wldbg_capture_record *record;
+	struct wldbg_capture_cursor prev;
+	const void *data;
+	uint32_t low = 0, high = file->chunks_num, mid;
+	int ret;
+
+	/* the first chunk that ends at or after the time */
+	while (low < high) {
+		mid = low + (high - low) / 2;
+		if (file->chunks[mid].last_time < time)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	cursor->chunk = low;
+	cursor->offset = 0;
+
+	for (;;) {
+		prev = *cursor;
+		ret = wldbg_capture_file_next(file, cursor, &record, &data);
+		if (ret <= 0)
+			return ret;
+
+		if (record->time >= time) {
+			*cursor = prev;
+			return 0;
+		}
+	}
+}
+
+uint32_t
+wldbg_capture_file_connection_chunks(struct wldbg_capture_file *file,
+				     uint32_t connection,
+				     const uint32_t **chunks)
+{
+	uint32_t i;
+
+	*chunks = NULL;
+	if (file->unfinished)
+		return file->chunks_num;
+
+	for (i = 0; i < file->connections_num; ++i) {
+		if (file->connections[i].id == connection) {
+			*chunks = file->refs + file->connections[i].first;
+			return file->connections[i].chunks_num;
+		}
+	}
+
+	return 0;
+}
+
+uint64_t
+wldbg_capture_file_start_time(struct wldbg_capture_file *file)
+{
+	if (file->chunks_num == 0)
+		return 0;
+
+	return file->chunks[0].first_time;
+}
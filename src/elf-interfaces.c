@@ -0,0 +1,1039 @@
+/*
+ * Copyright (c) 2015 Marek Chalupa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+
+/*
+ * Interfaces compiled into the client and its libraries. Toolkits
+ * often carry the code that wayland-scanner generated for the protocols
+ * they use, so we read the wl_interface tables right from the ELF files.
+ *
+ * The tables are full of pointers, so the relocations of the file
+ * are applied while reading them. Pointers to interfaces from other
+ * objects are relocated against symbols (like wl_surface_interface),
+ * these are linked by names like the interfaces from protocol XML files.
+ *
+ * Interfaces of every object are cached by its build-id (or path and
+ * mtime if it has none), so next time only the headers are read.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <elf.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "wayland/wayland-util.h"
+
+#include "wldbg.h"
+#include "wldbg-parse-message.h"
+#include "wldbg-protocols.h"
+#include "protocols-private.h"
+
+#if defined(__x86_64__)
+#define ELF_MACHINE	EM_X86_64
+#define ELF_R_RELATIVE	R_X86_64_RELATIVE
+#define ELF_R_ABS	R_X86_64_64
+#define ELF_R_GLOB_DAT	R_X86_64_GLOB_DAT
+#elif defined(__aarch64__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define ELF_MACHINE	EM_AARCH64
+#define ELF_R_RELATIVE	R_AARCH64_RELATIVE
+#define ELF_R_ABS	R_AARCH64_ABS64
+#define ELF_R_GLOB_DAT	R_AARCH64_GLOB_DAT
+#endif
+
+#ifdef ELF_MACHINE
+
+/* older elf.h do not have packed relative relocations */
+#ifndef DT_RELR
+#define DT_RELRSZ	35
+#define DT_RELR		36
+#endif
+
+/* do not walk through the whole system */
+#define MAX_OBJECTS	256
+#define MAX_STRING	256
+#define MAX_MESSAGES	1024
+
+#define DEFAULT_LIBRARY_PATH	"/lib64:/usr/lib64:/lib:/usr/lib"
+#define DEFAULT_PATH		"/usr/local/bin:/usr/bin:/bin"
+
+#define LDCACHE_PATH	"/etc/ld.so.cache"
+#define LDCACHE_MAGIC	"glibc-ld.so.cache1.1"
+
+/* the new format of ld.so.cache */
+struct ldcache_header {
+	char magic[20];
+	uint32_t nlibs;
+	uint32_t len_strings;
+	uint8_t flags;
+	uint8_t padding[3];
+	uint32_t extension_offset;
+	uint32_t unused[3];
+};
+
+struct ldcache_entry {
+	int32_t flags;
+	/* offsets of the name and the path */
+	uint32_t key;
+	uint32_t value;
+	uint32_t osversion;
+	uint64_t hwcap;
+};
+
+struct elf_reloc {
+	uint64_t offset;
+	uint64_t value;
+	/* the value is relative to this symbol from another object */
+	const char *symbol;
+};
+
+struct elf_dynamic {
+	uint64_t strtab;
+	uint64_t symtab;
+	uint64_t rela;
+	uint64_t relasz;
+	uint64_t relr;
+	uint64_t relrsz;
+	const char *runpath;
+	const char *rpath;
+	/* const char * */
+	struct wl_array needed;
+};
+
+struct elf {
+	const char *path;
+	const char *data;
+	size_t size;
+	const Elf64_Ehdr *ehdr;
+	const Elf64_Phdr *phdrs;
+	const Elf64_Shdr *shdrs;
+
+	struct elf_dynamic dynamic;
+	/* struct elf_reloc sorted by offset */
+	struct wl_array relocs;
+	/* addresses of interfaces that were copied (uint64_t) */
+	struct wl_array seen;
+	struct wl_list *interfaces;
+};
+
+struct scan {
+	/* paths of objects that were scanned (char *) */
+	struct wl_array objects;
+	struct wl_list interfaces;
+
+	const char *ldcache;
+	size_t ldcache_size;
+};
+
+static int
+in_file(struct elf *elf, uint64_t off, uint64_t len)
+{
+	return off <= elf->size && len <= elf->size - off;
+}
+
+static int
+elf_open(struct elf *elf, const char *path)
+{
+	const Elf64_Ehdr *ehdr;
+	struct stat st;
+	void *data;
+	int fd;
+
+	memset(elf, 0, sizeof *elf);
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -1;
+
+	if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)
+	    || (size_t) st.st_size < sizeof *ehdr) {
+		close(fd);
+		return -1;
+	}
+
+	data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+		return -1;
+
+	elf->path = path;
+	elf->data = data;
+	elf->size = st.st_size;
+	elf->ehdr = ehdr = data;
+	wl_array_init(&elf->dynamic.needed);
+	wl_array_init(&elf->relocs);
+	wl_array_init(&elf->seen);
+
+	if (memcmp(ehdr->e_ident, ELFMAG, SELFMAG) != 0
+	    || ehdr->e_ident[EI_CLASS] != ELFCLASS64
+	    || ehdr->e_ident[EI_DATA] != ELFDATA2LSB
+	    || ehdr->e_machine != ELF_MACHINE
+	    || (ehdr->e_type != ET_EXEC && ehdr->e_type != ET_DYN)
+	    || ehdr->e_phentsize != sizeof(Elf64_Phdr)
+	    || !in_file(elf, ehdr->e_phoff,
+			(uint64_t) ehdr->e_phnum * sizeof(Elf64_Phdr)))
+		goto err;
+
+	elf->phdrs = (const Elf64_Phdr *) (elf->data + ehdr->e_phoff);
+
+	/* section headers are needed only for symbols */
+	if (ehdr->e_shoff != 0
+	    && ehdr->e_shentsize == sizeof(Elf64_Shdr)
+	    && in_file(elf, ehdr->e_shoff,
+		       (uint64_t) ehdr->e_shnum * sizeof(Elf64_Shdr)))
+		elf->shdrs = (const Elf64_Shdr *) (elf->data + ehdr->e_shoff);
+
+	return 0;
+
+err:
+	munmap(data, st.st_size);
+	return -1;
+}
+
+static void
+elf_close(struct elf *elf)
+{
+	wl_array_release(&elf->dynamic.needed);
+	wl_array_release(&elf->relocs);
+	wl_array_release(&elf->seen);
+	munmap((void *) elf->data, elf->size);
+}
+
+/* data at the virtual address, if they are in the file */
+static const void *
+vaddr_data(struct elf *elf, uint64_t vaddr, uint64_t len)
+{
+	const Elf64_Phdr *ph;
+	uint64_t off;
+	int i;
+
+	for (i = 0; i < elf->ehdr->e_phnum; ++i) {
+		ph = &elf->phdrs[i];
+		if (ph->p_type != PT_LOAD || vaddr < ph->p_vaddr)
+			continue;
+
+		off = vaddr - ph->p_vaddr;
+		if (off > ph->p_filesz || len > ph->p_filesz - off)
+			continue;
+
+		if (!in_file(elf, ph->p_offset + off, len))
+			return NULL;
+
+		return elf->data + ph->p_offset + off;
+	}
+
+	return NULL;
+}
+
+static const char *
+vaddr_string(struct elf *elf, uint64_t vaddr)
+{
+	const char *str;
+	unsigned int len;
+
+	/* find the longest part that is in the file */
+	for (len = MAX_STRING; len > 0; len /= 2) {
+		str = vaddr_data(elf, vaddr, len);
+		if (str)
+			return memchr(str, '\0', len) ? str : NULL;
+	}
+
+	return NULL;
+}
+
+static const char *
+section_string(struct elf *elf, const Elf64_Shdr *strtab, uint32_t off)
+{
+	const char *str;
+
+	if (strtab->sh_type != SHT_STRTAB || off >= strtab->sh_size
+	    || !in_file(elf, strtab->sh_offset, strtab->sh_size))
+		return NULL;
+
+	str = elf->data + strtab->sh_offset + off;
+	if (!memchr(str, '\0', strtab->sh_size - off))
+		return NULL;
+
+	return str;
+}
+
+static int
+build_id(struct elf *elf, char *buf, size_t size)
+{
+	static const char hex[] = "0123456789abcdef";
+	const Elf64_Phdr *ph;
+	const Elf64_Nhdr *nhdr;
+	const unsigned char *desc;
+	uint64_t off, end, align;
+	unsigned int i, n;
+
+	for (i = 0; i < elf->ehdr->e_phnum; ++i) {
+		ph = &elf->phdrs[i];
+		if (ph->p_type != PT_NOTE
+		    || !in_file(elf, ph->p_offset, ph->p_filesz))
+			continue;
+
+		align = ph->p_align == 8 ? 8 : 4;
+		off = ph->p_offset;
+		end = ph->p_offset + ph->p_filesz;
+		while (off + sizeof *nhdr <= end) {
+			nhdr = (const Elf64_Nhdr *) (elf->data + off);
+			desc = (const unsigned char *) elf->data + off
+			       + sizeof *nhdr
+			       + ((nhdr->n_namesz + align - 1) & ~(align - 1));
+			off = desc - (const unsigned char *) elf->data
+			      + ((nhdr->n_descsz + align - 1) & ~(align - 1));
+			if (off > end)
+				break;
+
+			if (nhdr->n_type != NT_GNU_BUILD_ID
+			    || nhdr->n_namesz != 4
+			    || memcmp(nhdr + 1, "GNU", 4) != 0
+			    || nhdr->n_descsz * 2 >= size)
+				continue;
+
+			for (n = 0; n < nhdr->n_descsz; ++n) {
+				buf[2 * n] = hex[desc[n] >> 4];
+				buf[2 * n + 1] = hex[desc[n] & 0xf];
+			}
+
+			buf[2 * n] = '\0';
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+static void
+read_dynamic(struct elf *elf)
+{
+	struct elf_dynamic *dyn = &elf->dynamic;
+	const Elf64_Phdr *ph = NULL;
+	const Elf64_Dyn *d;
+	const char *str, **needed;
+	uint64_t runpath = 0, rpath = 0;
+	unsigned int i, num;
+
+	for (i = 0; i < elf->ehdr->e_phnum; ++i)
+		if (elf->phdrs[i].p_type == PT_DYNAMIC)
+			ph = &elf->phdrs[i];
+
+	/* statically linked */
+	if (!ph || !in_file(elf, ph->p_offset, ph->p_filesz))
+		return;
+
+	d = (const Elf64_Dyn *) (elf->data + ph->p_offset);
+	num = ph->p_filesz / sizeof *d;
+
+	/* the string table first, everything refers to it */
+	for (i = 0; i < num && d[i].d_tag != DT_NULL; ++i)
+		if (d[i].d_tag == DT_STRTAB)
+			dyn->strtab = d[i].d_un.d_ptr;
+
+	for (i = 0; i < num && d[i].d_tag != DT_NULL; ++i) {
+		switch (d[i].d_tag) {
+		case DT_SYMTAB:
+			dyn->symtab = d[i].d_un.d_ptr;
+			break;
+		case DT_RELA:
+			dyn->rela = d[i].d_un.d_ptr;
+			break;
+		case DT_RELASZ:
+			dyn->relasz = d[i].d_un.d_val;
+			break;
+		case DT_RELR:
+			dyn->relr = d[i].d_un.d_ptr;
+			break;
+		case DT_RELRSZ:
+			dyn->relrsz = d[i].d_un.d_val;
+			break;
+		case DT_RUNPATH:
+			runpath = d[i].d_un.d_val;
+			break;
+		case DT_RPATH:
+			rpath = d[i].d_un.d_val;
+			break;
+		case DT_NEEDED:
+			str = vaddr_string(elf, dyn->strtab + d[i].d_un.d_val);
+			needed = wl_array_add(&dyn->needed, sizeof *needed);
+			if (str && needed)
+				*needed = str;
+			else if (needed)
+				dyn->needed.size -= sizeof *needed;
+			break;
+		}
+	}
+
+	if (runpath)
+		dyn->runpath = vaddr_string(elf, dyn->strtab + runpath);
+	if (rpath)
+		dyn->rpath = vaddr_string(elf, dyn->strtab + rpath);
+}
+
+static void
+add_reloc(struct elf *elf, uint64_t offset, uint64_t value,
+	  const char *symbol)
+{
+	struct elf_reloc *reloc;
+
+	reloc = wl_array_add(&elf->relocs, sizeof *reloc);
+	if (!reloc)
+		return;
+
+	reloc->offset = offset;
+	reloc->value = value;
+	reloc->symbol = symbol;
+}
+
+/* relr relocations have the addend in the place */
+static void
+add_relr(struct elf *elf, uint64_t offset)
+{
+	const void *p = vaddr_data(elf, offset, sizeof(uint64_t));
+	uint64_t value;
+
+	if (!p)
+		return;
+
+	memcpy(&value, p, sizeof value);
+	add_reloc(elf, offset, value, NULL);
+}
+
+static int
+compare_relocs(const void *a, const void *b)
+{
+	const struct elf_reloc *ra = a, *rb = b;
+
+	if (ra->offset < rb->offset)
+		return -1;
+
+	return ra->offset > rb->offset;
+}
+
+static void
+read_relocs(struct elf *elf)
+{
+	struct elf_dynamic *dyn = &elf->dynamic;
+	const Elf64_Rela *rela;
+	const Elf64_Sym *sym;
+	const uint64_t *relr;
+	uint64_t i, num, where = 0, bits;
+	unsigned int n;
+
+	num = dyn->relasz / sizeof *rela;
+	rela = vaddr_data(elf, dyn->rela, num * sizeof *rela);
+	for (i = 0; rela && i < num; ++i) {
+		switch (ELF64_R_TYPE(rela[i].r_info)) {
+		case ELF_R_RELATIVE:
+			add_reloc(elf, rela[i].r_offset, rela[i].r_addend, NULL);
+			break;
+		case ELF_R_ABS:
+		case ELF_R_GLOB_DAT:
+			sym = vaddr_data(elf, dyn->symtab
+					 + ELF64_R_SYM(rela[i].r_info)
+					   * sizeof *sym, sizeof *sym);
+			if (!sym)
+				break;
+
+			if (sym->st_shndx != SHN_UNDEF)
+				add_reloc(elf, rela[i].r_offset,
+					  sym->st_value + rela[i].r_addend,
+					  NULL);
+			else
+				add_reloc(elf, rela[i].r_offset,
+					  rela[i].r_addend,
+					  vaddr_string(elf, dyn->strtab
+						       + sym->st_name));
+			break;
+		}
+	}
+
+	/* an address and then bitmaps of the next 63 words */
+	num = dyn->relrsz / sizeof *relr;
+	relr = vaddr_data(elf, dyn->relr, num * sizeof *relr);
+	for (i = 0; relr && i < num; ++i) {
+		if ((relr[i] & 1) == 0) {
+			where = relr[i];
+			add_relr(elf, where);
+			where += sizeof(uint64_t);
+			continue;
+		}
+
+		for (n = 0, bits = relr[i] >> 1; bits; ++n, bits >>= 1)
+			if (bits & 1)
+				add_relr(elf, where + n * sizeof(uint64_t));
+
+		where += 63 * sizeof(uint64_t);
+	}
+
+	qsort(elf->relocs.data, elf->relocs.size / sizeof(struct elf_reloc),
+	      sizeof(struct elf_reloc), compare_relocs);
+}
+
+/* the value of the pointer at vaddr after relocation. If it points
+ * into another object, symbol is the name it is relative to */
+static int
+read_pointer(struct elf *elf, uint64_t vaddr,
+	     uint64_t *value, const char **symbol)
+{
+	struct elf_reloc key = { vaddr, 0, NULL }, *reloc;
+	const void *p;
+
+	reloc = bsearch(&key, elf->relocs.data,
+			elf->relocs.size / sizeof *reloc,
+			sizeof *reloc, compare_relocs);
+	if (reloc) {
+		*value = reloc->value;
+		*symbol = reloc->symbol;
+		return 0;
+	}
+
+	*symbol = NULL;
+	p = vaddr_data(elf, vaddr, sizeof *value);
+	if (!p)
+		return -1;
+
+	memcpy(value, p, sizeof *value);
+	return 0;
+}
+
+/* string that a pointer in this object points to */
+static const char *
+read_string(struct elf *elf, uint64_t vaddr)
+{
+	const char *symbol;
+	uint64_t value;
+
+	if (read_pointer(elf, vaddr, &value, &symbol) < 0 || symbol || !value)
+		return NULL;
+
+	return vaddr_string(elf, value);
+}
+
+static int
+is_identifier(const char *str)
+{
+	if (!str || !*str)
+		return 0;
+
+	for (; *str; ++str)
+		if (!(*str == '_' || (*str >= 'a' && *str <= 'z')
+		      || (*str >= 'A' && *str <= 'Z')
+		      || (*str >= '0' && *str <= '9')))
+			return 0;
+
+	return 1;
+}
+
+static const char *
+copy_interface(struct elf *elf, uint64_t vaddr);
+
+static int
+copy_messages(struct elf *elf, struct protocol_interface *pi, int is_event,
+	      uint64_t vaddr, int num)
+{
+	struct wldbg_signature sig;
+	char names[WLDBG_SIGNATURE_MAX_ARGS][MAX_STRING];
+	const char *types[WLDBG_SIGNATURE_MAX_ARGS];
+	const char *name, *signature, *symbol;
+	uint64_t msg, types_vaddr, value;
+	size_t len;
+	int i, n;
+
+	for (i = 0; i < num; ++i) {
+		msg = vaddr + i * sizeof(struct wl_message);
+
+		name = read_string(elf, msg + offsetof(struct wl_message, name));
+		signature = read_string(elf, msg + offsetof(struct wl_message,
+							    signature));
+		if (!is_identifier(name) || !signature
+		    || wldbg_signature_compile(&sig, signature) < 0
+		    || read_pointer(elf, msg + offsetof(struct wl_message, types),
+				    &types_vaddr, &symbol) < 0)
+			return -1;
+
+		for (n = 0; n < sig.args_num; ++n) {
+			types[n] = NULL;
+			if (!types_vaddr || symbol
+			    || read_pointer(elf, types_vaddr
+						 + n * sizeof(void *),
+					    &value, &types[n]) < 0)
+				continue;
+
+			/* wl_surface_interface from libwayland etc. */
+			if (types[n]) {
+				len = strlen(types[n]);
+				if (len <= sizeof "_interface" - 1
+				    || len >= MAX_STRING
+				    || strcmp(types[n] + len
+					      - (sizeof "_interface" - 1),
+					      "_interface") != 0) {
+					types[n] = NULL;
+					continue;
+				}
+
+				len -= sizeof "_interface" - 1;
+				memcpy(names[n], types[n], len);
+				names[n][len] = '\0';
+				types[n] = names[n];
+			} else if (value) {
+				types[n] = copy_interface(elf, value);
+			}
+		}
+
+		if (protocols_interface_add_message(pi, is_event, name,
+						    signature, types,
+						    sig.args_num) < 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+/* copy the interface and interfaces it refers to,
+ * returns its name or NULL if it does not look right */
+static const char *
+copy_interface(struct elf *elf, uint64_t vaddr)
+{
+	struct protocol_interface *pi;
+	struct wl_interface intf;
+	struct wl_list tmp;
+	const void *data;
+	const char *name, *symbol;
+	uint64_t methods, events, *seen;
+
+	data = vaddr_data(elf, vaddr, sizeof intf);
+	name = read_string(elf, vaddr + offsetof(struct wl_interface, name));
+	if (!data || !is_identifier(name))
+		return NULL;
+
+	wl_array_for_each(seen, &elf->seen)
+		if (*seen == vaddr)
+			return name;
+
+	seen = wl_array_add(&elf->seen, sizeof *seen);
+	if (!seen)
+		return NULL;
+	*seen = vaddr;
+
+	memcpy(&intf, data, sizeof intf);
+	if (intf.version <= 0
+	    || intf.method_count < 0 || intf.method_count > MAX_MESSAGES
+	    || intf.event_count < 0 || intf.event_count > MAX_MESSAGES
+	    || read_pointer(elf, vaddr + offsetof(struct wl_interface,
+						  methods),
+			    &methods, &symbol) < 0 || symbol
+	    || read_pointer(elf, vaddr + offsetof(struct wl_interface,
+						  events),
+			    &events, &symbol) < 0 || symbol)
+		return NULL;
+
+	pi = protocols_interface_create(name, intf.version);
+	if (!pi)
+		return NULL;
+
+	if (copy_messages(elf, pi, 0, methods, intf.method_count) < 0
+	    || copy_messages(elf, pi, 1, events, intf.event_count) < 0) {
+		wl_list_init(&tmp);
+		wl_list_insert(&tmp, &pi->link);
+		protocols_free_interfaces(&tmp);
+		return NULL;
+	}
+
+	protocols_interface_finish(pi);
+	wl_list_insert(elf->interfaces->prev, &pi->link);
+
+	return name;
+}
+
+static int
+has_suffix(const char *str, const char *suffix)
+{
+	size_t len = strlen(str), slen = strlen(suffix);
+
+	return len >= slen && strcmp(str + len - slen, suffix) == 0;
+}
+
+/* stripped objects do not have symbols of the interfaces (they are
+ * hidden), so look at everything that is relocated to point to a name
+ * and check whether it looks like a wl_interface. Every message must
+ * have a valid signature, that is hard to be matched by accident */
+static void
+scan_relocs(struct elf *elf)
+{
+	struct elf_reloc *reloc;
+	struct wl_interface intf;
+	const void *data;
+
+	wl_array_for_each(reloc, &elf->relocs) {
+		if (reloc->symbol || reloc->offset % sizeof(void *) != 0)
+			continue;
+
+		data = vaddr_data(elf, reloc->offset, sizeof intf);
+		if (!data)
+			continue;
+
+		memcpy(&intf, data, sizeof intf);
+		if (intf.version > 0 && intf.version < 1000
+		    && intf.method_count + intf.event_count > 0)
+			copy_interface(elf, reloc->offset);
+	}
+}
+
+/* wayland-scanner names them like xdg_surface_interface */
+static void
+scan_symbols(struct elf *elf)
+{
+	const Elf64_Shdr *sh, *strtab;
+	const Elf64_Sym *sym;
+	const char *name;
+	uint64_t i, num;
+	int s, has_symtab = 0;
+
+	for (s = 0; elf->shdrs && s < elf->ehdr->e_shnum; ++s) {
+		sh = &elf->shdrs[s];
+		if ((sh->sh_type != SHT_SYMTAB && sh->sh_type != SHT_DYNSYM)
+		    || sh->sh_link >= elf->ehdr->e_shnum
+		    || !in_file(elf, sh->sh_offset, sh->sh_size))
+			continue;
+
+		if (sh->sh_type == SHT_SYMTAB)
+			has_symtab = 1;
+
+		strtab = &elf->shdrs[sh->sh_link];
+		sym = (const Elf64_Sym *) (elf->data + sh->sh_offset);
+		num = sh->sh_size / sizeof *sym;
+		for (i = 0; i < num; ++i) {
+			if (ELF64_ST_TYPE(sym[i].st_info) != STT_OBJECT
+			    || sym[i].st_shndx == SHN_UNDEF
+			    || sym[i].st_size != sizeof(struct wl_interface))
+				continue;
+
+			name = section_string(elf, strtab, sym[i].st_name);
+			if (name && has_suffix(name, "_interface"))
+				copy_interface(elf, sym[i].st_value);
+		}
+	}
+
+	if (!has_symtab)
+		scan_relocs(elf);
+}
+
+static void
+load_object(struct scan *scan, struct elf *elf)
+{
+	struct wl_list interfaces;
+	struct wl_array files;
+	struct stat st;
+	char key[PATH_MAX + 8];
+
+	wl_list_init(&interfaces);
+	wl_array_init(&files);
+
+	/* without build-id, the cache must check the file */
+	if (build_id(elf, key + 6, sizeof key - 6) == 0) {
+		memcpy(key, "build-", 6);
+	} else {
+		snprintf(key, sizeof key, "elf:%s", elf->path);
+		if (stat(elf->path, &st) < 0
+		    || protocols_add_file(&files, elf->path, &st) < 0)
+			goto out;
+	}
+
+	if (protocols_load_cache(key, &files, &interfaces) < 0) {
+		read_relocs(elf);
+		elf->interfaces = &interfaces;
+		scan_symbols(elf);
+
+		protocols_write_cache(key, &files, &interfaces);
+	}
+
+	wl_list_insert_list(scan->interfaces.prev, &interfaces);
+
+out:
+	protocols_free_files(&files);
+}
+
+/* is it an ELF file that we can read? */
+static int
+compatible(const char *path)
+{
+	Elf64_Ehdr ehdr;
+	int fd, ret;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return 0;
+
+	ret = read(fd, &ehdr, sizeof ehdr) == sizeof ehdr
+	      && memcmp(ehdr.e_ident, ELFMAG, SELFMAG) == 0
+	      && ehdr.e_ident[EI_CLASS] == ELFCLASS64
+	      && ehdr.e_machine == ELF_MACHINE;
+	close(fd);
+
+	return ret;
+}
+
+/* look for the file in directories separated by ':'. $ORIGIN
+ * at the beginning is the directory of the object */
+static int
+find_in_dirs(const char *dirs, const char *name, const char *origin,
+	     char *out, size_t size)
+{
+	const char *dir, *end, *slash;
+	int origin_len, ret;
+
+	slash = origin ? strrchr(origin, '/') : NULL;
+	origin_len = slash ? slash - origin : 0;
+
+	for (dir = dirs; dir && *dir; dir = *end ? end + 1 : end) {
+		end = strchrnul(dir, ':');
+
+		if (strncmp(dir, "$ORIGIN", 7) == 0 && slash)
+			ret = snprintf(out, size, "%.*s%.*s/%s",
+				       origin_len, origin,
+				       (int) (end - dir - 7), dir + 7, name);
+		else if (strncmp(dir, "${ORIGIN}", 9) == 0 && slash)
+			ret = snprintf(out, size, "%.*s%.*s/%s",
+				       origin_len, origin,
+				       (int) (end - dir - 9), dir + 9, name);
+		else
+			ret = snprintf(out, size, "%.*s/%s",
+				       (int) (end - dir), dir, name);
+
+		if (ret < (int) size && compatible(out))
+			return 0;
+	}
+
+	return -1;
+}
+
+static int
+find_in_ldcache(struct scan *scan, const char *name, char *out, size_t size)
+{
+	const struct ldcache_header *header;
+	const struct ldcache_entry *entry;
+	const char *key, *value;
+	struct stat st;
+	void *data;
+	uint32_t i;
+	int fd;
+
+	if (!scan->ldcache) {
+		fd = open(LDCACHE_PATH, O_RDONLY | O_CLOEXEC);
+		if (fd < 0)
+			return -1;
+
+		if (fstat(fd, &st) < 0
+		    || (size_t) st.st_size < sizeof *header) {
+			close(fd);
+			return -1;
+		}
+
+		data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (data == MAP_FAILED)
+			return -1;
+
+		scan->ldcache = data;
+		scan->ldcache_size = st.st_size;
+	}
+
+	/* only the new format, the old one is not used for years */
+	header = (const struct ldcache_header *) scan->ldcache;
+	if (memcmp(header->magic, LDCACHE_MAGIC, sizeof header->magic) != 0
+	    || header->nlibs > (scan->ldcache_size - sizeof *header)
+			       / sizeof *entry)
+		return -1;
+
+	entry = (const struct ldcache_entry *) (header + 1);
+	for (i = 0; i < header->nlibs; ++i, ++entry) {
+		if (entry->key >= scan->ldcache_size
+		    || entry->value >= scan->ldcache_size)
+			continue;
+
+		key = scan->ldcache + entry->key;
+		value = scan->ldcache + entry->value;
+		if (!memchr(key, '\0', scan->ldcache_size - entry->key)
+		    || !memchr(value, '\0', scan->ldcache_size - entry->value)
+		    || strcmp(key, name) != 0)
+			continue;
+
+		if (snprintf(out, size, "%s", value) < (int) size
+		    && compatible(out))
+			return 0;
+	}
+
+	return -1;
+}
+
+/* roughly what the dynamic linker does */
+static int
+find_library(struct scan *scan, struct elf *elf, const char *name,
+	     char *out, size_t size)
+{
+	const char *path = elf->dynamic.runpath;
+
+	if (strchr(name, '/'))
+		return snprintf(out, size, "%s", name) < (int) size ? 0 : -1;
+
+	if (!path && elf->dynamic.rpath
+	    && find_in_dirs(elf->dynamic.rpath, name, elf->path,
+			    out, size) == 0)
+		return 0;
+
+	if (find_in_dirs(getenv("LD_LIBRARY_PATH"), name, NULL,
+			 out, size) == 0
+	    || find_in_dirs(path, name, elf->path, out, size) == 0
+	    || find_in_ldcache(scan, name, out, size) == 0
+	    || find_in_dirs(DEFAULT_LIBRARY_PATH, name, NULL,
+			    out, size) == 0)
+		return 0;
+
+	return -1;
+}
+
+/* only objects that use libwayland can have protocol code */
+static int
+uses_wayland(struct elf *elf)
+{
+	const char **needed;
+
+	wl_array_for_each(needed, &elf->dynamic.needed)
+		if (strncmp(*needed, "libwayland-", 11) == 0)
+			return 1;
+
+	return 0;
+}
+
+static void
+scan_object(struct scan *scan, const char *path, int is_program)
+{
+	struct elf elf;
+	const char **needed;
+	char **object, lib[PATH_MAX];
+
+	wl_array_for_each(object, &scan->objects)
+		if (strcmp(*object, path) == 0)
+			return;
+
+	if (scan->objects.size / sizeof *object >= MAX_OBJECTS)
+		return;
+
+	object = wl_array_add(&scan->objects, sizeof *object);
+	if (!object)
+		return;
+
+	if (!(*object = strdup(path))) {
+		scan->objects.size -= sizeof *object;
+		return;
+	}
+
+	if (elf_open(&elf, *object) < 0)
+		return;
+
+	read_dynamic(&elf);
+	if (is_program || uses_wayland(&elf))
+		load_object(scan, &elf);
+
+	wl_array_for_each(needed, &elf.dynamic.needed)
+		if (find_library(scan, &elf, *needed, lib, sizeof lib) == 0)
+			scan_object(scan, lib, 0);
+
+	elf_close(&elf);
+}
+
+/* find the program like execvp() does */
+static int
+find_program(const char *program, char *out, size_t size)
+{
+	const char *path = getenv("PATH");
+	const char *dir, *end;
+	int ret;
+
+	if (strchr(program, '/'))
+		return snprintf(out, size, "%s", program) < (int) size ? 0 : -1;
+
+	if (!path)
+		path = DEFAULT_PATH;
+
+	for (dir = path; *dir; dir = *end ? end + 1 : end) {
+		end = strchrnul(dir, ':');
+		ret = snprintf(out, size, "%.*s/%s",
+			       (int) (end - dir), dir, program);
+		if (ret < (int) size && access(out, X_OK) == 0)
+			return 0;
+	}
+
+	return -1;
+}
+
+int
+wldbg_protocols_load_binary(const char *program)
+{
+	struct scan scan;
+	char path[PATH_MAX], **object;
+	int ret;
+
+	if (find_program(program, path, sizeof path) < 0)
+		return 0;
+
+	memset(&scan, 0, sizeof scan);
+	wl_array_init(&scan.objects);
+	wl_list_init(&scan.interfaces);
+
+	scan_object(&scan, path, 1);
+	ret = protocols_register(&scan.interfaces);
+
+	wl_array_for_each(object, &scan.objects)
+		free(*object);
+	wl_array_release(&scan.objects);
+
+	if (scan.ldcache)
+		munmap((void *) scan.ldcache, scan.ldcache_size);
+
+	return ret;
+}
+
+#else /* ELF_MACHINE */
+
+int
+wldbg_protocols_load_binary(const char *program)
+{
+	(void) program;
+
+	/* we do not know relocations of this architecture */
+	return 0;
+}
+
+#endif /* ELF_MACHINE */
@@ -0,0 +1,217 @@
+/*
+ * Copyright (c) 2015 Marek Chalupa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "wldbg.h"
+#include "wldbg-private.h"
+#include "wldbg-capture.h"
+#include "flight-recorder.h"
+
+struct wldbg_flight_recorder *
+wldbg_flight_recorder_create(size_t size)
+{
+	struct wldbg_flight_recorder *recorder;
+
+	recorder = calloc(1, sizeof *recorder);
+	if (!recorder)
+		return NULL;
+
+	/* records are aligned to 8 bytes */
+	recorder->size = size & ~(size_t) 7;
+	recorder->data = malloc(recorder->size);
+	if (!recorder->data) {
+		free(recorder);
+		return NULL;
+	}
+
+	return recorder;
+}
+
+void
+wldbg_flight_recorder_destroy(struct wldbg_flight_recorder *recorder)
+{
+	free(recorder->data);
+	free(recorder);
+}
+
+static struct wldbg_capture_record *
+record_at(struct wldbg_flight_recorder *recorder, size_t offset)
+{
+	return (struct wldbg_capture_record *)(recorder->data + offset);
+}
+
+/* where the record after the one at offset is. A record with size 0
+ * or no space for a record means that the next one is at the start */
+static size_t
+next_record(struct wldbg_flight_recorder *recorder, size_t offset)
+{
+	struct wldbg_capture_record *record = record_at(recorder, offset);
+
+	offset += sizeof *record + WLDBG_CAPTURE_ALIGN(record->size);
+	if (recorder->size - offset < sizeof *record
+	    || record_at(recorder, offset)->size == 0)
+		return 0;
+
+	return offset;
+}
+
+static void
+drop_oldest(struct wldbg_flight_recorder *recorder)
+{
+	recorder->tail = next_record(recorder, recorder->tail);
+	--recorder->records;
+}
+
+void *
+wldbg_flight_recorder_reserve(struct wldbg_flight_recorder *recorder,
+			      uint16_t size)
+{
+	struct wldbg_capture_record *record;
+	size_t len = sizeof *record + WLDBG_CAPTURE_ALIGN(size);
+
+	if (len > recorder->size) {
+		++recorder->dropped;
+		return NULL;
+	}
+
+	if (recorder->size - recorder->head < len) {
+		/* the rest of the ring is skipped, drop
+		 * the records that are there */
+		while (recorder->records > 0
+		       && recorder->tail >= recorder->head)
+			drop_oldest(recorder);
+
+		if (recorder->size - recorder->head >= sizeof *record)
+			record_at(recorder, recorder->head)->size = 0;
+
+		recorder->head = 0;
+	}
+
+	while (recorder->records > 0
+	       && recorder->tail >= recorder->head
+	       && recorder->tail < recorder->head + len)
+		drop_oldest(recorder);
+
+	if (recorder->records == 0)
+		recorder->tail = recorder->head;
+
+	recorder->reserved = recorder->head;
+	record = record_at(recorder, recorder->reserved);
+	record->size = size;
+
+	return record + 1;
+}
+
+void
+wldbg_flight_recorder_commit(struct wldbg_flight_recorder *recorder,
+			     struct wldbg_message *message, uint64_t time)
+{
+	struct wldbg_capture_record *record;
+
+	record = record_at(recorder, recorder->reserved);
+	wldbg_capture_record_init(record, message, time,
+				  record + 1, record->size);
+
+	recorder->head = recorder->reserved + sizeof *record
+		+ WLDBG_CAPTURE_ALIGN(record->size);
+	++recorder->records;
+}
+
+int
+wldbg_flight_recorder_write(struct wldbg_flight_recorder *recorder,
+			    struct wldbg_capture *capture)
+{
+	struct wldbg_capture_record *record;
+	size_t offset = recorder->tail;
+	uint32_t i;
+
+	for (i = 0; i < recorder->records; ++i) {
+		record = record_at(recorder, offset);
+		if (wldbg_capture_write_record(capture, record,
+					       record + 1) < 0)
+			return -1;
+
+		offset = next_record(recorder, offset);
+	}
+
+	return 0;
+}
+
+void
+wldbg_flight_recorder_clear(struct wldbg_flight_recorder *recorder)
+{
+	recorder->head = 0;
+	recorder->tail = 0;
+	recorder->records = 0;
+}
+
+int
+wldbg_flight_recorder_trigger(struct wldbg_connection *conn,
+			      const char *reason)
+{
+	if (!conn->flight_recorder)
+		return 0;
+
+	return wldbg_flight_recorder_dump(conn->wldbg, conn->flight_recorder,
+					  conn->id, reason);
+}
+
+int
+wldbg_flight_recorder_dump(struct wldbg *wldbg,
+			   struct wldbg_flight_recorder *recorder,
+			   unsigned int conn_id, const char *reason)
+{
+	struct wldbg_capture *capture;
+	unsigned int n;
+	char path[64];
+	int ret;
+
+	/* workers can write their rings at the same time */
+	n = __atomic_add_fetch(&wldbg->flight_recorder.dumps, 1,
+			       __ATOMIC_RELAXED);
+	snprintf(path, sizeof path, "wldbg-flight-%d-%u-%u.cap",
+		 getpid(), conn_id, n);
+
+	capture = wldbg_capture_create(path);
+	if (!capture)
+		return -1;
+
+	ret = wldbg_flight_recorder_write(recorder, capture);
+	wldbg_capture_destroy(capture);
+
+	fprintf(stderr, "Flight recorder (%s): %u messages of connection %u "
+		"written to %s\n", reason, recorder->records, conn_id, path);
+	if (recorder->dropped > 0)
+		fprintf(stderr, "Flight recorder: %lu messages did not fit "
+			"into the ring\n", recorder->dropped);
+
+	wldbg_flight_recorder_clear(recorder);
+
+	return ret;
+}
@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2015 Marek Chalupa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _WLDBG_FLIGHT_RECORDER_H_
+#define _WLDBG_FLIGHT_RECORDER_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "wldbg.h"
+
+struct wldbg_capture;
+struct wldbg_connection;
+
+/*
+ * Flight recorder keeps the last messages of a connection in a ring
+ * that is allocated when the connection is created. Records in the
+ * ring look the same as in capture files (wldbg-capture.h), so when
+ * something goes wrong (wl_display.error, a breakpoint, SIGUSR1,
+ * the client crashed) the ring is written into a capture file.
+ *
+ * Records are never split at the end of the ring, the rest
+ * of the ring is skipped instead.
+ */
+struct wldbg_flight_recorder {
+	char *data;
+	size_t size;
+
+	/* the oldest record and the place for the next one */
+	size_t tail;
+	size_t head;
+	uint32_t records;
+
+	/* the place that was given by reserve() */
+	size_t reserved;
+	/* messages that did not fit into the ring at all */
+	unsigned long dropped;
+};
+
+struct wldbg_flight_recorder *
+wldbg_flight_recorder_create(size_t size);
+
+void
+wldbg_flight_recorder_destroy(struct wldbg_flight_recorder *recorder);
+
+/* place for data of a message of given size in the ring, old records
+ * are dropped to make the space. NULL if the message is bigger
+ * than the ring. The data must be copied there and the message
+ * committed before the next reserve */
+void *
+wldbg_flight_recorder_reserve(struct wldbg_flight_recorder *recorder,
+			      uint16_t size);
+
+void
+wldbg_flight_recorder_commit(struct wldbg_flight_recorder *recorder,
+			     struct wldbg_message *message, uint64_t time);
+
+/* write the records from the oldest one */
+int
+wldbg_flight_recorder_write(struct wldbg_flight_recorder *recorder,
+			    struct wldbg_capture *capture);
+
+void
+wldbg_flight_recorder_clear(struct wldbg_flight_recorder *recorder);
+
+/* write the ring of the connection into a new capture file
+ * and clear it. reason is for the user */
+int
+wldbg_flight_recorder_trigger(struct wldbg_connection *conn,
+			      const char *reason);
+
+/* the same for a ring of the connection with id conn_id,
+ * that may be gone already */
+int
+wldbg_flight_recorder_dump(struct wldbg *wldbg,
+			   struct wldbg_flight_recorder *recorder,
+			   unsigned int conn_id, const char *reason);
+
+#endif /* _WLDBG_FLIGHT_RECORDER_H_ */
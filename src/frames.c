@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2015 Marek Chalupa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "frames.h"
+#include "wayland/wayland-private.h"
+
+/* header of a message - object id and opcode with size */
+#define HEADER_SIZE	(2 * sizeof(uint32_t))
+
+void
+wldbg_frames_init(struct wldbg_frames *frames)
+{
+	wl_array_init(&frames->index);
+	frames->num = 0;
+	frames->length = 0;
+}
+
+void
+wldbg_frames_release(struct wldbg_frames *frames)
+{
+	wl_array_release(&frames->index);
+	frames->num = 0;
+	frames->length = 0;
+}
+
+int
+wldbg_frames_scan(struct wldbg_frames *frames,
+		  struct wl_connection *conn,
+		  size_t len, size_t max_size)
+{
+	uint32_t header[2], *p;
+	struct wldbg_frame *frame;
+	size_t offset = 0, size;
+
+	/* keep the memory, we'll need it on the next read again */
+	frames->index.size = 0;
+	frames->num = 0;
+	frames->length = 0;
+
+	while (offset + HEADER_SIZE <= len) {
+		p = wl_connection_peek(conn, offset, HEADER_SIZE, header);
+		size = p[1] >> 16;
+
+		/* the message would never fit into the buffer
+		 * or the size is just garbage */
+		if (size < HEADER_SIZE || size % sizeof(uint32_t) != 0
+		    || size > max_size) {
+			fprintf(stderr, "Invalid size of message: %lu "
+				"(object %u, offset %lu)\n",
+				(unsigned long) size, p[0],
+				(unsigned long) offset);
+			errno = EINVAL;
+			return -1;
+		}
+
+		/* partial message, wait for the rest */
+		if (offset + size > len)
+			break;
+
+		frame = wl_array_add(&frames->index, sizeof *frame);
+		if (!frame)
+			return -1;
+
+		frame->offset = offset;
+		frame->size = size;
+		++frames->num;
+
+		offset += size;
+	}
+
+	frames->length = offset;
+
+	return frames->num;
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2015 Marek Chalupa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _WLDBG_FRAMES_H_
+#define _WLDBG_FRAMES_H_
+
+#include <stddef.h>
+
+#include "wldbg.h"
+#include "wayland/wayland-util.h"
+
+struct wl_connection;
+
+/*
+ * Index of complete messages in the input buffer of a connection.
+ * A read can end in the middle of a message, the rest of the message
+ * then stays in the input buffer until the next read completes it.
+ */
+struct wldbg_frames {
+	/* array of struct wldbg_frame */
+	struct wl_array index;
+	unsigned int num;
+	/* bytes taken by the complete messages */
+	size_t length;
+};
+
+void
+wldbg_frames_init(struct wldbg_frames *frames);
+
+void
+wldbg_frames_release(struct wldbg_frames *frames);
+
+/* go through the first len bytes of the input buffer of conn and
+ * index the complete messages. Messages can not be bigger
+ * than max_size. Returns the number of complete messages
+ * or -1 if some message has invalid size */
+int
+wldbg_frames_scan(struct wldbg_frames *frames,
+		  struct wl_connection *conn,
+		  size_t len, size_t max_size);
+
+static inline struct wldbg_frame *
+wldbg_frames_get(struct wldbg_frames *frames, unsigned int i)
+{
+	return (struct wldbg_frame *) frames->index.data + i;
+}
+
+#endif /* _WLDBG_FRAMES_H_ */
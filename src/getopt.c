@@ -26,10 +26,17 @@
 #define _GNU_SOURCE
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
 #include <assert.h>
 
 #include "wldbg-private.h"
 #include "getopt.h"
+#include "util.h"
+#include "observers.h"
+#include "poller.h"
+#include "wldbg-capture.h"
+#include "wayland/wayland-private.h"
 
 static int
 is_prefix_of(const char *what, const char *src)
@@ -52,10 +59,45 @@ is_prefix_of(const char *what, const char *src)
 	return 1;
 }
 
+/* parse size of a buffer, the number can be followed by k or m.
+ * what is the name of the buffer for the error message */
+static int
+parse_size(const char *what, const char *str, unsigned long min,
+	   unsigned int *size)
+{
+	char *end;
+	unsigned long val;
+
+	errno = 0;
+	val = strtoul(str, &end, 10);
+	if (errno || end == str)
+		goto err;
+
+	if (*end == 'k' || *end == 'K') {
+		val *= 1024;
+		++end;
+	} else if (*end == 'm' || *end == 'M') {
+		val *= 1024 * 1024;
+		++end;
+	}
+
+	if (*end != '\0' || val < min || val > (1UL << 30))
+		goto err;
+
+	*size = val;
+	return 0;
+
+err:
+	fprintf(stderr, "Error: invalid %s '%s' "
+			"(must be between %lu and 1G)\n",
+		what, str, min);
+	return -1;
+}
+
 static int
 set_opt(const char *arg, struct wldbg_options *opts)
 {
-	int match = 0;
+	int match = 0, n;
 
 	if (*arg == '\0') {
 		fprintf(stderr, "Error: empty option\n");
@@ -75,6 +117,124 @@ set_opt(const char *arg, struct wldbg_options *opts)
 	} else if (is_prefix_of(arg, "pass-whole-buffer")) {
 		dbg("Command line option: pass-whole-buffer\n");
 		opts->pass_whole_buffer = 1;
+		match = 1;
+	} else if (is_prefix_of(arg, "batch-forward")) {
+		dbg("Command line option: batch-forward\n");
+		opts->batch_forward = 1;
+		match = 1;
+	} else if (is_prefix_of("workers=", arg)) {
+		dbg("Command line option: %s\n", arg);
+		n = str_to_uint((char *) arg + sizeof("workers=") - 1);
+		if (n <= 0) {
+			fprintf(stderr, "Error: invalid number of workers: %s\n",
+				arg + sizeof("workers=") - 1);
+			return 0;
+		}
+
+		opts->workers = n;
+		match = 1;
+	} else if (is_prefix_of("buffer-size=", arg)) {
+		dbg("Command line option: %s\n", arg);
+		/* smaller buffer could not hold the biggest message */
+		if (parse_size("buffer size",
+			       arg + sizeof("buffer-size=") - 1,
+			       WL_BUFFER_DEFAULT_SIZE, &opts->buffer_size) < 0)
+			return 0;
+
+		match = 1;
+	} else if (is_prefix_of("max-buffer-size=", arg)) {
+		dbg("Command line option: %s\n", arg);
+		if (parse_size("maximal buffer size",
+			       arg + sizeof("max-buffer-size=") - 1,
+			       WL_BUFFER_DEFAULT_SIZE,
+			       &opts->max_buffer_size) < 0)
+			return 0;
+
+		match = 1;
+	} else if (is_prefix_of("flight-recorder=", arg)) {
+		dbg("Command line option: %s\n", arg);
+		/* the ring must hold at least one record
+		 * with the biggest message */
+		if (parse_size("flight recorder size",
+			       arg + sizeof("flight-recorder=") - 1,
+			       sizeof(struct wldbg_capture_record)
+			       + WL_BUFFER_DEFAULT_SIZE,
+			       &opts->flight_recorder) < 0)
+			return 0;
+
+		match = 1;
+	} else if (is_prefix_of(arg, "pass-stats")) {
+		dbg("Command line option: pass-stats\n");
+		opts->pass_stats = 1;
+		match = 1;
+	} else if (is_prefix_of(arg, "latency")) {
+		dbg("Command line option: latency\n");
+		opts->latency = 1;
+		match = 1;
+	} else if (is_prefix_of("observers=", arg)) {
+		dbg("Command line option: %s\n", arg);
+		if (strcmp(arg, "observers=block") == 0) {
+			opts->observers = WLDBG_OBSERVERS_BLOCK;
+		} else if (strcmp(arg, "observers=drop-newest") == 0) {
+			opts->observers = WLDBG_OBSERVERS_DROP_NEWEST;
+		} else if (strcmp(arg, "observers=count-drops") == 0) {
+			opts->observers = WLDBG_OBSERVERS_COUNT_DROPS;
+		} else {
+			fprintf(stderr, "Error: unknown policy for observers: %s\n",
+				arg + sizeof("observers=") - 1);
+			return 0;
+		}
+
+		match = 1;
+	} else if (is_prefix_of("replay=", arg)) {
+		dbg("Command line option: %s\n", arg);
+		opts->replay = arg + sizeof("replay=") - 1;
+		if (*opts->replay == '\0') {
+			fprintf(stderr, "Error: no capture file to replay\n");
+			return 0;
+		}
+
+		match = 1;
+	} else if (is_prefix_of("replay-from=", arg)) {
+		dbg("Command line option: %s\n", arg);
+		n = str_to_uint((char *) arg + sizeof("replay-from=") - 1);
+		if (n < 0) {
+			fprintf(stderr, "Error: invalid number of seconds: %s\n",
+				arg + sizeof("replay-from=") - 1);
+			return 0;
+		}
+
+		opts->replay_from = n;
+		match = 1;
+	} else if (is_prefix_of("protocols=", arg)) {
+		dbg("Command line option: %s\n", arg);
+		opts->protocols = arg + sizeof("protocols=") - 1;
+		match = 1;
+	} else if (is_prefix_of("event-loop=", arg)) {
+		dbg("Command line option: %s\n", arg);
+		if (strcmp(arg, "event-loop=epoll") == 0) {
+			opts->event_loop = WLDBG_POLLER_EPOLL;
+		} else if (strcmp(arg, "event-loop=io_uring") == 0) {
+			opts->event_loop = WLDBG_POLLER_IO_URING;
+		} else {
+			fprintf(stderr, "Error: unknown event loop: %s\n",
+				arg + sizeof("event-loop=") - 1);
+			return 0;
+		}
+
+		match = 1;
+	} else if (is_prefix_of("balance=", arg)) {
+		dbg("Command line option: %s\n", arg);
+		if (strcmp(arg, "balance=round-robin") == 0) {
+			opts->least_loaded = 0;
+		} else if (strcmp(arg, "balance=least-loaded") == 0) {
+			opts->least_loaded = 1;
+		} else {
+			fprintf(stderr, "Error: unknown balancing: %s\n",
+				arg + sizeof("balance=") - 1);
+			return 0;
+		}
+
 		match = 1;
 	} else if (is_prefix_of(arg, "objinfo")) {
 		dbg("Command line option: objinfo\n");
@@ -99,6 +259,12 @@ int get_opts(int argc, char *argv[], struct wldbg_options *opts)
 			break;
 		}
 
+		/* the only option with separate value */
+		if (strcmp("--replay", argv[n]) == 0 && n + 1 < argc) {
+			opts->replay = argv[++n];
+			continue;
+		}
+
 		/* options */
 		if (is_prefix_of("--", argv[n])) {
 			if (!set_opt(argv[n] + 2, opts))
@@ -31,6 +31,41 @@ struct wldbg_options {
 	unsigned int objinfo           : 1;
 	unsigned int server_mode       : 1;
 	unsigned int pass_whole_buffer : 1;
+	unsigned int batch_forward     : 1;
+	/* hand connections to the least loaded worker
+	 * instead of round-robin */
+	unsigned int least_loaded      : 1;
+	/* measure how long messages spend in wldbg */
+	unsigned int latency           : 1;
+	/* measure how long passes run */
+	unsigned int pass_stats        : 1;
+
+	/* run observer passes in the background with this
+	 * policy (enum wldbg_observers_policy), 0 means inline */
+	unsigned int observers;
+
+	/* what the main loop waits on
+	 * (enum wldbg_poller_backend), epoll by default */
+	unsigned int event_loop;
+
+	/* number of worker threads in server mode */
+	unsigned int workers;
+
+	/* initial and maximal size of connection buffers */
+	unsigned int buffer_size;
+	unsigned int max_buffer_size;
+
+	/* size of the flight recorder's ring for every connection */
+	unsigned int flight_recorder;
+
+	/* capture file to replay instead of running a program */
+	const char *replay;
+	/* skip this many seconds of the capture */
+	unsigned int replay_from;
+
+	/* protocol XML files or directories with them (separated
+	 * by ':') that are loaded before the default ones */
+	const char *protocols;
 
 	/* parsed path to the program and
 	 * its arguments */
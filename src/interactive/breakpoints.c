@@ -218,8 +218,7 @@ create_breakpoint(struct wldbg_message *message, char *buf)
 			*at = 0;
 			intf = wldbg_message_get_interface(message, buf);
 			if (!intf) {
-				printf("Wldbg does not know the interface. "
-				       "It has not been probably resolved yet\n");
+				printf("Wldbg does not know the interface\n");
 				goto err;
 			}
 
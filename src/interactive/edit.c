@@ -78,6 +78,7 @@ static int
 read_message_from_tmpfile(char *file, struct wldbg_message *message)
 {
 	int fd, ret;
+	size_t size;
 	assert(file);
 
 	fd = open(file, O_RDONLY);
@@ -86,16 +87,20 @@ read_message_from_tmpfile(char *file, struct wldbg_message *message)
 		return -1;
 	}
 
-	/* XXX do not use hard-coded numbers... */
-	/* size of the buffer is 4096 atm */
-	ret = read(fd, message->data, 4096);
+	/* get a private copy of the message that we can overwrite */
+	wldbg_message_make_writable(message);
+
+	/* the private buffer is as big as the biggest
+	 * connection buffer */
+	size = message->connection->wldbg->max_buffer_size;
+	ret = read(fd, message->data, size);
 	if (ret < 0) {
 		perror("Reading tmp file\n");
 		close(fd);
 		return -1;
 	}
 
-	assert(ret <= 4096);
+	assert((size_t) ret <= size);
 	message->size = ret;
 
 	close(fd);
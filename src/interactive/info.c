@@ -35,18 +35,24 @@
 static void
 print_object(uint32_t id, const struct wl_interface *intf, void *data)
 {
-	(void) data;
+	struct wldbg_message *message = data;
+	uint32_t version = wldbg_message_get_object_version(message, id);
+
 	if (id >= WL_SERVER_ID_START)
-		printf("\tSRV %u -> %s\n",
+		printf("\tSRV %u -> %s",
 		       id - WL_SERVER_ID_START, intf ? intf->name : "NULL");
 	else
-		printf("\t%u -> %s\n", id, intf ? intf->name : "NULL");
+		printf("\t%u -> %s", id, intf ? intf->name : "NULL");
+
+	if (version)
+		printf(" v%u", version);
+	putchar('\n');
 }
 
 static void
 print_objects(struct wldbg_message *message)
 {
-	wldbg_message_objects_iterate(message, print_object, NULL);
+	wldbg_message_objects_iterate(message, print_object, message);
 }
 
 static void
@@ -109,14 +115,36 @@ info_wldbg(struct wldbg_interactive *wldbgi)
 	printf("Flags:"
 	       "\tpass_whole_buffer : %u\n"
 	       "\trunning           : %u\n"
-	       "\terror             : %u\n"
-	       "\texit              : %u\n"
-	       "\tserver_mode       : %u\n",
+	       "\terror             : %d\n"
+	       "\texit              : %d\n"
+	       "\tserver_mode       : %u\n"
+	       "\tbatch_forward     : %u\n",
 	       wldbg->flags.pass_whole_buffer,
 	       wldbg->flags.running,
-	       wldbg->flags.error,
-	       wldbg->flags.exit,
-	       wldbg->flags.server_mode);
+	       wldbg_has_error(wldbg),
+	       wldbg_should_exit(wldbg),
+	       wldbg->flags.server_mode,
+	       wldbg->flags.batch_forward);
+
+	printf("Loop:\n"
+	       "\titerations        : %lu\n"
+	       "\tready events      : %lu\n"
+	       "\tevents per wakeup : %.2f (max %u)\n"
+	       "\treads             : %lu\n"
+	       "\tmessages          : %lu (%.2f per read)\n"
+	       "\tbuffer size       : %u (max %u)\n",
+	       wldbg->statistics.loop_iterations,
+	       wldbg->statistics.ready_events,
+	       wldbg->statistics.loop_iterations ?
+		(double) wldbg->statistics.ready_events
+			/ wldbg->statistics.loop_iterations : 0.0,
+	       wldbg->statistics.max_ready_events,
+	       wldbg->statistics.reads,
+	       wldbg->statistics.messages,
+	       wldbg->statistics.reads ?
+		(double) wldbg->statistics.messages
+			/ wldbg->statistics.reads : 0.0,
+	       wldbg->buffer_size, wldbg->max_buffer_size);
 
 	if (!wldbg->flags.server_mode)
 		return;
@@ -152,7 +180,9 @@ info_connections(struct wldbg_interactive *wldbgi)
 
 		printf("%d.\n", n);
 		printf("\tserver: pid=%d\n", conn->server.pid);
+		printf("\t      : paused=%lu times\n", conn->server.flow.pauses);
 		printf("\tclient: pid=%d\n", conn->client.pid);
+		printf("\t      : paused=%lu times\n", conn->client.flow.pauses);
 		printf("\t      : program=\'%s\'\n", conn->client.program);
 		printf("\t      : path=\'%s\'\n", conn->client.path);
 		printf("\t      : argc=\'%d\'\n", conn->client.argc);
@@ -163,6 +193,28 @@ info_connections(struct wldbg_interactive *wldbgi)
 	}
 }
 
+static void
+info_latency(struct wldbg_interactive *wldbgi)
+{
+	struct wldbg *wldbg = wldbgi->wldbg;
+	struct wldbg_connection *conn;
+	int n = 0;
+
+	if (!wldbg->flags.latency) {
+		printf("Latency is not measured (run wldbg with --latency)\n");
+		return;
+	}
+
+	wl_list_for_each(conn, &wldbg->connections, link) {
+		++n;
+
+		printf("%d. %s (%d)\n", n,
+		       conn->client.program ? conn->client.program : "?",
+		       conn->client.pid);
+		wldbg_latency_print(conn->latency);
+	}
+}
+
 void
 cmd_info_help(int oneline)
 {
@@ -179,7 +231,8 @@ cmd_info_help(int oneline)
 	       "breakpoints (b)\n"
 	       "filters (f)\n"
 	       "process (proc, p)\n"
-	       "connection (conn, c)\n");
+	       "connection (conn, c)\n"
+	       "latency (l)\n");
 }
 
 void
@@ -227,6 +280,8 @@ cmd_info(struct wldbg_interactive *wldbgi,
 	} else if (MATCH(buf, "c") || MATCH(buf, "conn")
 		   || MATCH(buf, "connection")) {
 		info_connections(wldbgi);
+	} else if (MATCH(buf, "l") || MATCH(buf, "latency")) {
+		info_latency(wldbgi);
 	} else {
 		printf("Unknown arguments\n");
 		cmd_info_help(0);
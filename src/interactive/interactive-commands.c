@@ -63,7 +63,7 @@ cmd_quit(struct wldbg_interactive *wldbgi,
 	(void) buf;
 
 	if (wldbgi->wldbg->flags.running
-		&& !wldbgi->wldbg->flags.error
+		&& !wldbg_has_error(wldbgi->wldbg)
 		&& !wl_list_empty(&wldbgi->wldbg->connections)) {
 
 		printf("Program seems running. "
@@ -84,7 +84,7 @@ cmd_quit(struct wldbg_interactive *wldbgi,
 
 	dbg("Exiting...\n");
 
-	wldbgi->wldbg->flags.exit = 1;
+	wldbg_exit(wldbgi->wldbg);
 
 	return CMD_END_QUERY;
 }
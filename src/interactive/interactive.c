@@ -46,6 +46,7 @@
 #include "passes.h"
 #include "getopt.h"
 #include "util.h"
+#include "flight-recorder.h"
 
 #include "interactive.h"
 #include "input.h"
@@ -68,8 +69,8 @@ query_user(struct wldbg_interactive *wldbgi, struct wldbg_message *message)
 		/* free previous buffer, free(NULL) is a no-op */
 		free(buf);
 
-		if (wldbgi->wldbg->flags.exit
-			|| wldbgi->wldbg->flags.error) {
+		if (wldbg_should_exit(wldbgi->wldbg)
+			|| wldbg_has_error(wldbgi->wldbg)) {
 			/* we freed the buf, prevent free after
 			 * the loop to double-free the memory */
 			buf = NULL;
@@ -209,6 +210,9 @@ process_interactive(void *user_data, struct wldbg_message *message)
 	wl_list_for_each(b, &wldbgi->breakpoints, link) {
 		if (b->applies(message, b)) {
 			wldbgi->stop = 1;
+			/* what led to the breakpoint */
+			wldbg_flight_recorder_trigger(message->connection,
+						      "breakpoint");
 			/* reset skip_message flag, we want
 			 * to stop on this message */
 			skip_message = 0;
@@ -258,7 +262,7 @@ wldbgi_destory(void *data)
 
 	dbg("Destroying wldbgi\n");
 
-	wldbgi->wldbg->flags.exit = 1;
+	wldbg_exit(wldbgi->wldbg);
 
 	if (wldbgi->client.path)
 		free(wldbgi->client.path);
@@ -325,6 +329,7 @@ interactive_init(struct wldbg *wldbg)
 
 	/* insert always at the end */
 	wl_list_insert(wldbg->passes.prev, &pass->link);
+	wldbg_passes_changed(wldbg);
 
 	pass->wldbg_pass.init = NULL;
 	/* XXX ! */
@@ -163,23 +163,18 @@ print_objinfo(struct wldbg_objects_info *oi, struct wldbg_object_info *info)
 }
 
 static void
-print_all_objinfo(struct wldbg_objects_info *oi)
+print_one_objinfo(uint32_t id, void *info, void *oi)
 {
+	(void) id;
 
-	unsigned int i;
-	struct wldbg_object_info *info;
-
-	for (i = 0; i < oi->client_objects.count; ++i) {
-		info = wldbg_ids_map_get(&oi->client_objects, i);
-		if (info)
-			print_objinfo(oi, info);
-	}
+	print_objinfo(oi, info);
+}
 
-	for (i = 0; i < oi->server_objects.count; ++i) {
-		info = wldbg_ids_map_get(&oi->server_objects, i);
-		if (info)
-			print_objinfo(oi, info);
-	}
+static void
+print_all_objinfo(struct wldbg_objects_info *oi)
+{
+	wldbg_ids_map_for_each(&oi->client_objects, print_one_objinfo, oi);
+	wldbg_ids_map_for_each(&oi->server_objects, print_one_objinfo, oi);
 }
 
 void
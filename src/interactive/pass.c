@@ -67,6 +67,7 @@ add_pass(struct wldbg *wldbg, const char *name)
 		} else {
 			/* insert always at the head */
 			wl_list_insert(wldbg->passes.next, &pass->link);
+			wldbg_passes_changed(wldbg);
 
 			dbg("Added pass '%s'\n", name);
 		}
@@ -81,6 +82,15 @@ loaded_passes(struct wldbg *wldbg)
 	struct pass *pass;
 
 	printf("Loaded passes:\n");
+
+	/* with --pass-stats show how expensive they are */
+	if (wldbg->flags.pass_stats) {
+		pass_print_statistics_header();
+		wl_list_for_each(pass, &wldbg->passes, link)
+			pass_print_statistics(pass);
+		return;
+	}
+
 	wl_list_for_each(pass, &wldbg->passes, link) {
 		printf("\t - %s\n", pass->name);
 	}
@@ -96,6 +106,7 @@ remove_pass(struct wldbg *wldbg, const char *name)
 	wl_list_for_each_safe(pass, tmp, &wldbg->passes, link) {
 		if (strcmp(pass->name, name) == 0) {
 			wl_list_remove(&pass->link);
+			wldbg_passes_changed(wldbg);
 
 			free(pass->name);
 			free(pass);
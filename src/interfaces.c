@@ -0,0 +1,403 @@
+/*
+ * Copyright (c) 2015 Marek Chalupa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "wayland/wayland-util.h"
+
+#include "wldbg.h"
+#include "wldbg-parse-message.h"
+#include "interfaces.h"
+
+struct pointer_slot {
+	const struct wl_interface *interface;
+	uint32_t id;
+	/* events and then requests of this copy of the interface */
+	struct wldbg_signature *signatures;
+};
+
+static struct {
+	/* interfaces indexed by id, the first one is NULL */
+	const struct wl_interface **interfaces;
+	uint32_t count;
+	uint32_t capacity;
+
+	/* open addressing tables with the same size (a power of two).
+	 * names has ids, pointers has every copy of an interface */
+	uint32_t *names;
+	struct pointer_slot *pointers;
+	uint32_t size;
+	uint32_t pointers_num;
+} registry;
+
+static uint32_t
+hash_name(const char *name)
+{
+	/* FNV-1a */
+	uint32_t hash = 2166136261u;
+
+	while (*name) {
+		hash ^= (unsigned char) *name++;
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+static uint32_t
+hash_pointer(const struct wl_interface *intf)
+{
+	uintptr_t p = (uintptr_t) intf;
+
+	return (uint32_t) ((p >> 4) * 2654435761u);
+}
+
+static uint32_t *
+find_name(uint32_t *names, uint32_t size, const char *name)
+{
+	uint32_t i = hash_name(name) & (size - 1);
+
+	while (names[i]
+	       && strcmp(registry.interfaces[names[i]]->name, name) != 0)
+		i = (i + 1) & (size - 1);
+
+	return &names[i];
+}
+
+static struct pointer_slot *
+find_pointer(struct pointer_slot *pointers, uint32_t size,
+	     const struct wl_interface *intf)
+{
+	uint32_t i = hash_pointer(intf) & (size - 1);
+
+	while (pointers[i].interface && pointers[i].interface != intf)
+		i = (i + 1) & (size - 1);
+
+	return &pointers[i];
+}
+
+static int
+grow_tables(void)
+{
+	uint32_t *names, size, i;
+	struct pointer_slot *pointers;
+
+	size = registry.size ? registry.size * 2 : 64;
+	names = calloc(size, sizeof *names);
+	pointers = calloc(size, sizeof *pointers);
+	if (!names || !pointers) {
+		free(names);
+		free(pointers);
+		return -1;
+	}
+
+	for (i = 1; i < registry.count; ++i)
+		*find_name(names, size, registry.interfaces[i]->name) = i;
+
+	for (i = 0; i < registry.size; ++i) {
+		if (registry.pointers[i].interface)
+			*find_pointer(pointers, size,
+				      registry.pointers[i].interface)
+				= registry.pointers[i];
+	}
+
+	free(registry.names);
+	free(registry.pointers);
+	registry.names = names;
+	registry.pointers = pointers;
+	registry.size = size;
+
+	return 0;
+}
+
+int
+wldbg_signature_compile(struct wldbg_signature *sig, const char *signature)
+{
+	const char *s;
+	unsigned int n = 0;
+
+	memset(sig, 0, sizeof *sig);
+
+	/* the version at the start */
+	for (s = signature; *s >= '0' && *s <= '9'; ++s)
+		sig->since = sig->since * 10 + (*s - '0');
+	if (sig->since == 0)
+		sig->since = 1;
+
+	for (; *s; ++s) {
+		switch (*s) {
+		case '?':
+			sig->nullable |= 1u << n;
+			continue;
+		case 's':
+		case 'a':
+			if (!sig->varlen && !sig->fds)
+				sig->first_varlen = n;
+			sig->varlen |= 1u << n;
+			break;
+		case 'n':
+			sig->new_ids[sig->new_ids_num++] = n;
+			break;
+		case 'h':
+			if (!sig->varlen && !sig->fds)
+				sig->first_varlen = n;
+			sig->fds |= 1u << n;
+			++sig->fds_num;
+			break;
+		case 'i':
+		case 'u':
+		case 'f':
+		case 'o':
+			break;
+		default:
+			/* digits elsewhere are ignored like in libwayland */
+			if (*s >= '0' && *s <= '9')
+				continue;
+			return -1;
+		}
+
+		if (n == WLDBG_SIGNATURE_MAX_ARGS)
+			return -1;
+
+		sig->types[n++] = *s;
+	}
+
+	sig->args_num = n;
+	if (!sig->varlen && !sig->fds)
+		sig->first_varlen = n;
+
+	return 0;
+}
+
+/* signatures of events and requests. Messages with invalid
+ * signature get args_num 0xff */
+static struct wldbg_signature *
+compile_interface(const struct wl_interface *intf)
+{
+	struct wldbg_signature *sigs;
+	const struct wl_message *msg;
+	int i, count = intf->event_count + intf->method_count;
+
+	sigs = calloc(count > 0 ? count : 1, sizeof *sigs);
+	if (!sigs)
+		return NULL;
+
+	for (i = 0; i < count; ++i) {
+		if (i < intf->event_count)
+			msg = &intf->events[i];
+		else
+			msg = &intf->methods[i - intf->event_count];
+
+		if (!msg->signature
+		    || wldbg_signature_compile(&sigs[i], msg->signature) < 0)
+			sigs[i].args_num = 0xff;
+	}
+
+	return sigs;
+}
+
+/* interfaces of objects in arguments are known too */
+static void
+add_types(const struct wl_interface *intf,
+	  const struct wldbg_signature *sigs)
+{
+	const struct wl_message *msg;
+	int i, n, count = intf->event_count + intf->method_count;
+
+	for (i = 0; i < count; ++i) {
+		if (i < intf->event_count)
+			msg = &intf->events[i];
+		else
+			msg = &intf->methods[i - intf->event_count];
+
+		if (!msg->types || sigs[i].args_num == 0xff)
+			continue;
+
+		/* types are indexed by arguments */
+		for (n = 0; n < sigs[i].args_num; ++n) {
+			if (msg->types[n])
+				wldbg_interfaces_add(msg->types[n]);
+		}
+	}
+}
+
+static int
+grow_interfaces(void)
+{
+	const struct wl_interface **interfaces;
+	uint32_t capacity;
+
+	capacity = registry.capacity ? registry.capacity * 2 : 64;
+	interfaces = realloc(registry.interfaces,
+			     capacity * sizeof *interfaces);
+	if (!interfaces)
+		return -1;
+
+	/* id 0 is for unknown interfaces */
+	if (registry.count == 0) {
+		interfaces[0] = NULL;
+		registry.count = 1;
+	}
+
+	registry.interfaces = interfaces;
+	registry.capacity = capacity;
+
+	return 0;
+}
+
+uint32_t
+wldbg_interfaces_add(const struct wl_interface *intf)
+{
+	struct pointer_slot *slot;
+	struct wldbg_signature *signatures;
+	uint32_t *name, id;
+
+	/* keep the load under 1/2 */
+	if ((registry.pointers_num + 1) * 2 > registry.size
+	    && grow_tables() < 0)
+		goto err;
+
+	slot = find_pointer(registry.pointers, registry.size, intf);
+	if (slot->interface)
+		return slot->id;
+
+	/* a copy of a known interface gets its id */
+	name = find_name(registry.names, registry.size, intf->name);
+	if (!*name) {
+		if (registry.count >= registry.capacity
+		    && grow_interfaces() < 0)
+			goto err;
+
+		registry.interfaces[registry.count] = intf;
+		*name = registry.count++;
+	}
+
+	signatures = compile_interface(intf);
+	if (!signatures)
+		goto err;
+
+	slot->interface = intf;
+	slot->id = *name;
+	slot->signatures = signatures;
+	++registry.pointers_num;
+
+	/* this can grow the tables, slot is not valid after it */
+	id = slot->id;
+	add_types(intf, signatures);
+
+	return id;
+
+err:
+	fprintf(stderr, "Out of memory for interfaces\n");
+	return 0;
+}
+
+void
+wldbg_interfaces_clear(void)
+{
+	uint32_t i;
+
+	for (i = 0; i < registry.size; ++i)
+		free(registry.pointers[i].signatures);
+
+	free(registry.interfaces);
+	free(registry.names);
+	free(registry.pointers);
+	memset(&registry, 0, sizeof registry);
+}
+
+uint32_t
+wldbg_interface_id(const struct wl_interface *intf)
+{
+	struct pointer_slot *slot;
+
+	if (!intf || registry.size == 0)
+		return 0;
+
+	slot = find_pointer(registry.pointers, registry.size, intf);
+	if (slot->interface)
+		return slot->id;
+
+	/* a copy that we have not seen, its name can still be known */
+	return *find_name(registry.names, registry.size, intf->name);
+}
+
+const struct wl_interface *
+wldbg_interface_get(uint32_t id)
+{
+	if (id == 0 || id >= registry.count)
+		return NULL;
+
+	return registry.interfaces[id];
+}
+
+const struct wl_interface *
+wldbg_interface_lookup(const char *name)
+{
+	if (registry.count == 0)
+		return NULL;
+
+	return registry.interfaces[*find_name(registry.names,
+					      registry.size, name)];
+}
+
+uint32_t
+wldbg_interfaces_count(void)
+{
+	return registry.count;
+}
+
+const struct wldbg_signature *
+wldbg_interface_get_signature(const struct wl_interface *intf,
+			      int from, uint32_t opcode)
+{
+	struct pointer_slot *slot;
+	const struct wldbg_signature *sig;
+
+	if (!intf || registry.size == 0)
+		return NULL;
+
+	slot = find_pointer(registry.pointers, registry.size, intf);
+	if (!slot->interface)
+		return NULL;
+
+	if (from == SERVER) {
+		if (opcode >= (uint32_t) intf->event_count)
+			return NULL;
+		sig = &slot->signatures[opcode];
+	} else {
+		if (opcode >= (uint32_t) intf->method_count)
+			return NULL;
+		sig = &slot->signatures[intf->event_count + opcode];
+	}
+
+	if (sig->args_num == 0xff)
+		return NULL;
+
+	return sig;
+}
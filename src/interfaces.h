@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2015 Marek Chalupa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _WLDBG_INTERFACES_H_
+#define _WLDBG_INTERFACES_H_
+
+#include <stdint.h>
+
+struct wl_interface;
+
+/*
+ * Registry of interfaces that wldbg knows. Names are interned: every
+ * name has one interface and a small dense id (from 1, 0 means
+ * unknown), so per-interface data can be kept in arrays indexed
+ * by the id. Other copies of an interface with the same name
+ * (e.g. from a client's library) get the same id.
+ *
+ * Signatures of all messages are compiled when the interface is
+ * added (see wldbg-parse-message.h) and interfaces that the messages
+ * refer to are added too.
+ *
+ * Interfaces are added only while initializing, before any
+ * connection exists, so that worker threads can read the
+ * registry without locking. Lookups are in wldbg.h.
+ */
+
+/* returns the id of the interface or 0 on error */
+uint32_t
+wldbg_interfaces_add(const struct wl_interface *intf);
+
+void
+wldbg_interfaces_clear(void);
+
+#endif /* _WLDBG_INTERFACES_H_ */
@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2015 Marek Chalupa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <time.h>
+
+#include "wldbg.h"
+#include "latency.h"
+
+#define SUB_BITS	WLDBG_HISTOGRAM_SUB_BITS
+#define SUB_COUNT	(1U << SUB_BITS)
+
+static unsigned int
+bucket_of(uint64_t value)
+{
+	unsigned int e;
+
+	if (value >= (uint64_t) 1 << WLDBG_HISTOGRAM_MAX_BITS)
+		value = ((uint64_t) 1 << WLDBG_HISTOGRAM_MAX_BITS) - 1;
+
+	if (value < SUB_COUNT)
+		return value;
+
+	/* position of the highest bit, at least SUB_BITS */
+	e = 63 - __builtin_clzll(value);
+
+	return ((e - SUB_BITS + 1) << SUB_BITS)
+		+ (value >> (e - SUB_BITS)) - SUB_COUNT;
+}
+
+/* the biggest value that falls into the bucket */
+static uint64_t
+bucket_value(unsigned int i)
+{
+	unsigned int e;
+	uint64_t sub;
+
+	if (i < SUB_COUNT)
+		return i;
+
+	e = (i >> SUB_BITS) + SUB_BITS - 1;
+	sub = (i & (SUB_COUNT - 1)) + SUB_COUNT;
+
+	return ((sub + 1) << (e - SUB_BITS)) - 1;
+}
+
+void
+wldbg_histogram_add(struct wldbg_histogram *h, uint64_t value, uint64_t count)
+{
+	h->buckets[bucket_of(value)] += count;
+	h->count += count;
+
+	if (value > h->max)
+		h->max = value;
+}
+
+uint64_t
+wldbg_histogram_percentile(const struct wldbg_histogram *h, double p)
+{
+	uint64_t rank, seen = 0;
+	unsigned int i;
+
+	if (h->count == 0)
+		return 0;
+
+	rank = (uint64_t) (p * h->count);
+	if (rank == 0)
+		rank = 1;
+
+	for (i = 0; i < WLDBG_HISTOGRAM_BUCKETS; ++i) {
+		seen += h->buckets[i];
+		if (seen >= rank)
+			break;
+	}
+
+	/* the last bucket has also all bigger values */
+	if (i >= WLDBG_HISTOGRAM_BUCKETS - 1 || bucket_value(i) > h->max)
+		return h->max;
+
+	return bucket_value(i);
+}
+
+uint64_t
+wldbg_time_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+uint64_t
+wldbg_thread_cpu_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void
+print_histogram(const char *name, const struct wldbg_histogram *h)
+{
+	printf("\t%-18s %10lu %10.1f %10.1f %10.1f %10.1f\n", name,
+	       (unsigned long) h->count,
+	       wldbg_histogram_percentile(h, 0.5) / 1000.0,
+	       wldbg_histogram_percentile(h, 0.99) / 1000.0,
+	       wldbg_histogram_percentile(h, 0.999) / 1000.0,
+	       h->max / 1000.0);
+}
+
+void
+wldbg_latency_print(struct wldbg_latency *latency)
+{
+	printf("\t%-18s %10s %10s %10s %10s %10s\n", "latency (us)",
+	       "messages", "p50", "p99", "p999", "max");
+	print_histogram("client -> server", &latency->proxy[CLIENT]);
+	print_histogram("server -> client", &latency->proxy[SERVER]);
+}
@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2015 Marek Chalupa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _WLDBG_LATENCY_H_
+#define _WLDBG_LATENCY_H_
+
+#include <stdint.h>
+
+/*
+ * Histogram of latencies in nanoseconds. Like HDR histograms, every
+ * power of two is split into the same number of buckets, so the error
+ * is at most 1/32 of the value and we need only about a thousand
+ * buckets for values up to 18 minutes. Bigger values are counted in
+ * the last bucket, max is exact.
+ */
+#define WLDBG_HISTOGRAM_SUB_BITS	5
+#define WLDBG_HISTOGRAM_MAX_BITS	40
+#define WLDBG_HISTOGRAM_BUCKETS						\
+	((WLDBG_HISTOGRAM_MAX_BITS - WLDBG_HISTOGRAM_SUB_BITS + 1)	\
+	 << WLDBG_HISTOGRAM_SUB_BITS)
+
+struct wldbg_histogram {
+	uint64_t count;
+	uint64_t max;
+	uint64_t buckets[WLDBG_HISTOGRAM_BUCKETS];
+};
+
+/* add value count times */
+void
+wldbg_histogram_add(struct wldbg_histogram *h, uint64_t value, uint64_t count);
+
+/* value that is bigger than or equal to p (0.0 - 1.0) of values */
+uint64_t
+wldbg_histogram_percentile(const struct wldbg_histogram *h, double p);
+
+/* latencies of one connection, indexed by SERVER and CLIENT
+ * like wldbg_message.from */
+struct wldbg_latency {
+	/* from reading the message until it was written to the other side */
+	struct wldbg_histogram proxy[2];
+};
+
+/* CLOCK_MONOTONIC in nanoseconds */
+uint64_t
+wldbg_time_ns(void);
+
+/* CPU time of the calling thread in nanoseconds */
+uint64_t
+wldbg_thread_cpu_ns(void);
+
+void
+wldbg_latency_print(struct wldbg_latency *latency);
+
+#endif /* _WLDBG_LATENCY_H_ */
@@ -92,7 +92,7 @@ list_init(struct wldbg *wldbg,
 	} else {
 		printf("Usage: wldbg list\n\n");
 		printf("List all available passes\n");
-		wldbg->flags.error = 1;
+		wldbg_error(wldbg);
 		exit(-1);
 	}
 
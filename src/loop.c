@@ -4,17 +4,18 @@
 
 #include "wldbg.h"
 #include "wldbg-private.h"
+#include "poller.h"
 
 void
 wldbg_exit(struct wldbg *wldbg)
 {
-	wldbg->flags.exit = 1;
+	__atomic_store_n(&wldbg->flags.exit, 1, __ATOMIC_RELAXED);
 }
 
 void
 wldbg_error(struct wldbg *wldbg)
 {
-	wldbg->flags.error = 1;
+	__atomic_store_n(&wldbg->flags.error, 1, __ATOMIC_RELAXED);
 }
 
 /**
@@ -26,17 +27,14 @@ wldbg_monitor_fd(struct wldbg *wldbg, int fd,
 		 int (*dispatch)(int fd, void *data),
 		 void *data)
 {
-	struct epoll_event ev;
 	struct wldbg_fd_callback *cb;
 
 	cb = malloc(sizeof *cb);
 	if (!cb)
 		return NULL;
 
-	ev.events = EPOLLIN;
-	ev.data.ptr = cb;
-	if (epoll_ctl(wldbg->epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1) {
-		perror("Failed adding fd to epoll");
+	if (wldbg_poller_add(wldbg->poller, fd, EPOLLIN, cb) == -1) {
+		perror("Failed adding fd to poller");
 		free(cb);
 		return NULL;
 	}
@@ -57,12 +55,20 @@ int
 wldbg_remove_callback(struct wldbg *wldbg, struct wldbg_fd_callback *cb)
 {
 	int fd = cb->fd;
+	int i;
+
+	/* if the callback has an event in the batch that
+	 * is just being dispatched, forget the event */
+	for (i = wldbg->dispatch.current + 1; i < wldbg->dispatch.num; ++i) {
+		if (wldbg->dispatch.events[i].data.ptr == cb)
+			wldbg->dispatch.events[i].data.ptr = NULL;
+	}
 
 	wl_list_remove(&cb->link);
 	free(cb);
 
-	if (epoll_ctl(wldbg->epoll_fd, EPOLL_CTL_DEL, fd, NULL) == -1) {
-		perror("Failed removing fd from epoll");
+	if (wldbg_poller_remove(wldbg->poller, fd) == -1) {
+		perror("Failed removing fd from poller");
 		return -1;
 	}
 
@@ -78,3 +84,11 @@ wldbg_separate_messages(struct wldbg *wldbg, int state)
 	wldbg->flags.pass_whole_buffer = !!state;
 	return wldbg->flags.pass_whole_buffer;
 }
+
+void
+wldbg_passes_changed(struct wldbg *wldbg)
+{
+	/* connections compare it with the serial
+	 * of their tables and recompute them */
+	++wldbg->passes_serial;
+}
@@ -46,32 +46,40 @@
 
 void
 handle_shm_pool_message(struct wldbg_objects_info *oi,
-			struct wldbg_resolved_message *rm, int from);
+			struct wldbg_resolved_message *rm,
+			const struct wldbg_message_args *args, int from);
 void
 handle_wl_buffer_message(struct wldbg_objects_info *oi,
-			 struct wldbg_resolved_message *rm, int from);
+			 struct wldbg_resolved_message *rm,
+			 const struct wldbg_message_args *args, int from);
 void
 handle_wl_compositor_message(struct wldbg_objects_info *oi,
-			  struct wldbg_resolved_message *rm, int from);
+			  struct wldbg_resolved_message *rm,
+			  const struct wldbg_message_args *args, int from);
 
 void
 handle_wl_surface_message(struct wldbg_objects_info *oi,
-			  struct wldbg_resolved_message *rm, int from);
+			  struct wldbg_resolved_message *rm,
+			  const struct wldbg_message_args *args, int from);
 void
 handle_xdg_shell_message(struct wldbg_objects_info *oi,
-			 struct wldbg_resolved_message *rm, int from);
+			 struct wldbg_resolved_message *rm,
+			 const struct wldbg_message_args *args, int from);
 
 void
 handle_xdg_surface_message(struct wldbg_objects_info *oi,
-			   struct wldbg_resolved_message *rm, int from);
+			   struct wldbg_resolved_message *rm,
+			   const struct wldbg_message_args *args, int from);
 
 void
 handle_wl_registry_message(struct wldbg_objects_info *oi,
-			   struct wldbg_resolved_message *rm, int from);
+			   struct wldbg_resolved_message *rm,
+			   const struct wldbg_message_args *args, int from);
 
 void
 handle_wl_seat_message(struct wldbg_objects_info *oi,
-		       struct wldbg_resolved_message *rm, int from);
+		       struct wldbg_resolved_message *rm,
+		       const struct wldbg_message_args *args, int from);
 
 static int
 gather_info(void *user_data, struct wldbg_message *message)
@@ -79,32 +87,52 @@ gather_info(void *user_data, struct wldbg_message *message)
 	(void) user_data;
 	struct wldbg_objects_info *oinf = message->connection->objects_info;
 	struct wldbg_resolved_message rm;
+	struct wldbg_message_args args;
 
 	if (!wldbg_resolve_message(message, &rm)) {
 		fprintf(stderr, "Failed resolving message, loosing info\n");
 		return PASS_NEXT;
 	}
 
+	/* decode the arguments once, the handlers pick what they need */
+	if (wldbg_resolved_message_get_args(&rm, &args) < 0) {
+		fprintf(stderr, "Malformed message, loosing info\n");
+		return PASS_NEXT;
+	}
+
 	if (strcmp(rm.wl_interface->name, "wl_surface") == 0)
-		handle_wl_surface_message(oinf, &rm, message->from);
+		handle_wl_surface_message(oinf, &rm, &args, message->from);
 	else if (strcmp(rm.wl_interface->name, "xdg_surface") == 0)
-		handle_xdg_surface_message(oinf, &rm, message->from);
+		handle_xdg_surface_message(oinf, &rm, &args, message->from);
 	else if (strcmp(rm.wl_interface->name, "wl_buffer") == 0)
-		handle_wl_buffer_message(oinf, &rm, message->from);
+		handle_wl_buffer_message(oinf, &rm, &args, message->from);
 	else if (strcmp(rm.wl_interface->name, "wl_compositor") == 0)
-		handle_wl_compositor_message(oinf, &rm, message->from);
+		handle_wl_compositor_message(oinf, &rm, &args, message->from);
 	else if (strcmp(rm.wl_interface->name, "wl_shm_pool") == 0)
-		handle_shm_pool_message(oinf, &rm, message->from);
+		handle_shm_pool_message(oinf, &rm, &args, message->from);
 	else if (strcmp(rm.wl_interface->name, "xdg_shell") == 0)
-		handle_xdg_shell_message(oinf, &rm, message->from);
+		handle_xdg_shell_message(oinf, &rm, &args, message->from);
 	else if (strcmp(rm.wl_interface->name, "wl_registry") == 0)
-		handle_wl_registry_message(oinf, &rm, message->from);
+		handle_wl_registry_message(oinf, &rm, &args, message->from);
 	else if (strcmp(rm.wl_interface->name, "wl_seat") == 0)
-		handle_wl_seat_message(oinf, &rm, message->from);
+		handle_wl_seat_message(oinf, &rm, &args, message->from);
 
 	return PASS_NEXT;
 }
 
+/* interfaces that gather_info handles */
+static const char *objinfo_interfaces[] = {
+	"wl_surface",
+	"xdg_surface",
+	"wl_buffer",
+	"wl_compositor",
+	"wl_shm_pool",
+	"xdg_shell",
+	"wl_registry",
+	"wl_seat",
+	NULL
+};
+
 static struct pass *
 create_objinfo_pass(void)
 {
@@ -120,6 +148,9 @@ create_objinfo_pass(void)
 	pass->wldbg_pass.client_pass = gather_info;
 	pass->wldbg_pass.description
 		= "Gather additional information about objects";
+	/* the information is stored per connection */
+	pass->wldbg_pass.flags = WLDBG_PASS_THREAD_SAFE;
+	pass->wldbg_pass.subscription.interfaces = objinfo_interfaces;
 
 	return pass;
 }
@@ -135,6 +166,7 @@ wldbg_add_objinfo_pass(struct wldbg *wldbg)
 		return -1;
 
 	wl_list_insert(wldbg->passes.next, &pass->link);
+	wldbg_passes_changed(wldbg);
 	wldbg->gathering_info = 1;
 
 	return 0;
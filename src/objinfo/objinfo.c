@@ -48,34 +48,29 @@ create_objects_info(void)
 	return oi;
 }
 
+static void
+destroy_object_info(uint32_t id, void *data, void *user_data)
+{
+	struct wldbg_object_info *info = data;
+
+	(void) id;
+	(void) user_data;
+
+	if (info->destroy)
+		info->destroy(info->info);
+	free(info);
+}
+
 void
 destroy_objects_info(struct wldbg_objects_info *oi)
 {
-	unsigned int i;
-	struct wldbg_object_info *info;
-
 	if (!oi)
 		return;
 
-	for (i = 0; i < oi->client_objects.count; ++i) {
-		info = wldbg_ids_map_get(&oi->client_objects, i);
-		if (!info)
-			continue;
-
-		if (info->destroy)
-			info->destroy(info->info);
-		free(info);
-	}
-
-	for (i = 0; i < oi->server_objects.count; ++i) {
-		info = wldbg_ids_map_get(&oi->server_objects, i);
-		if (!info)
-			continue;
-
-		if (info->destroy)
-			info->destroy(info->info);
-		free(info);
-	}
+	wldbg_ids_map_for_each(&oi->client_objects,
+			       destroy_object_info, NULL);
+	wldbg_ids_map_for_each(&oi->server_objects,
+			       destroy_object_info, NULL);
 
 	wldbg_ids_map_release(&oi->client_objects);
 	wldbg_ids_map_release(&oi->server_objects);
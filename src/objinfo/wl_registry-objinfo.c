@@ -35,16 +35,16 @@
 
 
 struct wldbg_object_info *
-create_wl_seat_info(struct wldbg_resolved_message *rm);
+create_wl_seat_info(const struct wldbg_message_args *args);
 
 static void
 handle_bind(struct wldbg_objects_info *oi,
-	    struct wldbg_resolved_message *rm, const char *obj)
+	    const struct wldbg_message_args *args, const char *obj)
 {
 	struct wldbg_object_info *info;
 
 	if (strcmp(obj, "wl_seat") == 0) {
-		info = create_wl_seat_info(rm);
+		info = create_wl_seat_info(args);
 		if (!info) {
 			fprintf(stderr, "Out of memory, loosing informaiton\n");
 			return;
@@ -58,18 +58,16 @@ handle_bind(struct wldbg_objects_info *oi,
 
 void
 handle_wl_registry_message(struct wldbg_objects_info *oi,
-			   struct wldbg_resolved_message *rm, int from)
+			   struct wldbg_resolved_message *rm,
+			   const struct wldbg_message_args *args, int from)
 {
-	struct wldbg_resolved_arg *arg;
-
 	if (from == CLIENT) {
 		 if (strcmp(rm->wl_message->name, "bind") == 0) {
-			/* skip the global id */
-			wldbg_resolved_message_next_argument(rm);
-			/* get the global name */
-			arg = wldbg_resolved_message_next_argument(rm);
+			/* name, interface, version and new id */
+			if (args->num < 4 || !args->args[1].data)
+				return;
 
-			handle_bind(oi, rm, (const char *) arg->data);
+			handle_bind(oi, args, (const char *) args->args[1].data);
 		}
 	}
 }
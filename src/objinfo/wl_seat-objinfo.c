@@ -42,10 +42,8 @@ free_seat(void *ptr)
 }
 
 struct wldbg_object_info *
-create_wl_seat_info(struct wldbg_resolved_message *rm)
+create_wl_seat_info(const struct wldbg_message_args *args)
 {
-	struct wldbg_resolved_arg *arg;
-
 	struct wldbg_object_info *oi = malloc(sizeof *oi);
 	if (!oi)
 		return NULL;
@@ -63,24 +61,21 @@ create_wl_seat_info(struct wldbg_resolved_message *rm)
 	oi->destroy = free_seat;
 
 	info->capabilities = 0;
+	info->name = NULL;
 
-	/* get version of the seat */
-	arg = wldbg_resolved_message_next_argument(rm);
-	oi->version = *arg->data;
-
-	/* get id of the seat */
-	arg = wldbg_resolved_message_next_argument(rm);
-	oi->id = *arg->data;
+	/* version and id of the seat from wl_registry.bind */
+	oi->version = *args->args[2].data;
+	oi->id = *args->args[3].data;
 
 	return oi;
 }
 
 void
 handle_wl_seat_message(struct wldbg_objects_info *oi,
-		       struct wldbg_resolved_message *rm, int from)
+		       struct wldbg_resolved_message *rm,
+		       const struct wldbg_message_args *args, int from)
 {
 	struct wldbg_object_info *i;
-	struct wldbg_resolved_arg *arg;
 	struct wldbg_wl_seat_info *info;
 
 	i = objects_info_get(oi, rm->base.id);
@@ -92,13 +87,16 @@ handle_wl_seat_message(struct wldbg_objects_info *oi,
 	info = i->info;
 
 	if (from == SERVER) {
+		if (args->num < 1)
+			return;
+
 		if (strcmp(rm->wl_message->name, "name") == 0) {
-			arg = wldbg_resolved_message_next_argument(rm);
-			if (arg->data)
-				info->name = strdup((const char *) arg->data);
+			if (args->args[0].data) {
+				free(info->name);
+				info->name = strdup((const char *) args->args[0].data);
+			}
 		} else if (strcmp(rm->wl_message->name, "capabilities") == 0) {
-			arg = wldbg_resolved_message_next_argument(rm);
-			info->capabilities = *arg->data;
+			info->capabilities = *args->args[0].data;
 		}
 	}
 }
@@ -56,14 +56,17 @@ create_wl_buffer_info(struct wldbg_resolved_message *rm)
 
 void
 handle_shm_pool_message(struct wldbg_objects_info *oi,
-			struct wldbg_resolved_message *rm, int from)
+			struct wldbg_resolved_message *rm,
+			const struct wldbg_message_args *args, int from)
 {
 	struct wldbg_object_info *info;
-	struct wldbg_resolved_arg *arg;
 	struct wldbg_wl_buffer_info *buff_info;
 
 	if (from == CLIENT) {
 		 if (strcmp(rm->wl_message->name, "create_buffer") == 0) {
+			if (args->num < 6)
+				return;
+
 			info = create_wl_buffer_info(rm);
 			if (!info) {
 				fprintf(stderr, "Out of memory, loosing informaiton\n");
@@ -72,29 +75,14 @@ handle_shm_pool_message(struct wldbg_objects_info *oi,
 
 			buff_info = (struct wldbg_wl_buffer_info *) info->info;
 
-			/* new wl_buffer id */
-			arg = wldbg_resolved_message_next_argument(rm);
-			info->id = *arg->data;
-
-			/* offset */
-			arg = wldbg_resolved_message_next_argument(rm);
-			buff_info->offset = (int32_t) *arg->data;
-
-			/* width */
-			arg = wldbg_resolved_message_next_argument(rm);
-			buff_info->width = (int32_t) *arg->data;
-
-			/* height */
-			arg = wldbg_resolved_message_next_argument(rm);
-			buff_info->height = (int32_t) *arg->data;
-
-			/* stride */
-			arg = wldbg_resolved_message_next_argument(rm);
-			buff_info->stride = (int32_t) *arg->data;
-
-			/* format */
-			arg = wldbg_resolved_message_next_argument(rm);
-			buff_info->format = *arg->data;
+			/* new wl_buffer id, offset, width, height,
+			 * stride and format */
+			info->id = *args->args[0].data;
+			buff_info->offset = (int32_t) *args->args[1].data;
+			buff_info->width = (int32_t) *args->args[2].data;
+			buff_info->height = (int32_t) *args->args[3].data;
+			buff_info->stride = (int32_t) *args->args[4].data;
+			buff_info->format = *args->args[5].data;
 
 			objects_info_put(oi, info->id, info);
 			dbg("Created wl_buffer, id %u\n", info->id);
@@ -104,7 +92,8 @@ handle_shm_pool_message(struct wldbg_objects_info *oi,
 
 void
 handle_wl_buffer_message(struct wldbg_objects_info *oi,
-			 struct wldbg_resolved_message *rm, int from)
+			 struct wldbg_resolved_message *rm,
+			 const struct wldbg_message_args *args, int from)
 {
 	struct wldbg_object_info *info = objects_info_get(oi, rm->base.id);
 	if (!info) {
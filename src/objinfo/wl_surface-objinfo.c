@@ -79,10 +79,10 @@ make_wl_buffer_unreleased(struct wldbg_objects_info *oi, uint32_t id)
 
 void
 handle_wl_surface_message(struct wldbg_objects_info *oi,
-			  struct wldbg_resolved_message *rm, int from)
+			  struct wldbg_resolved_message *rm,
+			  const struct wldbg_message_args *args, int from)
 {
 	struct wldbg_wl_surface_info *surf_info;
-	struct wldbg_resolved_arg *arg;
 	struct wldbg_object_info *info = objects_info_get(oi, rm->base.id);
 	if (!info) {
 		fprintf(stderr, "ERROR: no wl_surface with id %d\n",
@@ -93,17 +93,18 @@ handle_wl_surface_message(struct wldbg_objects_info *oi,
 	surf_info = (struct wldbg_wl_surface_info *) info->info;
 	if (from == CLIENT) {
 		if (strcmp(rm->wl_message->name, "frame") == 0) {
-			arg = wldbg_resolved_message_next_argument(rm);
-			surf_info->last_frame_id = *arg->data;
+			if (args->num < 1)
+				return;
+
+			surf_info->last_frame_id = *args->args[0].data;
 		} else if (strcmp(rm->wl_message->name, "attach") == 0) {
-			/* wl_buffer */
-			arg = wldbg_resolved_message_next_argument(rm);
-			surf_info->wl_buffer_id = *arg->data;
-			/* attached x, y */
-			arg = wldbg_resolved_message_next_argument(rm);
-			surf_info->attached_x = *arg->data;
-			arg = wldbg_resolved_message_next_argument(rm);
-			surf_info->attached_y = *arg->data;
+			if (args->num < 3)
+				return;
+
+			/* wl_buffer and attached x, y */
+			surf_info->wl_buffer_id = *args->args[0].data;
+			surf_info->attached_x = *args->args[1].data;
+			surf_info->attached_y = *args->args[2].data;
 
 			make_wl_buffer_unreleased(oi, surf_info->wl_buffer_id);
 
@@ -133,13 +134,16 @@ handle_wl_surface_message(struct wldbg_objects_info *oi,
 
 void
 handle_wl_compositor_message(struct wldbg_objects_info *oi,
-			  struct wldbg_resolved_message *rm, int from)
+			  struct wldbg_resolved_message *rm,
+			  const struct wldbg_message_args *args, int from)
 {
 	struct wldbg_object_info *info;
-	struct wldbg_resolved_arg *arg;
 
 	if (from == CLIENT) {
 		if (strcmp(rm->wl_message->name, "create_surface") == 0) {
+			if (args->num < 1)
+				return;
+
 		       info = create_wl_surface_info(rm);
 			if (!info) {
 				fprintf(stderr,
@@ -148,8 +152,7 @@ handle_wl_compositor_message(struct wldbg_objects_info *oi,
 			}
 
 			/* new wl_surface id */
-			arg = wldbg_resolved_message_next_argument(rm);
-			info->id = *arg->data;
+			info->id = *args->args[0].data;
 
 			objects_info_put(oi, info->id, info);
 			dbg("Created wl_surface, id %u\n", info->id);
@@ -64,13 +64,16 @@ create_xdg_surface_info(struct wldbg_resolved_message *rm)
 
 void
 handle_xdg_shell_message(struct wldbg_objects_info *oi,
-			 struct wldbg_resolved_message *rm, int from)
+			 struct wldbg_resolved_message *rm,
+			 const struct wldbg_message_args *args, int from)
 {
 	struct wldbg_object_info *info;
-	struct wldbg_resolved_arg *arg;
 
 	if (from == CLIENT) {
 		 if (strcmp(rm->wl_message->name, "get_xdg_surface") == 0) {
+			if (args->num < 2)
+				return;
+
 			info = create_xdg_surface_info(rm);
 			if (!info) {
 				fprintf(stderr, "Out of memory, loosing informaiton\n");
@@ -78,9 +81,7 @@ handle_xdg_shell_message(struct wldbg_objects_info *oi,
 			}
 
 			/* new xdg_surface id */
-			arg = wldbg_resolved_message_next_argument(rm);
-			/* FIXME check for NULL */
-			info->id = *arg->data;
+			info->id = *args->args[0].data;
 
 			/* just check -> do it an assertion */
 			if (objects_info_get(oi, info->id))
@@ -88,8 +89,7 @@ handle_xdg_shell_message(struct wldbg_objects_info *oi,
 					"but now I'm creating xgd_surface\n", info->id);
 
 			/* wl_surface id */
-			arg = wldbg_resolved_message_next_argument(rm);
-			((struct wldbg_xdg_surface_info *) info->info)->wl_surface_id = *arg->data;
+			((struct wldbg_xdg_surface_info *) info->info)->wl_surface_id = *args->args[1].data;
 
 			objects_info_put(oi, info->id, info);
 			vdbg("Created xdg_surface, id %u\n", info->id);
@@ -99,10 +99,10 @@ handle_xdg_shell_message(struct wldbg_objects_info *oi,
 
 void
 handle_xdg_surface_message(struct wldbg_objects_info *oi,
-			   struct wldbg_resolved_message *rm, int from)
+			   struct wldbg_resolved_message *rm,
+			   const struct wldbg_message_args *args, int from)
 {
 	struct wldbg_xdg_surface_info *xdg_info;
-	struct wldbg_resolved_arg *arg;
 	struct wldbg_object_info *info = objects_info_get(oi, rm->base.id);
 	if (!info) {
 		fprintf(stderr, "ERROR: no xdg_surface with id %d\n", rm->base.id);
@@ -115,17 +115,13 @@ handle_xdg_surface_message(struct wldbg_objects_info *oi,
 			uint8_t idx = xdg_info->configures_num % 10;
 			struct xdg_configure *c = &xdg_info->configures[idx];
 
-			/* width */
-			arg = wldbg_resolved_message_next_argument(rm);
-			c->width = *arg->data;
-			/* height */
-			arg = wldbg_resolved_message_next_argument(rm);
-			c->height = *arg->data;
-			/* flags */
-			arg = wldbg_resolved_message_next_argument(rm);
-			/* serial */
-			arg = wldbg_resolved_message_next_argument(rm);
-			c->serial = *arg->data;
+			/* width, height, states and serial */
+			if (args->num < 4)
+				return;
+
+			c->width = *args->args[0].data;
+			c->height = *args->args[1].data;
+			c->serial = *args->args[3].data;
 
 			/* reset acked flag with this configure,
 			 * we didn't get it yet */
@@ -135,17 +131,20 @@ handle_xdg_surface_message(struct wldbg_objects_info *oi,
 		}
 	} else {
 		if (strcmp(rm->wl_message->name, "set_title") == 0) {
-			arg = wldbg_resolved_message_next_argument(rm);
-			if (arg && arg->data) {
+			if (args->num > 0 && args->args[0].data) {
 				/* free on NULL is no-op */
 				free(xdg_info->title);
-				xdg_info->title = strdup((const char *) arg->data);
+				xdg_info->title = strdup((const char *) args->args[0].data);
 			}
 		} else if (strcmp(rm->wl_message->name, "ack_configure") == 0) {
-			arg = wldbg_resolved_message_next_argument(rm);
-			uint32_t serial = *arg->data;
+			uint32_t serial;
 			uint8_t idx;
 
+			if (args->num < 1)
+				return;
+
+			serial = *args->args[0].data;
+
 			/* find serial */
 			for (idx = 0; idx < 10; ++idx) {
 				struct xdg_configure *c = &xdg_info->configures[idx];
@@ -0,0 +1,390 @@
+/*
+ * Copyright (c) 2015 Marek Chalupa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <assert.h>
+#include <sys/eventfd.h>
+
+#include "wldbg.h"
+#include "wldbg-private.h"
+#include "wldbg-parse-message.h"
+#include "observers.h"
+#include "passes.h"
+#include "wayland/wayland-private.h"
+
+/* the object of the message and objects in arguments */
+#define MAX_OBJECTS	(WL_CLOSURE_MAX_ARGS + 1)
+
+/* records are aligned, so that the data of messages are too */
+#define ALIGN(n)	(((n) + 7) & ~((size_t) 7))
+
+struct record {
+	/* size of the whole record, 0 means that the rest
+	 * of the ring is unused and the next record is
+	 * at the beginning of the ring */
+	uint32_t size;
+	uint32_t message_size;
+	struct wldbg_connection *connection;
+	uint64_t passes;
+	unsigned long dropped;
+	uint64_t index;
+	int from;
+	unsigned int objects_num;
+	struct wldbg_message_object objects[];
+	/* followed by the data of the message */
+};
+
+static void
+wake(int fd)
+{
+	uint64_t val = 1;
+
+	if (write(fd, &val, sizeof val) != sizeof val)
+		perror("observers: eventfd write");
+}
+
+static void
+sleep_on(int fd)
+{
+	uint64_t val;
+
+	if (read(fd, &val, sizeof val) < 0 && errno != EINTR)
+		perror("observers: eventfd read");
+}
+
+static size_t
+ring_used(struct wldbg_observers *observers)
+{
+	return observers->head
+		- __atomic_load_n(&observers->tail, __ATOMIC_SEQ_CST);
+}
+
+/* called by the producer */
+static void
+wait_for_space(struct wldbg_observers *observers, size_t size)
+{
+	while (observers->size - ring_used(observers) < size) {
+		__atomic_store_n(&observers->producer_sleeps, 1,
+				 __ATOMIC_SEQ_CST);
+
+		/* the observer could free the space before it saw
+		 * that we want to sleep, check once more */
+		if (observers->size - ring_used(observers) < size)
+			sleep_on(observers->producer_fd);
+
+		__atomic_store_n(&observers->producer_sleeps, 0,
+				 __ATOMIC_SEQ_CST);
+	}
+}
+
+/* interfaces of the objects from the message as they are now,
+ * the observer thread can not look into the connection */
+static unsigned int
+snapshot_objects(struct wldbg_message *message,
+		 struct wldbg_message_object *objects)
+{
+	struct wldbg_resolved_message rm;
+	struct wldbg_message_args args;
+	const struct wldbg_message_arg *arg;
+	unsigned int i, n = 0;
+
+	if (!wldbg_resolve_message(message, &rm))
+		return 0;
+
+	objects[n].id = rm.base.id;
+	objects[n].interface = rm.wl_interface;
+	objects[n].version = rm.version;
+	objects[n].handle
+		= wldbg_message_get_object_handle(message, rm.base.id);
+	++n;
+
+	/* only the object itself if the arguments are broken */
+	if (wldbg_resolved_message_get_args(&rm, &args) < 0)
+		return n;
+
+	for (i = 0; i < args.num && n < MAX_OBJECTS; ++i) {
+		arg = &args.args[i];
+		if (arg->type != 'o' || !arg->data)
+			continue;
+
+		objects[n].id = *arg->data;
+		objects[n].interface
+			= wldbg_message_get_object(message, *arg->data);
+		objects[n].version
+			= wldbg_message_get_object_version(message, *arg->data);
+		objects[n].handle
+			= wldbg_message_get_object_handle(message, *arg->data);
+		++n;
+	}
+
+	return n;
+}
+
+void
+wldbg_observers_push(struct wldbg_observers *observers,
+		     struct wldbg_message *message, uint64_t passes)
+{
+	struct wldbg_message_object objects[MAX_OBJECTS];
+	struct record *rec;
+	unsigned int objects_num;
+	size_t need, total, head, off, used;
+
+	objects_num = snapshot_objects(message, objects);
+
+	need = ALIGN(sizeof *rec + objects_num * sizeof *objects
+		     + message->size);
+	head = observers->head;
+	off = head & (observers->size - 1);
+
+	/* the record does not fit before the end of the ring,
+	 * skip the rest of the ring */
+	total = need;
+	if (off + need > observers->size)
+		total += observers->size - off;
+
+	assert(total <= observers->size);
+
+	if (observers->size - ring_used(observers) < total) {
+		if (observers->policy != WLDBG_OBSERVERS_BLOCK) {
+			++observers->statistics.dropped;
+			++observers->dropped_since;
+			return;
+		}
+
+		++observers->statistics.blocked;
+		wait_for_space(observers, total);
+	}
+
+	if (off + need > observers->size) {
+		((struct record *) (observers->ring + off))->size = 0;
+		head += observers->size - off;
+		off = 0;
+	}
+
+	rec = (struct record *) (observers->ring + off);
+	rec->size = need;
+	rec->message_size = message->size;
+	rec->connection = message->connection;
+	rec->passes = passes;
+	rec->index = message->index;
+	rec->from = message->from;
+	rec->objects_num = objects_num;
+	memcpy(rec->objects, objects, objects_num * sizeof *objects);
+	memcpy(rec->objects + objects_num, message->data, message->size);
+
+	if (observers->policy == WLDBG_OBSERVERS_COUNT_DROPS) {
+		rec->dropped = observers->dropped_since;
+		observers->dropped_since = 0;
+	} else {
+		rec->dropped = 0;
+	}
+
+	++observers->statistics.messages;
+	used = ring_used(observers) + total;
+	if (used > observers->statistics.max_used)
+		observers->statistics.max_used = used;
+
+	__atomic_store_n(&observers->head, head + need, __ATOMIC_SEQ_CST);
+
+	if (__atomic_load_n(&observers->observer_sleeps, __ATOMIC_SEQ_CST))
+		wake(observers->observer_fd);
+}
+
+void
+wldbg_observers_sync(struct wldbg_observers *observers)
+{
+	wait_for_space(observers, observers->size);
+}
+
+static void
+run_observers(struct wldbg_observers *observers, struct record *rec)
+{
+	struct wldbg_message message;
+	struct pass *pass;
+	unsigned int n = 0;
+
+	memset(&message, 0, sizeof message);
+	message.data = rec->objects + rec->objects_num;
+	message.size = rec->message_size;
+	message.from = rec->from;
+	message.connection = rec->connection;
+	message.objects = rec->objects;
+	message.objects_num = rec->objects_num;
+	message.dropped = rec->dropped;
+	message.index = rec->index;
+
+	/* the list of passes does not change while
+	 * observers are running (no interactive mode) */
+	wl_list_for_each(pass, &observers->wldbg->passes, link) {
+		if (!(pass->wldbg_pass.flags & WLDBG_PASS_OBSERVER)
+		    || (n < 64 && !(rec->passes & ((uint64_t) 1 << n)))) {
+			++n;
+			continue;
+		}
+
+		++n;
+
+		if (pass_call(observers->wldbg, pass, &message) == PASS_STOP)
+			break;
+	}
+}
+
+static void *
+observers_run(void *data)
+{
+	struct wldbg_observers *observers = data;
+	struct record *rec;
+	size_t tail, off;
+
+	for (;;) {
+		tail = observers->tail;
+
+		if (tail == __atomic_load_n(&observers->head,
+					    __ATOMIC_SEQ_CST)) {
+			if (__atomic_load_n(&observers->quit,
+					    __ATOMIC_SEQ_CST))
+				break;
+
+			__atomic_store_n(&observers->observer_sleeps, 1,
+					 __ATOMIC_SEQ_CST);
+
+			if (tail == __atomic_load_n(&observers->head,
+						    __ATOMIC_SEQ_CST)
+			    && !__atomic_load_n(&observers->quit,
+						__ATOMIC_SEQ_CST))
+				sleep_on(observers->observer_fd);
+
+			__atomic_store_n(&observers->observer_sleeps, 0,
+					 __ATOMIC_SEQ_CST);
+			continue;
+		}
+
+		off = tail & (observers->size - 1);
+		rec = (struct record *) (observers->ring + off);
+
+		if (rec->size == 0) {
+			tail += observers->size - off;
+		} else {
+			run_observers(observers, rec);
+			tail += rec->size;
+		}
+
+		__atomic_store_n(&observers->tail, tail, __ATOMIC_SEQ_CST);
+
+		if (__atomic_load_n(&observers->producer_sleeps,
+				    __ATOMIC_SEQ_CST))
+			wake(observers->producer_fd);
+	}
+
+	return NULL;
+}
+
+struct wldbg_observers *
+wldbg_observers_create(struct wldbg *wldbg,
+		       enum wldbg_observers_policy policy)
+{
+	struct wldbg_observers *observers;
+	size_t size = WLDBG_OBSERVERS_RING_SIZE;
+
+	observers = calloc(1, sizeof *observers);
+	if (!observers)
+		return NULL;
+
+	/* biggest message with its objects must fit into
+	 * the ring even when it has to skip the end of the ring */
+	while (size < 4 * (size_t) wldbg->max_buffer_size)
+		size *= 2;
+
+	observers->wldbg = wldbg;
+	observers->policy = policy;
+	observers->size = size;
+
+	observers->ring = malloc(size);
+	if (!observers->ring)
+		goto err_free;
+
+	observers->observer_fd = eventfd(0, EFD_CLOEXEC);
+	if (observers->observer_fd == -1) {
+		perror("eventfd");
+		goto err_ring;
+	}
+
+	observers->producer_fd = eventfd(0, EFD_CLOEXEC);
+	if (observers->producer_fd == -1) {
+		perror("eventfd");
+		goto err_observer_fd;
+	}
+
+	if (pthread_create(&observers->thread, NULL,
+			   observers_run, observers) != 0) {
+		fprintf(stderr, "Failed creating observer thread\n");
+		goto err_producer_fd;
+	}
+
+	return observers;
+
+err_producer_fd:
+	close(observers->producer_fd);
+err_observer_fd:
+	close(observers->observer_fd);
+err_ring:
+	free(observers->ring);
+err_free:
+	free(observers);
+	return NULL;
+}
+
+void
+wldbg_observers_destroy(struct wldbg_observers *observers)
+{
+	__atomic_store_n(&observers->quit, 1, __ATOMIC_SEQ_CST);
+	wake(observers->observer_fd);
+
+	pthread_join(observers->thread, NULL);
+
+	dbg("Observers: messages: %lu, dropped: %lu, blocked: %lu, "
+	    "max used: %lu of %lu bytes\n",
+	    observers->statistics.messages,
+	    observers->statistics.dropped,
+	    observers->statistics.blocked,
+	    (unsigned long) observers->statistics.max_used,
+	    (unsigned long) observers->size);
+
+	if (observers->statistics.dropped > 0)
+		fprintf(stderr, "Observers missed %lu messages "
+			"(the ring was full)\n",
+			observers->statistics.dropped);
+
+	close(observers->producer_fd);
+	close(observers->observer_fd);
+	free(observers->ring);
+	free(observers);
+}
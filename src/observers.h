@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2015 Marek Chalupa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _WLDBG_OBSERVERS_H_
+#define _WLDBG_OBSERVERS_H_
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include "wldbg.h"
+
+/* what to do when the ring is full */
+enum wldbg_observers_policy {
+	/* wait until the observer thread makes some space */
+	WLDBG_OBSERVERS_BLOCK = 1,
+	/* drop the message that does not fit */
+	WLDBG_OBSERVERS_DROP_NEWEST,
+	/* drop it too, but tell the observers how many
+	 * messages they missed (wldbg_message.dropped) */
+	WLDBG_OBSERVERS_COUNT_DROPS,
+};
+
+/* default size of the ring, it is always at least
+ * four times max_buffer_size */
+#define WLDBG_OBSERVERS_RING_SIZE	(1024 * 1024)
+
+/*
+ * Passes with WLDBG_PASS_OBSERVER flag run in a background thread.
+ * The thread that forwards messages copies them into a single-producer
+ * single-consumer ring and the observer thread runs the passes on them,
+ * so that a slow terminal or disk does not stall the clients.
+ * Every thread that forwards messages (main thread or a worker)
+ * has its own ring and observer thread.
+ */
+struct wldbg_observers {
+	struct wldbg *wldbg;
+	pthread_t thread;
+	enum wldbg_observers_policy policy;
+
+	char *ring;
+	/* power of two */
+	size_t size;
+	/* free-running positions, head is written only by
+	 * the producer and tail only by the observer thread */
+	size_t head;
+	size_t tail;
+
+	/* eventfds for sleeping when the ring is empty (observer)
+	 * or full (producer) and flags that say somebody sleeps,
+	 * so that we do not need a syscall for every message */
+	int observer_fd;
+	int producer_fd;
+	int observer_sleeps;
+	int producer_sleeps;
+	int quit;
+
+	/* touched only by the producer */
+	unsigned long dropped_since;
+	struct {
+		unsigned long messages;
+		unsigned long dropped;
+		unsigned long blocked;
+		size_t max_used;
+	} statistics;
+};
+
+struct wldbg_observers *
+wldbg_observers_create(struct wldbg *wldbg,
+		       enum wldbg_observers_policy policy);
+
+/* run the observers on what is left in the ring and stop the thread */
+void
+wldbg_observers_destroy(struct wldbg_observers *observers);
+
+/* copy the message for observer passes from the mask (bit n is set
+ * for n-th pass, passes from 64th on get every message) */
+void
+wldbg_observers_push(struct wldbg_observers *observers,
+		     struct wldbg_message *message, uint64_t passes);
+
+/* wait until observers processed all messages
+ * (i. e. before destroying a connection) */
+void
+wldbg_observers_sync(struct wldbg_observers *observers);
+
+#endif /* _WLDBG_OBSERVERS_H_ */
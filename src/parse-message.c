@@ -26,7 +26,6 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <assert.h>
-#include <ctype.h>
 
 #include "resolve.h"
 #include "util.h"
@@ -86,6 +85,7 @@ int wldbg_resolve_message(struct wldbg_message *msg,
 		return 0;
 
 	out->wl_interface = interface;
+	out->version = wldbg_message_get_object_version(msg, out->base.id);
 
 	if (msg->from == SERVER) {
 		if ((uint32_t) interface->event_count <= out->base.opcode)
@@ -102,69 +102,124 @@ int wldbg_resolve_message(struct wldbg_message *msg,
 	if (!out->wl_message || !out->wl_message->signature)
 		return 0;
 
+	/* interfaces that were not registered get it compiled here */
+	out->signature = wldbg_interface_get_signature(interface, msg->from,
+						       out->base.opcode);
+	if (!out->signature
+	    && wldbg_signature_compile(&out->compiled,
+				       out->wl_message->signature) < 0)
+		return 0;
+
 	return 1;
 }
 
-static const char *
-signature_get_type(const char *sig, unsigned int *nullable)
+static const struct wldbg_signature *
+message_signature(struct wldbg_resolved_message *msg)
 {
-	assert(sig);
+	return msg->signature ? msg->signature : &msg->compiled;
+}
 
-	*nullable = 0;
-	while(*sig && (*sig == '?' || isdigit(*sig))) {
-		if (*sig == '?')
-			*nullable = 1;
-		++sig;
+int
+wldbg_signature_arg_offset(const struct wldbg_signature *sig,
+			   const uint32_t *data, uint32_t size,
+			   unsigned int arg)
+{
+	uint32_t off;
+	unsigned int n;
+
+	if (arg <= sig->first_varlen)
+		return arg < size ? (int) arg : -1;
+
+	/* strings and arrays have the size and then the data,
+	 * fds are not in the data at all. The sizes come from
+	 * the wire, so check them against the message */
+	off = sig->first_varlen;
+	for (n = sig->first_varlen; n < arg; ++n) {
+		if (sig->varlen & (1u << n)) {
+			if (off >= size
+			    || data[off] > (size - off - 1) * sizeof(uint32_t))
+				return -1;
+			off += 1 + DIV_ROUNDUP(data[off], sizeof(uint32_t));
+		} else if (!(sig->fds & (1u << n))) {
+			++off;
+		}
 	}
 
-	return sig;
+	return off < size ? (int) off : -1;
 }
 
-static uint32_t *
-get_data_ptr(struct wldbg_resolved_message *msg)
+/* checks that the argument at data[off] is inside of the message
+ * with words of data. Sizes of strings and arrays come from the wire,
+ * so they are checked too, like that strings are terminated */
+static int
+argument_valid(const uint32_t *data, uint32_t words, uint32_t off,
+	       char type, int varlen)
 {
-	/* If this is a string or array that is empty,
-	 * set it to NULL, otherwise make it pointing
-	 * to the data */
-	if ((*msg->signature_position == 'a'
-	     || *msg->signature_position == 's')) {
-		/* msg->data_position points to the size of the
-		 * array/string, so here we check if the size of
-		 * array/string is 0 */
-		if (*msg->data_position == 0)
-			return NULL;
-		else
-			/* skip size argument and point
-			 * to the data itself */
-			return msg->data_position + 1;
-	} else {
-		/* if this is not a string or array, just
-		 * point to the data */
-		return msg->data_position;
-	}
+	uint32_t len;
+
+	if (off >= words)
+		return 0;
 
-	assert(0 && "Should not be reached");
+	if (!varlen)
+		return 1;
+
+	len = data[off];
+	if (len > (words - off - 1) * sizeof(uint32_t))
+		return 0;
+
+	/* strings carry the terminating 0 in the length */
+	if (len > 0 && type == 's'
+	    && ((const char *) (data + off + 1))[len - 1] != '\0')
+		return 0;
+
+	return 1;
 }
 
-static void
-initialize_iterator(struct wldbg_resolved_message *msg)
+static uint32_t
+message_words(const struct wldbg_resolved_message *msg)
 {
-	const char *sig = signature_get_type(msg->wl_message->signature,
-					     &msg->cur_arg.nullable);
+	if (msg->base.size < 8)
+		return 0;
 
-	msg->signature_position = sig;
-	msg->data_position = msg->base.data;
+	return (msg->base.size - 8) / sizeof(uint32_t);
+}
 
-	msg->cur_arg.type = *sig;
-	msg->cur_arg.data = get_data_ptr(msg);
+static void
+set_current_argument(struct wldbg_resolved_message *msg,
+		     const struct wldbg_signature *sig)
+{
+	struct wldbg_resolved_arg *arg = &msg->cur_arg;
+
+	arg->type = sig->types[msg->arg];
+	arg->nullable = !!(sig->nullable & (1u << msg->arg));
+
+	/* empty strings and arrays are NULL, otherwise
+	 * the data are after the size */
+	if (sig->varlen & (1u << msg->arg))
+		arg->data = *msg->data_position == 0
+			    ? NULL : msg->data_position + 1;
+	else if (sig->fds & (1u << msg->arg))
+		arg->data = NULL;
+	else
+		arg->data = msg->data_position;
+}
 
-	assert(!*sig || *sig == 'a' || *sig == 's' || msg->cur_arg.data);
+static void
+ensure_signature(struct wldbg_resolved_message *msg)
+{
+	/* the message was not filled by wldbg_resolve_message */
+	if (!msg->signature && msg->compiled.args_num == 0
+	    && msg->wl_message && msg->wl_message->signature)
+		wldbg_signature_compile(&msg->compiled,
+					msg->wl_message->signature);
 }
 
 void
 wldbg_resolved_message_reset_iterator(struct wldbg_resolved_message *msg)
 {
-	msg->signature_position = NULL;
+	ensure_signature(msg);
+
+	msg->arg = 0;
 	msg->data_position = NULL;
 	memset(&msg->cur_arg, 0,
 	       sizeof(struct wldbg_resolved_arg));
@@ -173,68 +228,106 @@ wldbg_resolved_message_reset_iterator(struct wldbg_resolved_message *msg)
 struct wldbg_resolved_arg *
 wldbg_resolved_message_next_argument(struct wldbg_resolved_message *msg)
 {
-	size_t size, off = 0;
-	char type;
-
-	/* first iteration */
-	if (msg->signature_position == NULL) {
-		initialize_iterator(msg);
-		/* message has no arguments? */
-		if (msg->cur_arg.type == 0)
+	const struct wldbg_signature *sig = message_signature(msg);
+	uint32_t *p;
+
+	if (msg->data_position == NULL) {
+		/* first iteration */
+		msg->arg = 0;
+		msg->data_position = msg->base.data;
+	} else {
+		/* calling next_argument on iterator
+		 * that reached the end */
+		if (msg->arg >= sig->args_num)
 			return NULL;
 
-		return &msg->cur_arg;
+		p = msg->data_position;
+		if (sig->varlen & (1u << msg->arg))
+			p += 1 + DIV_ROUNDUP(*p, sizeof(uint32_t));
+		else if (!(sig->fds & (1u << msg->arg)))
+			++p;
+
+		msg->data_position = p;
+		++msg->arg;
 	}
 
-	/* need to store type before getting next argument,
-	 * so that we know where to shift in data */
-	type = *msg->signature_position;
+	if (msg->arg >= sig->args_num) {
+		msg->cur_arg.type = 0;
+		return NULL;
+	}
 
-	/* calling next_argument on iterator that reached
-	 * the end */
-	if (type == 0)
+	/* stop at the end of the message, the next calls return NULL */
+	if (!(sig->fds & (1u << msg->arg))
+	    && !argument_valid(msg->base.data, message_words(msg),
+			       msg->data_position - msg->base.data,
+			       sig->types[msg->arg],
+			       sig->varlen & (1u << msg->arg))) {
+		msg->arg = sig->args_num;
+		msg->cur_arg.type = 0;
 		return NULL;
+	}
 
-	/* set new type and position in signature */
-	msg->signature_position
-		= signature_get_type(msg->signature_position + 1,
-				     &msg->cur_arg.nullable);
-	msg->cur_arg.type = *msg->signature_position;
+	set_current_argument(msg, sig);
 
-	if (msg->cur_arg.type == 0)
-		return NULL;
+	return &msg->cur_arg;
+}
 
-	/* find data of next argument */
-	switch (type) {
-	case 'u':
-	case 'i':
-	case 'f':
-	case 'o':
-	case 'n':
-	case 'h':
-		++msg->data_position;
-		break;
-	case 's':
-	case 'a':
-		/* msg->data_position now points to
-		 * size argument of previous string/array */
-		size = *msg->data_position;
-		if (size == 0) {
-			++msg->data_position;
-		} else {
-			off = DIV_ROUNDUP(size, sizeof(uint32_t));
-			msg->data_position += (off + 1);
+int
+wldbg_resolved_message_get_args(struct wldbg_resolved_message *msg,
+				struct wldbg_message_args *args)
+{
+	const struct wldbg_signature *sig;
+	struct wldbg_message_arg *arg;
+	uint32_t *data = msg->base.data;
+	uint32_t words, off = 0, len;
+	unsigned int n;
+
+	ensure_signature(msg);
+	sig = message_signature(msg);
+
+	if (msg->base.size < 8)
+		return -1;
+	words = message_words(msg);
+
+	for (n = 0; n < sig->args_num; ++n) {
+		arg = &args->args[n];
+		arg->type = sig->types[n];
+		arg->nullable = !!(sig->nullable & (1u << n));
+		arg->length = 0;
+
+		if (sig->fds & (1u << n)) {
+			arg->data = NULL;
+			continue;
+		}
+
+		if (!argument_valid(data, words, off, arg->type,
+				    sig->varlen & (1u << n)))
+			return -1;
+
+		if (!(sig->varlen & (1u << n))) {
+			arg->data = data + off++;
+			continue;
 		}
-		break;
-	default:
-		fprintf(stderr, "Warning: unhandled type: %d (%c)\n", type, type);
+
+		len = data[off++];
+		arg->length = len;
+		arg->data = len ? data + off : NULL;
+		off += DIV_ROUNDUP(len, sizeof(uint32_t));
 	}
 
-	/* ok, we now have pointer to the data of
-	 * the current argument, so set it in the iterator */
-	msg->cur_arg.data = get_data_ptr(msg);
+	args->num = sig->args_num;
 
-	return &msg->cur_arg;
+	return 0;
+}
+
+const struct wldbg_message_arg *
+wldbg_message_args_get(const struct wldbg_message_args *args,
+		       unsigned int i)
+{
+	if (i >= args->num)
+		return NULL;
+
+	return &args->args[i];
 }
 
 char *
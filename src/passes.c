@@ -37,6 +37,7 @@
 #include "util.h"
 #include "wldbg-pass.h"
 #include "getopt.h"
+#include "latency.h"
 
 /* hardcoded passes */
 extern struct wldbg_pass wldbg_pass_list;
@@ -122,7 +123,7 @@ dealloc_pass(struct pass *pass)
 struct pass *
 alloc_pass(const char *name)
 {
-	struct pass *pass = malloc(sizeof *pass);
+	struct pass *pass = calloc(1, sizeof *pass);
 	if (!pass)
 		return NULL;
 
@@ -253,6 +254,75 @@ pass_init(struct wldbg *wldbg, struct pass *pass,
 		return 0;
 }
 
+static void
+statistics_add(struct pass_statistics *stats, uint64_t time, int stop)
+{
+	uint64_t max = __atomic_load_n(&stats->max_ns, __ATOMIC_RELAXED);
+
+	__atomic_fetch_add(&stats->calls, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&stats->total_ns, time, __ATOMIC_RELAXED);
+	if (stop)
+		__atomic_fetch_add(&stats->stops, 1, __ATOMIC_RELAXED);
+
+	while (time > max
+	       && !__atomic_compare_exchange_n(&stats->max_ns, &max, time, 1,
+					       __ATOMIC_RELAXED,
+					       __ATOMIC_RELAXED))
+		;
+}
+
+int
+pass_call(struct wldbg *wldbg, struct pass *pass,
+	  struct wldbg_message *message)
+{
+	uint64_t start = 0;
+	int ret;
+
+	/* CPU time, a pass that waits for a slow terminal
+	 * or disk is not expensive */
+	if (wldbg->flags.pass_stats)
+		start = wldbg_thread_cpu_ns();
+
+	if (message->from == SERVER)
+		ret = pass->wldbg_pass.server_pass(pass->wldbg_pass.user_data,
+						   message);
+	else
+		ret = pass->wldbg_pass.client_pass(pass->wldbg_pass.user_data,
+						   message);
+
+	if (wldbg->flags.pass_stats)
+		statistics_add(&pass->statistics[message->from],
+			       wldbg_thread_cpu_ns() - start, ret == PASS_STOP);
+
+	return ret;
+}
+
+static void
+print_statistics(const char *name, const char *direction,
+		 struct pass_statistics *stats)
+{
+	printf("	%-16s %-6s %10lu %8lu %12.1f %8.2f %10.1f\n",
+	       name, direction, stats->calls, stats->stops,
+	       stats->total_ns / 1000.0,
+	       stats->calls ? (double) stats->total_ns / stats->calls / 1000.0
+			    : 0.0,
+	       stats->max_ns / 1000.0);
+}
+
+void
+pass_print_statistics(struct pass *pass)
+{
+	print_statistics(pass->name, "server", &pass->statistics[SERVER]);
+	print_statistics(pass->name, "client", &pass->statistics[CLIENT]);
+}
+
+void
+pass_print_statistics_header(void)
+{
+	printf("	%-16s %-6s %10s %8s %12s %8s %10s\n", "pass (cpu us)", "from",
+	       "calls", "stops", "total", "avg", "max");
+}
+
 static int
 count_args(int argc, const char *argv[])
 {
@@ -326,6 +396,7 @@ load_passes(struct wldbg *wldbg, struct wldbg_options *opts,
 
 				++pass_created;
 				wl_list_insert(wldbg->passes.next, &pass->link);
+				wldbg_passes_changed(wldbg);
 				dbg("Pass '%s' loaded\n", argv[argc - rest]);
 			} else {
 				dbg("Loading pass '%s' failed\n",
@@ -41,6 +41,30 @@ int
 pass_init(struct wldbg *wldbg, struct pass *pass,
 		int argc, const char *argv[]);
 
+/* call the pass on the message and account
+ * the time it took with --pass-stats */
+int
+pass_call(struct wldbg *wldbg, struct pass *pass,
+	  struct wldbg_message *message);
+
+void
+pass_print_statistics_header(void);
+
+void
+pass_print_statistics(struct pass *pass);
+
+/* defined in subscriptions.c */
+struct pass_subscriptions;
+
+/* get mask of passes that want the message - bit n is set
+ * when n-th pass in wldbg->passes wants it. Passes from 64th on
+ * are not in the mask and are called always */
+uint64_t
+pass_subscriptions_get_mask(struct wldbg_message *message);
+
+void
+pass_subscriptions_destroy(struct pass_subscriptions *subscriptions);
+
 /* defined in passes/list.c */
 void
 list_passes(int lng);
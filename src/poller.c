@@ -0,0 +1,1651 @@
+/*
+ * Copyright (c) 2015 Marek Chalupa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include "config.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+#ifdef HAVE_IO_URING
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include <linux/time_types.h>
+#endif
+
+#include "wayland/wayland-util.h"
+#include "wayland/wayland-private.h"
+#include "poller.h"
+
+#ifdef HAVE_IO_URING
+
+#define URING_ENTRIES		256
+/* multishot receives can complete many times per request */
+#define URING_CQ_ENTRIES	(4 * URING_ENTRIES)
+
+/* every socket has its own group of provided buffers, so a peer
+ * that is not read (reading is paused) fills only its own buffers
+ * and then the data wait in the socket */
+#define URING_RECV_BUFFERS	8
+#define URING_RECV_BUFFER_SIZE	4096
+
+/* wl_connection sends at most 28 fds (MAX_FDS_OUT) in one sendmsg
+ * and receives at most that many in one recvmsg */
+#define URING_MAX_FDS		28
+#define URING_CONTROL_SIZE	CMSG_SPACE(URING_MAX_FDS * sizeof(int))
+
+/* how long the last sends may wait for the peer on exit */
+#define URING_RELEASE_TIMEOUT_MS	100
+
+/* limits of what one connection sends in one loop iteration */
+#define URING_SEND_MAX		(256 * 1024)
+#define URING_MAX_SENDS		32
+
+/* what request completed, in the low bits of user_data */
+#define URING_POLL		0
+#define URING_RECV		1
+#define URING_SEND		2
+#define URING_KIND_MASK		3
+
+struct uring;
+struct uring_entry;
+
+/* one sendmsg of a batch */
+struct uring_sendmsg {
+	/* the data are in the buffer of the batch */
+	uint32_t offset, len;
+	int fds[URING_MAX_FDS];
+	int fds_num;
+
+	/* used by the kernel until the send completes */
+	struct msghdr msg;
+	struct iovec iov;
+	char cmsg[URING_CONTROL_SIZE];
+};
+
+/* what a connection sent in one loop iteration. The sends are
+ * submitted linked, so that they go out in order */
+struct uring_send {
+	char *data;
+	uint32_t size, alloc;
+
+	struct uring_sendmsg *msgs;
+	unsigned int num, alloc_num;
+
+	/* the batch is in the kernel */
+	unsigned int submitted : 1;
+	/* sends that completed so far */
+	unsigned int done;
+};
+
+/* fd of a wl_connection whose data go through the ring */
+struct uring_io {
+	struct wl_connection_io base;
+	struct uring *uring;
+	struct uring_entry *entry;
+
+	/* ring of provided buffers followed by the buffers */
+	void *mem;
+	size_t mem_size;
+	struct io_uring_buf_ring *buf_ring;
+	char *buffers;
+	uint16_t bgid;
+	uint16_t buf_tail;
+	/* multishot RECVMSG reads the lengths from it */
+	struct msghdr recv_msg;
+
+	/* multishot RECVMSG is in the kernel */
+	unsigned int receiving : 1;
+	unsigned int eof : 1;
+	int recv_error;
+	/* filled buffers that were not read yet, in order */
+	uint16_t held[URING_RECV_BUFFERS];
+	unsigned int held_first, held_num;
+	/* how much of the first held buffer was read */
+	uint32_t held_offset;
+
+	/* EPOLLHUP or EPOLLERR reported by the poll */
+	uint32_t hangup;
+	int send_error;
+	struct uring_send send;
+	/* in the list of batches to submit */
+	struct wl_list send_link;
+};
+
+/* fd polled by io_uring */
+struct uring_entry {
+	int fd;
+	uint32_t events;
+	void *data;
+
+	/* POLL_ADD request is in the kernel */
+	unsigned int armed : 1;
+	/* POLL_REMOVE request for it is in the kernel */
+	unsigned int canceling : 1;
+	/* removed, free it when its requests are done */
+	unsigned int dead : 1;
+	/* in the list of entries waiting to be armed */
+	unsigned int queued : 1;
+	/* in the list of entries that may have events to report */
+	unsigned int ready : 1;
+
+	/* requests (submitted or not) that point to the entry */
+	unsigned int requests;
+
+	/* in the list of entries waiting to be armed
+	 * or in the list of removed entries */
+	struct wl_list link;
+	struct wl_list ready_link;
+
+	/* set when the fd is read and written by the ring */
+	struct uring_io *io;
+};
+
+struct uring {
+	int fd;
+
+	void *sq_ring;
+	size_t sq_ring_size;
+	unsigned *sq_head, *sq_tail, *sq_mask, *sq_array, *sq_flags;
+	struct io_uring_sqe *sqes;
+	size_t sqes_size;
+	/* sqes filled, but not submitted yet */
+	unsigned to_submit;
+
+	void *cq_ring;
+	size_t cq_ring_size;
+	unsigned *cq_head, *cq_tail, *cq_mask, *cq_overflow;
+	struct io_uring_cqe *cqes;
+
+	/* entries indexed by fd */
+	struct uring_entry **entries;
+	int entries_size;
+	/* entries that need a POLL_ADD or RECVMSG request */
+	struct wl_list unarmed;
+	/* removed entries that are still used by the kernel */
+	struct wl_list removed;
+	/* entries of sockets whose state changed, they are
+	 * reported in the next wait if they have some events */
+	struct wl_list ready;
+	/* sockets with sends to submit */
+	struct wl_list sending;
+
+	/* groups of provided buffers are numbered from this one */
+	uint16_t next_bgid;
+};
+
+#endif /* HAVE_IO_URING */
+
+struct wldbg_poller {
+	enum wldbg_poller_backend backend;
+	int epoll_fd;
+#ifdef HAVE_IO_URING
+	struct uring uring;
+#endif
+};
+
+#ifdef HAVE_IO_URING
+
+static int
+uring_enter(struct uring *uring, unsigned min_complete, unsigned flags)
+{
+	int ret;
+
+	ret = syscall(__NR_io_uring_enter, uring->fd, uring->to_submit,
+		      min_complete, flags, NULL, 0);
+	if (ret < 0)
+		return -1;
+
+	uring->to_submit -= ret;
+	return 0;
+}
+
+static unsigned
+uring_sq_space(struct uring *uring)
+{
+	return *uring->sq_mask + 1
+		- (*uring->sq_tail
+		   - __atomic_load_n(uring->sq_head, __ATOMIC_ACQUIRE));
+}
+
+static struct io_uring_sqe *
+uring_get_sqe(struct uring *uring)
+{
+	struct io_uring_sqe *sqe;
+	unsigned tail;
+
+	/* full, submit what we have */
+	if (uring_sq_space(uring) == 0) {
+		if (uring_enter(uring, 0, 0) < 0)
+			return NULL;
+		if (uring_sq_space(uring) == 0) {
+			errno = EBUSY;
+			return NULL;
+		}
+	}
+
+	tail = *uring->sq_tail;
+	sqe = &uring->sqes[tail & *uring->sq_mask];
+	memset(sqe, 0, sizeof *sqe);
+	uring->sq_array[tail & *uring->sq_mask] = tail & *uring->sq_mask;
+	__atomic_store_n(uring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+	++uring->to_submit;
+
+	return sqe;
+}
+
+static void
+uring_queue(struct uring *uring, struct uring_entry *entry)
+{
+	if (entry->queued)
+		return;
+
+	wl_list_insert(uring->unarmed.prev, &entry->link);
+	entry->queued = 1;
+}
+
+static void
+uring_mark_ready(struct uring *uring, struct uring_entry *entry)
+{
+	if (entry->ready)
+		return;
+
+	wl_list_insert(uring->ready.prev, &entry->ready_link);
+	entry->ready = 1;
+}
+
+static int
+uring_arm(struct uring *uring, struct uring_entry *entry)
+{
+	struct io_uring_sqe *sqe;
+
+	sqe = uring_get_sqe(uring);
+	if (!sqe)
+		return -1;
+
+	/* one-shot poll, so that the fd is level-triggered
+	 * like with epoll - it is re-armed after dispatching.
+	 * Sockets read by the ring are polled only for hangup */
+	sqe->opcode = IORING_OP_POLL_ADD;
+	sqe->fd = entry->fd;
+	sqe->poll32_events = entry->io ? 0 : entry->events;
+	sqe->user_data = (uintptr_t) entry | URING_POLL;
+
+	entry->armed = 1;
+	++entry->requests;
+	return 0;
+}
+
+static int
+uring_cancel(struct uring *uring, struct uring_entry *entry)
+{
+	struct io_uring_sqe *sqe;
+
+	if (entry->canceling)
+		return 0;
+
+	sqe = uring_get_sqe(uring);
+	if (!sqe)
+		return -1;
+
+	sqe->opcode = IORING_OP_POLL_REMOVE;
+	sqe->fd = -1;
+	sqe->addr = (uintptr_t) entry | URING_POLL;
+	/* we do not care about the result of removing */
+	sqe->user_data = 0;
+
+	entry->canceling = 1;
+	return 0;
+}
+
+/* cancel receiving or sending of a removed socket */
+static int
+uring_cancel_io(struct uring *uring, struct uring_entry *entry, int kind)
+{
+	struct io_uring_sqe *sqe;
+
+	sqe = uring_get_sqe(uring);
+	if (!sqe)
+		return -1;
+
+	sqe->opcode = IORING_OP_ASYNC_CANCEL;
+	sqe->fd = -1;
+	sqe->addr = (uintptr_t) entry | kind;
+	sqe->cancel_flags = IORING_ASYNC_CANCEL_ALL;
+	sqe->user_data = 0;
+
+	return 0;
+}
+
+static struct io_uring_recvmsg_out *
+uring_io_buffer(struct uring_io *io, uint16_t bid)
+{
+	return (struct io_uring_recvmsg_out *)
+		(io->buffers + bid * URING_RECV_BUFFER_SIZE);
+}
+
+/* give the buffer back to the kernel */
+static void
+uring_io_recycle(struct uring_io *io, uint16_t bid)
+{
+	struct io_uring_buf *buf;
+
+	buf = &io->buf_ring->bufs[io->buf_tail & (URING_RECV_BUFFERS - 1)];
+	buf->addr = (uintptr_t) uring_io_buffer(io, bid);
+	buf->len = URING_RECV_BUFFER_SIZE;
+	buf->bid = bid;
+
+	++io->buf_tail;
+	__atomic_store_n(&io->buf_ring->tail, io->buf_tail, __ATOMIC_RELEASE);
+}
+
+/* close the fds that came with the data in the buffer */
+static void
+uring_io_close_fds(struct uring_io *io, struct io_uring_recvmsg_out *out)
+{
+	struct msghdr msg;
+	struct cmsghdr *cmsg;
+	int *fds, i, num;
+
+	memset(&msg, 0, sizeof msg);
+	msg.msg_control = out + 1;
+	msg.msg_controllen = out->controllen;
+
+	for (cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL;
+	     cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+		if (cmsg->cmsg_level != SOL_SOCKET
+		    || cmsg->cmsg_type != SCM_RIGHTS)
+			continue;
+
+		fds = (int *) CMSG_DATA(cmsg);
+		num = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+		for (i = 0; i < num; ++i)
+			close(fds[i]);
+	}
+}
+
+/* drop the received data that nobody is going to read */
+static void
+uring_io_drop_received(struct uring_io *io)
+{
+	uint16_t bid;
+
+	while (io->held_num > 0) {
+		bid = io->held[io->held_first];
+		if (io->held_offset == 0)
+			uring_io_close_fds(io, uring_io_buffer(io, bid));
+		uring_io_recycle(io, bid);
+
+		io->held_first = (io->held_first + 1) % URING_RECV_BUFFERS;
+		--io->held_num;
+		io->held_offset = 0;
+	}
+}
+
+static void
+uring_send_reset(struct uring_send *send)
+{
+	unsigned int i;
+	int j;
+
+	for (i = 0; i < send->num; ++i) {
+		for (j = 0; j < send->msgs[i].fds_num; ++j)
+			close(send->msgs[i].fds[j]);
+	}
+
+	send->size = 0;
+	send->num = 0;
+	send->submitted = 0;
+	send->done = 0;
+}
+
+static int
+uring_io_can_receive(struct uring_io *io)
+{
+	return !io->receiving && !io->eof && !io->recv_error
+		&& !io->entry->dead
+		&& io->held_num < URING_RECV_BUFFERS;
+}
+
+/* keep receiving into the provided buffers until they run out */
+static int
+uring_io_receive(struct uring *uring, struct uring_io *io)
+{
+	struct io_uring_sqe *sqe;
+
+	sqe = uring_get_sqe(uring);
+	if (!sqe)
+		return -1;
+
+	sqe->opcode = IORING_OP_RECVMSG;
+	sqe->fd = io->entry->fd;
+	sqe->addr = (uintptr_t) &io->recv_msg;
+	sqe->len = 1;
+	sqe->ioprio = IORING_RECV_MULTISHOT;
+	sqe->msg_flags = MSG_CMSG_CLOEXEC;
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->buf_group = io->bgid;
+	sqe->user_data = (uintptr_t) io->entry | URING_RECV;
+
+	io->receiving = 1;
+	++io->entry->requests;
+	return 0;
+}
+
+/* wl_connection reads from the received buffers */
+static int
+uring_io_recvmsg(struct wl_connection_io *base, struct msghdr *msg)
+{
+	struct uring_io *io = wl_container_of(base, io, base);
+	struct io_uring_recvmsg_out *out;
+	size_t space = 0, copied = 0, controllen = 0, len, n;
+	struct iovec *iov = msg->msg_iov;
+	size_t iov_offset = 0;
+	char *payload;
+	uint16_t bid;
+
+	for (n = 0; n < msg->msg_iovlen; ++n)
+		space += msg->msg_iov[n].iov_len;
+
+	while (io->held_num > 0 && copied < space) {
+		bid = io->held[io->held_first];
+		out = uring_io_buffer(io, bid);
+
+		/* fds come with the first byte of the buffer */
+		if (io->held_offset == 0 && out->controllen > 0) {
+			if (controllen + out->controllen
+			    > msg->msg_controllen)
+				break;
+
+			memcpy((char *) msg->msg_control + controllen,
+			       out + 1, out->controllen);
+			controllen += out->controllen;
+		}
+
+		payload = (char *) (out + 1) + URING_CONTROL_SIZE;
+		len = out->payloadlen - io->held_offset;
+		if (len > space - copied)
+			len = space - copied;
+
+		io->held_offset += len;
+		copied += len;
+
+		/* copy into the (at most two) chunks of the buffer */
+		while (len > 0) {
+			n = iov->iov_len - iov_offset;
+			if (n > len)
+				n = len;
+
+			memcpy((char *) iov->iov_base + iov_offset,
+			       payload + io->held_offset - len, n);
+			len -= n;
+			iov_offset += n;
+			if (iov_offset == iov->iov_len) {
+				++iov;
+				iov_offset = 0;
+			}
+		}
+
+		if (io->held_offset < out->payloadlen)
+			break;
+
+		uring_io_recycle(io, bid);
+		io->held_first = (io->held_first + 1) % URING_RECV_BUFFERS;
+		--io->held_num;
+		io->held_offset = 0;
+	}
+
+	msg->msg_controllen = controllen;
+	msg->msg_flags = 0;
+
+	if (copied > 0) {
+		if (uring_io_can_receive(io))
+			uring_queue(io->uring, io->entry);
+		/* level-triggered, the rest is reported again */
+		if (io->held_num > 0)
+			uring_mark_ready(io->uring, io->entry);
+
+		return copied;
+	}
+
+	if (io->held_num > 0) {
+		/* the fds do not fit, like MSG_CTRUNC */
+		errno = EOVERFLOW;
+		return -1;
+	}
+
+	if (io->recv_error) {
+		errno = io->recv_error;
+		return -1;
+	}
+
+	if (io->eof)
+		return 0;
+
+	errno = EAGAIN;
+	return -1;
+}
+
+/* wl_connection sends: the data and fds are added to the batch
+ * that is submitted in the next wait. While the previous batch
+ * is in the kernel, the connection keeps the data queued */
+static int
+uring_io_sendmsg(struct wl_connection_io *base, const struct msghdr *msg)
+{
+	struct uring_io *io = wl_container_of(base, io, base);
+	struct uring_send *send = &io->send;
+	struct uring_sendmsg *m, *msgs;
+	struct cmsghdr *cmsg;
+	size_t len = 0, n, i;
+	uint32_t alloc;
+	int fds_num = 0;
+	char *data;
+
+	if (io->send_error) {
+		errno = io->send_error;
+		return -1;
+	}
+
+	if (send->submitted) {
+		errno = EAGAIN;
+		return -1;
+	}
+
+	for (i = 0; i < msg->msg_iovlen; ++i)
+		len += msg->msg_iov[i].iov_len;
+
+	for (cmsg = CMSG_FIRSTHDR((struct msghdr *) msg); cmsg != NULL;
+	     cmsg = CMSG_NXTHDR((struct msghdr *) msg, cmsg)) {
+		if (cmsg->cmsg_level == SOL_SOCKET
+		    && cmsg->cmsg_type == SCM_RIGHTS)
+			fds_num += (cmsg->cmsg_len - CMSG_LEN(0))
+				   / sizeof(int);
+	}
+
+	if (fds_num > URING_MAX_FDS) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (len > URING_SEND_MAX - send->size)
+		len = URING_SEND_MAX - send->size;
+	if (len == 0) {
+		errno = EAGAIN;
+		return -1;
+	}
+
+	/* fds can go out earlier than the data of their message,
+	 * but not later, so they can join the previous sendmsg */
+	if (send->num == 0
+	    || send->msgs[send->num - 1].fds_num + fds_num > URING_MAX_FDS) {
+		if (send->num == URING_MAX_SENDS) {
+			errno = EAGAIN;
+			return -1;
+		}
+
+		if (send->num == send->alloc_num) {
+			n = send->alloc_num ? 2 * send->alloc_num : 4;
+			msgs = realloc(send->msgs, n * sizeof *msgs);
+			if (!msgs)
+				return -1;
+
+			send->msgs = msgs;
+			send->alloc_num = n;
+		}
+
+		m = &send->msgs[send->num++];
+		m->offset = send->size;
+		m->len = 0;
+		m->fds_num = 0;
+	}
+
+	m = &send->msgs[send->num - 1];
+
+	if (send->size + len > send->alloc) {
+		alloc = send->alloc ? send->alloc : 4096;
+		while (alloc < send->size + len)
+			alloc *= 2;
+
+		data = realloc(send->data, alloc);
+		if (!data) {
+			if (m->len == 0)
+				--send->num;
+			return -1;
+		}
+
+		send->data = data;
+		send->alloc = alloc;
+	}
+
+	/* the first batch of this iteration */
+	if (send->size == 0)
+		wl_list_insert(io->uring->sending.prev, &io->send_link);
+
+	for (i = 0, n = len; n > 0; ++i) {
+		size_t chunk = msg->msg_iov[i].iov_len;
+
+		if (chunk > n)
+			chunk = n;
+
+		memcpy(send->data + send->size, msg->msg_iov[i].iov_base,
+		       chunk);
+		send->size += chunk;
+		n -= chunk;
+	}
+
+	for (cmsg = CMSG_FIRSTHDR((struct msghdr *) msg); cmsg != NULL;
+	     cmsg = CMSG_NXTHDR((struct msghdr *) msg, cmsg)) {
+		if (cmsg->cmsg_level != SOL_SOCKET
+		    || cmsg->cmsg_type != SCM_RIGHTS)
+			continue;
+
+		n = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+		memcpy(m->fds + m->fds_num, CMSG_DATA(cmsg), n * sizeof(int));
+		m->fds_num += n;
+	}
+
+	m->len += len;
+
+	return len;
+}
+
+/* submit the batch of sends, linked so that they go out in order */
+static int
+uring_io_submit(struct uring *uring, struct uring_io *io)
+{
+	struct uring_send *send = &io->send;
+	struct uring_sendmsg *m;
+	struct io_uring_sqe *sqe;
+	struct cmsghdr *cmsg;
+	unsigned int i;
+
+	/* a link can not be split between two submissions */
+	if (uring_sq_space(uring) < send->num && uring_enter(uring, 0, 0) < 0)
+		return -1;
+
+	for (i = 0; i < send->num; ++i) {
+		m = &send->msgs[i];
+
+		m->iov.iov_base = send->data + m->offset;
+		m->iov.iov_len = m->len;
+
+		memset(&m->msg, 0, sizeof m->msg);
+		m->msg.msg_iov = &m->iov;
+		m->msg.msg_iovlen = 1;
+
+		if (m->fds_num > 0) {
+			m->msg.msg_control = m->cmsg;
+			m->msg.msg_controllen
+				= CMSG_LEN(m->fds_num * sizeof(int));
+
+			cmsg = CMSG_FIRSTHDR(&m->msg);
+			cmsg->cmsg_level = SOL_SOCKET;
+			cmsg->cmsg_type = SCM_RIGHTS;
+			cmsg->cmsg_len = CMSG_LEN(m->fds_num * sizeof(int));
+			memcpy(CMSG_DATA(cmsg), m->fds,
+			       m->fds_num * sizeof(int));
+		}
+
+		sqe = uring_get_sqe(uring);
+		if (!sqe)
+			return -1;
+
+		/* stream sockets: the kernel retries until
+		 * the whole message is sent */
+		sqe->opcode = IORING_OP_SENDMSG;
+		sqe->fd = io->entry->fd;
+		sqe->addr = (uintptr_t) &m->msg;
+		sqe->len = 1;
+		sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+		if (i + 1 < send->num)
+			sqe->flags = IOSQE_IO_LINK;
+		sqe->user_data = (uintptr_t) io->entry | URING_SEND;
+
+		++io->entry->requests;
+	}
+
+	send->submitted = 1;
+	return 0;
+}
+
+static struct uring_io *
+uring_io_create(struct uring *uring, struct uring_entry *entry)
+{
+	struct io_uring_buf_reg reg;
+	struct uring_io *io;
+	long page = sysconf(_SC_PAGESIZE);
+	int i, ret = -1;
+
+	io = calloc(1, sizeof *io);
+	if (!io)
+		return NULL;
+
+	io->uring = uring;
+	io->entry = entry;
+	io->base.recvmsg = uring_io_recvmsg;
+	io->base.sendmsg = uring_io_sendmsg;
+
+	/* the ring must be page-aligned */
+	io->mem_size = page + URING_RECV_BUFFERS * URING_RECV_BUFFER_SIZE;
+	io->mem = mmap(NULL, io->mem_size, PROT_READ | PROT_WRITE,
+		       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (io->mem == MAP_FAILED) {
+		free(io);
+		return NULL;
+	}
+
+	io->buf_ring = io->mem;
+	io->buffers = (char *) io->mem + page;
+	for (i = 0; i < URING_RECV_BUFFERS; ++i)
+		uring_io_recycle(io, i);
+
+	/* the group can still be used by a removed socket */
+	for (i = 0; i < 16 && ret < 0; ++i) {
+		memset(&reg, 0, sizeof reg);
+		reg.ring_addr = (uintptr_t) io->buf_ring;
+		reg.ring_entries = URING_RECV_BUFFERS;
+		reg.bgid = uring->next_bgid++;
+
+		ret = syscall(__NR_io_uring_register, uring->fd,
+			      IORING_REGISTER_PBUF_RING, &reg, 1);
+		if (ret < 0 && errno != EEXIST)
+			break;
+	}
+
+	if (ret < 0) {
+		munmap(io->mem, io->mem_size);
+		free(io);
+		return NULL;
+	}
+
+	io->bgid = reg.bgid;
+	io->recv_msg.msg_controllen = URING_CONTROL_SIZE;
+
+	return io;
+}
+
+static void
+uring_io_free(struct uring_io *io)
+{
+	uring_io_drop_received(io);
+	uring_send_reset(&io->send);
+
+	munmap(io->mem, io->mem_size);
+	free(io->send.data);
+	free(io->send.msgs);
+	free(io);
+}
+
+/* the kernel does not use the entry anymore */
+static void
+uring_free_entry(struct uring *uring, struct uring_entry *entry)
+{
+	struct io_uring_buf_reg reg;
+
+	wl_list_remove(&entry->link);
+
+	if (entry->io) {
+		memset(&reg, 0, sizeof reg);
+		reg.bgid = entry->io->bgid;
+		syscall(__NR_io_uring_register, uring->fd,
+			IORING_UNREGISTER_PBUF_RING, &reg, 1);
+
+		uring_io_free(entry->io);
+	}
+
+	free(entry);
+}
+
+/* multishot RECVMSG filled a buffer or ended */
+static void
+uring_io_received(struct uring *uring, struct uring_entry *entry,
+		  struct io_uring_cqe *cqe)
+{
+	struct uring_io *io = entry->io;
+	struct io_uring_recvmsg_out *out;
+	uint16_t bid;
+
+	if (!(cqe->flags & IORING_CQE_F_MORE)) {
+		io->receiving = 0;
+		--entry->requests;
+	}
+
+	if (cqe->flags & IORING_CQE_F_BUFFER) {
+		bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+		out = uring_io_buffer(io, bid);
+
+		if (!entry->dead && out->payloadlen > 0
+		    && !(out->flags & MSG_CTRUNC)) {
+			io->held[(io->held_first + io->held_num)
+				 % URING_RECV_BUFFERS] = bid;
+			++io->held_num;
+		} else {
+			/* end of stream, or the fds did not fit */
+			if (out->payloadlen == 0)
+				io->eof = 1;
+			else if (out->flags & MSG_CTRUNC)
+				io->recv_error = EOVERFLOW;
+
+			uring_io_close_fds(io, out);
+			uring_io_recycle(io, bid);
+		}
+	} else if (cqe->res == 0) {
+		io->eof = 1;
+	} else if (cqe->res < 0 && cqe->res != -ENOBUFS
+		   && cqe->res != -ECANCELED) {
+		io->recv_error = -cqe->res;
+	}
+
+	if (entry->dead)
+		return;
+
+	/* out of buffers, it is re-armed when some are read */
+	if (uring_io_can_receive(io))
+		uring_queue(uring, entry);
+
+	uring_mark_ready(uring, entry);
+}
+
+static void
+uring_io_sent(struct uring *uring, struct uring_entry *entry,
+	      struct io_uring_cqe *cqe)
+{
+	struct uring_io *io = entry->io;
+	struct uring_send *send = &io->send;
+	struct uring_sendmsg *m = &send->msgs[send->done++];
+
+	--entry->requests;
+
+	/* links after a failed send are canceled */
+	if (cqe->res != (int) m->len && !io->send_error)
+		io->send_error = cqe->res < 0 ? -cqe->res : EPIPE;
+
+	if (send->done < send->num)
+		return;
+
+	uring_send_reset(send);
+
+	if (!entry->dead)
+		uring_mark_ready(uring, entry);
+}
+
+/* POLL_ADD completed, returns the events to report */
+static uint32_t
+uring_polled(struct uring *uring, struct uring_entry *entry,
+	     struct io_uring_cqe *cqe)
+{
+	uint32_t mask;
+
+	entry->armed = 0;
+	entry->canceling = 0;
+	--entry->requests;
+
+	if (entry->dead)
+		return 0;
+
+	/* canceled because of new events, it is re-armed below */
+	if (cqe->res == -ECANCELED) {
+		mask = 0;
+	} else if (cqe->res < 0) {
+		mask = EPOLLERR;
+	} else {
+		mask = cqe->res & (entry->events | EPOLLHUP | EPOLLERR);
+	}
+
+	if (entry->io) {
+		/* the data are read by receives, the poll is
+		 * here for hangups and they are reported until
+		 * the socket is removed */
+		mask &= EPOLLHUP | EPOLLERR;
+		if (mask) {
+			entry->io->hangup |= mask;
+			uring_mark_ready(uring, entry);
+		} else {
+			uring_queue(uring, entry);
+		}
+
+		return 0;
+	}
+
+	uring_queue(uring, entry);
+	return mask;
+}
+
+/* events of a socket that is read and written by the ring */
+static uint32_t
+uring_io_events(struct uring_entry *entry)
+{
+	struct uring_io *io = entry->io;
+	uint32_t mask = io->hangup;
+
+	/* the peer does not take data anymore */
+	if (io->send_error)
+		mask |= EPOLLHUP;
+
+	if ((entry->events & EPOLLIN)
+	    && (io->held_num > 0 || io->eof || io->recv_error))
+		mask |= EPOLLIN;
+
+	if ((entry->events & EPOLLOUT) && !io->send.submitted)
+		mask |= EPOLLOUT;
+
+	return mask;
+}
+
+static int
+uring_init(struct uring *uring)
+{
+	struct io_uring_params p;
+	struct io_uring_probe *probe;
+
+	memset(uring, 0, sizeof *uring);
+	memset(&p, 0, sizeof p);
+	wl_list_init(&uring->unarmed);
+	wl_list_init(&uring->removed);
+	wl_list_init(&uring->ready);
+	wl_list_init(&uring->sending);
+
+	p.flags = IORING_SETUP_CQSIZE;
+	p.cq_entries = URING_CQ_ENTRIES;
+
+	uring->fd = syscall(__NR_io_uring_setup, URING_ENTRIES, &p);
+	if (uring->fd < 0)
+		return -1;
+
+	/* without NODROP the kernel drops completions when the CQ ring
+	 * is full and the fds would silently stay disarmed */
+	if (!(p.features & IORING_FEAT_NODROP)) {
+		errno = ENOSYS;
+		goto err_fd;
+	}
+
+	/* multishot RECVMSG came in Linux 6.0, together with SEND_ZC */
+	probe = calloc(1, sizeof *probe + 256 * sizeof probe->ops[0]);
+	if (!probe)
+		goto err_fd;
+
+	if (syscall(__NR_io_uring_register, uring->fd,
+		    IORING_REGISTER_PROBE, probe, 256) < 0
+	    || probe->last_op < IORING_OP_SEND_ZC
+	    || !(probe->ops[IORING_OP_SEND_ZC].flags
+		 & IO_URING_OP_SUPPORTED)) {
+		free(probe);
+		errno = ENOSYS;
+		goto err_fd;
+	}
+	free(probe);
+
+	uring->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	uring->cq_ring_size = p.cq_off.cqes
+		+ p.cq_entries * sizeof(struct io_uring_cqe);
+	uring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+
+	uring->sq_ring = mmap(NULL, uring->sq_ring_size,
+			      PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+			      uring->fd, IORING_OFF_SQ_RING);
+	if (uring->sq_ring == MAP_FAILED)
+		goto err_fd;
+
+	uring->cq_ring = mmap(NULL, uring->cq_ring_size,
+			      PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+			      uring->fd, IORING_OFF_CQ_RING);
+	if (uring->cq_ring == MAP_FAILED)
+		goto err_sq;
+
+	uring->sqes = mmap(NULL, uring->sqes_size,
+			   PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+			   uring->fd, IORING_OFF_SQES);
+	if (uring->sqes == MAP_FAILED)
+		goto err_cq;
+
+	uring->sq_head = (unsigned *)((char *) uring->sq_ring + p.sq_off.head);
+	uring->sq_tail = (unsigned *)((char *) uring->sq_ring + p.sq_off.tail);
+	uring->sq_mask = (unsigned *)((char *) uring->sq_ring
+				      + p.sq_off.ring_mask);
+	uring->sq_array = (unsigned *)((char *) uring->sq_ring
+				       + p.sq_off.array);
+	uring->sq_flags = (unsigned *)((char *) uring->sq_ring
+				       + p.sq_off.flags);
+
+	uring->cq_head = (unsigned *)((char *) uring->cq_ring + p.cq_off.head);
+	uring->cq_tail = (unsigned *)((char *) uring->cq_ring + p.cq_off.tail);
+	uring->cq_mask = (unsigned *)((char *) uring->cq_ring
+				      + p.cq_off.ring_mask);
+	uring->cq_overflow = (unsigned *)((char *) uring->cq_ring
+					  + p.cq_off.overflow);
+	uring->cqes = (struct io_uring_cqe *)((char *) uring->cq_ring
+					      + p.cq_off.cqes);
+
+	return 0;
+
+err_cq:
+	munmap(uring->cq_ring, uring->cq_ring_size);
+err_sq:
+	munmap(uring->sq_ring, uring->sq_ring_size);
+err_fd:
+	close(uring->fd);
+	return -1;
+}
+
+static int
+uring_add(struct uring *uring, int fd, uint32_t events, void *data)
+{
+	struct uring_entry *entry, **entries;
+	int size;
+
+	if (fd >= uring->entries_size) {
+		size = uring->entries_size ? uring->entries_size : 64;
+		while (size <= fd)
+			size *= 2;
+
+		entries = realloc(uring->entries, size * sizeof *entries);
+		if (!entries)
+			return -1;
+
+		memset(entries + uring->entries_size, 0,
+		       (size - uring->entries_size) * sizeof *entries);
+		uring->entries = entries;
+		uring->entries_size = size;
+	}
+
+	if (uring->entries[fd]) {
+		errno = EEXIST;
+		return -1;
+	}
+
+	entry = calloc(1, sizeof *entry);
+	if (!entry)
+		return -1;
+
+	entry->fd = fd;
+	entry->events = events;
+	entry->data = data;
+
+	uring->entries[fd] = entry;
+	uring_queue(uring, entry);
+
+	return 0;
+}
+
+static struct uring_entry *
+uring_get_entry(struct uring *uring, int fd)
+{
+	if (fd < 0 || fd >= uring->entries_size || !uring->entries[fd]) {
+		errno = ENOENT;
+		return NULL;
+	}
+
+	return uring->entries[fd];
+}
+
+static int
+uring_modify(struct uring *uring, int fd, uint32_t events, void *data)
+{
+	struct uring_entry *entry;
+
+	entry = uring_get_entry(uring, fd);
+	if (!entry)
+		return -1;
+
+	entry->data = data;
+	if (entry->events == events)
+		return 0;
+
+	entry->events = events;
+
+	/* receiving and sending do not depend on the events,
+	 * only what is reported does */
+	if (entry->io) {
+		uring_mark_ready(uring, entry);
+		return 0;
+	}
+
+	/* unarmed entries are armed with the new events in the
+	 * next wait, armed ones must be canceled first and
+	 * they are re-armed when the cancellation completes */
+	if (entry->armed)
+		return uring_cancel(uring, entry);
+
+	return 0;
+}
+
+static int
+uring_remove(struct uring *uring, int fd)
+{
+	struct uring_entry *entry;
+	struct uring_io *io;
+
+	entry = uring_get_entry(uring, fd);
+	if (!entry)
+		return -1;
+
+	uring->entries[fd] = NULL;
+
+	if (entry->queued) {
+		wl_list_remove(&entry->link);
+		entry->queued = 0;
+	}
+
+	if (entry->ready) {
+		wl_list_remove(&entry->ready_link);
+		entry->ready = 0;
+	}
+
+	io = entry->io;
+	if (io) {
+		uring_io_drop_received(io);
+		if (io->send.num > 0 && !io->send.submitted) {
+			wl_list_remove(&io->send_link);
+			uring_send_reset(&io->send);
+		}
+	}
+
+	/* the kernel has a pointer to it, free it
+	 * when its requests complete */
+	entry->dead = 1;
+	wl_list_insert(&uring->removed, &entry->link);
+
+	if (entry->requests == 0) {
+		uring_free_entry(uring, entry);
+		return 0;
+	}
+
+	if (entry->armed && uring_cancel(uring, entry) < 0)
+		return -1;
+
+	if (io && io->receiving && uring_cancel_io(uring, entry, URING_RECV) < 0)
+		return -1;
+
+	if (io && io->send.submitted
+	    && uring_cancel_io(uring, entry, URING_SEND) < 0)
+		return -1;
+
+	return 0;
+}
+
+/* the fd becomes a socket of a wl_connection that is
+ * read and written by the ring */
+static struct wl_connection_io *
+uring_get_io(struct uring *uring, int fd)
+{
+	struct uring_entry *entry;
+	struct uring_io *io;
+
+	entry = uring_get_entry(uring, fd);
+	if (!entry)
+		return NULL;
+
+	if (entry->io)
+		return &entry->io->base;
+
+	io = uring_io_create(uring, entry);
+	if (!io)
+		return NULL;
+
+	entry->io = io;
+
+	/* an armed poll still waits for EPOLLIN, when it
+	 * completes it is re-armed only for hangups */
+	uring_queue(uring, entry);
+
+	return &io->base;
+}
+
+/* post the requests that the entry needs */
+static int
+uring_arm_entry(struct uring *uring, struct uring_entry *entry)
+{
+	if (!entry->io)
+		return uring_arm(uring, entry);
+
+	if (!entry->armed && !entry->io->hangup
+	    && uring_arm(uring, entry) < 0)
+		return -1;
+
+	if (uring_io_can_receive(entry->io)
+	    && uring_io_receive(uring, entry->io) < 0)
+		return -1;
+
+	return 0;
+}
+
+/* take completions, events of polled fds are stored in events.
+ * What does not fit into events stays in the ring */
+static int
+uring_reap(struct uring *uring, struct epoll_event *events, int max)
+{
+	struct uring_entry *entry;
+	struct io_uring_cqe *cqe;
+	unsigned head, tail;
+	uint32_t mask;
+	int n = 0;
+
+	for (;;) {
+		head = *uring->cq_head;
+		tail = __atomic_load_n(uring->cq_tail, __ATOMIC_ACQUIRE);
+
+		for (; head != tail && n < max; ++head) {
+			cqe = &uring->cqes[head & *uring->cq_mask];
+			entry = (struct uring_entry *)(uintptr_t)
+				(cqe->user_data & ~(uint64_t) URING_KIND_MASK);
+
+			/* result of cancelling */
+			if (!entry)
+				continue;
+
+			switch (cqe->user_data & URING_KIND_MASK) {
+			case URING_RECV:
+				uring_io_received(uring, entry, cqe);
+				break;
+			case URING_SEND:
+				uring_io_sent(uring, entry, cqe);
+				break;
+			default:
+				mask = uring_polled(uring, entry, cqe);
+				if (mask) {
+					events[n].events = mask;
+					events[n].data.ptr = entry->data;
+					++n;
+				}
+			}
+
+			if (entry->dead && entry->requests == 0)
+				uring_free_entry(uring, entry);
+		}
+
+		__atomic_store_n(uring->cq_head, head, __ATOMIC_RELEASE);
+
+		if (n == max
+		    || !(__atomic_load_n(uring->sq_flags, __ATOMIC_ACQUIRE)
+			 & IORING_SQ_CQ_OVERFLOW))
+			break;
+
+		/* completions that did not fit into the CQ ring
+		 * wait in the kernel, let it move them to the ring */
+		if (uring_enter(uring, 0, IORING_ENTER_GETEVENTS) < 0
+		    && errno != EBUSY)
+			return -1;
+	}
+
+	/* the kernel could not keep a completion (no memory),
+	 * we do not know which fd is not watched anymore */
+	if (*uring->cq_overflow != 0) {
+		fprintf(stderr, "io_uring dropped completions\n");
+		errno = EOVERFLOW;
+		return -1;
+	}
+
+	return n;
+}
+
+/* report events of sockets that are read and written by the ring */
+static int
+uring_report(struct uring *uring, struct epoll_event *events, int max)
+{
+	struct uring_entry *entry, *tmp;
+	struct wl_list again;
+	uint32_t mask;
+	int n = 0;
+
+	wl_list_init(&again);
+
+	wl_list_for_each_safe(entry, tmp, &uring->ready, ready_link) {
+		if (n == max)
+			break;
+
+		wl_list_remove(&entry->ready_link);
+		entry->ready = 0;
+
+		mask = uring_io_events(entry);
+		if (!mask)
+			continue;
+
+		events[n].events = mask;
+		events[n].data.ptr = entry->data;
+		++n;
+
+		/* like with epoll, hangup is reported again and again */
+		if (mask & (EPOLLHUP | EPOLLERR)) {
+			wl_list_insert(again.prev, &entry->ready_link);
+			entry->ready = 1;
+		}
+	}
+
+	wl_list_insert_list(uring->ready.prev, &again);
+
+	return n;
+}
+
+static int
+uring_wait(struct uring *uring, struct epoll_event *events, int max)
+{
+	struct uring_entry *entry, *tmp;
+	struct uring_io *io, *io_tmp;
+	unsigned min_complete;
+	int n;
+
+	wl_list_for_each_safe(entry, tmp, &uring->unarmed, link) {
+		if (uring_arm_entry(uring, entry) < 0)
+			return -1;
+
+		wl_list_remove(&entry->link);
+		entry->queued = 0;
+	}
+
+	/* what the connections sent in this iteration is
+	 * submitted together with waiting */
+	wl_list_for_each_safe(io, io_tmp, &uring->sending, send_link) {
+		if (uring_io_submit(uring, io) < 0)
+			return -1;
+
+		wl_list_remove(&io->send_link);
+	}
+
+	/* do not wait if some sockets may have events already */
+	min_complete = wl_list_empty(&uring->ready) ? 1 : 0;
+
+	/* submit the new requests and wait in one syscall */
+	if ((min_complete > 0 || uring->to_submit > 0)
+	    && uring_enter(uring, min_complete,
+			   min_complete ? IORING_ENTER_GETEVENTS : 0) < 0
+	    && errno != EBUSY)
+		return -1;
+
+	n = uring_reap(uring, events, max);
+	if (n < 0)
+		return -1;
+
+	return n + uring_report(uring, events + n, max - n);
+}
+
+/* sends that are in the kernel, or all requests that are */
+static unsigned
+uring_entry_pending(struct uring_entry *entry, int sends)
+{
+	struct uring_send *send;
+
+	if (!sends)
+		return entry->requests;
+
+	if (!entry->io || !entry->io->send.submitted)
+		return 0;
+
+	send = &entry->io->send;
+	return send->num - send->done;
+}
+
+static unsigned
+uring_pending(struct uring *uring, int sends)
+{
+	struct uring_entry *entry;
+	unsigned n = 0;
+	int i;
+
+	for (i = 0; i < uring->entries_size; ++i) {
+		if (uring->entries[i])
+			n += uring_entry_pending(uring->entries[i], sends);
+	}
+
+	wl_list_for_each(entry, &uring->removed, link)
+		n += uring_entry_pending(entry, sends);
+
+	return n;
+}
+
+/* take completions until the (send) requests are done. When timeout
+ * is not -1, give up when nothing completes in timeout ms */
+static int
+uring_drain(struct uring *uring, int sends, long timeout)
+{
+	struct io_uring_getevents_arg arg;
+	struct __kernel_timespec ts;
+	struct epoll_event events[16];
+	unsigned flags = IORING_ENTER_GETEVENTS;
+	int ret;
+
+	memset(&arg, 0, sizeof arg);
+	if (timeout >= 0) {
+		ts.tv_sec = timeout / 1000;
+		ts.tv_nsec = (timeout % 1000) * 1000000;
+		arg.ts = (uintptr_t) &ts;
+		flags |= IORING_ENTER_EXT_ARG;
+	}
+
+	/* submit first, waiting that submits returns no ETIME */
+	if (uring->to_submit > 0 && uring_enter(uring, 0, 0) < 0)
+		return -1;
+
+	while (uring_pending(uring, sends) > 0) {
+		ret = syscall(__NR_io_uring_enter, uring->fd, 0, 1, flags,
+			      timeout >= 0 ? &arg : NULL,
+			      timeout >= 0 ? sizeof arg : 0);
+		if (ret < 0 && errno != EINTR) {
+			if (errno == ETIME)
+				return 0;
+			return -1;
+		}
+
+		/* events of the fds are not interesting anymore */
+		while ((ret = uring_reap(uring, events, 16)) == 16)
+			;
+		if (ret < 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+static void
+uring_release(struct uring *uring)
+{
+	struct uring_entry *entry, *tmp;
+	struct uring_io *io, *io_tmp;
+	struct io_uring_sqe *sqe;
+	int i, busy = 0;
+
+	/* hand over what was sent in the last iteration and give
+	 * the peers a while to take it */
+	wl_list_for_each_safe(io, io_tmp, &uring->sending, send_link) {
+		if (uring_io_submit(uring, io) < 0)
+			break;
+		wl_list_remove(&io->send_link);
+	}
+	if (uring_drain(uring, 1, URING_RELEASE_TIMEOUT_MS) < 0)
+		busy = 1;
+
+	/* the kernel reads the data and fds of sends and writes into
+	 * the buffers of receives until the requests complete, so cancel
+	 * them all and wait before freeing anything */
+	sqe = uring_get_sqe(uring);
+	if (sqe) {
+		sqe->opcode = IORING_OP_ASYNC_CANCEL;
+		sqe->fd = -1;
+		sqe->cancel_flags = IORING_ASYNC_CANCEL_ANY;
+		sqe->user_data = 0;
+	}
+
+	if (!sqe || uring_drain(uring, 0, -1) < 0)
+		busy = 1;
+
+	munmap(uring->sqes, uring->sqes_size);
+	munmap(uring->cq_ring, uring->cq_ring_size);
+	munmap(uring->sq_ring, uring->sq_ring_size);
+	close(uring->fd);
+
+	/* we do not know what the kernel still uses, leak it */
+	if (busy) {
+		fprintf(stderr, "io_uring requests did not complete\n");
+		free(uring->entries);
+		return;
+	}
+
+	for (i = 0; i < uring->entries_size; ++i) {
+		if (!uring->entries[i])
+			continue;
+		if (uring->entries[i]->io)
+			uring_io_free(uring->entries[i]->io);
+		free(uring->entries[i]);
+	}
+	free(uring->entries);
+
+	wl_list_for_each_safe(entry, tmp, &uring->removed, link) {
+		if (entry->io)
+			uring_io_free(entry->io);
+		free(entry);
+	}
+}
+
+#endif /* HAVE_IO_URING */
+
+struct wldbg_poller *
+wldbg_poller_create(enum wldbg_poller_backend backend)
+{
+	struct wldbg_poller *poller;
+
+	poller = calloc(1, sizeof *poller);
+	if (!poller)
+		return NULL;
+
+	poller->backend = backend;
+	poller->epoll_fd = -1;
+
+	switch (backend) {
+	case WLDBG_POLLER_EPOLL:
+		poller->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+		if (poller->epoll_fd == -1) {
+			perror("epoll_create failed");
+			goto err;
+		}
+		break;
+	case WLDBG_POLLER_IO_URING:
+#ifdef HAVE_IO_URING
+		if (uring_init(&poller->uring) < 0) {
+			perror("io_uring_setup failed");
+			goto err;
+		}
+		break;
+#else
+		fprintf(stderr, "wldbg was built without io_uring support\n");
+		goto err;
+#endif
+	}
+
+	return poller;
+
+err:
+	free(poller);
+	return NULL;
+}
+
+void
+wldbg_poller_destroy(struct wldbg_poller *poller)
+{
+#ifdef HAVE_IO_URING
+	if (poller->backend == WLDBG_POLLER_IO_URING)
+		uring_release(&poller->uring);
+#endif
+	if (poller->epoll_fd >= 0)
+		close(poller->epoll_fd);
+
+	free(poller);
+}
+
+enum wldbg_poller_backend
+wldbg_poller_get_backend(struct wldbg_poller *poller)
+{
+	return poller->backend;
+}
+
+int
+wldbg_poller_add(struct wldbg_poller *poller, int fd,
+		 uint32_t events, void *data)
+{
+	struct epoll_event ev;
+
+#ifdef HAVE_IO_URING
+	if (poller->backend == WLDBG_POLLER_IO_URING)
+		return uring_add(&poller->uring, fd, events, data);
+#endif
+
+	ev.events = events;
+	ev.data.ptr = data;
+
+	return epoll_ctl(poller->epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+int
+wldbg_poller_modify(struct wldbg_poller *poller, int fd,
+		    uint32_t events, void *data)
+{
+	struct epoll_event ev;
+
+#ifdef HAVE_IO_URING
+	if (poller->backend == WLDBG_POLLER_IO_URING)
+		return uring_modify(&poller->uring, fd, events, data);
+#endif
+
+	ev.events = events;
+	ev.data.ptr = data;
+
+	return epoll_ctl(poller->epoll_fd, EPOLL_CTL_MOD, fd, &ev);
+}
+
+int
+wldbg_poller_remove(struct wldbg_poller *poller, int fd)
+{
+#ifdef HAVE_IO_URING
+	if (poller->backend == WLDBG_POLLER_IO_URING)
+		return uring_remove(&poller->uring, fd);
+#endif
+
+	return epoll_ctl(poller->epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+}
+
+int
+wldbg_poller_wait(struct wldbg_poller *poller,
+		  struct epoll_event *events, int max)
+{
+#ifdef HAVE_IO_URING
+	if (poller->backend == WLDBG_POLLER_IO_URING)
+		return uring_wait(&poller->uring, events, max);
+#endif
+
+	return epoll_wait(poller->epoll_fd, events, max, -1);
+}
+
+struct wl_connection_io *
+wldbg_poller_get_io(struct wldbg_poller *poller, int fd)
+{
+#ifdef HAVE_IO_URING
+	if (poller->backend == WLDBG_POLLER_IO_URING)
+		return uring_get_io(&poller->uring, fd);
+#endif
+
+	return NULL;
+}
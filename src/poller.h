@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2015 Marek Chalupa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _WLDBG_POLLER_H_
+#define _WLDBG_POLLER_H_
+
+#include <stdint.h>
+#include <sys/epoll.h>
+
+/*
+ * What the main loop and workers wait on. The default is epoll,
+ * with io_uring (if compiled in) fds are polled by POLL_ADD requests
+ * and sockets of connections are read and written by the ring
+ * (see wldbg_poller_get_io()). New requests are submitted together
+ * with waiting, so one loop iteration is one syscall no matter how
+ * many fds changed their events or how many connections sent data.
+ * Both backends report ready fds as epoll events, so the dispatching
+ * code is the same.
+ */
+
+enum wldbg_poller_backend {
+	WLDBG_POLLER_EPOLL = 0,
+	WLDBG_POLLER_IO_URING,
+};
+
+struct wldbg_poller;
+
+struct wldbg_poller *
+wldbg_poller_create(enum wldbg_poller_backend backend);
+
+void
+wldbg_poller_destroy(struct wldbg_poller *poller);
+
+enum wldbg_poller_backend
+wldbg_poller_get_backend(struct wldbg_poller *poller);
+
+/* events are EPOLLIN and EPOLLOUT, hangup and errors are
+ * always reported. data is returned in the event's data.ptr */
+int
+wldbg_poller_add(struct wldbg_poller *poller, int fd,
+		 uint32_t events, void *data);
+
+int
+wldbg_poller_modify(struct wldbg_poller *poller, int fd,
+		    uint32_t events, void *data);
+
+int
+wldbg_poller_remove(struct wldbg_poller *poller, int fd);
+
+/* wait until some fds are ready, returns the number of events
+ * stored in events or -1 and errno set */
+int
+wldbg_poller_wait(struct wldbg_poller *poller,
+		  struct epoll_event *events, int max);
+
+struct wl_connection_io;
+
+/* with io_uring, the socket fd (added already) is read and written
+ * by the ring: a multishot RECVMSG is kept posted on it and what is
+ * sent in one loop iteration goes out in a batch of linked SENDMSGs.
+ * EPOLLIN is reported when received data wait, EPOLLOUT when the
+ * previous batch was sent. Returns what the wl_connection should use
+ * instead of recvmsg and sendmsg or NULL if the fd is only polled */
+struct wl_connection_io *
+wldbg_poller_get_io(struct wldbg_poller *poller, int fd);
+
+#endif /* _WLDBG_POLLER_H_ */
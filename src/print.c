@@ -562,7 +562,7 @@ print_id(uint32_t id)
 }
 
 static void
-print_arg(struct wldbg_resolved_arg *arg, struct wldbg_resolved_message *rm,
+print_arg(const struct wldbg_message_arg *arg, struct wldbg_resolved_message *rm,
 	  uint32_t pos, struct wldbg_message *message)
 {
 	const struct wl_interface *obj;
@@ -604,7 +604,7 @@ print_arg(struct wldbg_resolved_arg *arg, struct wldbg_resolved_message *rm,
 		break;
 	case 's':
 		if (arg->data)
-			printf("%u:\"%s\"", *(arg->data - 1),
+			printf("%u:\"%s\"", arg->length,
 			       (const char *) (arg->data));
 		else
 			printf("0:\"\"");
@@ -627,10 +627,7 @@ print_arg(struct wldbg_resolved_arg *arg, struct wldbg_resolved_message *rm,
 			printf("nil");
 		break;
 	case 'a':
-		if (arg->data)
-			len = DIV_ROUNDUP(*(arg->data - 1), sizeof(uint32_t));
-		else
-			len = 0;
+		len = DIV_ROUNDUP(arg->length, sizeof(uint32_t));
 
 		if (len && print_xdg_surface_message(rm->wl_interface,
 						     rm->wl_message, pos,
@@ -653,7 +650,8 @@ wldbg_message_print(struct wldbg_message *message)
 	uint32_t pos;
 	struct wldbg_connection *conn = message->connection;
 	struct wldbg_resolved_message rm;
-	struct wldbg_resolved_arg *arg;
+	struct wldbg_message_args args;
+	const struct wldbg_signature *sig;
 
 	if (conn->wldbg->flags.server_mode) {
 		if (conn->client.program)
@@ -695,30 +693,32 @@ wldbg_message_print(struct wldbg_message *message)
 			message->from == SERVER ? "event" : "request");
 		printf("[opcode %u][size %uB]\n", rm.base.opcode, rm.base.size);
 		return;
-	} else {
-		printf("%s(", rm.wl_message->name);
 	}
 
+	/* the arguments do not fit into the message */
+	if (wldbg_resolved_message_get_args(&rm, &args) < 0) {
+		printf("%s_malformed_[size %uB]\n",
+		       rm.wl_message->name, rm.base.size);
+		return;
+	}
+
+	printf("%s(", rm.wl_message->name);
 
-	pos = 0;
-	while((arg = wldbg_resolved_message_next_argument(&rm))) {
+	for (pos = 0; pos < args.num; ++pos) {
 		if (pos > 0)
 			printf(", ");
 
-		/* currently we can have up to WL_CLOSURE_MAX_ARGS,
-		 * but if that changes we must update wayland-private.h */
-		if (pos >= WL_CLOSURE_MAX_ARGS) {
-			/* be kind to user... for now */
-			fprintf(stderr, "Probably wrong %s, too much arguments\n",
-				message->from == SERVER ? "event" : "request");
-			fflush(stdout);
-			break;
-		}
-
-		print_arg(arg, &rm, pos, message);
-		++pos;
+		print_arg(&args.args[pos], &rm, pos, message);
 	}
 
-	printf(")\n");
+	printf(")");
+
+	/* the object was bound with lower version */
+	sig = rm.signature ? rm.signature : &rm.compiled;
+	if (rm.version && sig->since > rm.version)
+		printf(" [since version %u, object has version %u]",
+		       sig->since, rm.version);
+
+	putchar('\n');
 }
 
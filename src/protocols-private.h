@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2015 Marek Chalupa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _WLDBG_PROTOCOLS_PRIVATE_H_
+#define _WLDBG_PROTOCOLS_PRIVATE_H_
+
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "wayland/wayland-util.h"
+
+/* what protocols.c shares with the loaders of interfaces */
+
+struct message_info {
+	/* names of the interfaces and enums of the arguments
+	 * (char *), NULL if the argument has none */
+	struct wl_array types;
+	struct wl_array enums;
+};
+
+struct protocol_interface {
+	struct wl_interface interface;
+	/* the interface that wldbg uses for this name, either
+	 * interface or the one that was known before */
+	const struct wl_interface *registered;
+
+	/* struct wl_message and struct message_info */
+	struct wl_array requests;
+	struct wl_array requests_info;
+	struct wl_array events;
+	struct wl_array events_info;
+
+	/* struct wldbg_enum */
+	struct wl_array enums;
+
+	/* it lives in a mapped cache file */
+	int cached;
+
+	struct wl_list link;
+};
+
+/* a file that the interfaces were loaded from */
+struct protocol_file {
+	char *path;
+	struct timespec mtime;
+	off_t size;
+};
+
+struct protocol_interface *
+protocols_interface_create(const char *name, int version);
+
+/* types has names of interfaces of the arguments (or NULLs) */
+int
+protocols_interface_add_message(struct protocol_interface *pi, int is_event,
+				const char *name, const char *signature,
+				const char **types, unsigned int types_num);
+
+/* call when all messages are added */
+void
+protocols_interface_finish(struct protocol_interface *pi);
+
+void
+protocols_free_interfaces(struct wl_list *interfaces);
+
+int
+protocols_add_file(struct wl_array *files, const char *path, struct stat *st);
+
+void
+protocols_free_files(struct wl_array *files);
+
+/* append the interfaces from the cache with the key, if it
+ * was made from these files (they can be none) */
+int
+protocols_load_cache(const char *key, struct wl_array *files,
+		     struct wl_list *interfaces);
+
+void
+protocols_write_cache(const char *key, struct wl_array *files,
+		      struct wl_list *interfaces);
+
+/* link the interfaces by names of types and add them to wldbg.
+ * The list is empty afterwards, the interfaces are kept until
+ * wldbg_protocols_release(). Returns the number of added ones */
+int
+protocols_register(struct wl_list *interfaces);
+
+#endif /* _WLDBG_PROTOCOLS_PRIVATE_H_ */
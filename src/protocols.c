@@ -0,0 +1,1578 @@
+/*
+ * Copyright (c) 2015 Marek Chalupa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <limits.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <expat.h>
+
+#include "wayland/wayland-util.h"
+
+#include "wldbg.h"
+#include "wldbg-protocols.h"
+#include "interfaces.h"
+#include "protocols-private.h"
+
+/* wayland-protocols has stable/xdg-shell/xdg-shell.xml etc. */
+#define MAX_DEPTH	4
+
+struct protocol_map {
+	void *data;
+	size_t size;
+};
+
+static struct {
+	struct wl_list interfaces;
+	/* struct protocol_map of cache files in use */
+	struct wl_array maps;
+	/* set by wldbg_protocols_set_cache_dir() */
+	const char *cache_dir;
+	int initialized;
+
+	/* loaded interfaces indexed by the id of the interface */
+	struct protocol_interface **by_id;
+	uint32_t by_id_size;
+} protocols;
+
+struct parser {
+	XML_Parser parser;
+	const char *path;
+	int error;
+
+	struct wl_list *interfaces;
+	struct protocol_interface *interface;
+
+	struct wl_message *message;
+	struct message_info *info;
+	struct wl_array signature;
+
+	struct wldbg_enum *enumeration;
+	struct wl_array entries;
+};
+
+struct protocol_interface *
+protocols_interface_create(const char *name, int version)
+{
+	struct protocol_interface *pi;
+
+	pi = calloc(1, sizeof *pi);
+	if (!pi || !(pi->interface.name = strdup(name))) {
+		free(pi);
+		return NULL;
+	}
+
+	pi->interface.version = version;
+	wl_array_init(&pi->requests);
+	wl_array_init(&pi->requests_info);
+	wl_array_init(&pi->events);
+	wl_array_init(&pi->events_info);
+	wl_array_init(&pi->enums);
+
+	return pi;
+}
+
+void
+protocols_interface_finish(struct protocol_interface *pi)
+{
+	pi->interface.method_count
+		= pi->requests.size / sizeof(struct wl_message);
+	pi->interface.methods = pi->requests.data;
+	pi->interface.event_count
+		= pi->events.size / sizeof(struct wl_message);
+	pi->interface.events = pi->events.data;
+}
+
+static int
+add_string(struct wl_array *array, const char *str);
+
+int
+protocols_interface_add_message(struct protocol_interface *pi, int is_event,
+				const char *name, const char *signature,
+				const char **types, unsigned int types_num)
+{
+	struct wl_message *msg;
+	struct message_info *info;
+	unsigned int i;
+
+	msg = wl_array_add(is_event ? &pi->events : &pi->requests,
+			   sizeof *msg);
+	info = wl_array_add(is_event ? &pi->events_info : &pi->requests_info,
+			    sizeof *info);
+	if (!msg || !info)
+		return -1;
+
+	memset(msg, 0, sizeof *msg);
+	wl_array_init(&info->types);
+	wl_array_init(&info->enums);
+
+	msg->name = strdup(name);
+	msg->signature = strdup(signature);
+	msg->types = calloc(types_num ? types_num : 1, sizeof *msg->types);
+	if (!msg->name || !msg->signature || !msg->types)
+		return -1;
+
+	for (i = 0; i < types_num; ++i)
+		if (add_string(&info->types, types[i]) < 0
+		    || add_string(&info->enums, NULL) < 0)
+			return -1;
+
+	return 0;
+}
+
+static void
+fail(struct parser *ctx, const char *msg)
+{
+	fprintf(stderr, "%s:%lu: %s\n", ctx->path,
+		(unsigned long) XML_GetCurrentLineNumber(ctx->parser), msg);
+
+	ctx->error = 1;
+	XML_StopParser(ctx->parser, XML_FALSE);
+}
+
+static const char *
+get_attribute(const char **atts, const char *name)
+{
+	for (; *atts; atts += 2)
+		if (strcmp(atts[0], name) == 0)
+			return atts[1];
+
+	return NULL;
+}
+
+static int
+add_string(struct wl_array *array, const char *str)
+{
+	char **p;
+
+	p = wl_array_add(array, sizeof *p);
+	if (!p)
+		return -1;
+
+	*p = NULL;
+	if (str && !(*p = strdup(str)))
+		return -1;
+
+	return 0;
+}
+
+static void
+free_strings(struct wl_array *array)
+{
+	char **p;
+
+	wl_array_for_each(p, array)
+		free(*p);
+
+	wl_array_release(array);
+}
+
+static int
+add_signature(struct parser *ctx, const char *str)
+{
+	size_t len = strlen(str);
+	char *p;
+
+	p = wl_array_add(&ctx->signature, len);
+	if (!p)
+		return -1;
+
+	memcpy(p, str, len);
+	return 0;
+}
+
+static char
+arg_type(const char *type)
+{
+	static const struct {
+		const char *name;
+		char type;
+	} types[] = {
+		{ "int", 'i' },
+		{ "uint", 'u' },
+		{ "fixed", 'f' },
+		{ "string", 's' },
+		{ "object", 'o' },
+		{ "new_id", 'n' },
+		{ "array", 'a' },
+		{ "fd", 'h' },
+	};
+	unsigned int i;
+
+	for (i = 0; i < sizeof types / sizeof *types; ++i)
+		if (strcmp(types[i].name, type) == 0)
+			return types[i].type;
+
+	return 0;
+}
+
+static void
+start_interface(struct parser *ctx, const char **atts)
+{
+	struct protocol_interface *pi;
+	const char *name = get_attribute(atts, "name");
+	const char *version = get_attribute(atts, "version");
+
+	if (!name || !version) {
+		fail(ctx, "interface without name or version");
+		return;
+	}
+
+	pi = protocols_interface_create(name, atoi(version));
+	if (!pi) {
+		fail(ctx, "out of memory");
+		return;
+	}
+
+	wl_list_insert(ctx->interfaces->prev, &pi->link);
+	ctx->interface = pi;
+}
+
+static void
+start_message(struct parser *ctx, const char **atts, int is_event)
+{
+	struct protocol_interface *pi = ctx->interface;
+	const char *name = get_attribute(atts, "name");
+	const char *since = get_attribute(atts, "since");
+	struct wl_message *msg;
+	struct message_info *info;
+
+	if (!pi || ctx->message || !name) {
+		fail(ctx, "misplaced or unnamed message");
+		return;
+	}
+
+	msg = wl_array_add(is_event ? &pi->events : &pi->requests,
+			   sizeof *msg);
+	info = wl_array_add(is_event ? &pi->events_info : &pi->requests_info,
+			    sizeof *info);
+	if (!msg || !info) {
+		fail(ctx, "out of memory");
+		return;
+	}
+
+	memset(msg, 0, sizeof *msg);
+	wl_array_init(&info->types);
+	wl_array_init(&info->enums);
+	ctx->message = msg;
+	ctx->info = info;
+
+	if (!(msg->name = strdup(name))) {
+		fail(ctx, "out of memory");
+		return;
+	}
+
+	/* the signature starts with the version
+	 * of the message like from wayland-scanner */
+	ctx->signature.size = 0;
+	if (since && atoi(since) > 1 && add_signature(ctx, since) < 0)
+		fail(ctx, "out of memory");
+}
+
+static void
+start_arg(struct parser *ctx, const char **atts)
+{
+	struct message_info *info = ctx->info;
+	const char *type = get_attribute(atts, "type");
+	const char *interface = get_attribute(atts, "interface");
+	const char *allow_null = get_attribute(atts, "allow-null");
+	const char *enumeration = get_attribute(atts, "enum");
+	char str[3] = { 0 }, *p = str;
+
+	if (!ctx->message || !type) {
+		fail(ctx, "misplaced argument or argument without type");
+		return;
+	}
+
+	if (allow_null && strcmp(allow_null, "true") == 0)
+		*p++ = '?';
+
+	if (!(*p = arg_type(type))) {
+		fail(ctx, "unknown type of argument");
+		return;
+	}
+
+	/* new_id without interface is sent as the name
+	 * and version of the interface and the id */
+	if (*p == 'n' && !interface) {
+		if (add_signature(ctx, "su") < 0
+		    || add_string(&info->types, NULL) < 0
+		    || add_string(&info->types, NULL) < 0
+		    || add_string(&info->enums, NULL) < 0
+		    || add_string(&info->enums, NULL) < 0) {
+			fail(ctx, "out of memory");
+			return;
+		}
+	}
+
+	if (add_signature(ctx, str) < 0
+	    || add_string(&info->types, interface) < 0
+	    || add_string(&info->enums, enumeration) < 0)
+		fail(ctx, "out of memory");
+}
+
+static void
+start_enum(struct parser *ctx, const char **atts)
+{
+	struct wldbg_enum *e;
+	const char *name = get_attribute(atts, "name");
+	const char *bitfield = get_attribute(atts, "bitfield");
+
+	if (!ctx->interface || ctx->enumeration || !name) {
+		fail(ctx, "misplaced or unnamed enum");
+		return;
+	}
+
+	e = wl_array_add(&ctx->interface->enums, sizeof *e);
+	if (!e) {
+		fail(ctx, "out of memory");
+		return;
+	}
+
+	memset(e, 0, sizeof *e);
+	ctx->enumeration = e;
+
+	e->bitfield = bitfield && strcmp(bitfield, "true") == 0;
+	if (!(e->name = strdup(name)))
+		fail(ctx, "out of memory");
+}
+
+static void
+start_entry(struct parser *ctx, const char **atts)
+{
+	struct wldbg_enum_entry *entry;
+	const char *name = get_attribute(atts, "name");
+	const char *value = get_attribute(atts, "value");
+	unsigned long val;
+	char *end;
+
+	if (!ctx->enumeration || !name || !value) {
+		fail(ctx, "misplaced entry or entry without name or value");
+		return;
+	}
+
+	errno = 0;
+	val = strtoul(value, &end, 0);
+	if (errno || end == value || *end != '\0' || val > UINT32_MAX) {
+		fail(ctx, "invalid value of entry");
+		return;
+	}
+
+	entry = wl_array_add(&ctx->entries, sizeof *entry);
+	if (!entry) {
+		fail(ctx, "out of memory");
+		return;
+	}
+
+	entry->value = val;
+	if (!(entry->name = strdup(name)))
+		fail(ctx, "out of memory");
+}
+
+static void
+start_element(void *data, const XML_Char *element, const XML_Char **atts)
+{
+	struct parser *ctx = data;
+
+	if (ctx->error)
+		return;
+
+	if (strcmp(element, "interface") == 0)
+		start_interface(ctx, atts);
+	else if (strcmp(element, "request") == 0)
+		start_message(ctx, atts, 0);
+	else if (strcmp(element, "event") == 0)
+		start_message(ctx, atts, 1);
+	else if (strcmp(element, "arg") == 0)
+		start_arg(ctx, atts);
+	else if (strcmp(element, "enum") == 0)
+		start_enum(ctx, atts);
+	else if (strcmp(element, "entry") == 0)
+		start_entry(ctx, atts);
+}
+
+static void
+end_message(struct parser *ctx)
+{
+	struct wl_message *msg = ctx->message;
+	size_t num = ctx->info->types.size / sizeof(char *);
+	char *p;
+
+	ctx->message = NULL;
+
+	p = wl_array_add(&ctx->signature, 1);
+	if (!p) {
+		fail(ctx, "out of memory");
+		return;
+	}
+
+	*p = '\0';
+	msg->signature = strdup(ctx->signature.data);
+	/* filled when all the protocols are loaded */
+	msg->types = calloc(num ? num : 1, sizeof *msg->types);
+	if (!msg->signature || !msg->types)
+		fail(ctx, "out of memory");
+}
+
+static void
+end_element(void *data, const XML_Char *element)
+{
+	struct parser *ctx = data;
+	struct protocol_interface *pi = ctx->interface;
+	struct wldbg_enum *e = ctx->enumeration;
+
+	if (ctx->error)
+		return;
+
+	if (strcmp(element, "interface") == 0) {
+		protocols_interface_finish(pi);
+		ctx->interface = NULL;
+	} else if (strcmp(element, "request") == 0
+		   || strcmp(element, "event") == 0) {
+		end_message(ctx);
+	} else if (strcmp(element, "enum") == 0) {
+		e->entries = ctx->entries.data;
+		e->entries_num = ctx->entries.size
+				 / sizeof(struct wldbg_enum_entry);
+		wl_array_init(&ctx->entries);
+		ctx->enumeration = NULL;
+	}
+}
+
+static void
+free_entries(const struct wldbg_enum_entry *entries, unsigned int num)
+{
+	unsigned int i;
+
+	for (i = 0; i < num; ++i)
+		free((char *) entries[i].name);
+
+	free((void *) entries);
+}
+
+static void
+free_messages(struct wl_array *messages, struct wl_array *infos)
+{
+	struct wl_message *msg;
+	struct message_info *info;
+
+	wl_array_for_each(msg, messages) {
+		free((char *) msg->name);
+		free((char *) msg->signature);
+		free(msg->types);
+	}
+
+	wl_array_for_each(info, infos) {
+		free_strings(&info->types);
+		free_strings(&info->enums);
+	}
+
+	wl_array_release(messages);
+	wl_array_release(infos);
+}
+
+static void
+free_interface(struct protocol_interface *pi)
+{
+	struct wldbg_enum *e;
+
+	/* freed with the whole mapping */
+	if (pi->cached)
+		return;
+
+	free_messages(&pi->requests, &pi->requests_info);
+	free_messages(&pi->events, &pi->events_info);
+
+	wl_array_for_each(e, &pi->enums) {
+		free((char *) e->name);
+		free_entries(e->entries, e->entries_num);
+	}
+
+	wl_array_release(&pi->enums);
+	free((char *) pi->interface.name);
+	free(pi);
+}
+
+void
+protocols_free_interfaces(struct wl_list *interfaces)
+{
+	struct protocol_interface *pi, *tmp;
+
+	wl_list_for_each_safe(pi, tmp, interfaces, link)
+		free_interface(pi);
+
+	wl_list_init(interfaces);
+}
+
+/* parse the file and append its interfaces to the list */
+static int
+load_file(const char *path, struct wl_list *interfaces)
+{
+	struct parser ctx;
+	struct wl_list parsed;
+	void *buf;
+	ssize_t len;
+	int fd;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		fprintf(stderr, "Opening '%s': %s\n", path, strerror(errno));
+		return -1;
+	}
+
+	memset(&ctx, 0, sizeof ctx);
+	wl_list_init(&parsed);
+	wl_array_init(&ctx.signature);
+	wl_array_init(&ctx.entries);
+	ctx.path = path;
+	ctx.interfaces = &parsed;
+
+	ctx.parser = XML_ParserCreate(NULL);
+	if (!ctx.parser) {
+		fprintf(stderr, "Out of memory\n");
+		close(fd);
+		return -1;
+	}
+
+	XML_SetUserData(ctx.parser, &ctx);
+	XML_SetElementHandler(ctx.parser, start_element, end_element);
+
+	do {
+		buf = XML_GetBuffer(ctx.parser, 4096);
+		if (!buf) {
+			fprintf(stderr, "Out of memory\n");
+			ctx.error = 1;
+			break;
+		}
+
+		len = read(fd, buf, 4096);
+		if (len < 0) {
+			fprintf(stderr, "Reading '%s': %s\n",
+				path, strerror(errno));
+			ctx.error = 1;
+			break;
+		}
+
+		if (XML_ParseBuffer(ctx.parser, len, len == 0)
+		    == XML_STATUS_ERROR) {
+			/* errors from handlers were reported already */
+			if (!ctx.error)
+				fprintf(stderr, "%s:%lu: %s\n", path,
+					(unsigned long)
+					XML_GetCurrentLineNumber(ctx.parser),
+					XML_ErrorString(
+						XML_GetErrorCode(ctx.parser)));
+			ctx.error = 1;
+		}
+	} while (len > 0 && !ctx.error);
+
+	XML_ParserFree(ctx.parser);
+	close(fd);
+
+	wl_array_release(&ctx.signature);
+	/* entries of an enum that did not end */
+	free_entries(ctx.entries.data,
+		     ctx.entries.size / sizeof(struct wldbg_enum_entry));
+
+	if (ctx.error) {
+		protocols_free_interfaces(&parsed);
+		return -1;
+	}
+
+	wl_list_insert_list(interfaces->prev, &parsed);
+
+	return 0;
+}
+
+static int
+has_suffix(const char *str, const char *suffix)
+{
+	size_t len = strlen(str), slen = strlen(suffix);
+
+	return len >= slen && strcmp(str + len - slen, suffix) == 0;
+}
+
+int
+protocols_add_file(struct wl_array *files, const char *path, struct stat *st)
+{
+	struct protocol_file *file;
+
+	file = wl_array_add(files, sizeof *file);
+	if (!file || !(file->path = strdup(path))) {
+		if (file)
+			files->size -= sizeof *file;
+		fprintf(stderr, "Out of memory\n");
+		return -1;
+	}
+
+	file->mtime = st->st_mtim;
+	file->size = st->st_size;
+
+	return 0;
+}
+
+void
+protocols_free_files(struct wl_array *files)
+{
+	struct protocol_file *file;
+
+	wl_array_for_each(file, files)
+		free(file->path);
+
+	wl_array_release(files);
+}
+
+static int
+find_files(const char *path, struct wl_array *files, int depth);
+
+static int
+find_files_in_dir(const char *path, struct wl_array *files, int depth)
+{
+	struct dirent **entries;
+	char file[PATH_MAX];
+	struct stat st;
+	int i, num;
+
+	num = scandir(path, &entries, NULL, alphasort);
+	if (num < 0) {
+		fprintf(stderr, "Reading '%s': %s\n", path, strerror(errno));
+		return -1;
+	}
+
+	for (i = 0; i < num; ++i) {
+		if (entries[i]->d_name[0] != '.'
+		    && snprintf(file, sizeof file, "%s/%s", path,
+				entries[i]->d_name) < (int) sizeof file
+		    && stat(file, &st) == 0) {
+			if (S_ISDIR(st.st_mode) && depth < MAX_DEPTH)
+				find_files(file, files, depth + 1);
+			else if (S_ISREG(st.st_mode)
+				 && has_suffix(file, ".xml"))
+				protocols_add_file(files, file, &st);
+		}
+
+		free(entries[i]);
+	}
+
+	free(entries);
+
+	return 0;
+}
+
+/* protocol files in the path, sorted, so that
+ * the list is the same every time */
+static int
+find_files(const char *path, struct wl_array *files, int depth)
+{
+	struct stat st;
+
+	if (stat(path, &st) < 0) {
+		fprintf(stderr, "Loading protocols from '%s': %s\n",
+			path, strerror(errno));
+		return -1;
+	}
+
+	if (S_ISDIR(st.st_mode))
+		return find_files_in_dir(path, files, depth);
+
+	return protocols_add_file(files, path, &st);
+}
+
+/*
+ * Parsing all the XML files on every start is slow, so the parsed
+ * interfaces are written into a cache file. Its name is made from the
+ * paths that were loaded and it has the list of the files with their
+ * mtimes and sizes. If any file changed (or there is a new one),
+ * the XML files are parsed and the cache written again.
+ *
+ * The cache has the same structures that are in memory (struct
+ * protocol_interface and everything it points to), pointers are
+ * offsets from the beginning of the file. The file is mapped privately,
+ * the pointers are relocated and the structures used right from the
+ * mapping. Only the pages with pointers get copied on write,
+ * the strings stay shared with the page cache.
+ */
+
+#define CACHE_MAGIC	"WLDBGPRO"
+#define CACHE_VERSION	2
+
+struct cache_header {
+	char magic[8];
+	uint32_t version;
+	/* the cache is not portable */
+	uint16_t pointer_size;
+	uint16_t interface_size;
+	uint64_t size;
+	/* offset of the key, the hash in the name can collide */
+	uint64_t key;
+
+	/* struct cache_file */
+	uint64_t files;
+	uint32_t files_num;
+	uint32_t interfaces_num;
+	/* struct protocol_interface */
+	uint64_t interfaces;
+	/* offsets of pointers (uint64_t) */
+	uint64_t relocs;
+	uint64_t relocs_num;
+};
+
+struct cache_file {
+	/* offset of the path */
+	uint64_t path;
+	int64_t mtime_sec;
+	int64_t mtime_nsec;
+	uint64_t size;
+};
+
+struct blob {
+	struct wl_array data;
+	/* uint64_t offsets of pointers */
+	struct wl_array relocs;
+	int error;
+};
+
+#define BLOB_AT(b, off) ((void *) ((char *) (b)->data.data + (off)))
+
+/* returns the offset of zeroed memory, 0 on error
+ * (the header is at 0, so nothing else can be there) */
+static uint64_t
+blob_alloc(struct blob *b, size_t size)
+{
+	uint64_t off = b->data.size;
+	void *p;
+
+	size = (size + 7) & ~(size_t) 7;
+	p = wl_array_add(&b->data, size);
+	if (!p) {
+		b->error = 1;
+		return 0;
+	}
+
+	memset(p, 0, size);
+	return off;
+}
+
+/* make the pointer at offset where point to offset off */
+static void
+blob_pointer(struct blob *b, uint64_t where, uint64_t off)
+{
+	uint64_t *reloc;
+
+	if (off == 0)
+		return;
+
+	*(uintptr_t *) BLOB_AT(b, where) = off;
+
+	reloc = wl_array_add(&b->relocs, sizeof *reloc);
+	if (!reloc) {
+		b->error = 1;
+		return;
+	}
+
+	*reloc = where;
+}
+
+static uint64_t
+blob_string(struct blob *b, const char *str)
+{
+	uint64_t off;
+
+	if (!str)
+		return 0;
+
+	off = blob_alloc(b, strlen(str) + 1);
+	if (off)
+		strcpy(BLOB_AT(b, off), str);
+
+	return off;
+}
+
+/* copy of the data of the array that is at offset where */
+static uint64_t
+blob_array(struct blob *b, uint64_t where, const struct wl_array *array)
+{
+	struct wl_array *out;
+	uint64_t off;
+
+	if (array->size == 0)
+		return 0;
+
+	off = blob_alloc(b, array->size);
+	if (!off)
+		return 0;
+
+	memcpy(BLOB_AT(b, off), array->data, array->size);
+	out = BLOB_AT(b, where);
+	out->size = array->size;
+	/* not allocated, nobody may grow it */
+	out->alloc = 0;
+	blob_pointer(b, where + offsetof(struct wl_array, data), off);
+
+	return off;
+}
+
+static void
+blob_strings(struct blob *b, uint64_t where, const struct wl_array *strings)
+{
+	char **str;
+	uint64_t off;
+
+	off = blob_array(b, where, strings);
+	if (!off)
+		return;
+
+	wl_array_for_each(str, strings) {
+		blob_pointer(b, off, blob_string(b, *str));
+		off += sizeof *str;
+	}
+}
+
+static uint64_t
+blob_messages(struct blob *b, uint64_t where, uint64_t where_info,
+	      const struct wl_array *messages, const struct wl_array *infos)
+{
+	const struct wl_message *msg = messages->data;
+	const struct message_info *info;
+	uint64_t off, off_info, types;
+	size_t num;
+
+	off = blob_array(b, where, messages);
+	off_info = blob_array(b, where_info, infos);
+	if (!off || !off_info)
+		return 0;
+
+	wl_array_for_each(info, infos) {
+		blob_pointer(b, off + offsetof(struct wl_message, name),
+			     blob_string(b, msg->name));
+		blob_pointer(b, off + offsetof(struct wl_message, signature),
+			     blob_string(b, msg->signature));
+
+		/* filled when the interfaces are linked */
+		num = info->types.size / sizeof(char *);
+		types = blob_alloc(b, (num ? num : 1) * sizeof(void *));
+		blob_pointer(b, off + offsetof(struct wl_message, types),
+			     types);
+
+		blob_strings(b, off_info + offsetof(struct message_info,
+						    types), &info->types);
+		blob_strings(b, off_info + offsetof(struct message_info,
+						    enums), &info->enums);
+
+		++msg;
+		off += sizeof *msg;
+		off_info += sizeof *info;
+	}
+
+	return off - messages->size;
+}
+
+static void
+blob_enums(struct blob *b, uint64_t where, const struct wl_array *enums)
+{
+	const struct wldbg_enum *e;
+	struct wldbg_enum *out;
+	uint64_t off, entries;
+	unsigned int i;
+
+	off = blob_array(b, where, enums);
+	if (!off)
+		return;
+
+	wl_array_for_each(e, enums) {
+		blob_pointer(b, off + offsetof(struct wldbg_enum, name),
+			     blob_string(b, e->name));
+
+		entries = 0;
+		if (e->entries_num > 0)
+			entries = blob_alloc(b, e->entries_num
+						* sizeof *e->entries);
+		if (!entries && e->entries_num > 0)
+			return;
+
+		for (i = 0; i < e->entries_num; ++i) {
+			((struct wldbg_enum_entry *) BLOB_AT(b, entries))[i]
+				.value = e->entries[i].value;
+			blob_pointer(b, entries + i * sizeof *e->entries
+					+ offsetof(struct wldbg_enum_entry,
+						   name),
+				     blob_string(b, e->entries[i].name));
+		}
+
+		out = BLOB_AT(b, off);
+		out->bitfield = e->bitfield;
+		out->entries_num = e->entries_num;
+		blob_pointer(b, off + offsetof(struct wldbg_enum, entries),
+			     entries);
+
+		off += sizeof *e;
+	}
+}
+
+static void
+blob_interface(struct blob *b, uint64_t where,
+	       const struct protocol_interface *pi)
+{
+	struct protocol_interface *out;
+	uint64_t off;
+
+	out = BLOB_AT(b, where);
+	out->interface.version = pi->interface.version;
+	out->interface.method_count = pi->interface.method_count;
+	out->interface.event_count = pi->interface.event_count;
+	out->cached = 1;
+
+	blob_pointer(b, where + offsetof(struct protocol_interface,
+					 interface.name),
+		     blob_string(b, pi->interface.name));
+
+	off = blob_messages(b, where + offsetof(struct protocol_interface,
+						requests),
+			    where + offsetof(struct protocol_interface,
+					     requests_info),
+			    &pi->requests, &pi->requests_info);
+	if (pi->requests.size > 0)
+		blob_pointer(b, where + offsetof(struct protocol_interface,
+						 interface.methods), off);
+
+	off = blob_messages(b, where + offsetof(struct protocol_interface,
+						events),
+			    where + offsetof(struct protocol_interface,
+					     events_info),
+			    &pi->events, &pi->events_info);
+	if (pi->events.size > 0)
+		blob_pointer(b, where + offsetof(struct protocol_interface,
+						 interface.events), off);
+
+	blob_enums(b, where + offsetof(struct protocol_interface, enums),
+		   &pi->enums);
+}
+
+static uint32_t
+hash_string(const char *str)
+{
+	uint32_t hash = 2166136261u;
+
+	for (; *str; ++str) {
+		hash ^= (unsigned char) *str;
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+/* DIR/protocols-HASH.cache, where DIR is $XDG_CACHE_HOME/wldbg
+ * if it was not set */
+static int
+cache_path(const char *key, char *path, size_t size)
+{
+	const char *xdg = getenv("XDG_CACHE_HOME");
+	const char *home = getenv("HOME");
+	char dir[PATH_MAX];
+	int ret;
+
+	if (protocols.cache_dir) {
+		ret = snprintf(dir, sizeof dir, "%s", protocols.cache_dir);
+	} else if (xdg && *xdg) {
+		mkdir(xdg, 0700);
+		ret = snprintf(dir, sizeof dir, "%s/wldbg", xdg);
+	} else if (home && *home) {
+		ret = snprintf(dir, sizeof dir, "%s/.cache", home);
+		mkdir(dir, 0700);
+		ret = snprintf(dir, sizeof dir, "%s/.cache/wldbg", home);
+	} else {
+		return -1;
+	}
+
+	if (ret >= (int) sizeof dir)
+		return -1;
+
+	mkdir(dir, 0700);
+	ret = snprintf(path, size, "%s/protocols-%08x.cache",
+		       dir, hash_string(key));
+	if (ret >= (int) size)
+		return -1;
+
+	return 0;
+}
+
+static int
+write_all(int fd, const void *data, size_t size)
+{
+	ssize_t ret;
+
+	while (size > 0) {
+		ret = write(fd, data, size);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+
+		data = (const char *) data + ret;
+		size -= ret;
+	}
+
+	return 0;
+}
+
+static void
+write_cache(const char *path, const char *key, struct wl_array *files,
+	    struct wl_list *interfaces)
+{
+	struct blob b;
+	struct cache_header *header;
+	struct cache_file *cf;
+	struct protocol_file *file;
+	struct protocol_interface *pi;
+	uint64_t off, key_off, files_off, interfaces_off, relocs_off;
+	uint32_t num;
+	char tmp[PATH_MAX];
+	int fd;
+
+	memset(&b, 0, sizeof b);
+	wl_array_init(&b.data);
+	wl_array_init(&b.relocs);
+
+	blob_alloc(&b, sizeof *header);
+	key_off = blob_string(&b, key);
+
+	num = files->size / sizeof *file;
+	files_off = blob_alloc(&b, num * sizeof *cf);
+	if (b.error)
+		goto out;
+
+	off = files_off;
+	wl_array_for_each(file, files) {
+		/* not a pointer, it is used only while checking */
+		uint64_t str = blob_string(&b, file->path);
+
+		cf = BLOB_AT(&b, off);
+		cf->path = str;
+		cf->mtime_sec = file->mtime.tv_sec;
+		cf->mtime_nsec = file->mtime.tv_nsec;
+		cf->size = file->size;
+		off += sizeof *cf;
+	}
+
+	num = wl_list_length(interfaces);
+	interfaces_off = blob_alloc(&b, num * sizeof *pi);
+	if (b.error)
+		goto out;
+
+	off = interfaces_off;
+	wl_list_for_each(pi, interfaces, link) {
+		blob_interface(&b, off, pi);
+		off += sizeof *pi;
+	}
+
+	relocs_off = blob_alloc(&b, b.relocs.size);
+	if (b.error || (b.relocs.size > 0 && !relocs_off))
+		goto out;
+
+	memcpy(BLOB_AT(&b, relocs_off), b.relocs.data, b.relocs.size);
+
+	header = BLOB_AT(&b, 0);
+	memcpy(header->magic, CACHE_MAGIC, sizeof header->magic);
+	header->version = CACHE_VERSION;
+	header->pointer_size = sizeof(void *);
+	header->interface_size = sizeof(struct protocol_interface);
+	header->size = b.data.size;
+	header->key = key_off;
+	header->files = files_off;
+	header->files_num = files->size / sizeof *file;
+	header->interfaces = interfaces_off;
+	header->interfaces_num = num;
+	header->relocs = relocs_off;
+	header->relocs_num = b.relocs.size / sizeof(uint64_t);
+
+	/* more wldbgs can start at once, replace the file atomically */
+	if (snprintf(tmp, sizeof tmp, "%s.XXXXXX", path) >= (int) sizeof tmp)
+		goto out;
+
+	fd = mkstemp(tmp);
+	if (fd < 0)
+		goto out;
+
+	if (write_all(fd, b.data.data, b.data.size) < 0
+	    || close(fd) < 0 || rename(tmp, path) < 0) {
+		fprintf(stderr, "Writing protocol cache '%s': %s\n",
+			path, strerror(errno));
+		unlink(tmp);
+	}
+
+out:
+	wl_array_release(&b.data);
+	wl_array_release(&b.relocs);
+}
+
+static int
+cache_string_valid(const char *data, size_t size, uint64_t off)
+{
+	return off < size && memchr(data + off, '\0', size - off) != NULL;
+}
+
+static int
+cache_files_match(const char *data, size_t size,
+		  const struct cache_header *header, struct wl_array *files)
+{
+	const struct cache_file *cf;
+	struct protocol_file *file;
+
+	if (header->files_num != files->size / sizeof *file
+	    || header->files > size
+	    || header->files_num > (size - header->files) / sizeof *cf)
+		return 0;
+
+	cf = (const struct cache_file *) (data + header->files);
+	wl_array_for_each(file, files) {
+		if (!cache_string_valid(data, size, cf->path)
+		    || strcmp(data + cf->path, file->path) != 0
+		    || cf->mtime_sec != file->mtime.tv_sec
+		    || cf->mtime_nsec != file->mtime.tv_nsec
+		    || cf->size != (uint64_t) file->size)
+			return 0;
+		++cf;
+	}
+
+	return 1;
+}
+
+/* map the cache and append its interfaces to the list,
+ * if the cache is for these files */
+static int
+load_cache(const char *path, const char *key, struct wl_array *files,
+	   struct wl_list *interfaces)
+{
+	struct cache_header *header;
+	struct protocol_interface *pi;
+	struct protocol_map *map;
+	const uint64_t *relocs;
+	uintptr_t *ptr;
+	struct stat st;
+	char *data;
+	uint64_t i;
+	int fd;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return -1;
+
+	if (fstat(fd, &st) < 0 || (size_t) st.st_size < sizeof *header) {
+		close(fd);
+		return -1;
+	}
+
+	/* private, so that we can relocate the pointers */
+	data = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+		return -1;
+
+	header = (struct cache_header *) data;
+	if (memcmp(header->magic, CACHE_MAGIC, sizeof header->magic) != 0
+	    || header->version != CACHE_VERSION
+	    || header->pointer_size != sizeof(void *)
+	    || header->interface_size != sizeof *pi
+	    || header->size != (uint64_t) st.st_size
+	    || !cache_string_valid(data, st.st_size, header->key)
+	    || strcmp(data + header->key, key) != 0
+	    || !cache_files_match(data, st.st_size, header, files))
+		goto err;
+
+	if (header->relocs > header->size
+	    || header->relocs_num > (header->size - header->relocs)
+				    / sizeof *relocs
+	    || header->interfaces > header->size
+	    || header->interfaces_num > (header->size - header->interfaces)
+					/ sizeof *pi)
+		goto err;
+
+	relocs = (const uint64_t *) (data + header->relocs);
+	for (i = 0; i < header->relocs_num; ++i) {
+		if (relocs[i] % sizeof *ptr != 0
+		    || relocs[i] > header->size - sizeof *ptr)
+			goto err;
+
+		ptr = (uintptr_t *) (data + relocs[i]);
+		if (*ptr >= header->size)
+			goto err;
+
+		*ptr += (uintptr_t) data;
+	}
+
+	map = wl_array_add(&protocols.maps, sizeof *map);
+	if (!map)
+		goto err;
+
+	map->data = data;
+	map->size = st.st_size;
+
+	pi = (struct protocol_interface *) (data + header->interfaces);
+	for (i = 0; i < header->interfaces_num; ++i, ++pi)
+		wl_list_insert(interfaces->prev, &pi->link);
+
+	return 0;
+
+err:
+	munmap(data, st.st_size);
+	return -1;
+}
+
+static void
+init_protocols(void)
+{
+	if (protocols.initialized)
+		return;
+
+	wl_list_init(&protocols.interfaces);
+	wl_array_init(&protocols.maps);
+	protocols.initialized = 1;
+}
+
+int
+protocols_load_cache(const char *key, struct wl_array *files,
+		     struct wl_list *interfaces)
+{
+	char path[PATH_MAX];
+
+	init_protocols();
+	if (cache_path(key, path, sizeof path) < 0)
+		return -1;
+
+	return load_cache(path, key, files, interfaces);
+}
+
+void
+protocols_write_cache(const char *key, struct wl_array *files,
+		      struct wl_list *interfaces)
+{
+	char path[PATH_MAX];
+
+	if (cache_path(key, path, sizeof path) == 0)
+		write_cache(path, key, files, interfaces);
+}
+
+static const struct wl_interface *
+find_interface(struct wl_list *interfaces, const char *name)
+{
+	const struct wl_interface *intf;
+	struct protocol_interface *pi;
+
+	intf = wldbg_interface_lookup(name);
+	if (intf)
+		return intf;
+
+	wl_list_for_each(pi, interfaces, link)
+		if (strcmp(pi->interface.name, name) == 0)
+			return &pi->interface;
+
+	return NULL;
+}
+
+static void
+link_messages(struct wl_list *interfaces,
+	      struct wl_array *messages, struct wl_array *infos)
+{
+	struct wl_message *msg = messages->data;
+	struct message_info *info;
+	const char **name;
+	unsigned int i;
+
+	wl_array_for_each(info, infos) {
+		i = 0;
+		wl_array_for_each(name, &info->types) {
+			if (*name)
+				msg->types[i] = find_interface(interfaces,
+							       *name);
+			++i;
+		}
+
+		++msg;
+	}
+}
+
+static int
+set_by_id(uint32_t id, struct protocol_interface *pi)
+{
+	struct protocol_interface **by_id;
+	uint32_t size;
+
+	if (id >= protocols.by_id_size) {
+		size = id + 16;
+		by_id = realloc(protocols.by_id, size * sizeof *by_id);
+		if (!by_id)
+			return -1;
+
+		memset(by_id + protocols.by_id_size, 0,
+		       (size - protocols.by_id_size) * sizeof *by_id);
+		protocols.by_id = by_id;
+		protocols.by_id_size = size;
+	}
+
+	/* the first loaded protocol has the enums */
+	if (!protocols.by_id[id])
+		protocols.by_id[id] = pi;
+
+	return 0;
+}
+
+/* fill the types of messages and add the interfaces to wldbg.
+ * Returns the number of interfaces that were not known before */
+static int
+register_interfaces(struct wl_list *interfaces)
+{
+	struct protocol_interface *pi;
+	const struct wl_interface *known;
+	uint32_t id;
+	int num = 0;
+
+	wl_list_for_each(pi, interfaces, link) {
+		link_messages(interfaces, &pi->requests, &pi->requests_info);
+		link_messages(interfaces, &pi->events, &pi->events_info);
+	}
+
+	wl_list_for_each(pi, interfaces, link) {
+		/* it could have been added as a type
+		 * of an argument of another interface */
+		known = wldbg_interface_lookup(pi->interface.name);
+		if (!known || known == &pi->interface) {
+			id = wldbg_interfaces_add(&pi->interface);
+			pi->registered = &pi->interface;
+			++num;
+		} else {
+			id = wldbg_interface_id(known);
+			pi->registered = known;
+		}
+
+		if (id == 0 || set_by_id(id, pi) < 0) {
+			fprintf(stderr, "Out of memory\n");
+			return -1;
+		}
+	}
+
+	return num;
+}
+
+int
+protocols_register(struct wl_list *interfaces)
+{
+	int ret;
+
+	init_protocols();
+	ret = register_interfaces(interfaces);
+
+	/* registered interfaces are in use, keep them all */
+	wl_list_insert_list(protocols.interfaces.prev, interfaces);
+
+	return ret;
+}
+
+/* key is what the files were found from, it names the cache */
+static int
+load_files(struct wl_array *files, const char *key)
+{
+	struct wl_list interfaces;
+	struct protocol_file *file;
+
+	wl_list_init(&interfaces);
+
+	if (files->size == 0)
+		return 0;
+
+	if (protocols_load_cache(key, files, &interfaces) == 0)
+		return protocols_register(&interfaces);
+
+	/* broken files are skipped, so that one of them
+	 * does not stop loading all the others */
+	wl_array_for_each(file, files)
+		load_file(file->path, &interfaces);
+
+	protocols_write_cache(key, files, &interfaces);
+
+	return protocols_register(&interfaces);
+}
+
+int
+wldbg_protocols_load(const char *path)
+{
+	struct wl_array files;
+	int ret = -1;
+
+	wl_array_init(&files);
+	if (find_files(path, &files, 0) == 0)
+		ret = load_files(&files, path);
+
+	protocols_free_files(&files);
+
+	return ret;
+}
+
+int
+wldbg_protocols_load_path(const char *paths)
+{
+	struct wl_array files;
+	char *copy, *path, *saveptr;
+	int ret;
+
+	copy = strdup(paths);
+	if (!copy) {
+		fprintf(stderr, "Out of memory\n");
+		return -1;
+	}
+
+	/* load them all at once, they can refer to each other */
+	wl_array_init(&files);
+	for (path = strtok_r(copy, ":", &saveptr); path;
+	     path = strtok_r(NULL, ":", &saveptr)) {
+		if (access(path, F_OK) == 0)
+			find_files(path, &files, 0);
+	}
+
+	free(copy);
+
+	ret = load_files(&files, paths);
+	protocols_free_files(&files);
+
+	return ret;
+}
+
+void
+wldbg_protocols_set_cache_dir(const char *dir)
+{
+	protocols.cache_dir = dir;
+}
+
+void
+wldbg_protocols_release(void)
+{
+	struct protocol_map *map;
+
+	if (!protocols.initialized)
+		return;
+
+	protocols_free_interfaces(&protocols.interfaces);
+	wl_array_for_each(map, &protocols.maps)
+		munmap(map->data, map->size);
+	wl_array_release(&protocols.maps);
+	wl_array_init(&protocols.maps);
+
+	free(protocols.by_id);
+	protocols.by_id = NULL;
+	protocols.by_id_size = 0;
+}
+
+static struct protocol_interface *
+get_protocol_interface(const struct wl_interface *intf)
+{
+	uint32_t id = wldbg_interface_id(intf);
+
+	if (id == 0 || id >= protocols.by_id_size)
+		return NULL;
+
+	return protocols.by_id[id];
+}
+
+static const struct wldbg_enum *
+find_enum(struct protocol_interface *pi, const char *name)
+{
+	struct wldbg_enum *e;
+
+	if (!pi)
+		return NULL;
+
+	wl_array_for_each(e, &pi->enums)
+		if (strcmp(e->name, name) == 0)
+			return e;
+
+	return NULL;
+}
+
+const struct wldbg_enum *
+wldbg_interface_get_enum(const struct wl_interface *intf, const char *name)
+{
+	return find_enum(get_protocol_interface(intf), name);
+}
+
+const struct wldbg_enum *
+wldbg_message_get_arg_enum(const struct wl_interface *intf, int from,
+			   uint32_t opcode, unsigned int arg)
+{
+	struct protocol_interface *pi = get_protocol_interface(intf);
+	struct wl_array *infos;
+	struct message_info *info;
+	const char *name, *dot;
+	char intf_name[256];
+
+	if (!pi)
+		return NULL;
+
+	infos = from == SERVER ? &pi->events_info : &pi->requests_info;
+	if (opcode >= infos->size / sizeof *info)
+		return NULL;
+
+	info = (struct message_info *) infos->data + opcode;
+	if (arg >= info->enums.size / sizeof(char *))
+		return NULL;
+
+	name = ((char **) info->enums.data)[arg];
+	if (!name)
+		return NULL;
+
+	/* enums of other interfaces are interface.enum */
+	dot = strchr(name, '.');
+	if (!dot)
+		return find_enum(pi, name);
+
+	if (dot - name >= (int) sizeof intf_name)
+		return NULL;
+
+	memcpy(intf_name, name, dot - name);
+	intf_name[dot - name] = '\0';
+
+	return find_enum(get_protocol_interface(
+				wldbg_interface_lookup(intf_name)), dot + 1);
+}
+
+const char *
+wldbg_enum_get_name(const struct wldbg_enum *e, uint32_t value)
+{
+	unsigned int i;
+
+	for (i = 0; i < e->entries_num; ++i)
+		if (e->entries[i].value == value)
+			return e->entries[i].name;
+
+	return NULL;
+}
@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2015 Marek Chalupa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include "wldbg.h"
+#include "wldbg-private.h"
+#include "wldbg-capture.h"
+#include "latency.h"
+#include "replay.h"
+
+/* connections are created on their first message, ids of
+ * connections in the capture are kept, so that passes see
+ * the same numbers as when the capture was recorded */
+static struct wldbg_connection *
+replay_connection(struct wldbg *wldbg, uint32_t id)
+{
+	struct wldbg_connection *conn;
+
+	wl_list_for_each(conn, &wldbg->connections, link) {
+		if (conn->id == id)
+			return conn;
+	}
+
+	conn = wldbg_connection_alloc(wldbg);
+	if (!conn)
+		return NULL;
+
+	conn->id = id;
+	wl_list_insert(wldbg->connections.prev, &conn->link);
+	++wldbg->connections_num;
+
+	return conn;
+}
+
+int
+wldbg_replay(struct wldbg *wldbg, const char *path, unsigned int from)
+{
+	struct wldbg_capture_file file;
+	const struct wldbg_capture_record *record;
+	const void *data;
+	struct wldbg_message *message = &wldbg->message;
+	struct wldbg_connection *conn, *tmp;
+	uint64_t start, time;
+	struct wldbg_capture_cursor cursor;
+	int ret;
+
+	if (wldbg_capture_file_open(&file, path) < 0)
+		return -1;
+
+	memset(&cursor, 0, sizeof cursor);
+	/* the index gets us right to the chunk with the time */
+	if (from > 0 && wldbg_capture_file_seek(&file, &cursor,
+			wldbg_capture_file_start_time(&file)
+			+ from * 1000000000ULL) < 0) {
+		wldbg_capture_file_close(&file);
+		return -1;
+	}
+
+	start = wldbg_time_ns();
+
+	while ((ret = wldbg_capture_file_next(&file, &cursor,
+					      &record, &data)) > 0) {
+		conn = replay_connection(wldbg, record->connection);
+		if (!conn) {
+			ret = -1;
+			break;
+		}
+
+		memset(message, 0, sizeof *message);
+		message->connection = conn;
+		message->from = record->from;
+		/* the file is mapped read-only, passes that want to
+		 * change the message get a copy like with a live one */
+		message->data = (void *) data;
+		message->size = record->size;
+
+		run_passes(message);
+		++wldbg->statistics.messages;
+
+		if (wldbg_should_exit(wldbg))
+			break;
+		if (wldbg_has_error(wldbg)) {
+			ret = -1;
+			break;
+		}
+	}
+
+	time = wldbg_time_ns() - start;
+	fprintf(stderr, "Replayed %lu messages of %d connections in %.3f s\n",
+		wldbg->statistics.messages, wldbg->connections_num,
+		time / 1e9);
+
+	/* this waits for observers too */
+	wl_list_for_each_safe(conn, tmp, &wldbg->connections, link) {
+		wl_list_remove(&conn->link);
+		--wldbg->connections_num;
+		wldbg_connection_destroy(conn);
+	}
+
+	wldbg_capture_file_close(&file);
+
+	return ret < 0 ? -1 : 0;
+}
@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2015 Marek Chalupa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _WLDBG_REPLAY_H_
+#define _WLDBG_REPLAY_H_
+
+#include "wldbg.h"
+
+/* run passes on messages from the capture file
+ * (see wldbg-capture.h) instead of a live connection,
+ * starting 'from' seconds after the first message */
+int
+wldbg_replay(struct wldbg *wldbg, const char *path, unsigned int from);
+
+/* defined in wldbg.c */
+struct wldbg_connection *
+wldbg_connection_alloc(struct wldbg *wldbg);
+
+void
+wldbg_connection_destroy(struct wldbg_connection *conn);
+
+void
+run_passes(struct wldbg_message *message);
+
+#endif /* _WLDBG_REPLAY_H_ */
@@ -39,91 +39,54 @@
 #include "wldbg-pass.h"
 #include "wldbg-private.h"
 #include "wldbg-ids-map.h"
+#include "wldbg-parse-message.h"
 #include "passes.h"
 #include "util.h"
 #include "resolve.h"
+#include "interfaces.h"
 
-static struct wl_list shared_interfaces;
-
+/* created is the index of the message that created the object */
 static void
-resolved_objects_put(struct resolved_objects *ro,
-		     uint32_t id, const struct wl_interface *intf)
-{
-	if (id >= WL_SERVER_ID_START)
-		wldbg_ids_map_insert(&ro->objects.server_objects,
-				     id - WL_SERVER_ID_START, (void *) intf);
-	else
-		wldbg_ids_map_insert(&ro->objects.client_objects, id, (void *) intf);
-}
-
-/* this pass analyze the connection and translates object id
- * to human-readable names */
-
-struct interface
+resolved_objects_put(struct resolved_objects *ro, uint32_t id,
+		     const struct wl_interface *intf, uint32_t version,
+		     uint64_t created)
 {
-	const struct wl_interface *interface;
-	struct wl_list link;
-};
+	struct wldbg_ids_map *map = &ro->objects.client_objects;
+	struct wldbg_ids_map_entry *entry;
 
-static void
-add_interface(struct wl_list *intfs, struct interface *intf)
-{
-	struct interface *i;
-
-	wl_list_for_each(i, intfs, link) {
-		if (strcmp(i->interface->name, intf->interface->name) == 0) {
-			dbg("Already got '%s' interface, discarding\n",
-				intf->interface->name);
-			free(intf);
-			return;
-		}
+	if (id >= WL_SERVER_ID_START) {
+		map = &ro->objects.server_objects;
+		id -= WL_SERVER_ID_START;
 	}
 
-	dbg("Adding interface '%s'\n", intf->interface->name);
-	wl_list_insert(intfs->next, &intf->link);
+	entry = wldbg_ids_map_insert_version(map, id, (void *) intf, version);
+	if (entry)
+		entry->created = created;
 }
 
+/* freed ids do not keep pages of the map, but their lifetime
+ * is known until the id is used again */
 static void
-add_shared_interface(struct interface *intf)
-{
-	add_interface(&shared_interfaces, intf);
-}
-
-static const struct wl_interface *
-get_interface(struct resolved_objects *ro, const char *name)
+resolved_objects_destroy(struct resolved_objects *ro, uint32_t id,
+			 uint64_t destroyed)
 {
-	struct interface *i;
-
-	wl_list_for_each(i, ro->interfaces, link) {
-		if (strcmp(i->interface->name, name) == 0) {
-			return i->interface;
-		}
-	}
-
-	wl_list_for_each(i, &ro->additional_interfaces, link) {
-		if (strcmp(i->interface->name, name) == 0) {
-			return i->interface;
-		}
-	}
-
-	dbg("RESOLVE: Didn't find '%s' interface\n", name);
-	return NULL;
+	if (id >= WL_SERVER_ID_START)
+		wldbg_ids_map_destroy(&ro->objects.server_objects,
+				      id - WL_SERVER_ID_START, destroyed);
+	else
+		wldbg_ids_map_destroy(&ro->objects.client_objects,
+				      id, destroyed);
 }
 
-static struct interface *
-create_interface(const struct wl_interface *intf)
-{
-	struct interface *ret = malloc(sizeof *ret);
-	if (!ret)
-		return NULL;
-
-	ret->interface = intf;
+/* this pass analyze the connection and translates object id
+ * to human-readable names */
 
-	return ret;
-}
+/* ids of interfaces that need special care */
+static uint32_t display_id;
+static uint32_t registry_id;
 
-static struct interface *
-libwayland_get_interface(void *handle, const char *intf)
+static void
+libwayland_add_interface(void *handle, const char *intf)
 {
 	const struct wl_interface *interface;
 
@@ -133,17 +96,41 @@ libwayland_get_interface(void *handle, const char *intf)
 	if (!interface) {
 		dbg("Failed loading interface '%s' from libwayland: %s\n",
 			intf, dlerror());
-		return NULL;
+		return;
 	}
 
-	return create_interface(interface);
+	wldbg_interfaces_add(interface);
 }
 
 static void
 parse_libwayland(void)
 {
-	struct interface *intf;
+	static const char *names[] = {
+		"wl_display_interface",
+		"wl_registry_interface",
+		"wl_callback_interface",
+		"wl_compositor_interface",
+		"wl_shm_pool_interface",
+		"wl_shm_interface",
+		"wl_buffer_interface",
+		"wl_data_offer_interface",
+		"wl_data_source_interface",
+		"wl_data_device_interface",
+		"wl_data_device_manager_interface",
+		"wl_shell_interface",
+		"wl_shell_surface_interface",
+		"wl_surface_interface",
+		"wl_seat_interface",
+		"wl_pointer_interface",
+		"wl_keyboard_interface",
+		"wl_touch_interface",
+		"wl_output_interface",
+		"wl_region_interface",
+		"wl_subcompositor_interface",
+		"wl_subsurface_interface",
+	};
 	void *handle;
+	unsigned int i;
 
 	handle = dlopen("libwayland-client.so", RTLD_NOW);
 	if (!handle) {
@@ -151,50 +138,8 @@ parse_libwayland(void)
 		return;
 	}
 
-	if ((intf = libwayland_get_interface(handle, "wl_display_interface")))
-		add_shared_interface(intf);
-	if ((intf = libwayland_get_interface(handle, "wl_registry_interface")))
-		add_shared_interface(intf);
-	if ((intf = libwayland_get_interface(handle, "wl_callback_interface")))
-		add_shared_interface(intf);
-	if ((intf = libwayland_get_interface(handle, "wl_compositor_interface")))
-		add_shared_interface(intf);
-	if ((intf = libwayland_get_interface(handle, "wl_shm_pool_interface")))
-		add_shared_interface(intf);
-	if ((intf = libwayland_get_interface(handle, "wl_shm_interface")))
-		add_shared_interface(intf);
-	if ((intf = libwayland_get_interface(handle, "wl_buffer_interface")))
-		add_shared_interface(intf);
-	if ((intf = libwayland_get_interface(handle, "wl_data_offer_interface")))
-		add_shared_interface(intf);
-	if ((intf = libwayland_get_interface(handle, "wl_data_source_interface")))
-		add_shared_interface(intf);
-	if ((intf = libwayland_get_interface(handle, "wl_data_device_interface")))
-		add_shared_interface(intf);
-	if ((intf = libwayland_get_interface(handle, "wl_data_device_manager_interface")))
-		add_shared_interface(intf);
-	if ((intf = libwayland_get_interface(handle, "wl_shell_interface")))
-		add_shared_interface(intf);
-	if ((intf = libwayland_get_interface(handle, "wl_shell_surface_interface")))
-		add_shared_interface(intf);
-	if ((intf = libwayland_get_interface(handle, "wl_surface_interface")))
-		add_shared_interface(intf);
-	if ((intf = libwayland_get_interface(handle, "wl_seat_interface")))
-		add_shared_interface(intf);
-	if ((intf = libwayland_get_interface(handle, "wl_pointer_interface")))
-		add_shared_interface(intf);
-	if ((intf = libwayland_get_interface(handle, "wl_keyboard_interface")))
-		add_shared_interface(intf);
-	if ((intf = libwayland_get_interface(handle, "wl_touch_interface")))
-		add_shared_interface(intf);
-	if ((intf = libwayland_get_interface(handle, "wl_output_interface")))
-		add_shared_interface(intf);
-	if ((intf = libwayland_get_interface(handle, "wl_region_interface")))
-		add_shared_interface(intf);
-	if ((intf = libwayland_get_interface(handle, "wl_subcompositor_interface")))
-		add_shared_interface(intf);
-	if ((intf = libwayland_get_interface(handle, "wl_subsurface_interface")))
-		add_shared_interface(intf);
+	for (i = 0; i < sizeof names / sizeof *names; ++i)
+		libwayland_add_interface(handle, names[i]);
 
 	dlclose(handle);
 }
@@ -206,25 +151,9 @@ extern const struct wl_interface xdg_popup_interface;
 static void
 add_hardcoded_xdg_shell(void)
 {
-	struct interface *intf;
-
-	intf = create_interface(&xdg_shell_interface);
-	if (!intf)
-		return;
-
-	add_shared_interface(intf);
-
-	intf = create_interface(&xdg_surface_interface);
-	if (!intf)
-		return;
-
-	add_shared_interface(intf);
-
-	intf = create_interface(&xdg_popup_interface);
-	if (!intf)
-		return;
-
-	add_shared_interface(intf);
+	wldbg_interfaces_add(&xdg_shell_interface);
+	wldbg_interfaces_add(&xdg_surface_interface);
+	wldbg_interfaces_add(&xdg_popup_interface);
 }
 
 extern const struct wl_interface wl_drm_interface;
@@ -232,101 +161,127 @@ extern const struct wl_interface wl_drm_interface;
 static void
 add_hardcoded_drm_interface(void)
 {
-	struct interface *intf;
-
-	intf = create_interface(&wl_drm_interface);
-	if (!intf)
-		return;
-
-	add_shared_interface(intf);
+	wldbg_interfaces_add(&wl_drm_interface);
 }
 
-static int
-wl_message_new_id_pos(const char *signature)
+/* signature of the message, compiled into tmp if the interface
+ * was not registered. NULL if the signature is not valid */
+static const struct wldbg_signature *
+message_signature(const struct wl_interface *intf,
+		  const struct wl_message *wl_message,
+		  int from, uint32_t opcode, struct wldbg_signature *tmp)
 {
-	int n = 0;
+	const struct wldbg_signature *sig;
 
-	while (signature[n] != '\0') {
-		if (signature[n] == 'n')
-			return n;
+	sig = wldbg_interface_get_signature(intf, from, opcode);
+	if (sig)
+		return sig;
 
-		++n;
-	}
+	if (!wl_message->signature
+	    || wldbg_signature_compile(tmp, wl_message->signature) < 0)
+		return NULL;
 
-	return -1;
+	return tmp;
 }
 
-static uint32_t
-get_new_id(const char *signature, uint32_t *data)
+/* decode arguments of the message, the lengths of strings
+ * and arrays are checked against the size of the message */
+static int
+get_args(struct wldbg_message *message, const struct wl_interface *intf,
+	 const struct wl_message *wl_message,
+	 const struct wldbg_signature *sig, struct wldbg_message_args *args)
 {
-	int n = 0, pos = 2;
-	uint32_t size;
-
-	while (signature[n] != '\0') {
-		switch(signature[n]) {
-		case 'n':
-			vdbg("Found new_id: %u\n", data[pos]);
-			return data[pos];
-		case 's':
-		case 'a':
-			size = DIV_ROUNDUP(data[pos], sizeof(uint32_t));
-			pos += size + 1;
-			break;
-		default:
-			++pos;
-		}
+	struct wldbg_resolved_message rm;
+
+	memset(&rm, 0, sizeof rm);
+	if (!wldbg_parse_message(message, &rm.base)
+	    || rm.base.size > message->size)
+		return -1;
 
-		++n;
+	rm.wl_interface = intf;
+	rm.wl_message = wl_message;
+	rm.signature = sig;
+
+	if (wldbg_resolved_message_get_args(&rm, args) < 0) {
+		fprintf(stderr, "RESOLVE: malformed message %s.%s\n",
+			intf->name, wl_message->name);
+		return -1;
 	}
 
-	assert(0 && "No new id in message");
+	return 0;
 }
 
+/* new objects get the version of the object that created them,
+ * like in libwayland. new_id without an interface is preceded
+ * by the name of the interface and the version ("sun") */
 static void
-get_new_ids(struct resolved_objects *ro, uint32_t *data,
-	    const struct wl_message *wl_message, const char *guess_type)
+get_new_ids(struct resolved_objects *ro, struct wldbg_message *message,
+	    const struct wl_message *wl_message,
+	    const struct wldbg_signature *sig,
+	    const struct wldbg_message_args *args,
+	    const char *guess_type, uint32_t version)
 {
-	uint32_t new_id;
+	uint32_t new_id, new_version;
 	const struct wl_interface *new_intf;
-	int id_pos, pos = 0;
+	unsigned int i, n;
 
-	assert(wl_message->signature && "BUG: no wl_message->signature");
 	assert(wl_message->types && "BUG: no wl_message->types");
 
-	/* search for new_id's in loop in the case there
-	 * are more of them in a event/request */
-	while ((id_pos = wl_message_new_id_pos(
-			wl_message->signature + pos)) >= 0) {
+	/* there can be more new_id's in an event/request */
+	for (i = 0; i < sig->new_ids_num; ++i) {
+		n = sig->new_ids[i];
+		new_id = *args->args[n].data;
+		new_intf = wl_message->types[n];
+		new_version = version;
 
-		new_id = get_new_id(wl_message->signature + pos, data);
-		new_intf = (void *) wl_message->types[id_pos];
+		if (!new_intf && n >= 2 && sig->types[n - 1] == 'u'
+		    && sig->types[n - 2] == 's')
+			new_version = *args->args[n - 1].data;
 
 		/* if the type is unknown, we guessed it is
 		 * this type (usualy from bind request) */
 		if (!new_intf && guess_type){
 			dbg("RESOLVE: Guessing unknown type is '%s'\n",
 				guess_type);
-			new_intf = get_interface(ro, guess_type);
+			new_intf = wldbg_interface_lookup(guess_type);
 		}
 
 		if (!new_intf)
 			new_intf = &unknown_interface;
 
-		resolved_objects_put(ro, new_id, new_intf);
+		resolved_objects_put(ro, new_id, new_intf, new_version,
+				     message->index);
 
-		dbg("RESOLVE: Got new id %u (%s)\n", new_id, new_intf->name);
-
-		pos = id_pos + 1;
+		dbg("RESOLVE: Got new id %u (%s v%u)\n", new_id,
+		    new_intf->name, new_version);
 	}
 }
 
+/* the message was added in a version that the object does not have */
+static void
+check_version(const struct wl_interface *intf,
+	      const struct wl_message *wl_message,
+	      const struct wldbg_signature *sig,
+	      uint32_t id, uint32_t version)
+{
+	if (version == 0 || sig->since <= version)
+		return;
+
+	fprintf(stderr, "Message %s@%u.%s is since version %u, "
+		"but the object has version %u\n",
+		intf->name, id, wl_message->name, sig->since, version);
+}
+
 static int
 resolve_in(void *user_data, struct wldbg_message *message)
 {
-	uint32_t id, opcode;
+	uint32_t id, opcode, version;
 	uint32_t *data = message->data;
 	const struct wl_interface *intf;
 	const struct wl_message *wl_message;
+	const struct wldbg_signature *sig;
+	struct wldbg_signature tmp;
+	struct wldbg_message_args args;
 	struct resolved_objects *ro = message->connection->resolved_objects;
 
 	(void) user_data;
@@ -353,14 +308,29 @@ resolve_in(void *user_data, struct wldbg_message *message)
 
 
 		wl_message = &intf->events[opcode];
+		sig = message_signature(intf, wl_message, SERVER,
+					opcode, &tmp);
+		version = wldbg_message_get_object_version(message, id);
+		if (sig)
+			check_version(intf, wl_message, sig, id, version);
 
 		/* handle delete_id event */
 		if (id == 1 /* wl_display */
 			&& opcode == WL_DISPLAY_DELETE_ID) {
-			resolved_objects_put(ro, data[2], &free_entry);
-			dbg("RESOLVE: Freed id %u\n", data[2]);
-		} else
-			get_new_ids(ro, data, wl_message, NULL);
+			if (sig && get_args(message, intf, wl_message,
+					    sig, &args) == 0
+			    && args.num > 0) {
+				resolved_objects_destroy(ro, *args.args[0].data,
+							 message->index);
+				dbg("RESOLVE: Freed id %u\n",
+				    *args.args[0].data);
+			}
+		} else if (sig && sig->new_ids_num > 0
+			   && get_args(message, intf, wl_message,
+				       sig, &args) == 0) {
+			get_new_ids(ro, message, wl_message, sig, &args,
+				    NULL, version);
+		}
 	}
 
 	return PASS_NEXT;
@@ -369,10 +339,13 @@ resolve_in(void *user_data, struct wldbg_message *message)
 static int
 resolve_out(void *user_data, struct wldbg_message *message)
 {
-	uint32_t id, opcode;
+	uint32_t id, opcode, version;
 	uint32_t *data = message->data;
 	const struct wl_interface *intf;
 	const struct wl_message *wl_message;
+	const struct wldbg_signature *sig;
+	struct wldbg_signature tmp;
+	struct wldbg_message_args args;
 	const char *guess_type = NULL;
 	struct resolved_objects *ro = message->connection->resolved_objects;
 
@@ -401,14 +374,26 @@ resolve_out(void *user_data, struct wldbg_message *message)
 
 		wl_message = &intf->methods[opcode];
 
-		/* data + 4 is the string with the name
-		 * of interface in bind request. Use it
-		 * to guess the interface of new id */
-		if (strcmp(intf->name, "wl_registry") == 0
-			&& opcode == WL_REGISTRY_BIND)
-				guess_type = (const char *) (data + 4);
+		sig = message_signature(intf, wl_message, CLIENT,
+					opcode, &tmp);
+		version = wldbg_message_get_object_version(message, id);
+		if (!sig)
+			return PASS_NEXT;
+
+		check_version(intf, wl_message, sig, id, version);
+		if (sig->new_ids_num == 0
+		    || get_args(message, intf, wl_message, sig, &args) < 0)
+			return PASS_NEXT;
 
-		get_new_ids(ro, data, wl_message, guess_type);
+		/* the second argument of bind request is the name
+		 * of interface. Use it to guess the interface of new id */
+		if (opcode == WL_REGISTRY_BIND
+		    && wldbg_interface_id(intf) == registry_id
+		    && args.num > 1 && args.args[1].type == 's')
+			guess_type = (const char *) args.args[1].data;
+
+		get_new_ids(ro, message, wl_message, sig, &args,
+			    guess_type, version);
 	}
 
 	return PASS_NEXT;
@@ -425,16 +410,10 @@ create_resolved_objects(void)
 
 	wldbg_ids_map_init(&ro->objects.client_objects);
 	wldbg_ids_map_init(&ro->objects.server_objects);
-	wl_list_init(&ro->additional_interfaces);
-
-	/* these are shared between connection */
-	/* and contain at least libwayland interfaces */
-	assert(!wl_list_empty(&shared_interfaces));
-	ro->interfaces = &shared_interfaces;
 
 	/* id 0 is always empty and 1 is always display */
-	resolved_objects_put(ro, 0, NULL);
-	resolved_objects_put(ro, 1, get_interface(ro, "wl_display"));
+	resolved_objects_put(ro, 0, NULL, 0, 0);
+	resolved_objects_put(ro, 1, wldbg_interface_get(display_id), 1, 0);
 
 	return ro;
 }
@@ -442,17 +421,12 @@ create_resolved_objects(void)
 void
 destroy_resolved_objects(struct resolved_objects *ro)
 {
-	struct interface *intf, *tmp;
-
 	if (!ro)
 		return;
 
 	wldbg_ids_map_release(&ro->objects.client_objects);
 	wldbg_ids_map_release(&ro->objects.server_objects);
 
-	wl_list_for_each_safe(intf, tmp, &ro->additional_interfaces, link)
-		free(intf);
-
 	free(ro);
 }
 
@@ -465,12 +439,6 @@ resolve_init(struct wldbg *wldbg, struct wldbg_pass *pass,
 	(void) wldbg;
 	(void) pass;
 
-	wl_list_init(&shared_interfaces);
-	struct interface *i;
-	int count = 0;
-	wl_list_for_each(i, &shared_interfaces, link)
-		count++;
-
 	/* get interfaces from libwayland.so */
 	parse_libwayland();
 
@@ -484,21 +452,50 @@ resolve_init(struct wldbg *wldbg, struct wldbg_pass *pass,
 
 	*/
 
+	display_id = wldbg_interface_id(wldbg_interface_lookup("wl_display"));
+	registry_id = wldbg_interface_id(wldbg_interface_lookup("wl_registry"));
+	if (!display_id) {
+		fprintf(stderr, "Resolving objects: no wl_display interface\n");
+		return -1;
+	}
+
 	dbg("Resolving objects inited\n");
 
 	return 0;
 }
 
-static void
-resolve_destroy(void *data)
+/* we need only messages that create or destroy objects
+ * and the messages with invalid opcode or one that can be
+ * too new for the object, so that we can warn */
+static int
+resolve_match(const struct wl_interface *intf, uint32_t opcode, int from)
 {
-	struct interface *intf, *tmp;
+	const struct wl_message *wl_message;
+	const struct wldbg_signature *sig;
+	struct wldbg_signature tmp;
+
+	/* resolve_in/out ignore objects that we do not know */
+	if (!intf)
+		return 0;
 
-	(void) data;
+	if (from == SERVER) {
+		if (opcode >= (uint32_t) intf->event_count)
+			return 1;
 
-	wl_list_for_each_safe(intf, tmp, &shared_interfaces, link) {
-		free(intf);
+		if (opcode == WL_DISPLAY_DELETE_ID
+		    && wldbg_interface_id(intf) == display_id)
+			return 1;
+
+		wl_message = &intf->events[opcode];
+	} else {
+		if (opcode >= (uint32_t) intf->method_count)
+			return 1;
+
+		wl_message = &intf->methods[opcode];
 	}
+
+	sig = message_signature(intf, wl_message, from, opcode, &tmp);
+	return sig && (sig->new_ids_num > 0 || sig->since > 1);
 }
 
 static struct pass *
@@ -511,10 +508,13 @@ create_resolve_pass(void)
 		return NULL;
 
 	pass->wldbg_pass.init = resolve_init;
-	pass->wldbg_pass.destroy = resolve_destroy;
 	pass->wldbg_pass.server_pass = resolve_in;
 	pass->wldbg_pass.client_pass = resolve_out;
 	pass->wldbg_pass.description = "Assign interfaces to objects";
+	/* shared interfaces are only read after init,
+	 * everything else is per connection */
+	pass->wldbg_pass.flags = WLDBG_PASS_THREAD_SAFE;
+	pass->wldbg_pass.subscription.match = resolve_match;
 
 	return pass;
 }
@@ -537,6 +537,7 @@ wldbg_add_resolve_pass(struct wldbg *wldbg)
 
 	/* insert always at the begining */
 	wl_list_insert(&wldbg->passes, &pass->link);
+	wldbg_passes_changed(wldbg);
 	wldbg->resolving_objects = 1;
 
 	return 0;
@@ -61,37 +61,142 @@ resolved_objects_get(struct resolved_objects *ro, uint32_t id)
 		return wldbg_ids_map_get(&ro->objects.client_objects, id);
 }
 
+static uint32_t
+resolved_objects_get_version(struct resolved_objects *ro, uint32_t id)
+{
+	if (id >= WL_SERVER_ID_START)
+		return wldbg_ids_map_get_version(&ro->objects.server_objects,
+						 id - WL_SERVER_ID_START);
+	else
+		return wldbg_ids_map_get_version(&ro->objects.client_objects,
+						 id);
+}
+
+static const struct wldbg_ids_map_entry *
+resolved_objects_get_entry(struct resolved_objects *ro, uint32_t id)
+{
+	if (id >= WL_SERVER_ID_START)
+		return wldbg_ids_map_get_entry(&ro->objects.server_objects,
+					       id - WL_SERVER_ID_START);
+	else
+		return wldbg_ids_map_get_entry(&ro->objects.client_objects,
+					       id);
+}
+
+static uint64_t
+entry_handle(const struct wldbg_ids_map_entry *entry, uint32_t id)
+{
+	return ((uint64_t) entry->generation << 32) | id;
+}
+
 const struct wl_interface *
 wldbg_message_get_object(struct wldbg_message *msg, uint32_t id)
 {
 	struct resolved_objects *ro = msg->connection->resolved_objects;
+	unsigned int i;
+
+	/* copy of the message for observers */
+	if (msg->objects) {
+		for (i = 0; i < msg->objects_num; ++i)
+			if (msg->objects[i].id == id)
+				return msg->objects[i].interface;
+
+		return NULL;
+	}
+
 	if (!ro)
 		return NULL;
 
 	return resolved_objects_get(ro, id);
 }
 
-const struct wl_interface *
-wldbg_message_get_interface(struct wldbg_message *msg, const char *name)
+uint32_t
+wldbg_message_get_object_version(struct wldbg_message *msg, uint32_t id)
 {
-	unsigned int i;
-	const struct wl_interface *intf;
 	struct resolved_objects *ro = msg->connection->resolved_objects;
+	unsigned int i;
 
-	for (i = 0; i < ro->objects.client_objects.count; ++i) {
-		intf = wldbg_ids_map_get(&ro->objects.client_objects, i);
-		if (intf && strcmp(intf->name, name) == 0)
-			return intf;
+	if (msg->objects) {
+		for (i = 0; i < msg->objects_num; ++i)
+			if (msg->objects[i].id == id)
+				return msg->objects[i].version;
+
+		return 0;
 	}
 
-	for (i = 0; i < ro->objects.server_objects.count; ++i) {
-		intf = wldbg_ids_map_get(&ro->objects.server_objects,
-					 WL_SERVER_ID_START + i);
-		if (intf && strcmp(intf->name, name) == 0)
-			return intf;
+	if (!ro)
+		return 0;
+
+	return resolved_objects_get_version(ro, id);
+}
+
+uint64_t
+wldbg_message_get_object_handle(struct wldbg_message *msg, uint32_t id)
+{
+	struct resolved_objects *ro = msg->connection->resolved_objects;
+	const struct wldbg_ids_map_entry *entry;
+	unsigned int i;
+
+	if (msg->objects) {
+		for (i = 0; i < msg->objects_num; ++i)
+			if (msg->objects[i].id == id)
+				return msg->objects[i].handle;
+
+		return 0;
 	}
 
-	return NULL;
+	if (!ro)
+		return 0;
+
+	entry = resolved_objects_get_entry(ro, id);
+	if (!entry || !entry->data)
+		return 0;
+
+	return entry_handle(entry, id);
+}
+
+int
+wldbg_message_get_object_lifetime(struct wldbg_message *msg, uint32_t id,
+				  struct wldbg_object_lifetime *lifetime)
+{
+	struct resolved_objects *ro = msg->connection->resolved_objects;
+	const struct wldbg_ids_map_entry *entry;
+
+	if (msg->objects || !ro)
+		return -1;
+
+	entry = resolved_objects_get_entry(ro, id);
+	if (!entry)
+		return -1;
+
+	lifetime->handle = entry_handle(entry, id);
+	lifetime->created = entry->created;
+	lifetime->destroyed = entry->destroyed;
+
+	return 0;
+}
+
+const struct wl_interface *
+wldbg_message_get_interface(struct wldbg_message *msg, const char *name)
+{
+	(void) msg;
+
+	return wldbg_interface_lookup(name);
+}
+
+struct iterate_data {
+	void (*func)(uint32_t id, const struct wl_interface *intf,
+		     void *data);
+	void *data;
+	uint32_t base;
+};
+
+static void
+iterate_object(uint32_t id, void *intf, void *data)
+{
+	struct iterate_data *it = data;
+
+	it->func(it->base + id, intf, it->data);
 }
 
 static void
@@ -101,19 +206,14 @@ resolved_objects_iterate(struct resolved_objects *ro,
 				      void *data),
 			 void *data)
 {
-	unsigned int i;
-	const struct wl_interface *intf;
+	struct iterate_data it = { func, data, 0 };
 
-	for (i = 0; i < ro->objects.client_objects.count; ++i) {
-		intf = wldbg_ids_map_get(&ro->objects.client_objects, i);
-		func(i, intf, data);
-	}
+	wldbg_ids_map_for_each(&ro->objects.client_objects,
+			       iterate_object, &it);
 
-	for (i = 0; i < ro->objects.server_objects.count; ++i) {
-		intf = wldbg_ids_map_get(&ro->objects.server_objects,
-					 WL_SERVER_ID_START + i);
-		func( WL_SERVER_ID_START + i, intf, data);
-	}
+	it.base = WL_SERVER_ID_START;
+	wldbg_ids_map_for_each(&ro->objects.server_objects,
+			       iterate_object, &it);
 }
 
 void
@@ -168,7 +168,10 @@ connect_to_wayland_server(struct wldbg_connection *conn, const char *display)
 		return -1;
 	}
 
-	conn->server.connection = wl_connection_create(conn->server.fd);
+	conn->server.connection
+		= wl_connection_create_sized(conn->server.fd,
+					     conn->wldbg->buffer_size,
+					     conn->wldbg->max_buffer_size);
 	if (!conn->server.connection) {
 		perror("Failed creating wl_connection");
 		goto err;
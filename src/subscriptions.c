@@ -0,0 +1,321 @@
+/*
+ * Copyright (c) 2015 Marek Chalupa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Tables of passes that want messages. For every interface
+ * that we have seen in the connection, there is an array of masks
+ * of passes indexed by opcode, for both directions. The tables are
+ * per connection, so that worker threads do not share them,
+ * and they are recomputed when wldbg->passes_serial changes.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+#include "wldbg.h"
+#include "wldbg-private.h"
+#include "wldbg-pass.h"
+#include "passes.h"
+
+#include "wayland/wayland-util.h"
+
+/* masks are uint64_t */
+#define MAX_MASKED_PASSES	64
+
+struct subscription {
+	const struct wl_interface *interface;
+	/* masks indexed by direction (SERVER, CLIENT) and opcode.
+	 * The last mask is for opcodes that the interface
+	 * does not know about */
+	uint64_t *masks[2];
+};
+
+struct pass_subscriptions {
+	/* wldbg->passes_serial that the tables were computed for */
+	unsigned int serial;
+
+	/* masks for objects with unknown interface */
+	uint64_t unknown[2];
+
+	/* hash table with open addressing,
+	 * size is a power of two */
+	struct subscription *table;
+	uint32_t size;
+	uint32_t count;
+};
+
+static int
+is_subscribed(struct wldbg_pass *pass, const struct wl_interface *intf,
+	      uint32_t opcode, int from)
+{
+	struct wldbg_pass_subscription *s = &pass->subscription;
+	unsigned int direction;
+	int i;
+
+	direction = from == SERVER ? WLDBG_SUBSCRIBE_SERVER
+				   : WLDBG_SUBSCRIBE_CLIENT;
+
+	if (s->directions && !(s->directions & direction))
+		return 0;
+
+	if (s->interfaces) {
+		if (!intf)
+			return 0;
+
+		for (i = 0; s->interfaces[i]; ++i)
+			if (strcmp(s->interfaces[i], intf->name) == 0)
+				break;
+
+		if (!s->interfaces[i])
+			return 0;
+	}
+
+	if (s->opcodes) {
+		if (!intf || opcode >= MAX_MASKED_PASSES
+		    || !(s->opcodes & ((uint64_t) 1 << opcode)))
+			return 0;
+	}
+
+	if (s->match)
+		return s->match(intf, opcode, from);
+
+	return 1;
+}
+
+static uint64_t
+compute_mask(struct wldbg *wldbg, const struct wl_interface *intf,
+	     uint32_t opcode, int from)
+{
+	struct pass *pass;
+	uint64_t mask = 0;
+	unsigned int n = 0;
+
+	wl_list_for_each(pass, &wldbg->passes, link) {
+		if (n == MAX_MASKED_PASSES)
+			break;
+
+		if (is_subscribed(&pass->wldbg_pass, intf, opcode, from))
+			mask |= (uint64_t) 1 << n;
+
+		++n;
+	}
+
+	return mask;
+}
+
+static uint64_t *
+compute_masks(struct wldbg *wldbg, const struct wl_interface *intf, int from)
+{
+	uint64_t *masks;
+	uint32_t count, opcode;
+
+	count = from == SERVER ? intf->event_count : intf->method_count;
+
+	/* + 1 for invalid opcodes */
+	masks = malloc((count + 1) * sizeof *masks);
+	if (!masks)
+		return NULL;
+
+	for (opcode = 0; opcode <= count; ++opcode)
+		masks[opcode] = compute_mask(wldbg, intf, opcode, from);
+
+	return masks;
+}
+
+static uint32_t
+hash_interface(const struct wl_interface *intf)
+{
+	uintptr_t p = (uintptr_t) intf;
+
+	return (uint32_t) ((p >> 4) * 2654435761u);
+}
+
+static void
+clear_table(struct pass_subscriptions *subs)
+{
+	uint32_t i;
+
+	if (subs->size == 0)
+		return;
+
+	for (i = 0; i < subs->size; ++i) {
+		free(subs->table[i].masks[SERVER]);
+		free(subs->table[i].masks[CLIENT]);
+	}
+
+	memset(subs->table, 0, subs->size * sizeof *subs->table);
+	subs->count = 0;
+}
+
+static struct subscription *
+find_slot(struct subscription *table, uint32_t size,
+	  const struct wl_interface *intf)
+{
+	uint32_t i = hash_interface(intf) & (size - 1);
+
+	while (table[i].interface && table[i].interface != intf)
+		i = (i + 1) & (size - 1);
+
+	return &table[i];
+}
+
+static int
+grow_table(struct pass_subscriptions *subs)
+{
+	struct subscription *table, *slot;
+	uint32_t size, i;
+
+	size = subs->size ? subs->size * 2 : 32;
+	table = calloc(size, sizeof *table);
+	if (!table)
+		return -1;
+
+	for (i = 0; i < subs->size; ++i) {
+		if (!subs->table[i].interface)
+			continue;
+
+		slot = find_slot(table, size, subs->table[i].interface);
+		*slot = subs->table[i];
+	}
+
+	free(subs->table);
+	subs->table = table;
+	subs->size = size;
+
+	return 0;
+}
+
+static struct subscription *
+add_subscription(struct wldbg *wldbg, struct pass_subscriptions *subs,
+		 const struct wl_interface *intf)
+{
+	struct subscription *slot;
+
+	/* keep the load under 1/2 */
+	if ((subs->count + 1) * 2 > subs->size && grow_table(subs) < 0)
+		return NULL;
+
+	slot = find_slot(subs->table, subs->size, intf);
+	assert(!slot->interface);
+
+	slot->masks[SERVER] = compute_masks(wldbg, intf, SERVER);
+	slot->masks[CLIENT] = compute_masks(wldbg, intf, CLIENT);
+	if (!slot->masks[SERVER] || !slot->masks[CLIENT]) {
+		free(slot->masks[SERVER]);
+		free(slot->masks[CLIENT]);
+		slot->masks[SERVER] = slot->masks[CLIENT] = NULL;
+		return NULL;
+	}
+
+	slot->interface = intf;
+	++subs->count;
+
+	return slot;
+}
+
+static struct pass_subscriptions *
+get_subscriptions(struct wldbg_connection *conn)
+{
+	struct wldbg *wldbg = conn->wldbg;
+	struct pass_subscriptions *subs = conn->subscriptions;
+
+	if (!subs) {
+		subs = calloc(1, sizeof *subs);
+		if (!subs)
+			return NULL;
+
+		/* make sure the tables are computed below */
+		subs->serial = wldbg->passes_serial - 1;
+		conn->subscriptions = subs;
+	}
+
+	if (subs->serial != wldbg->passes_serial) {
+		clear_table(subs);
+		subs->unknown[SERVER] = compute_mask(wldbg, NULL, 0, SERVER);
+		subs->unknown[CLIENT] = compute_mask(wldbg, NULL, 0, CLIENT);
+		subs->serial = wldbg->passes_serial;
+	}
+
+	return subs;
+}
+
+uint64_t
+pass_subscriptions_get_mask(struct wldbg_message *message)
+{
+	struct pass_subscriptions *subs;
+	struct subscription *slot;
+	const struct wl_interface *intf;
+	uint32_t *data = message->data;
+	uint32_t opcode, count;
+	int from = message->from;
+
+	/* whole buffer may contain different messages */
+	if (message->connection->wldbg->flags.pass_whole_buffer)
+		return ~((uint64_t) 0);
+
+	subs = get_subscriptions(message->connection);
+	/* no memory, better call everybody */
+	if (!subs)
+		return ~((uint64_t) 0);
+
+	intf = wldbg_message_get_object(message, data[0]);
+	/* free and unknown objects have negative version */
+	if (!intf || intf->version < 0)
+		return subs->unknown[from];
+
+	slot = NULL;
+	if (subs->size > 0) {
+		slot = find_slot(subs->table, subs->size, intf);
+		if (!slot->interface)
+			slot = NULL;
+	}
+
+	if (!slot) {
+		slot = add_subscription(message->connection->wldbg,
+					subs, intf);
+		if (!slot)
+			return ~((uint64_t) 0);
+	}
+
+	opcode = data[1] & 0xffff;
+	count = from == SERVER ? intf->event_count : intf->method_count;
+	if (opcode > count)
+		opcode = count;
+
+	return slot->masks[from][opcode];
+}
+
+void
+pass_subscriptions_destroy(struct pass_subscriptions *subs)
+{
+	if (!subs)
+		return;
+
+	clear_table(subs);
+	free(subs->table);
+	free(subs);
+}
@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) 2015 Marek Chalupa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _WLDBG_CAPTURE_H_
+#define _WLDBG_CAPTURE_H_
+
+#include <stdlib.h> /* size_t */
+#include <stdint.h>
+
+struct wldbg_message;
+
+/*
+ * Capture file: a header, chunks of records and an index at the end.
+ *
+ * Records of messages are written in chunks of about
+ * WLDBG_CAPTURE_CHUNK_SIZE bytes. The index has the time span of every
+ * chunk and the list of chunks of every connection, so a reader can
+ * find a place in a long capture without reading it all. Everything
+ * is aligned to 8 bytes, so the file can be mapped into memory
+ * and the records read right from it.
+ *
+ * If wldbg did not finish the file (crashed), the index is missing
+ * and readers find the chunks by walking their headers.
+ *
+ * Replay it with 'wldbg --replay=FILE pass ...'
+ */
+
+#define WLDBG_CAPTURE_MAGIC	"WLDBGCAP"
+#define WLDBG_CAPTURE_VERSION	2
+
+#define WLDBG_CAPTURE_CHUNK_MAGIC	"CHNK"
+#define WLDBG_CAPTURE_FOOTER_MAGIC	"WLDBGIDX"
+#define WLDBG_CAPTURE_CHUNK_SIZE	(64 * 1024)
+
+struct wldbg_capture_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t flags;
+};
+
+/* followed by 'size' bytes of records */
+struct wldbg_capture_chunk {
+	char magic[4];
+	uint32_t size;
+	uint32_t records;
+	uint32_t reserved;
+	/* time of the first and the last record */
+	uint64_t first_time;
+	uint64_t last_time;
+};
+
+struct wldbg_capture_record {
+	/* CLOCK_REALTIME in nanoseconds */
+	uint64_t time;
+	/* number of the connection in wldbg that captured it */
+	uint32_t connection;
+	/* size of the message that follows the record */
+	uint16_t size;
+	/* SERVER or CLIENT like wldbg_message.from */
+	uint8_t from;
+	/* number of fds that the message carried. The fds
+	 * themselves are not captured */
+	uint8_t fds;
+};
+
+#define WLDBG_CAPTURE_ALIGN(size)	(((size) + 7) & ~7)
+
+/*
+ * The index: entries for chunks, entries for connections and
+ * numbers of chunks that the connection entries point to,
+ * followed by the footer that ends the file.
+ */
+struct wldbg_capture_index_chunk {
+	/* offset of the chunk header in the file */
+	uint64_t offset;
+	uint64_t first_time;
+	uint64_t last_time;
+	uint32_t size;
+	uint32_t records;
+};
+
+struct wldbg_capture_index_connection {
+	uint32_t id;
+	/* chunks with messages of the connection are
+	 * chunks_num numbers from 'first' on */
+	uint32_t first;
+	uint32_t chunks_num;
+	uint32_t reserved;
+};
+
+struct wldbg_capture_footer {
+	/* offset of the first chunk entry */
+	uint64_t index;
+	uint32_t chunks_num;
+	uint32_t connections_num;
+	uint32_t refs_num;
+	uint32_t reserved;
+	char magic[8];
+};
+
+/* writing captures */
+struct wldbg_capture;
+
+/* the file must not exist */
+struct wldbg_capture *
+wldbg_capture_create(const char *path);
+
+int
+wldbg_capture_write(struct wldbg_capture *capture,
+		    struct wldbg_message *message);
+
+/* write the record that was filled somewhere else
+ * (the flight recorder) */
+int
+wldbg_capture_write_record(struct wldbg_capture *capture,
+			   const struct wldbg_capture_record *record,
+			   const void *data);
+
+/* time for records, CLOCK_REALTIME in nanoseconds */
+uint64_t
+wldbg_capture_time(void);
+
+/* fill the record for the message data of given size */
+void
+wldbg_capture_record_init(struct wldbg_capture_record *record,
+			  struct wldbg_message *message, uint64_t time,
+			  const void *data, uint16_t size);
+
+/* write out the last chunk and the index */
+void
+wldbg_capture_destroy(struct wldbg_capture *capture);
+
+/* reading captures */
+struct wldbg_capture_file {
+	void *data;
+	size_t size;
+
+	const struct wldbg_capture_index_chunk *chunks;
+	uint32_t chunks_num;
+	const struct wldbg_capture_index_connection *connections;
+	uint32_t connections_num;
+	const uint32_t *refs;
+
+	/* the file has no index, chunks were found
+	 * by walking the file and are allocated */
+	int unfinished;
+};
+
+/* position in the capture file, all zeros is the start */
+struct wldbg_capture_cursor {
+	uint32_t chunk;
+	/* offset of the next record in the file,
+	 * 0 if the chunk was not entered yet */
+	size_t offset;
+};
+
+int
+wldbg_capture_file_open(struct wldbg_capture_file *file, const char *path);
+
+void
+wldbg_capture_file_close(struct wldbg_capture_file *file);
+
+/* Returns 1 and the record and its data, 0 at the end
+ * of the file or -1 if the file is corrupted */
+int
+wldbg_capture_file_next(struct wldbg_capture_file *file,
+			struct wldbg_capture_cursor *cursor,
+			const struct wldbg_capture_record **record,
+			const void **data);
+
+/* move the cursor to the first record with time >= time.
+ * Only the chunk with the time is read */
+int
+wldbg_capture_file_seek(struct wldbg_capture_file *file,
+			struct wldbg_capture_cursor *cursor, uint64_t time);
+
+/* numbers of chunks that contain messages of the connection. Chunks
+ * start at file->chunks[n].offset, cursor { n, 0 } points to them.
+ * Returns the number of chunks, in unfinished files all of them
+ * (chunks is NULL then) */
+uint32_t
+wldbg_capture_file_connection_chunks(struct wldbg_capture_file *file,
+				     uint32_t connection,
+				     const uint32_t **chunks);
+
+/* time of the first message in the file or 0 if it is empty */
+uint64_t
+wldbg_capture_file_start_time(struct wldbg_capture_file *file);
+
+#endif /* _WLDBG_CAPTURE_H_ */
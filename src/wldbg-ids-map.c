@@ -32,54 +32,297 @@
 #include "wldbg-pass.h"
 #include "wldbg-ids-map.h"
 
+#define PAGE_MASK	(WLDBG_IDS_MAP_PAGE_SIZE - 1)
+
+/* this function is supposed to always succeed, so in this case
+ * we cannot do nothing better than abort(). We can't pass this
+ * slicently */
+static void
+out_of_memory(void)
+{
+	fprintf(stderr, "Out of memory");
+	abort();
+}
+
 void
 wldbg_ids_map_init(struct wldbg_ids_map *map)
 {
-	map->count = 0;
-	wl_array_init(&map->data);
+	memset(map, 0, sizeof *map);
+	wl_array_init(&map->sparse);
 }
 
 void
 wldbg_ids_map_release(struct wldbg_ids_map *map)
 {
-	map->count = 0;
-	wl_array_release(&map->data);
+	struct wldbg_ids_map_sparse *sp;
+	uint32_t i;
+
+	for (i = 0; i < map->direct_size; ++i)
+		free(map->direct[i]);
+	free(map->direct);
+
+	wl_array_for_each(sp, &map->sparse)
+		free(sp->page);
+	wl_array_release(&map->sparse);
+
+	wldbg_ids_map_init(map);
+}
+
+static struct wldbg_ids_map_sparse *
+find_sparse(struct wldbg_ids_map *map, uint32_t index, int *pos)
+{
+	struct wldbg_ids_map_sparse *sp = map->sparse.data;
+	int low = 0, high = map->sparse.size / sizeof *sp, mid;
+
+	while (low < high) {
+		mid = (low + high) / 2;
+		if (sp[mid].index == index) {
+			low = mid;
+			break;
+		}
+
+		if (sp[mid].index < index)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	if (pos)
+		*pos = low;
+
+	if (low < high)
+		return &sp[low];
+
+	return NULL;
+}
+
+static struct wldbg_ids_map_page *
+find_page(struct wldbg_ids_map *map, uint32_t index)
+{
+	struct wldbg_ids_map_sparse *sp;
+
+	if (index < map->direct_size)
+		return map->direct[index];
+
+	if (index < WLDBG_IDS_MAP_DIRECT_PAGES)
+		return NULL;
+
+	sp = find_sparse(map, index, NULL);
+	return sp ? sp->page : NULL;
+}
+
+static struct wldbg_ids_map_page *
+add_page(struct wldbg_ids_map *map, uint32_t index)
+{
+	struct wldbg_ids_map_page *page, **direct;
+	struct wldbg_ids_map_sparse *sp;
+	uint32_t size;
+	int pos;
+
+	page = calloc(1, sizeof *page);
+	if (!page)
+		out_of_memory();
+
+	if (index < WLDBG_IDS_MAP_DIRECT_PAGES) {
+		if (index >= map->direct_size) {
+			size = map->direct_size ? map->direct_size : 4;
+			while (size <= index)
+				size *= 2;
+
+			direct = realloc(map->direct, size * sizeof *direct);
+			if (!direct)
+				out_of_memory();
+
+			memset(direct + map->direct_size, 0,
+			       (size - map->direct_size) * sizeof *direct);
+			map->direct = direct;
+			map->direct_size = size;
+		}
+
+		map->direct[index] = page;
+	} else {
+		find_sparse(map, index, &pos);
+		if (!wl_array_add(&map->sparse, sizeof *sp))
+			out_of_memory();
+
+		sp = map->sparse.data;
+		memmove(sp + pos + 1, sp + pos,
+			map->sparse.size - (pos + 1) * sizeof *sp);
+		sp[pos].index = index;
+		sp[pos].page = page;
+	}
+
+	++map->pages_num;
+	return page;
+}
+
+static void
+remove_page(struct wldbg_ids_map *map, uint32_t index)
+{
+	struct wldbg_ids_map_sparse *sp;
+
+	if (index < map->direct_size) {
+		free(map->direct[index]);
+		map->direct[index] = NULL;
+	} else {
+		sp = find_sparse(map, index, NULL);
+		assert(sp);
+		free(sp->page);
+		memmove(sp, sp + 1, (char *) map->sparse.data
+			+ map->sparse.size - (char *) (sp + 1));
+		map->sparse.size -= sizeof *sp;
+	}
+
+	--map->pages_num;
 }
 
 void
 wldbg_ids_map_insert(struct wldbg_ids_map *map, uint32_t id,
 		     void *data)
 {
-	void **p;
-	size_t size;
-
-	if (id >= map->count) {
-		size = (id - map->count + 1) * sizeof(void *);
-		p = wl_array_add(&map->data, size);
-		if (!p) {
-			/* this function is supposed to always succeed,
-			 * so in this case we cannot do nothing better
-			 * than abort(). We can't pass this slicently */
-			fprintf(stderr, "Out of memory");
-			abort();
-		}
+	wldbg_ids_map_insert_version(map, id, data, 0);
+}
+
+struct wldbg_ids_map_entry *
+wldbg_ids_map_insert_version(struct wldbg_ids_map *map, uint32_t id,
+			     void *data, uint32_t version)
+{
+	struct wldbg_ids_map_page *page;
+	struct wldbg_ids_map_entry *entry;
+	uint32_t index = id >> WLDBG_IDS_MAP_PAGE_SHIFT;
 
-		/* set newly allocated memory to 0s */
-		memset(p, 0, size);
+	if (id >= map->count)
+		map->count = id + 1;
+
+	page = find_page(map, index);
+	if (!page) {
+		/* nothing to remove */
+		if (!data)
+			return NULL;
+
+		page = add_page(map, index);
 	}
 
-	p = ((void **) map->data.data) + id;
-	assert(p);
+	entry = &page->entries[id & PAGE_MASK];
+	if (entry->data && !data)
+		--page->used;
+	else if (!entry->data && data)
+		++page->used;
+
+	if (!data) {
+		memset(entry, 0, sizeof *entry);
+		if (page->used == 0)
+			remove_page(map, index);
+		return NULL;
+	}
+
+	/* 0 is for no object */
+	if (++map->generation == 0)
+		++map->generation;
+
+	entry->data = data;
+	entry->version = version;
+	entry->generation = map->generation;
+	entry->created = 0;
+	entry->destroyed = 0;
+
+	return entry;
+}
+
+void
+wldbg_ids_map_remove(struct wldbg_ids_map *map, uint32_t id)
+{
+	wldbg_ids_map_insert_version(map, id, NULL, 0);
+}
 
-	map->count = map->data.size / sizeof(void *);
-	*p = data;
+void
+wldbg_ids_map_destroy(struct wldbg_ids_map *map, uint32_t id,
+		      uint64_t destroyed)
+{
+	struct wldbg_ids_map_page *page;
+	struct wldbg_ids_map_entry *entry;
+	uint32_t index = id >> WLDBG_IDS_MAP_PAGE_SHIFT;
+
+	page = find_page(map, index);
+	if (!page || !page->entries[id & PAGE_MASK].data)
+		return;
+
+	entry = &page->entries[id & PAGE_MASK];
+	entry->data = NULL;
+	entry->destroyed = destroyed;
+	map->destroyed_id = id;
+	map->destroyed = *entry;
+
+	/* entries of destroyed objects do not keep the page */
+	if (--page->used == 0)
+		remove_page(map, index);
+}
+
+const struct wldbg_ids_map_entry *
+wldbg_ids_map_get_entry(struct wldbg_ids_map *map, uint32_t id)
+{
+	struct wldbg_ids_map_page *page;
+
+	page = find_page(map, id >> WLDBG_IDS_MAP_PAGE_SHIFT);
+	if (page && page->entries[id & PAGE_MASK].generation != 0)
+		return &page->entries[id & PAGE_MASK];
+
+	if (map->destroyed.generation != 0 && map->destroyed_id == id)
+		return &map->destroyed;
+
+	return NULL;
 }
 
 void *
 wldbg_ids_map_get(struct wldbg_ids_map *map, uint32_t id)
 {
-	if (id < map->count)
-		return ((void **) map->data.data)[id];
+	struct wldbg_ids_map_page *page;
+
+	page = find_page(map, id >> WLDBG_IDS_MAP_PAGE_SHIFT);
+	if (page)
+		return page->entries[id & PAGE_MASK].data;
 
 	return NULL;
 }
+
+uint32_t
+wldbg_ids_map_get_version(struct wldbg_ids_map *map, uint32_t id)
+{
+	struct wldbg_ids_map_page *page;
+
+	page = find_page(map, id >> WLDBG_IDS_MAP_PAGE_SHIFT);
+	/* destroyed objects keep the version in the entry */
+	if (page && page->entries[id & PAGE_MASK].data)
+		return page->entries[id & PAGE_MASK].version;
+
+	return 0;
+}
+
+static void
+page_for_each(struct wldbg_ids_map_page *page, uint32_t index,
+	      void (*func)(uint32_t id, void *data, void *user_data),
+	      void *user_data)
+{
+	uint32_t i;
+
+	for (i = 0; i < WLDBG_IDS_MAP_PAGE_SIZE; ++i)
+		if (page->entries[i].data)
+			func((index << WLDBG_IDS_MAP_PAGE_SHIFT) + i,
+			     page->entries[i].data, user_data);
+}
+
+void
+wldbg_ids_map_for_each(struct wldbg_ids_map *map,
+		       void (*func)(uint32_t id, void *data, void *user_data),
+		       void *user_data)
+{
+	struct wldbg_ids_map_sparse *sp;
+	uint32_t i;
+
+	for (i = 0; i < map->direct_size; ++i)
+		if (map->direct[i])
+			page_for_each(map->direct[i], i, func, user_data);
+
+	wl_array_for_each(sp, &map->sparse)
+		page_for_each(sp->page, sp->index, func, user_data);
+}
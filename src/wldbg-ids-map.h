@@ -29,10 +29,61 @@
 #include "wayland/wayland-util.h"
 
 /* we need just something like dynamic array. Wl_map is pain in the ass
- * for our purpose - belive me, I tried it ;) */
+ * for our purpose - belive me, I tried it ;)
+ *
+ * Ids are in pages of WLDBG_IDS_MAP_PAGE_SIZE entries. Pages of low ids
+ * (where almost all objects are) are found right by the index in an
+ * array, pages of higher ids are kept sorted and searched. That way
+ * one big (or broken) id does not allocate the whole range before it.
+ * Pages are allocated on insert and freed when they become empty */
+#define WLDBG_IDS_MAP_PAGE_SHIFT	8
+#define WLDBG_IDS_MAP_PAGE_SIZE		(1u << WLDBG_IDS_MAP_PAGE_SHIFT)
+/* pages in the array, that is 256K ids */
+#define WLDBG_IDS_MAP_DIRECT_PAGES	1024
+
+struct wldbg_ids_map_entry {
+	void *data;
+	/* version the object was bound or created with, 0 if unknown */
+	uint32_t version;
+	/* every inserted object gets the next generation of the map,
+	 * so objects that had the same id can be told apart. 0 if
+	 * there was no object */
+	uint32_t generation;
+	/* numbers of messages that created and destroyed the object,
+	 * 0 if they are not known (yet). The entry of a destroyed
+	 * object stays until the id is used again or its page is freed */
+	uint64_t created;
+	uint64_t destroyed;
+};
+
+struct wldbg_ids_map_page {
+	/* entries with data */
+	uint32_t used;
+	struct wldbg_ids_map_entry entries[WLDBG_IDS_MAP_PAGE_SIZE];
+};
+
 struct wldbg_ids_map {
+	/* the highest inserted id + 1 */
 	uint32_t count;
-	struct wl_array data;
+	uint32_t pages_num;
+	/* the last given generation */
+	uint32_t generation;
+	/* the entry of the last destroyed object is kept even when
+	 * its page is freed, passes look at it while handling the
+	 * message that destroyed it */
+	uint32_t destroyed_id;
+	struct wldbg_ids_map_entry destroyed;
+
+	/* pages indexed by id >> WLDBG_IDS_MAP_PAGE_SHIFT */
+	struct wldbg_ids_map_page **direct;
+	uint32_t direct_size;
+	/* struct wldbg_ids_map_sparse sorted by index */
+	struct wl_array sparse;
+};
+
+struct wldbg_ids_map_sparse {
+	uint32_t index;
+	struct wldbg_ids_map_page *page;
 };
 
 void
@@ -44,7 +95,38 @@ wldbg_ids_map_release(struct wldbg_ids_map *map);
 void
 wldbg_ids_map_insert(struct wldbg_ids_map *map, uint32_t id, void *data);
 
+/* returns the entry of the new object, NULL if data is NULL */
+struct wldbg_ids_map_entry *
+wldbg_ids_map_insert_version(struct wldbg_ids_map *map, uint32_t id,
+			     void *data, uint32_t version);
+
 void *
 wldbg_ids_map_get(struct wldbg_ids_map *map, uint32_t id);
 
+/* 0 if the id is not in the map or the object was destroyed */
+uint32_t
+wldbg_ids_map_get_version(struct wldbg_ids_map *map, uint32_t id);
+
+/* the same as inserting NULL */
+void
+wldbg_ids_map_remove(struct wldbg_ids_map *map, uint32_t id);
+
+/* remove the object, but keep its entry with the number of the
+ * message that destroyed it, see wldbg_ids_map_get_entry() */
+void
+wldbg_ids_map_destroy(struct wldbg_ids_map *map, uint32_t id,
+		      uint64_t destroyed);
+
+/* the entry of the object with the id or of the last destroyed one,
+ * NULL if there is none. The data are NULL for destroyed objects */
+const struct wldbg_ids_map_entry *
+wldbg_ids_map_get_entry(struct wldbg_ids_map *map, uint32_t id);
+
+/* call func for every id with data, in the order of ids.
+ * func must not change the map */
+void
+wldbg_ids_map_for_each(struct wldbg_ids_map *map,
+		       void (*func)(uint32_t id, void *data, void *user_data),
+		       void *user_data);
+
 #endif /* _WLDBG_IDS_MAP_H_ */
@@ -55,17 +55,98 @@ struct wldbg_resolved_arg {
 	uint32_t *data;
 };
 
+/*
+ * Signature of a wl_message parsed into a table, so that messages
+ * can be walked without reading the signature string again.
+ * Signatures of known interfaces are compiled when the interface
+ * is registered, see wldbg_interface_get_signature()
+ */
+#define WLDBG_SIGNATURE_MAX_ARGS	20
+
+struct wldbg_signature {
+	uint8_t args_num;
+	uint8_t new_ids_num;
+	uint8_t fds_num;
+	/* the first string, array or fd, args_num if there is none.
+	 * Arguments before it are at data[n] */
+	uint8_t first_varlen;
+	/* version of the interface that has the message */
+	uint32_t since;
+	/* bit n is set if argument n can be null */
+	uint32_t nullable;
+	/* bit n is set if argument n is a string or array */
+	uint32_t varlen;
+	/* bit n is set if argument n is an fd, it has no data
+	 * in the message (fds go in the control message) */
+	uint32_t fds;
+	/* types of arguments ('i', 'u', 's', ...) */
+	char types[WLDBG_SIGNATURE_MAX_ARGS];
+	/* indices of new_id arguments */
+	uint8_t new_ids[WLDBG_SIGNATURE_MAX_ARGS];
+};
+
+/* all arguments have 4 bytes, so they are where the signature says */
+#define WLDBG_SIGNATURE_FIXED_SIZE(sig)	\
+	((sig)->first_varlen == (sig)->args_num)
+
 struct wldbg_resolved_message {
 	struct wldbg_parsed_message base;
 	const struct wl_interface *wl_interface;
 	const struct wl_message *wl_message;
 
+	/* signature of the message, NULL if it is in 'compiled' */
+	const struct wldbg_signature *signature;
+	struct wldbg_signature compiled;
+
+	/* version of the object, 0 if it is not known. The message
+	 * is not valid if it is lower than signature->since */
+	uint32_t version;
+
 	/* position of arguments iterator */
 	struct wldbg_resolved_arg cur_arg;
-	const char *signature_position;
-    uint32_t *data_position;
+	unsigned int arg;
+	uint32_t *data_position;
+};
+
+/*
+ * All arguments of a message decoded at once, so that they can be
+ * accessed in any order without walking the message again. Unlike
+ * with the iterator, sizes of strings and arrays are checked against
+ * the size of the message
+ */
+struct wldbg_message_arg {
+	char type;
+	unsigned int nullable;
+	/* the same as in wldbg_resolved_arg, NULL for fds */
+	uint32_t *data;
+	/* size of the string (with the terminating 0) or the array
+	 * in bytes, 0 for other types */
+	uint32_t length;
+};
+
+/* there is WL_CLOSURE_MAX_ARGS arguments at most in libwayland */
+struct wldbg_message_args {
+	unsigned int num;
+	struct wldbg_message_arg args[WLDBG_SIGNATURE_MAX_ARGS];
 };
 
+/* returns -1 if the signature is not valid */
+int
+wldbg_signature_compile(struct wldbg_signature *sig, const char *signature);
+
+/* compiled signature of the event (from == SERVER) or the request,
+ * NULL if the interface is not registered or has no such message */
+const struct wldbg_signature *
+wldbg_interface_get_signature(const struct wl_interface *intf,
+			      int from, uint32_t opcode);
+
+/* the index of the argument in the message data (without header)
+ * of size words. -1 if the argument is not inside of the data */
+int
+wldbg_signature_arg_offset(const struct wldbg_signature *sig,
+			   const uint32_t *data, uint32_t size,
+			   unsigned int arg);
+
 int wldbg_parse_message(struct wldbg_message *msg, struct wldbg_parsed_message *out);
 
 int wldbg_resolve_message(struct wldbg_message *msg,
@@ -77,6 +158,17 @@ wldbg_resolved_message_next_argument(struct wldbg_resolved_message *msg);
 void
 wldbg_resolved_message_reset_iterator(struct wldbg_resolved_message *msg);
 
+/* decode all arguments of the message. Returns -1 if the message
+ * is shorter than its arguments or a string is not terminated */
+int
+wldbg_resolved_message_get_args(struct wldbg_resolved_message *msg,
+				struct wldbg_message_args *args);
+
+/* the argument or NULL if the message has not so many */
+const struct wldbg_message_arg *
+wldbg_message_args_get(const struct wldbg_message_args *args,
+		       unsigned int i);
+
 char *
 wldbg_resolved_message_get_name(struct wldbg_resolved_message *msg,
 				char *buff, size_t maxlen);
@@ -30,11 +30,55 @@
 
 struct wldbg_message;
 struct wldbg;
+struct wl_interface;
 
 /* flags for passes */
 enum {
 	/* suppress multiple loads of this pass */
 	WLDBG_PASS_LOAD_ONCE	= 1,
+	/* the pass can run for different connections
+	 * in more threads at once (see --workers) */
+	WLDBG_PASS_THREAD_SAFE	= 1 << 1,
+	/* the pass only looks at messages, it does not change them
+	 * and does not use the objects of the connection other than
+	 * by wldbg_message_get_object(). With --observers it runs
+	 * in a background thread on copies of messages */
+	WLDBG_PASS_OBSERVER	= 1 << 2,
+};
+
+/* directions for subscription */
+enum {
+	WLDBG_SUBSCRIBE_SERVER	= 1,
+	WLDBG_SUBSCRIBE_CLIENT	= 1 << 1,
+};
+
+/*
+ * What messages the pass wants to get. Zeroed subscription
+ * means all messages. Wldbg computes from subscriptions of all
+ * passes which passes to call for which message only when something
+ * changes, so the pass is not called at all for other messages.
+ * If the pass changes its subscription after init,
+ * it must call wldbg_passes_changed().
+ */
+struct wldbg_pass_subscription {
+	/* WLDBG_SUBSCRIBE_SERVER and/or WLDBG_SUBSCRIBE_CLIENT,
+	 * 0 means both */
+	unsigned int directions;
+
+	/* NULL-terminated array of names of interfaces,
+	 * NULL means all interfaces */
+	const char **interfaces;
+
+	/* bit n set means the pass wants messages with opcode n,
+	 * 0 means all opcodes */
+	uint64_t opcodes;
+
+	/* optional check for what the rest can not express.
+	 * It is called when computing the tables, not for every message.
+	 * intf is NULL for objects with unknown interface, from is
+	 * SERVER or CLIENT like in wldbg_message */
+	int (*match)(const struct wl_interface *intf,
+		     uint32_t opcode, int from);
 };
 
 struct wldbg_pass {
@@ -57,6 +101,8 @@ struct wldbg_pass {
 
 	/* flags for the pass, i. e. WLDBG_PASS_LOAD_ONCE, etc */
 	uint64_t flags;
+
+	struct wldbg_pass_subscription subscription;
 };
 
 enum {
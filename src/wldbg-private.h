@@ -32,6 +32,7 @@
 
 #include <unistd.h>
 #include <sys/signalfd.h>
+#include <sys/epoll.h>
 #include <sys/un.h>
 #include <stdio.h>
 #include <string.h>
@@ -40,6 +41,8 @@
 #include "wayland/wayland-util.h"
 #include "wldbg-pass.h"
 #include "wldbg-ids-map.h"
+#include "frames.h"
+#include "latency.h"
 
 #ifdef DEBUG
 
@@ -88,16 +91,63 @@ extern const char *debug_domain;
 
 struct wldbg_connection;
 struct resolved_objects;
+struct wldbg_worker;
+struct pass_subscriptions;
+
+/* maximal number of events dispatched in one loop iteration */
+#define WLDBG_MAX_EVENTS	32
+
+/* maximal number of reads from one fd in one loop iteration,
+ * so that one flooding client cannot starve the others.
+ * What is left in the socket is read in the next iteration */
+#define WLDBG_READ_BUDGET	16
+
+struct wldbg_observers;
+struct wldbg_poller;
 
 struct wldbg {
-	int epoll_fd;
+	/* epoll or io_uring, see poller.h */
+	struct wldbg_poller *poller;
 	int signals_fd;
 
+	/* events returned by the last wait */
+	struct {
+		struct epoll_event events[WLDBG_MAX_EVENTS];
+		int num;
+		/* index of the event that is being dispatched */
+		int current;
+	} dispatch;
+
+	struct {
+		unsigned long loop_iterations;
+		unsigned long ready_events;
+		unsigned int max_ready_events;
+		unsigned long reads;
+		/* messages (or buffers with pass_whole_buffer) */
+		unsigned long messages;
+	} statistics;
+
 	struct wldbg_message message;
+	/* complete messages in the last read */
+	struct wldbg_frames frames;
+	/* observer passes running in the background,
+	 * NULL when they run inline */
+	struct wldbg_observers *observers;
+	/* enum wldbg_observers_policy, 0 means no background observers */
+	int observers_policy;
+	/* scratch buffer for messages, max_buffer_size big */
 	char *buffer;
 
+	/* initial size of connection buffers and the size
+	 * up to which they can grow. Powers of two */
+	uint32_t buffer_size;
+	uint32_t max_buffer_size;
+
 	sigset_t handled_signals;
 	struct wl_list passes;
+	/* bumped when passes or their subscriptions change,
+	 * connections then recompute what passes to call */
+	unsigned int passes_serial;
 	struct wl_list monitored_fds;
 
 	unsigned int resolving_objects : 1;
@@ -108,12 +158,20 @@ struct wldbg {
 		unsigned int pass_whole_buffer : 1;
         /* wldbg is running in main loop */
 		unsigned int running           : 1;
-        /* some pass raised error */
-		unsigned int error             : 1;
-        /* some pass asked to exit */
-		unsigned int exit              : 1;
         /* running in server mode */
 		unsigned int server_mode       : 1;
+        /* gather messages from one read and flush them at once */
+		unsigned int batch_forward     : 1;
+        /* measure how long messages spend in wldbg */
+		unsigned int latency           : 1;
+        /* measure how long passes run */
+		unsigned int pass_stats        : 1;
+        /* some pass raised error. This and exit are set from workers
+         * and the signal handler too, so they are not bit-fields and
+         * are accessed atomically (wldbg_error(), wldbg_has_error()) */
+		int error;
+        /* some pass asked to exit */
+		int exit;
 	} flags;
 
 	struct {
@@ -130,30 +188,98 @@ struct wldbg {
 		const char *connect_to;
 	} server_mode;
 
+	/* worker threads that serve connections in server mode,
+	 * see workers.c. If num is 0, everything runs in main loop */
+	struct {
+		struct wldbg_worker *workers;
+		unsigned int num;
+		/* worker that gets the next connection (round-robin) */
+		unsigned int next;
+		unsigned int least_loaded : 1;
+	} workers;
+
 	/* this will be list later */
 	struct wl_list connections;
 	int connections_num;
+	/* id of the last created connection */
+	unsigned int last_connection_id;
+
+	struct {
+		/* size of the ring of every connection, 0 if it is off */
+		size_t size;
+		/* number of written rings, used in names of files */
+		unsigned int dumps;
+		/* rings of closed connections whose clients did not
+		 * exit yet (struct closed_flight_recorder in wldbg.c) */
+		struct wl_list closed;
+	} flight_recorder;
+
+};
+
+/* how expensive the pass is (--pass-stats), CPU time of the thread */
+struct pass_statistics {
+	unsigned long calls;
+	unsigned long stops;
+	uint64_t total_ns;
+	uint64_t max_ns;
 };
 
 struct pass {
 	struct wldbg_pass wldbg_pass;
 	struct wl_list link;
 	char *name;
+
+	/* indexed by SERVER and CLIENT. Passes can run in more threads
+	 * (workers, observers), so they are updated atomically */
+	struct pass_statistics statistics[2];
+};
+
+/*
+ * Backpressure between the peers. When a peer does not read fast
+ * enough, the data for it wait in the output buffer and we wait for
+ * EPOLLOUT on its fd. When more than high-water mark bytes wait,
+ * we stop reading from the other peer until it drops under
+ * low-water mark.
+ */
+#define WLDBG_HIGH_WATER(wldbg)	((wldbg)->max_buffer_size / 2)
+#define WLDBG_LOW_WATER(wldbg)	((wldbg)->max_buffer_size / 8)
+
+/* fds wait in their own buffer that can take two times
+ * max_buffer_size bytes of them, like the output buffer */
+#define WLDBG_FDS_HIGH_WATER(wldbg) \
+	((wldbg)->max_buffer_size / sizeof(int32_t) / 2)
+#define WLDBG_FDS_LOW_WATER(wldbg) \
+	((wldbg)->max_buffer_size / sizeof(int32_t) / 8)
+
+struct wldbg_flow {
+	/* callback of the fd, so that we can change the events */
+	struct wldbg_fd_callback *cb;
+	/* data for this peer wait for EPOLLOUT */
+	unsigned int writing : 1;
+	/* we do not read from this peer, because the other
+	 * peer does not keep up */
+	unsigned int paused  : 1;
+	unsigned long pauses;
 };
 
 struct wldbg_connection {
 	struct wldbg *wldbg;
+	/* number of the connection, it identifies
+	 * the connection in captures */
+	unsigned int id;
 
 	struct {
 		int fd;
 		/* TODO get rid of connection??? */
 		struct wl_connection *connection;
 		pid_t pid;
+		struct wldbg_flow flow;
 	} server;
 
 	struct {
 		int fd;
 		struct wl_connection *connection;
+		struct wldbg_flow flow;
 
 		char *program;
 		/* path to the binary */
@@ -167,6 +293,21 @@ struct wldbg_connection {
 
 	struct resolved_objects *resolved_objects;
 	struct wldbg_objects_info *objects_info;
+	/* messages that went through passes, see wldbg_message.index */
+	uint64_t messages;
+
+	/* what passes to call for what messages,
+	 * created on the first message. See subscriptions.c */
+	struct pass_subscriptions *subscriptions;
+
+	/* worker thread that serves this connection,
+	 * NULL if it is served by the main loop */
+	struct wldbg_worker *worker;
+
+	/* how long messages spend in wldbg, NULL without --latency */
+	struct wldbg_latency *latency;
+	/* the last messages, NULL without --flight-recorder */
+	struct wldbg_flight_recorder *flight_recorder;
 	struct wl_list link;
 };
 
@@ -186,12 +327,6 @@ struct resolved_objects_ids {
 
 struct resolved_objects {
 	struct resolved_objects_ids objects;
-
-	/* these are shared between connections */
-	struct wl_list *interfaces;
-
-	/* these are specific for connection */
-	struct wl_list additional_interfaces;
 };
 
 struct wldbg_objects_info {
@@ -201,4 +336,18 @@ struct wldbg_objects_info {
 	struct wldbg_ids_map server_objects;
 };
 
+/* set by wldbg_exit() */
+static inline int
+wldbg_should_exit(struct wldbg *wldbg)
+{
+	return __atomic_load_n(&wldbg->flags.exit, __ATOMIC_RELAXED);
+}
+
+/* set by wldbg_error() */
+static inline int
+wldbg_has_error(struct wldbg *wldbg)
+{
+	return __atomic_load_n(&wldbg->flags.error, __ATOMIC_RELAXED);
+}
+
 #endif /* _WLDBG_PRIVATE_H_ */
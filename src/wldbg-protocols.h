@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2015 Marek Chalupa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _WLDBG_PROTOCOLS_H_
+#define _WLDBG_PROTOCOLS_H_
+
+#include <stdint.h>
+
+struct wl_interface;
+
+/*
+ * Interfaces from Wayland protocol XML files (like the ones in
+ * /usr/share/wayland-protocols). The files are parsed into the same
+ * wl_interface tables that wayland-scanner generates and added to the
+ * interfaces that wldbg knows, so clients can be decoded even when
+ * wldbg was not built with their protocols.
+ *
+ * When wldbg already knows an interface with the same name, the one
+ * from the XML is not used for decoding, but its enums are kept.
+ * That way the enums of interfaces from libwayland are known too.
+ *
+ * Parsed files are cached in $XDG_CACHE_HOME/wldbg (~/.cache/wldbg),
+ * the cache is written again when some of the files change.
+ */
+
+struct wldbg_enum_entry {
+	const char *name;
+	uint32_t value;
+};
+
+struct wldbg_enum {
+	const char *name;
+	int bitfield;
+	unsigned int entries_num;
+	const struct wldbg_enum_entry *entries;
+};
+
+/* load a protocol XML file or all .xml files under a directory.
+ * Returns the number of added interfaces or -1 on error */
+int
+wldbg_protocols_load(const char *path);
+
+/* the same for a list of paths separated by ':'.
+ * Paths that do not exist are skipped */
+int
+wldbg_protocols_load_path(const char *paths);
+
+/* interfaces that wayland-scanner generated into the program (found
+ * in PATH if it has no '/') and into the libraries it needs. Only ELF
+ * objects of the architecture of wldbg are read, other programs are
+ * skipped. Returns the number of added interfaces or -1 on error */
+int
+wldbg_protocols_load_binary(const char *program);
+
+/* directory for the cache instead of the default one. The string
+ * is not copied, it must be valid while loading protocols.
+ * NULL sets the default back */
+void
+wldbg_protocols_set_cache_dir(const char *dir);
+
+/* free all loaded protocols. The interfaces must not be
+ * in use anymore, so it is called after clearing them */
+void
+wldbg_protocols_release(void);
+
+const struct wldbg_enum *
+wldbg_interface_get_enum(const struct wl_interface *intf, const char *name);
+
+/* enum of the argument of an event (from == SERVER) or a request.
+ * Arguments are numbered like in wldbg_resolved_message */
+const struct wldbg_enum *
+wldbg_message_get_arg_enum(const struct wl_interface *intf, int from,
+			   uint32_t opcode, unsigned int arg);
+
+/* name of the entry with the value or NULL */
+const char *
+wldbg_enum_get_name(const struct wldbg_enum *e, uint32_t value);
+
+#endif /* _WLDBG_PROTOCOLS_H_ */
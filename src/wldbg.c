@@ -45,6 +45,7 @@
 #include "wldbg-pass.h"
 #include "wldbg-private.h"
 #include "resolve.h"
+#include "passes.h"
 #include "objinfo/objinfo.h"
 #include "sockets.h"
 #include "getopt.h"
@@ -52,6 +53,18 @@
 #include "wayland/wayland-util.h"
 #include "wayland/wayland-os.h"
 #include "util.h"
+#include "workers.h"
+#include "observers.h"
+#include "poller.h"
+#include "replay.h"
+#include "flight-recorder.h"
+#include "wldbg-capture.h"
+#include "wldbg-protocols.h"
+#include "interfaces.h"
+
+#ifndef PROTOCOLS_PATH
+#error "Need defined PROTOCOLS_PATH (was made in Makefile.am)"
+#endif
 
 #ifdef DEBUG
 void
@@ -67,15 +80,10 @@ int
 load_passes(struct wldbg *wldbg, struct wldbg_options *opts,
 	    int argc, const char *argv[]);
 
-static int
-dispatch_messages(int fd, void *data);
-
-static struct wldbg_connection *
-wldbg_connection_create(struct wldbg *wldbg)
+/* connection without sockets, it is enough for replaying captures */
+struct wldbg_connection *
+wldbg_connection_alloc(struct wldbg *wldbg)
 {
-	const char *sock_name = NULL;
-	int fd;
-
 	struct wldbg_connection *conn = calloc(1, sizeof *conn);
 	if (!conn)
 		return NULL;
@@ -98,6 +106,20 @@ wldbg_connection_create(struct wldbg *wldbg)
 	}
 
 	conn->wldbg = wldbg;
+	conn->id = ++wldbg->last_connection_id;
+
+	return conn;
+}
+
+static struct wldbg_connection *
+wldbg_connection_create(struct wldbg *wldbg)
+{
+	const char *sock_name = NULL;
+	int fd;
+
+	struct wldbg_connection *conn = wldbg_connection_alloc(wldbg);
+	if (!conn)
+		return NULL;
 
 	if (wldbg->flags.server_mode) {
 		/* this one has precedence - so that we can connect
@@ -109,36 +131,75 @@ wldbg_connection_create(struct wldbg *wldbg)
 			sock_name = wldbg->server_mode.wldbg_socket_name;
 	}
 
+	/* the fds of the connection are monitored
+	 * when it is added, see wldbg_add_connection() */
 	fd = connect_to_wayland_server(conn, sock_name);
 	if (fd < 0) {
-		destroy_resolved_objects(conn->resolved_objects);
-		destroy_objects_info(conn->objects_info);
-		free(conn);
+		wldbg_connection_destroy(conn);
 		return NULL;
 	}
 
-	if (wldbg_monitor_fd(wldbg, conn->server.fd,
-			     dispatch_messages, conn) == NULL) {
-		destroy_resolved_objects(conn->resolved_objects);
-		destroy_objects_info(conn->objects_info);
-		free(conn);
-		close(fd);
-		return NULL;
+	if (wldbg->flags.latency) {
+		conn->latency = calloc(1, sizeof *conn->latency);
+		if (!conn->latency) {
+			wldbg_connection_destroy(conn);
+			return NULL;
+		}
+	}
+
+	if (wldbg->flight_recorder.size > 0) {
+		conn->flight_recorder
+			= wldbg_flight_recorder_create(wldbg->flight_recorder.size);
+		if (!conn->flight_recorder) {
+			wldbg_connection_destroy(conn);
+			return NULL;
+		}
 	}
 
 	return conn;
 }
 
-static void
+/* observers of the thread that serves the connection */
+static struct wldbg_observers *
+connection_observers(struct wldbg_connection *conn)
+{
+	if (conn->worker)
+		return conn->worker->observers;
+
+	return conn->wldbg->observers;
+}
+
+void
 wldbg_connection_destroy(struct wldbg_connection *conn)
 {
+	struct wldbg_observers *observers = connection_observers(conn);
+
+	/* copies of messages in the ring point to the connection */
+	if (observers)
+		wldbg_observers_sync(observers);
+
+	if (conn->latency) {
+		printf("Latency of connection to '%s' (%d):\n",
+		       conn->client.program ? conn->client.program : "?",
+		       conn->client.pid);
+		wldbg_latency_print(conn->latency);
+		free(conn->latency);
+	}
+
+	if (conn->flight_recorder)
+		wldbg_flight_recorder_destroy(conn->flight_recorder);
+
 	if (conn->resolved_objects)
 		destroy_resolved_objects(conn->resolved_objects);
 	if (conn->objects_info)
 		destroy_objects_info(conn->objects_info);
+	pass_subscriptions_destroy(conn->subscriptions);
 
-	wl_connection_destroy(conn->server.connection);
-	wl_connection_destroy(conn->client.connection);
+	/* replayed connections have no sockets */
+	if (conn->server.connection)
+		wl_connection_destroy(conn->server.connection);
+	if (conn->client.connection)
+		wl_connection_destroy(conn->client.connection);
 
 	/* XXX new version of wl_connection_destroy does not close
 	 * filedescriptors, so if we will update, uncomment this
@@ -153,16 +214,54 @@ wldbg_connection_destroy(struct wldbg_connection *conn)
 	free(conn);
 }
 
+/* with io_uring the ring receives and sends the data of the sockets,
+ * with epoll the connection uses recvmsg and sendmsg itself */
+void
+wldbg_connection_use_poller_io(struct wldbg_connection *conn,
+			       struct wldbg_poller *poller)
+{
+	struct wl_connection_io *io;
+
+	io = wldbg_poller_get_io(poller, conn->server.fd);
+	if (io)
+		wl_connection_set_io(conn->server.connection, io);
+
+	io = wldbg_poller_get_io(poller, conn->client.fd);
+	if (io)
+		wl_connection_set_io(conn->client.connection, io);
+}
+
 /**
- * Register new connection in wldbg
+ * Register new connection in wldbg and start dispatching its messages.
+ * In server mode with workers the connection is handed over
+ * to a worker thread.
  */
 static int
 wldbg_add_connection(struct wldbg_connection *conn)
 {
 	struct wldbg *wldbg = conn->wldbg;
+	struct wldbg_fd_callback *cb;
 
 	assert(wldbg->connections_num >= 0);
 
+	if (wldbg->workers.num > 0)
+		return wldbg_workers_add_connection(wldbg, conn);
+
+	cb = wldbg_monitor_fd(wldbg, conn->server.fd,
+			      wldbg_dispatch_messages, conn);
+	if (!cb)
+		return -1;
+
+	conn->server.flow.cb = cb;
+	conn->client.flow.cb = wldbg_monitor_fd(wldbg, conn->client.fd,
+						wldbg_dispatch_messages, conn);
+	if (!conn->client.flow.cb) {
+		wldbg_remove_callback(wldbg, cb);
+		return -1;
+	}
+
+	wldbg_connection_use_poller_io(conn, wldbg->poller);
+
 	wl_list_insert(&wldbg->connections, &conn->link);
 	++wldbg->connections_num;
 
@@ -202,54 +301,103 @@ wldbg_foreach_connection(struct wldbg *wldbg,
 		func(conn);
 }
 
+/* ring of a connection that the client closed */
+struct closed_flight_recorder {
+	struct wldbg_flight_recorder *recorder;
+	unsigned int conn_id;
+	pid_t pid;
+	struct wl_list link;
+};
+
+static void
+closed_flight_recorder_destroy(struct closed_flight_recorder *closed)
+{
+	wl_list_remove(&closed->link);
+	wldbg_flight_recorder_destroy(closed->recorder);
+	free(closed);
+}
+
+/* the client closed the connection. If it crashed, we want its last
+ * messages, but SIGCHLD comes when the connection is gone, so keep
+ * the ring until the client exits, see client_exited() */
+static void
+keep_flight_recorder(struct wldbg_connection *conn)
+{
+	struct wldbg *wldbg = conn->wldbg;
+	struct closed_flight_recorder *closed;
+	siginfo_t info;
+
+	/* reaped already, client_exited() saw the connection */
+	memset(&info, 0, sizeof info);
+	if (waitid(P_PID, conn->client.pid, &info,
+		   WEXITED | WNOHANG | WNOWAIT) < 0)
+		return;
+
+	closed = malloc(sizeof *closed);
+	if (!closed)
+		return;
+
+	closed->recorder = conn->flight_recorder;
+	closed->conn_id = conn->id;
+	closed->pid = conn->client.pid;
+	wl_list_insert(&wldbg->flight_recorder.closed, &closed->link);
+
+	conn->flight_recorder = NULL;
+}
+
 static int
-remove_connection(struct wldbg_connection *conn, struct wldbg_fd_callback *cb)
+remove_connection(struct wldbg_connection *conn)
 {
 	struct wldbg *wldbg = conn->wldbg;
+	struct wldbg_fd_callback *cb, *tmp;
+
+	/* we know the exit of only the client that we spawned */
+	if (conn->flight_recorder && !wldbg->flags.server_mode)
+		keep_flight_recorder(conn);
 
 	wldbg_remove_connection(conn);
-	if (wldbg_remove_callback(wldbg, cb) != 0)
-		return 0;
+
+	/* stop monitoring both client's and server's fd */
+	wl_list_for_each_safe(cb, tmp, &wldbg->monitored_fds, link) {
+		if (cb->data != conn)
+			continue;
+
+		if (wldbg_remove_callback(wldbg, cb) != 0)
+			return 0;
+	}
 
 	wldbg_connection_destroy(conn);
 
+	/* wait for the exit of the client that closed the connection */
+	if (wldbg->connections_num == 0
+	    && !wl_list_empty(&wldbg->flight_recorder.closed))
+		return 1;
+
 	/* if connections_num is 0, that we're done */
 	return wldbg->connections_num;
 }
 
 static int
-wldbg_dispatch(struct wldbg *wldbg)
+dispatch_event(struct wldbg *wldbg, struct epoll_event *ev)
 {
-	struct epoll_event ev;
 	struct wldbg_fd_callback *cb;
 	struct wldbg_connection *conn;
-	int n, ret;
-
-	assert(!wldbg->flags.exit);
-	assert(!wldbg->flags.error);
-
-	n = epoll_wait(wldbg->epoll_fd, &ev, 1, -1);
+	int ret;
 
-	if (n < 0) {
-		/* don't print error when we has been interrupted
-		 * by user */
-		if (errno == EINTR && wldbg->flags.exit)
-			return 0;
-
-		perror("epoll_wait");
-		return -1;
-	}
+	cb = ev->data.ptr;
+	/* the callback was removed while dispatching
+	 * previous events from this batch */
+	if (!cb)
+		return 1;
 
-	cb = ev.data.ptr;
-	assert(cb && "No callback set in event");
 	conn = cb->data;
 
-	if (ev.events & EPOLLHUP) {
+	if (ev->events & EPOLLHUP) {
 		/* if connections_num is 0, that we're done */
-		return remove_connection(conn, cb);
+		return remove_connection(conn);
 	}
 
-	if (ev.events & EPOLLERR) {
+	if (ev->events & EPOLLERR) {
 		fprintf(stderr, "epoll event error\n");
 		return -1;
 	}
@@ -260,150 +408,576 @@ wldbg_dispatch(struct wldbg *wldbg)
 	ret = cb->dispatch(cb->fd, cb->data);
 	if (ret <= 0) {
 		/* on error, remove connection */
-		return remove_connection(conn, cb);
+		return remove_connection(conn);
 	}
 
 	return ret;
 }
 
-static void
+static int
+wldbg_dispatch(struct wldbg *wldbg)
+{
+	int i, n, ret = 1;
+
+	assert(!wldbg_should_exit(wldbg));
+	assert(!wldbg_has_error(wldbg));
+
+	n = wldbg_poller_wait(wldbg->poller, wldbg->dispatch.events,
+			      WLDBG_MAX_EVENTS);
+
+	if (n < 0) {
+		/* don't print error when we has been interrupted
+		 * by user */
+		if (errno == EINTR && wldbg_should_exit(wldbg))
+			return 0;
+
+		perror("Waiting for events");
+		return -1;
+	}
+
+	++wldbg->statistics.loop_iterations;
+	wldbg->statistics.ready_events += n;
+	if ((unsigned int) n > wldbg->statistics.max_ready_events)
+		wldbg->statistics.max_ready_events = n;
+
+	wldbg->dispatch.num = n;
+	for (i = 0; i < n; ++i) {
+		wldbg->dispatch.current = i;
+
+		ret = dispatch_event(wldbg, &wldbg->dispatch.events[i]);
+		if (ret <= 0)
+			break;
+
+		if (wldbg_should_exit(wldbg) || wldbg_has_error(wldbg))
+			break;
+	}
+
+	wldbg->dispatch.num = 0;
+	wldbg->dispatch.current = 0;
+
+	return ret;
+}
+
+void
 run_passes(struct wldbg_message *message)
 {
 	struct pass *pass;
 	struct wldbg *wldbg = message->connection->wldbg;
+	struct wldbg_observers *observers;
+	uint64_t mask, observe = 0;
+	unsigned int n = 0;
+	int observed = 0;
 
 	assert(wldbg && "BUG: No wldbg set in message->connection");
 
+	message->index = ++message->connection->messages;
+
+	/* which passes want this message */
+	mask = pass_subscriptions_get_mask(message);
+	observers = connection_observers(message->connection);
+
 	wl_list_for_each(pass, &wldbg->passes, link) {
-		if (message->from == SERVER) {
-			if (pass->wldbg_pass.server_pass(
-				pass->wldbg_pass.user_data,
-				message) == PASS_STOP)
-				break;
-		} else {
-			if (pass->wldbg_pass.client_pass(
-				pass->wldbg_pass.user_data,
-				message) == PASS_STOP)
-				break;
+		/* passes from 64th on are not in the mask */
+		if (n < 64 && !(mask & ((uint64_t) 1 << n))) {
+			++n;
+			continue;
 		}
+
+		/* runs later in the observer thread */
+		if (observers
+		    && (pass->wldbg_pass.flags & WLDBG_PASS_OBSERVER)) {
+			if (n < 64)
+				observe |= (uint64_t) 1 << n;
+			observed = 1;
+			++n;
+			continue;
+		}
+
+		++n;
+
+		if (pass_call(wldbg, pass, message) == PASS_STOP)
+			break;
 	}
+
+	/* observers see the message as it is forwarded */
+	if (observed && !wldbg_has_error(wldbg))
+		wldbg_observers_push(observers, message, observe);
+}
+
+/* buffer of the thread that serves the connection */
+static char *
+connection_buffer(struct wldbg_connection *conn)
+{
+	if (conn->worker)
+		return conn->worker->buffer;
+
+	return conn->wldbg->buffer;
 }
 
+void *
+wldbg_message_make_writable(struct wldbg_message *message)
+{
+	char *buffer = connection_buffer(message->connection);
+
+	if (message->writable)
+		return message->data;
+
+	/* the message is in the buffer already if it was wrapped
+	 * around the end of the input ring */
+	if (message->data != buffer)
+		memcpy(buffer, message->data, message->size);
+
+	message->data = buffer;
+	message->writable = 1;
+
+	return message->data;
+}
+
+/* did some pass change the message? */
+static int
+message_changed(struct wldbg_message *message, void *data, size_t size)
+{
+	return message->writable
+		|| message->data != data
+		|| message->size != size;
+}
+
+static struct wldbg_flow *
+connection_flow(struct wldbg_connection *conn, struct wl_connection *wl_conn)
+{
+	if (wl_conn == conn->server.connection)
+		return &conn->server.flow;
+
+	return &conn->client.flow;
+}
+
+/* tell the poller whether we want to read from the peer
+ * and whether we wait until we can write to it */
 static int
-process_one_by_one(struct wl_connection *write_conn,
-		   struct wldbg_message *message)
+flow_update_events(struct wldbg_connection *conn, struct wldbg_flow *flow)
 {
-	int n = 0;
-	size_t rest = message->size;
+	struct wldbg_poller *poller;
+	uint32_t events;
+
+	if (conn->worker)
+		poller = conn->worker->poller;
+	else
+		poller = conn->wldbg->poller;
+
+	events = (flow->paused ? 0 : EPOLLIN)
+		 | (flow->writing ? EPOLLOUT : 0);
+
+	if (wldbg_poller_modify(poller, flow->cb->fd,
+				events, flow->cb) == -1) {
+		perror("Failed changing polled events");
+		return -1;
+	}
+
+	return 0;
+}
+
+/* send the data queued for the peer. If the peer does not read
+ * fast enough, keep the rest queued and send it on EPOLLOUT.
+ * When too much data is queued, stop reading from the other peer */
+static int
+flush_output(struct wldbg_connection *conn,
+	     struct wl_connection *read_conn,
+	     struct wl_connection *write_conn)
+{
+	struct wldbg_flow *out = connection_flow(conn, write_conn);
+	struct wldbg_flow *in = connection_flow(conn, read_conn);
+
+	/* we are waiting for EPOLLOUT already, do not try in vain */
+	if (!out->writing && wl_connection_flush(write_conn) < 0) {
+		if (errno != EAGAIN) {
+			perror("wl_connection_flush");
+			return -1;
+		}
+
+		out->writing = 1;
+		if (flow_update_events(conn, out) < 0)
+			return -1;
+	}
+
+	if (out->writing && !in->paused
+	    && (wl_connection_pending_output(write_conn)
+		> WLDBG_HIGH_WATER(conn->wldbg)
+		|| wl_connection_pending_fds(write_conn)
+		> WLDBG_FDS_HIGH_WATER(conn->wldbg))) {
+		vdbg("Connection [%p]: pausing reading from %s\n", conn,
+		     in == &conn->server.flow ? "server" : "client");
+
+		in->paused = 1;
+		++in->pauses;
+		if (flow_update_events(conn, in) < 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+/* the peer can take more data */
+static int
+dispatch_output(struct wldbg_connection *conn, struct wl_connection *wl_conn)
+{
+	struct wldbg_flow *out = connection_flow(conn, wl_conn);
+	struct wldbg_flow *in;
+	uint32_t pending, pending_fds;
+
+	if (wl_connection_flush(wl_conn) < 0 && errno != EAGAIN) {
+		perror("wl_connection_flush");
+		return -1;
+	}
+
+	pending = wl_connection_pending_output(wl_conn);
+	pending_fds = wl_connection_pending_fds(wl_conn);
+	if (pending == 0) {
+		out->writing = 0;
+		if (flow_update_events(conn, out) < 0)
+			return -1;
+	}
+
+	/* the other peer sends the data for this one */
+	if (out == &conn->server.flow)
+		in = &conn->client.flow;
+	else
+		in = &conn->server.flow;
+
+	if (in->paused && pending < WLDBG_LOW_WATER(conn->wldbg)
+	    && pending_fds < WLDBG_FDS_LOW_WATER(conn->wldbg)) {
+		vdbg("Connection [%p]: resuming reading from %s\n", conn,
+		     in == &conn->server.flow ? "server" : "client");
+
+		in->paused = 0;
+		if (flow_update_events(conn, in) < 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+/* events of the event that is being dispatched */
+static uint32_t
+current_events(struct wldbg_connection *conn)
+{
+	if (conn->worker)
+		return conn->worker->dispatch.events[
+			conn->worker->dispatch.current].events;
+
+	if (conn->wldbg->dispatch.num == 0)
+		return EPOLLIN;
+
+	return conn->wldbg->dispatch.events[
+		conn->wldbg->dispatch.current].events;
+}
+
+/* forward messages that were not changed by passes right from
+ * the input buffer. Their bytes start at *offset in the input buffer */
+static int
+forward_pending(struct wl_connection *read_conn,
+		struct wl_connection *write_conn,
+		size_t *offset, size_t *pending)
+{
+	if (*pending == 0)
+		return 0;
+
+	if (wl_connection_forward(read_conn, *offset,
+				  *pending, write_conn) < 0) {
+		perror("wl_connection_forward");
+		return -1;
+	}
+
+	*offset += *pending;
+	*pending = 0;
+
+	return 0;
+}
+
+/* n messages read at read_time were just written to the other side */
+static void
+record_latency(struct wldbg_message *message, uint64_t read_time,
+	       unsigned int n)
+{
+	struct wldbg_latency *latency = message->connection->latency;
+
+	if (!latency || n == 0)
+		return;
+
+	wldbg_histogram_add(&latency->proxy[message->from],
+			    wldbg_time_ns() - read_time, n);
+}
+
+static struct wldbg_frames *
+connection_frames(struct wldbg_connection *conn)
+{
+	if (conn->worker)
+		return &conn->worker->frames;
+
+	return &conn->wldbg->frames;
+}
+
+static int
+process_one_by_one(struct wl_connection *read_conn,
+		   struct wl_connection *write_conn,
+		   struct wldbg_message *message,
+		   struct wldbg_frames *frames, uint64_t read_time)
+{
+	unsigned int n;
+	size_t size;
+	/* unchanged messages that were not forwarded yet */
+	size_t pending = 0, pending_offset = 0;
+	void *data;
+	struct wldbg_frame *frame;
 	struct wldbg *wldbg = message->connection->wldbg;
 
-	while (rest > 0) {
-		message->size = ((uint32_t *) message->data)[1] >> 16;
+	for (n = 0; n < frames->num; ++n) {
+		frame = wldbg_frames_get(frames, n);
+		size = frame->size;
+
+		/* passes see the message right in the input buffer,
+		 * they get a copy only when they want to change it */
+		data = wl_connection_peek(read_conn, frame->offset, size,
+					  connection_buffer(message->connection));
+		message->data = data;
+		message->size = size;
+		message->writable = 0;
 
 		run_passes(message);
 
 		/* in interactive mode we can quit here. Do not
-		 * write into connection if we quit */
-		if (wldbg->flags.exit)
-			return 0;
-		if (wldbg->flags.error)
+		 * write into connection if we quit, but send what
+		 * we have already queued in batch mode */
+		if (wldbg_should_exit(wldbg)) {
+			if (wldbg->flags.batch_forward
+			    && forward_pending(read_conn, write_conn,
+					       &pending_offset, &pending) == 0)
+				wl_connection_flush(write_conn);
+			return n;
+		}
+		if (wldbg_has_error(wldbg))
 			return -1;
 
-		if (wl_connection_write(write_conn, message->data,
-					message->size) < 0) {
-			perror("wl_connection_write");
-			return -1;
+		if (message_changed(message, data, size)) {
+			/* keep the order - send the unchanged messages
+			 * first and then the changed copy */
+			if (forward_pending(read_conn, write_conn,
+					    &pending_offset, &pending) < 0)
+				return -1;
+
+			if (wl_connection_write(write_conn, message->data,
+						message->size) < 0) {
+				perror("wl_connection_write");
+				return -1;
+			}
+
+			/* skip the original message */
+			pending_offset += size;
+		} else {
+			pending += size;
 		}
 
-		if (wl_connection_flush(write_conn) < 0) {
-			perror("wl_connection_flush");
+		/* in batch mode the messages are gathered and
+		 * sent all at once below */
+		if (wldbg->flags.batch_forward)
+			continue;
+
+		if (forward_pending(read_conn, write_conn,
+				    &pending_offset, &pending) < 0)
 			return -1;
-		}
 
-		message->data = message->data + message->size;
-		rest -= message->size;
-		++n;
+		if (flush_output(message->connection,
+				 read_conn, write_conn) < 0)
+			return -1;
+
+		record_latency(message, read_time, 1);
 	}
 
-	assert(rest == 0 && "Bug!");
+	assert(pending_offset + pending == frames->length && "Bug!");
+
+	/* the fds were queued in process_data() before the first
+	 * message, so they go out with the first bytes of this batch
+	 * just like they came in with the first bytes of the read */
+	if (wldbg->flags.batch_forward) {
+		if (forward_pending(read_conn, write_conn,
+				    &pending_offset, &pending) < 0)
+			return -1;
+
+		if (flush_output(message->connection,
+				 read_conn, write_conn) < 0)
+			return -1;
+
+		record_latency(message, read_time, n);
+	}
 
 	return n;
 }
 
+static int
+process_whole_buffer(struct wl_connection *read_conn,
+		     struct wl_connection *write_conn,
+		     struct wldbg_message *message,
+		     struct wldbg_frames *frames, uint64_t read_time)
+{
+	struct wldbg *wldbg = message->connection->wldbg;
+	size_t len = frames->length;
+	void *data;
+
+	data = wl_connection_peek(read_conn, 0, len,
+				  connection_buffer(message->connection));
+	message->data = data;
+	message->size = len;
+
+	/* let passes find the messages without parsing the buffer */
+	message->frames = wldbg_frames_get(frames, 0);
+	message->frames_num = frames->num;
+
+	/* process passes */
+	run_passes(message);
+
+	/* if some pass wants exit or an error occured,
+	 * do not write into the connection */
+	if (wldbg_should_exit(wldbg))
+		return 0;
+	if (wldbg_has_error(wldbg))
+		return -1;
+
+	/* resend the data. If some pass changed them, use message->data,
+	 * because the pass could have reallocated the data */
+	if (message_changed(message, data, len)) {
+		if (wl_connection_write(write_conn,
+					message->data, message->size) < 0) {
+			perror("wl_connection_write");
+			return -1;
+		}
+	} else if (wl_connection_forward(read_conn, 0, len, write_conn) < 0) {
+		perror("wl_connection_forward");
+		return -1;
+	}
+
+	if (flush_output(message->connection, read_conn, write_conn) < 0)
+		return -1;
+
+	record_latency(message, read_time, frames->num);
+
+	return 1;
+}
+
+/* copy the messages into the ring of the connection,
+ * right from the input buffer when they are contiguous there */
+static void
+record_flight(struct wldbg_connection *conn, struct wl_connection *wl_conn,
+	      struct wldbg_message *message, struct wldbg_frames *frames)
+{
+	struct wldbg_flight_recorder *recorder = conn->flight_recorder;
+	uint64_t time = wldbg_capture_time();
+	struct wldbg_frame *frame;
+	uint32_t *data, *p;
+	unsigned int n;
+	int display_error = 0;
+
+	for (n = 0; n < frames->num; ++n) {
+		frame = wldbg_frames_get(frames, n);
+		data = wldbg_flight_recorder_reserve(recorder, frame->size);
+		if (!data)
+			continue;
+
+		p = wl_connection_peek(wl_conn, frame->offset,
+				       frame->size, data);
+		if (p != data)
+			memcpy(data, p, frame->size);
+
+		wldbg_flight_recorder_commit(recorder, message, time);
+
+		/* wl_display is always object 1, error is event 0 */
+		if (message->from == SERVER
+		    && data[0] == 1 && (data[1] & 0xffff) == 0)
+			display_error = 1;
+	}
+
+	if (display_error)
+		wldbg_flight_recorder_trigger(conn, "wl_display.error");
+}
+
+/* process complete messages from the first len bytes of the input
+ * buffer. Returns the number of processed messages (buffers with
+ * pass_whole_buffer) or -1 on error. A partial message at the end
+ * stays in the buffer and is processed after the next read */
 static int
 process_data(struct wldbg_connection *conn,
-	     struct wl_connection *wl_connection, int len)
+	     struct wl_connection *wl_connection, int len,
+	     uint64_t read_time)
 {
 	int ret = 0;
 	struct wl_connection *write_wl_conn;
 	struct wldbg *wldbg = conn->wldbg;
-	struct wldbg_message *message = &wldbg->message;
-	char *buffer = wldbg->buffer;
+	struct wldbg_message *message;
+	struct wldbg_frames *frames = connection_frames(conn);
+
+	/* every worker thread has its own message */
+	if (conn->worker)
+		message = &conn->worker->message;
+	else
+		message = &wldbg->message;
 
 	if (len == 0) {
 		fprintf(stderr, "ERROR: Message with length 0\n");
 		return -1;
 	}
 
-	/* reset the message */
-	memset(message, 0, sizeof *message);
-
-	wl_connection_copy(wl_connection, buffer, len);
-	wl_connection_consume(wl_connection, len);
+	if (wldbg_frames_scan(frames, wl_connection, len,
+			      wldbg->max_buffer_size) < 0)
+		return -1;
 
-	if (wl_connection == conn->server.connection) {
+	if (wl_connection == conn->server.connection)
 		write_wl_conn = conn->client.connection;
-		message->from = SERVER;
-	} else {
+	else
 		write_wl_conn = conn->server.connection;
-		message->from = CLIENT;
-	}
-
-	wl_connection_copy_fds(wl_connection, write_wl_conn);
 
-	message->data = buffer;
-	message->size = len;
-	message->connection = conn;
+	/* fds come with the first bytes of a message, so we
+	 * may have them even when the message is not complete yet.
+	 * They are sent with the first bytes we write. Reading is
+	 * paused long before the peer's fds buffer is full, so
+	 * failing here means that the fds would be lost */
+	if (wl_connection_copy_fds(wl_connection, write_wl_conn) < 0) {
+		perror("Failed passing fds");
+		return -1;
+	}
 
-	if (!wldbg->flags.pass_whole_buffer) {
-		ret = process_one_by_one(write_wl_conn, message);
-	} else {
-		/* process passes */
-		run_passes(message);
+	if (frames->num == 0)
+		return 0;
 
-		/* if some pass wants exit or an error occured,
-		 * do not write into the connection */
-		if (wldbg->flags.exit)
-			return 0;
-		if (wldbg->flags.error)
-			return -1;
+	/* reset the message */
+	memset(message, 0, sizeof *message);
 
-		/* resend the data. Use message->data, not buffer,
-		 * because some pass could have reallocated the data */
-		if (wl_connection_write(write_wl_conn,
-					message->data, message->size) < 0) {
-			perror("wl_connection_write");
-			return -1;
-		}
+	message->from = wl_connection == conn->server.connection
+			? SERVER : CLIENT;
+	message->connection = conn;
 
-		if (wl_connection_flush(write_wl_conn) < 0) {
-			perror("wl_connection_flush");
-			return -1;
-		}
+	if (conn->flight_recorder)
+		record_flight(conn, wl_connection, message, frames);
 
-		ret = 1;
-	}
+	/* the data stay in the input buffer while passes
+	 * are running and are consumed after they were forwarded */
+	if (!wldbg->flags.pass_whole_buffer)
+		ret = process_one_by_one(wl_connection, write_wl_conn,
+					 message, frames, read_time);
+	else
+		ret = process_whole_buffer(wl_connection, write_wl_conn,
+					   message, frames, read_time);
 
-	/* What if some pass reallocated the buffer? */
+	wl_connection_consume(wl_connection, frames->length);
 
 	return ret;
 }
 
-static int
-dispatch_messages(int fd, void *data)
+int
+wldbg_dispatch_messages(int fd, void *data)
 {
-	int len;
+	int len, n, ret;
+	uint32_t events;
+	uint64_t read_time = 0;
 	struct wldbg_connection *conn = data;
+	struct wldbg *wldbg = conn->wldbg;
 	struct wl_connection *wl_conn;
 
 	if (fd == conn->client.fd)
@@ -411,17 +985,60 @@ dispatch_messages(int fd, void *data)
 	else
 		wl_conn = conn->server.connection;
 
+	events = current_events(conn);
+
+	/* the peer can take the data we have queued for it */
+	if (events & EPOLLOUT) {
+		if (dispatch_output(conn, wl_conn) < 0)
+			return -1;
+	}
+
+	/* hangup or error is discovered by the read */
+	if (!(events & (EPOLLIN | EPOLLHUP | EPOLLERR)))
+		return 1;
+
 	vdbg("Reading connection [%p] from %s\n", conn,
 		fd == conn->client.fd ? "client" : "server");
 
-	len = wl_connection_read(wl_conn);
-	if (len < 0 && errno != EAGAIN) {
-		perror("wl_connection_read");
-		return -1;
-	} else if (len < 0 && errno == EAGAIN)
-		return 1;
+	/* read until there's nothing left, but at most
+	 * WLDBG_READ_BUDGET times, so that the other connections
+	 * get their turn too. Epoll is level-triggered, so we'll
+	 * get the rest in the next iteration */
+	for (n = 0; n < WLDBG_READ_BUDGET; ++n) {
+		len = wl_connection_read(wl_conn);
+		if (len < 0 && errno != EAGAIN) {
+			perror("wl_connection_read");
+			return -1;
+		} else if (len < 0 && errno == EAGAIN)
+			break;
 
-	return process_data(conn, wl_conn, len);
+		/* messages of one read have the same timestamp */
+		if (conn->latency)
+			read_time = wldbg_time_ns();
+
+		ret = process_data(conn, wl_conn, len, read_time);
+		if (ret < 0)
+			return -1;
+
+		if (conn->worker) {
+			++conn->worker->statistics.reads;
+			conn->worker->statistics.messages += ret;
+		} else {
+			++wldbg->statistics.reads;
+			wldbg->statistics.messages += ret;
+		}
+
+		if (wldbg_should_exit(wldbg))
+			return 0;
+		if (wldbg_has_error(wldbg))
+			return -1;
+
+		/* the other side does not keep up, wait for it */
+		if (connection_flow(conn, wl_conn)->paused)
+			break;
+	}
+
+	return 1;
 }
 
 static void
@@ -430,6 +1047,44 @@ wldbg_connection_kill(struct wldbg_connection *conn)
 	kill(conn->client.pid, SIGTERM);
 }
 
+static void
+dump_flight_recorder(struct wldbg_connection *conn)
+{
+	wldbg_flight_recorder_trigger(conn, "SIGUSR1");
+}
+
+static void
+client_exited(struct wldbg *wldbg, pid_t pid, int crashed)
+{
+	struct wldbg_connection *conn;
+	struct closed_flight_recorder *closed, *tmp;
+	int waited = 0;
+
+	wl_list_for_each(conn, &wldbg->connections, link) {
+		if (crashed && conn->client.pid == pid)
+			wldbg_flight_recorder_trigger(conn,
+					"client exited abnormally");
+	}
+
+	wl_list_for_each_safe(closed, tmp, &wldbg->flight_recorder.closed,
+			      link) {
+		if (closed->pid != pid)
+			continue;
+
+		if (crashed)
+			wldbg_flight_recorder_dump(wldbg, closed->recorder,
+						   closed->conn_id,
+						   "client exited abnormally");
+		closed_flight_recorder_destroy(closed);
+		waited = 1;
+	}
+
+	/* the main loop was running only because of the rings */
+	if (waited && wldbg->connections_num == 0
+	    && wl_list_empty(&wldbg->flight_recorder.closed))
+		wldbg_exit(wldbg);
+}
+
 static int
 dispatch_signals(int fd, void *data)
 {
@@ -453,11 +1108,18 @@ dispatch_signals(int fd, void *data)
 		pid = waitpid(-1, &s, WNOHANG);
 		fprintf(stderr, "Client '%d' exited %s...\n",
 			pid, WIFEXITED(s) ? "" : "abnormally");
+
+		if (pid > 0)
+			client_exited(wldbg, pid, !WIFEXITED(s));
+	} else if (si.ssi_signo == SIGUSR1) {
+		wldbg_foreach_connection(wldbg, dump_flight_recorder);
+		if (wldbg->workers.num > 0)
+			wldbg_workers_dump_flight_recorders(wldbg);
 	} else if (si.ssi_signo == SIGINT) {
 		fprintf(stderr, "Interrupted...\n");
 
 		wldbg_foreach_connection(wldbg, wldbg_connection_kill);
-		wldbg->flags.exit = 1;
+		wldbg_exit(wldbg);
 	} else {
 		assert(0 && "Got unhandled signal from epoll");
 	}
@@ -468,18 +1130,14 @@ dispatch_signals(int fd, void *data)
 static int
 create_client_connection_for_fd(struct wldbg_connection *conn, int fd)
 {
-	conn->client.connection = wl_connection_create(fd);
+	conn->client.connection
+		= wl_connection_create_sized(fd, conn->wldbg->buffer_size,
+					     conn->wldbg->max_buffer_size);
 	if (!conn->client.connection) {
 		perror("Failed creating wl_connection (client)");
 		return -1;
 	}
 
-	if (wldbg_monitor_fd(conn->wldbg, fd,
-			     dispatch_messages, conn) == NULL) {
-		wl_connection_destroy(conn->client.connection);
-		return -1;
-	}
-
 	conn->client.fd = fd;
 	conn->client.pid = get_pid_for_socket(fd);
 	if (conn->client.pid != -1)
@@ -525,8 +1183,13 @@ spawn_client(struct wldbg *wldbg, char *path, char *argv[])
 		return NULL;
 	}
 
-	assert(!wldbg->flags.error);
-	assert(!wldbg->flags.exit);
+	assert(!wldbg_has_error(wldbg));
+	assert(!wldbg_should_exit(wldbg));
+
+	/* interfaces compiled into the client, before anything
+	 * can use the registry. Not fatal, we just know less */
+	if (wldbg_protocols_load_binary(path) < 0)
+		fprintf(stderr, "Failed loading interfaces of '%s'\n", path);
 
 	conn = wldbg_connection_create(wldbg);
 	if (!conn)
@@ -589,19 +1252,19 @@ wldbg_run(struct wldbg *wldbg)
 {
 	int ret = 0;
 
-	assert(!wldbg->flags.exit);
-	assert(!wldbg->flags.error);
+	assert(!wldbg_should_exit(wldbg));
+	assert(!wldbg_has_error(wldbg));
 
 	wldbg->flags.running = 1;
 
 	while((ret = wldbg_dispatch(wldbg)) > 0) {
-		if (wldbg->flags.error) {
+		if (wldbg_has_error(wldbg)) {
 			dbg("Exiting for error flag");
 			ret = -1;
 			break;
 		}
 
-		if (wldbg->flags.exit) {
+		if (wldbg_should_exit(wldbg)) {
 			dbg("Exiting for exit flag");
 			ret = 0;
 			break;
@@ -649,12 +1312,39 @@ wldbg_destroy(struct wldbg *wldbg)
 {
 	struct pass *pass, *pass_tmp;
 	struct wldbg_fd_callback *cb, *cb_tmp;
+	struct closed_flight_recorder *closed, *closed_tmp;
+
+	dbg("Loop iterations: %lu, ready events: %lu (max %u per wakeup), "
+	    "reads: %lu, messages: %lu\n", wldbg->statistics.loop_iterations,
+	    wldbg->statistics.ready_events,
+	    wldbg->statistics.max_ready_events,
+	    wldbg->statistics.reads,
+	    wldbg->statistics.messages);
+
+	/* workers use passes and buffers,
+	 * so stop them first */
+	if (wldbg->workers.num > 0)
+		wldbg_workers_destroy(wldbg);
+
+	/* let observers finish before passes are destroyed */
+	if (wldbg->observers) {
+		wldbg_observers_destroy(wldbg->observers);
+		wldbg->observers = NULL;
+	}
+
+	if (wldbg->flags.pass_stats && !wl_list_empty(&wldbg->passes)) {
+		printf("Passes (CPU time):\n");
+		pass_print_statistics_header();
+		wl_list_for_each(pass, &wldbg->passes, link)
+			pass_print_statistics(pass);
+	}
 
 	/* free buffer */
 	free(wldbg->buffer);
+	wldbg_frames_release(&wldbg->frames);
 
-	if (wldbg->epoll_fd >= 0)
-		close(wldbg->epoll_fd);
+	if (wldbg->poller)
+		wldbg_poller_destroy(wldbg->poller);
 	if (wldbg->signals_fd >= 0)
 		close(wldbg->signals_fd);
 
@@ -675,6 +1365,15 @@ wldbg_destroy(struct wldbg *wldbg)
 	/* if there are any connections left that haven't got
 	 * HUP, free them */
 	wldbg_foreach_connection(wldbg, wldbg_connection_destroy);
+
+	wl_list_for_each_safe(closed, closed_tmp,
+			      &wldbg->flight_recorder.closed, link)
+		closed_flight_recorder_destroy(closed);
+
+	/* the registry is shared by all passes and connections,
+	 * so it goes away only when nothing can use it */
+	wldbg_interfaces_clear();
+	wldbg_protocols_release();
 }
 
 static int
@@ -683,23 +1382,27 @@ wldbg_init(struct wldbg *wldbg)
 	sigset_t signals;
 
 	memset(wldbg, 0, sizeof *wldbg);
-	wldbg->signals_fd = wldbg->epoll_fd = -1;
+	wldbg->signals_fd = -1;
 
-	/* wl_buffer has size 4096 and probably will
-	 * have some time */
-	wldbg->buffer = malloc(4096);
+	wldbg->buffer_size = WL_BUFFER_DEFAULT_SIZE;
+	wldbg->max_buffer_size = WL_BUFFER_DEFAULT_MAX_SIZE;
+
+	/* a message can be as big as the connection buffer,
+	 * parse_opts reallocates it if the user changes the size */
+	wldbg->buffer = malloc(wldbg->max_buffer_size);
 	if (!wldbg->buffer)
 		return -1;
 
 	wl_list_init(&wldbg->passes);
 	wl_list_init(&wldbg->monitored_fds);
 	wl_list_init(&wldbg->connections);
+	wl_list_init(&wldbg->flight_recorder.closed);
+	wldbg_frames_init(&wldbg->frames);
 
-	wldbg->epoll_fd = epoll_create1(0);
-	if (wldbg->epoll_fd == -1) {
-		perror("epoll_create failed");
+	/* options may switch it to io_uring later */
+	wldbg->poller = wldbg_poller_create(WLDBG_POLLER_EPOLL);
+	if (!wldbg->poller)
 		goto err_data;
-	}
 
 	sigemptyset(&signals);
 	sigaddset(&signals, SIGINT);
@@ -708,12 +1411,12 @@ wldbg_init(struct wldbg *wldbg)
 	/* block signals, let them come to signalfd */
 	if (sigprocmask(SIG_BLOCK, &signals, NULL) < 0) {
 		perror("blocking signals");
-		goto err_epoll;
+		goto err_poller;
 	}
 
 	if ((wldbg->signals_fd = signalfd(-1, &signals, SFD_CLOEXEC)) < 0) {
 		perror("signalfd");
-		goto err_epoll;
+		goto err_poller;
 	}
 
 	if (wldbg_monitor_fd(wldbg, wldbg->signals_fd,
@@ -732,8 +1435,9 @@ wldbg_init(struct wldbg *wldbg)
 
 err_signals:
 	close(wldbg->signals_fd);
-err_epoll:
-	close(wldbg->epoll_fd);
+err_poller:
+	wldbg_poller_destroy(wldbg->poller);
+	wldbg->poller = NULL;
 err_data:
 	free(wldbg->buffer);
 	return -1;
@@ -747,6 +1451,16 @@ help(void)
 	fprintf(stderr, "\twldbg [-i|--interactive] ARGUMENTS [PROGRAM]\n");
 	fprintf(stderr, "\twldbg pass ARGUMENTS, pass ARGUMENTS,... -- PROGRAM\n");
 	fprintf(stderr, "\twldbg [-s|--server-mode]\n");
+	fprintf(stderr, "\twldbg -s --workers=N [--balance=round-robin|least-loaded] "
+			"[pass ARGUMENTS, ...]\n");
+	fprintf(stderr, "\twldbg --observers=block|drop-newest|count-drops "
+			"pass ARGUMENTS, ... -- PROGRAM\n");
+	fprintf(stderr, "\twldbg --latency --pass-stats ...\n");
+	fprintf(stderr, "\twldbg --event-loop=epoll|io_uring ...\n");
+	fprintf(stderr, "\twldbg --flight-recorder=SIZE ...\n");
+	fprintf(stderr, "\twldbg --protocols=PATH[:PATH...] ...\n");
+	fprintf(stderr, "\twldbg --replay FILE [--replay-from=SECONDS] "
+			"pass ARGUMENTS, ...\n");
 	fprintf(stderr, "\nTry 'wldbg help' too.\n"
 			"For interactive mode and server-mode description "
 			"see documentation.\n");
@@ -778,7 +1492,12 @@ server_mode_accept(int fd, void *data)
 		goto err;
 	}
 
-	wldbg_add_connection(conn);
+	if (wldbg_add_connection(conn) < 0) {
+		/* the client fd is owned by the connection now */
+		wldbg_connection_destroy(conn);
+		return -1;
+	}
+
 	dbg("Created new connection to client: %s\n", name.sun_path);
 
 	return 1;
@@ -811,6 +1530,36 @@ server_mode_init(struct wldbg *wldbg)
 	return 0;
 }
 
+/* move everything that is monitored to a poller with another backend.
+ * Only listening fds are monitored at this moment, so all of them
+ * are polled for EPOLLIN */
+static int
+switch_poller(struct wldbg *wldbg, enum wldbg_poller_backend backend)
+{
+	struct wldbg_poller *poller;
+	struct wldbg_fd_callback *cb;
+
+	if (wldbg_poller_get_backend(wldbg->poller) == backend)
+		return 0;
+
+	poller = wldbg_poller_create(backend);
+	if (!poller)
+		return -1;
+
+	wl_list_for_each(cb, &wldbg->monitored_fds, link) {
+		if (wldbg_poller_add(poller, cb->fd, EPOLLIN, cb) == -1) {
+			perror("Failed adding fd to poller");
+			wldbg_poller_destroy(poller);
+			return -1;
+		}
+	}
+
+	wldbg_poller_destroy(wldbg->poller);
+	wldbg->poller = poller;
+
+	return 0;
+}
+
 static int
 parse_opts(struct wldbg *wldbg, struct wldbg_options *options,
 	   int argc, char *argv[])
@@ -823,10 +1572,105 @@ parse_opts(struct wldbg *wldbg, struct wldbg_options *options,
 		exit(1);
 	}
 
+	/* interfaces that libwayland does not have come from protocol
+	 * XML files. Do it before loading passes, they can look
+	 * the interfaces up */
+	if (options->protocols
+	    && wldbg_protocols_load_path(options->protocols) < 0)
+		return -1;
+
+	if (wldbg_protocols_load_path(PROTOCOLS_PATH) < 0)
+		return -1;
+
 	if (options->pass_whole_buffer) {
 		wldbg->flags.pass_whole_buffer = 1;
 	}
 
+	if (options->batch_forward) {
+		wldbg->flags.batch_forward = 1;
+	}
+
+	if (options->latency) {
+		wldbg->flags.latency = 1;
+	}
+
+	if (options->pass_stats) {
+		wldbg->flags.pass_stats = 1;
+	}
+
+	if (options->buffer_size) {
+		wldbg->buffer_size = wl_buffer_size_round(options->buffer_size);
+		if (wldbg->max_buffer_size < wldbg->buffer_size)
+			wldbg->max_buffer_size = wldbg->buffer_size;
+	}
+
+	if (options->max_buffer_size) {
+		wldbg->max_buffer_size
+			= wl_buffer_size_round(options->max_buffer_size);
+		if (wldbg->max_buffer_size < wldbg->buffer_size) {
+			fprintf(stderr, "Max buffer size (%u) is smaller than "
+				"buffer size (%u)\n", wldbg->max_buffer_size,
+				wldbg->buffer_size);
+			return -1;
+		}
+	}
+
+	if (options->buffer_size || options->max_buffer_size) {
+		free(wldbg->buffer);
+		wldbg->buffer = malloc(wldbg->max_buffer_size);
+		if (!wldbg->buffer)
+			return -1;
+	}
+
+	if (options->observers) {
+		/* the observer thread walks the list of passes,
+		 * so it must not change while running */
+		if (options->interactive
+		    || (options->server_mode && options->workers == 0)) {
+			fprintf(stderr, "Observers can not run in the "
+					"background in interactive mode\n");
+			return -1;
+		}
+
+		if (options->pass_whole_buffer) {
+			fprintf(stderr, "Observers can not run in the "
+					"background with pass-whole-buffer\n");
+			return -1;
+		}
+
+		wldbg->observers_policy = options->observers;
+	}
+
+	if (options->event_loop != WLDBG_POLLER_EPOLL
+	    && switch_poller(wldbg, options->event_loop) < 0) {
+		fprintf(stderr, "Falling back to epoll\n");
+	}
+
+	if (options->replay
+	    && (options->interactive || options->server_mode)) {
+		fprintf(stderr, "Captures can be replayed only "
+				"through passes\n");
+		return -1;
+	}
+
+	if (options->flight_recorder) {
+		wldbg->flight_recorder.size = options->flight_recorder;
+
+		/* SIGUSR1 writes the rings */
+		sigaddset(&wldbg->handled_signals, SIGUSR1);
+		if (sigprocmask(SIG_BLOCK, &wldbg->handled_signals, NULL) < 0
+		    || signalfd(wldbg->signals_fd, &wldbg->handled_signals,
+				SFD_CLOEXEC) < 0) {
+			perror("Handling SIGUSR1");
+			return -1;
+		}
+	}
+
+	if (options->workers > 0 && !options->server_mode) {
+		fprintf(stderr, "Workers can be used only in server mode\n");
+		return -1;
+	}
+
 	if (options->interactive) {
 		if (argc - pass_off < 1) {
 			fprintf(stderr, "Need client to run\n");
@@ -853,6 +1697,21 @@ parse_opts(struct wldbg *wldbg, struct wldbg_options *options,
 			return -1;
 
 		return 0;
+	} else if (options->server_mode && options->workers > 0) {
+		wldbg->flags.server_mode = 1;
+
+		/* connections are served by worker threads,
+		 * so we can not stop on them interactively.
+		 * The arguments are passes like in normal mode */
+		pass_num = load_passes(wldbg, options, argc - pass_off,
+				       (const char **) argv + pass_off);
+		if (pass_num == -1) {
+			fprintf(stderr, "Error occured while loading passes...\n");
+			return -1;
+		}
+
+		if (server_mode_init(wldbg) < 0)
+			return -1;
 	} else if (options->server_mode) {
 		wldbg->flags.server_mode = 1;
 
@@ -926,14 +1785,37 @@ int main(int argc, char *argv[])
 
 	/* if some pass created
 	 * an error while initializing, do not proceed */
-	if (wldbg.flags.error)
+	if (wldbg_has_error(&wldbg))
 		goto err;
 
-	if (wldbg.flags.exit) {
+	if (wldbg_should_exit(&wldbg)) {
 		wldbg_destroy(&wldbg);
 		return EXIT_SUCCESS;
 	}
 
+	/* start workers when all passes are loaded,
+	 * they are shared between the workers */
+	if (options.workers > 0
+	    && wldbg_workers_create(&wldbg, options.workers,
+				    options.least_loaded) < 0)
+		goto err;
+
+	/* workers have their own observers */
+	if (wldbg.observers_policy && options.workers == 0) {
+		wldbg.observers = wldbg_observers_create(&wldbg,
+							 wldbg.observers_policy);
+		if (!wldbg.observers)
+			goto err;
+	}
+
+	if (options.replay) {
+		if (wldbg_replay(&wldbg, options.replay,
+				 options.replay_from) < 0)
+			goto err;
+
+		goto out;
+	}
+
 	if (wldbg.flags.server_mode) {
 		printf("Listening for incoming connections...\n");
 	} else {
@@ -941,12 +1823,16 @@ int main(int argc, char *argv[])
 		if (conn == NULL)
 			goto err;
 
-		wldbg_add_connection(conn);
+		if (wldbg_add_connection(conn) < 0) {
+			wldbg_connection_destroy(conn);
+			goto err;
+		}
 	}
 
 	if (wldbg_run(&wldbg) < 0)
 		goto err;
 
+out:
 	free(options.path);
 	if (options.argv)
 		free_arguments(options.argv);
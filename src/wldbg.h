@@ -32,6 +32,29 @@
 struct wldbg;
 struct wldbg_connection;
 
+/* position of a message in the data of wldbg_message */
+struct wldbg_frame {
+	uint32_t offset;
+	uint32_t size;
+};
+
+/* object of a message and its interface, see wldbg_message.objects */
+struct wldbg_message_object {
+	uint32_t id;
+	const struct wl_interface *interface;
+	uint32_t version;
+	uint64_t handle;
+};
+
+/* see wldbg_message_get_object_lifetime() */
+struct wldbg_object_lifetime {
+	uint64_t handle;
+	/* indices of the messages that created and destroyed
+	 * the object, 0 if they are not known (yet) */
+	uint64_t created;
+	uint64_t destroyed;
+};
+
 struct wldbg_message {
 	/* raw data in message */
 	void *data;
@@ -47,14 +70,85 @@ struct wldbg_message {
 
 	/* pointer to connectoin structure */
 	struct wldbg_connection *connection;
+
+	/* set when data points to a private copy of the message,
+	 * see wldbg_message_make_writable() */
+	int writable;
+
+	/* with pass_whole_buffer the data contain several
+	 * messages and these are their offsets and sizes */
+	const struct wldbg_frame *frames;
+	unsigned int frames_num;
+
+	/* asynchronous observers (see WLDBG_PASS_OBSERVER) can not look
+	 * into the connection, they get the interfaces of objects from
+	 * the message as they were when the message was forwarded.
+	 * wldbg_message_get_object() uses them when they are set */
+	const struct wldbg_message_object *objects;
+	unsigned int objects_num;
+
+	/* number of messages that observers missed
+	 * before this one (--observers=count-drops) */
+	unsigned long dropped;
+
+	/* number of the message in the connection, from 1 */
+	uint64_t index;
 };
 
+/* data of the message point right into the input buffer of the
+ * connection and must not be changed. A pass that wants to change
+ * the message must call this function first. It copies the message
+ * into a private buffer (as big as the maximal size of connection
+ * buffers) and returns the new data pointer (which is stored
+ * in message->data too) */
+void *
+wldbg_message_make_writable(struct wldbg_message *message);
+
 const struct wl_interface *
 wldbg_message_get_object(struct wldbg_message *msg, uint32_t id);
 
+/* version that the object was bound with (wl_registry.bind) or
+ * inherited from the object that created it. 0 if it is not known */
+uint32_t
+wldbg_message_get_object_version(struct wldbg_message *msg, uint32_t id);
+
+/* Ids are used again when objects are destroyed. The handle is
+ * the id and the generation of the object, so it is unique in the
+ * connection and passes can use it as a key for per-object data.
+ * 0 if the object is not known */
+uint64_t
+wldbg_message_get_object_handle(struct wldbg_message *msg, uint32_t id);
+
+#define WLDBG_HANDLE_ID(handle)		((uint32_t) (handle))
+#define WLDBG_HANDLE_GENERATION(handle)	((uint32_t) ((handle) >> 32))
+
+/* the object with the id or the last destroyed one that had the id.
+ * Returns -1 if it is not known (and for observers, they have only
+ * handles) */
+int
+wldbg_message_get_object_lifetime(struct wldbg_message *msg, uint32_t id,
+				  struct wldbg_object_lifetime *lifetime);
+
+/* interface with the name, if wldbg knows it */
 const struct wl_interface *
 wldbg_message_get_interface(struct wldbg_message *msg, const char *name);
 
+/* Interfaces that wldbg knows have small dense ids, so passes can keep
+ * per-interface data in arrays with wldbg_interfaces_count() items.
+ * Copies of an interface with the same name have the same id.
+ * 0 is for unknown interfaces */
+uint32_t
+wldbg_interface_id(const struct wl_interface *intf);
+
+const struct wl_interface *
+wldbg_interface_get(uint32_t id);
+
+const struct wl_interface *
+wldbg_interface_lookup(const char *name);
+
+uint32_t
+wldbg_interfaces_count(void);
+
 void
 wldbg_message_objects_iterate(struct wldbg_message *message,
 			      void (*func)(uint32_t id,
@@ -82,6 +176,11 @@ wldbg_error(struct wldbg *wldbg);
 int
 wldbg_separate_messages(struct wldbg *wldbg, int state);
 
+/* let wldbg know that passes were added or removed
+ * or that some pass changed its subscription */
+void
+wldbg_passes_changed(struct wldbg *wldbg);
+
 struct wldbg_fd_callback;
 
 struct wldbg_fd_callback *
@@ -0,0 +1,513 @@
+/*
+ * Copyright (c) 2015 Marek Chalupa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <assert.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include "wldbg.h"
+#include "wldbg-private.h"
+#include "workers.h"
+#include "observers.h"
+#include "poller.h"
+#include "flight-recorder.h"
+
+static struct wldbg_fd_callback *
+worker_monitor_fd(struct wldbg_worker *worker, int fd,
+		  struct wldbg_connection *conn)
+{
+	struct wldbg_fd_callback *cb;
+
+	cb = malloc(sizeof *cb);
+	if (!cb)
+		return NULL;
+
+	if (wldbg_poller_add(worker->poller, fd, EPOLLIN, cb) == -1) {
+		perror("Failed adding fd to worker's poller");
+		free(cb);
+		return NULL;
+	}
+
+	cb->fd = fd;
+	cb->data = conn;
+	cb->dispatch = wldbg_dispatch_messages;
+
+	wl_list_insert(&worker->monitored_fds, &cb->link);
+
+	return cb;
+}
+
+static void
+worker_remove_callback(struct wldbg_worker *worker,
+		       struct wldbg_fd_callback *cb)
+{
+	int i;
+
+	/* forget events of the callback in the batch
+	 * that is just being dispatched */
+	for (i = worker->dispatch.current + 1; i < worker->dispatch.num; ++i) {
+		if (worker->dispatch.events[i].data.ptr == cb)
+			worker->dispatch.events[i].data.ptr = NULL;
+	}
+
+	if (wldbg_poller_remove(worker->poller, cb->fd) == -1)
+		perror("Failed removing fd from worker's poller");
+
+	wl_list_remove(&cb->link);
+	free(cb);
+}
+
+static void
+worker_remove_connection(struct wldbg_worker *worker,
+			 struct wldbg_connection *conn)
+{
+	struct wldbg_fd_callback *cb, *tmp;
+
+	dbg("Worker %u: removing connection [%p]\n", worker->id, conn);
+
+	wl_list_for_each_safe(cb, tmp, &worker->monitored_fds, link) {
+		if (cb->data == conn)
+			worker_remove_callback(worker, cb);
+	}
+
+	wl_list_remove(&conn->link);
+	__atomic_sub_fetch(&worker->connections_num, 1, __ATOMIC_RELAXED);
+
+	wldbg_connection_destroy(conn);
+}
+
+static void
+worker_take_connection(struct wldbg_worker *worker,
+		       struct wldbg_connection *conn)
+{
+	struct wldbg_fd_callback *cb;
+
+	wl_list_insert(&worker->connections, &conn->link);
+
+	cb = worker_monitor_fd(worker, conn->server.fd, conn);
+	conn->server.flow.cb = cb;
+	if (cb) {
+		cb = worker_monitor_fd(worker, conn->client.fd, conn);
+		conn->client.flow.cb = cb;
+	}
+
+	if (!cb) {
+		fprintf(stderr, "Worker %u: failed taking connection\n",
+			worker->id);
+		worker_remove_connection(worker, conn);
+		return;
+	}
+
+	wldbg_connection_use_poller_io(conn, worker->poller);
+
+	++worker->statistics.connections;
+	dbg("Worker %u: took connection [%p]\n", worker->id, conn);
+}
+
+/* returns 0 if the worker should exit */
+static int
+worker_wakeup(struct wldbg_worker *worker)
+{
+	struct wldbg_connection *conn, *tmp;
+	struct wl_list incoming;
+	uint64_t val;
+	int quit, dump;
+
+	if (read(worker->event_fd, &val, sizeof val) != sizeof val
+	    && errno != EAGAIN)
+		perror("Reading worker's eventfd");
+
+	wl_list_init(&incoming);
+
+	pthread_mutex_lock(&worker->lock);
+	wl_list_insert_list(&incoming, &worker->incoming);
+	wl_list_init(&worker->incoming);
+	quit = worker->quit;
+	dump = worker->dump_flight_recorders;
+	worker->dump_flight_recorders = 0;
+	pthread_mutex_unlock(&worker->lock);
+
+	wl_list_for_each_safe(conn, tmp, &incoming, link)
+		worker_take_connection(worker, conn);
+
+	/* rings are written only by the thread that fills them */
+	if (dump) {
+		wl_list_for_each(conn, &worker->connections, link)
+			wldbg_flight_recorder_trigger(conn, "SIGUSR1");
+	}
+
+	return !quit;
+}
+
+static void
+worker_dispatch_event(struct wldbg_worker *worker, struct epoll_event *ev)
+{
+	struct wldbg_fd_callback *cb = ev->data.ptr;
+	struct wldbg_connection *conn;
+
+	/* the callback was removed while dispatching
+	 * previous events from this batch */
+	if (!cb)
+		return;
+
+	conn = cb->data;
+
+	if (ev->events & EPOLLHUP) {
+		worker_remove_connection(worker, conn);
+		return;
+	}
+
+	if (ev->events & EPOLLERR) {
+		fprintf(stderr, "Worker %u: epoll event error\n", worker->id);
+		worker_remove_connection(worker, conn);
+		return;
+	}
+
+	if (cb->dispatch(cb->fd, cb->data) <= 0)
+		worker_remove_connection(worker, conn);
+}
+
+static void *
+worker_run(void *data)
+{
+	struct wldbg_worker *worker = data;
+	struct wldbg_connection *conn, *tmp;
+	struct epoll_event *ev;
+	int i, n, running = 1;
+
+	dbg("Worker %u: running\n", worker->id);
+
+	while (running) {
+		n = wldbg_poller_wait(worker->poller, worker->dispatch.events,
+				      WLDBG_MAX_EVENTS);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+
+			perror("Worker waiting for events");
+			break;
+		}
+
+		++worker->statistics.loop_iterations;
+		worker->statistics.ready_events += n;
+
+		worker->dispatch.num = n;
+		for (i = 0; i < n; ++i) {
+			worker->dispatch.current = i;
+			ev = &worker->dispatch.events[i];
+
+			if (ev->data.ptr == worker) {
+				if (!worker_wakeup(worker))
+					running = 0;
+				continue;
+			}
+
+			worker_dispatch_event(worker, ev);
+		}
+
+		worker->dispatch.num = 0;
+		worker->dispatch.current = 0;
+	}
+
+	/* take what was handed over after the last wakeup,
+	 * so that it is destroyed too */
+	worker_wakeup(worker);
+
+	wl_list_for_each_safe(conn, tmp, &worker->connections, link)
+		worker_remove_connection(worker, conn);
+
+	dbg("Worker %u: exiting\n", worker->id);
+
+	return NULL;
+}
+
+static int
+worker_init(struct wldbg_worker *worker, struct wldbg *wldbg,
+	    unsigned int id)
+{
+	worker->wldbg = wldbg;
+	worker->id = id;
+
+	wl_list_init(&worker->incoming);
+	wl_list_init(&worker->connections);
+	wl_list_init(&worker->monitored_fds);
+	wldbg_frames_init(&worker->frames);
+
+	/* the same size as wldbg->buffer */
+	worker->buffer = malloc(wldbg->max_buffer_size);
+	if (!worker->buffer)
+		return -1;
+
+	worker->poller
+		= wldbg_poller_create(wldbg_poller_get_backend(wldbg->poller));
+	if (!worker->poller)
+		goto err_buffer;
+
+	worker->event_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (worker->event_fd == -1) {
+		perror("eventfd");
+		goto err_poller;
+	}
+
+	if (wldbg_poller_add(worker->poller, worker->event_fd,
+			     EPOLLIN, worker) == -1) {
+		perror("Failed adding eventfd to worker's poller");
+		goto err_eventfd;
+	}
+
+	if (pthread_mutex_init(&worker->lock, NULL) != 0) {
+		fprintf(stderr, "Failed creating worker's lock\n");
+		goto err_eventfd;
+	}
+
+	if (wldbg->observers_policy) {
+		worker->observers
+			= wldbg_observers_create(wldbg,
+						 wldbg->observers_policy);
+		if (!worker->observers)
+			goto err_lock;
+	}
+
+	return 0;
+
+err_lock:
+	pthread_mutex_destroy(&worker->lock);
+err_eventfd:
+	close(worker->event_fd);
+err_poller:
+	wldbg_poller_destroy(worker->poller);
+err_buffer:
+	free(worker->buffer);
+	return -1;
+}
+
+static void
+worker_release(struct wldbg_worker *worker)
+{
+	dbg("Worker %u: connections: %lu, loop iterations: %lu, "
+	    "ready events: %lu, reads: %lu, messages: %lu\n", worker->id,
+	    worker->statistics.connections,
+	    worker->statistics.loop_iterations,
+	    worker->statistics.ready_events,
+	    worker->statistics.reads,
+	    worker->statistics.messages);
+
+	/* the connections are gone already */
+	if (worker->observers)
+		wldbg_observers_destroy(worker->observers);
+
+	pthread_mutex_destroy(&worker->lock);
+	close(worker->event_fd);
+	wldbg_poller_destroy(worker->poller);
+	free(worker->buffer);
+	wldbg_frames_release(&worker->frames);
+}
+
+static int
+worker_wake(struct wldbg_worker *worker)
+{
+	uint64_t val = 1;
+
+	if (write(worker->event_fd, &val, sizeof val) != sizeof val) {
+		perror("Waking up worker");
+		return -1;
+	}
+
+	return 0;
+}
+
+void
+wldbg_workers_dump_flight_recorders(struct wldbg *wldbg)
+{
+	struct wldbg_worker *worker;
+	unsigned int i;
+
+	for (i = 0; i < wldbg->workers.num; ++i) {
+		worker = &wldbg->workers.workers[i];
+
+		pthread_mutex_lock(&worker->lock);
+		worker->dump_flight_recorders = 1;
+		pthread_mutex_unlock(&worker->lock);
+
+		worker_wake(worker);
+	}
+}
+
+static int
+check_passes(struct wldbg *wldbg)
+{
+	struct pass *pass;
+
+	wl_list_for_each(pass, &wldbg->passes, link) {
+		if (!(pass->wldbg_pass.flags & WLDBG_PASS_THREAD_SAFE)) {
+			fprintf(stderr, "Pass '%s' is not thread-safe, "
+				"it cannot be used with workers\n",
+				pass->name);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+int
+wldbg_workers_create(struct wldbg *wldbg, unsigned int num, int least_loaded)
+{
+	struct wldbg_worker *worker;
+	unsigned int i;
+
+	assert(num > 0);
+	assert(wldbg->workers.num == 0);
+
+	/* passes are shared between the workers */
+	if (check_passes(wldbg) < 0)
+		return -1;
+
+	wldbg->workers.workers = calloc(num, sizeof *worker);
+	if (!wldbg->workers.workers)
+		return -1;
+
+	wldbg->workers.least_loaded = !!least_loaded;
+
+	for (i = 0; i < num; ++i) {
+		worker = &wldbg->workers.workers[i];
+
+		if (worker_init(worker, wldbg, i) < 0)
+			goto err;
+
+		if (pthread_create(&worker->thread, NULL,
+				   worker_run, worker) != 0) {
+			fprintf(stderr, "Failed creating worker thread\n");
+			worker_release(worker);
+			goto err;
+		}
+
+		/* count only running workers, so that
+		 * wldbg_workers_destroy knows what to join */
+		++wldbg->workers.num;
+	}
+
+	dbg("Created %u workers (%s)\n", num,
+	    least_loaded ? "least-loaded" : "round-robin");
+
+	return 0;
+
+err:
+	wldbg_workers_destroy(wldbg);
+	return -1;
+}
+
+void
+wldbg_workers_destroy(struct wldbg *wldbg)
+{
+	struct wldbg_worker *worker;
+	unsigned int i;
+
+	for (i = 0; i < wldbg->workers.num; ++i) {
+		worker = &wldbg->workers.workers[i];
+
+		pthread_mutex_lock(&worker->lock);
+		worker->quit = 1;
+		pthread_mutex_unlock(&worker->lock);
+
+		worker_wake(worker);
+	}
+
+	for (i = 0; i < wldbg->workers.num; ++i) {
+		worker = &wldbg->workers.workers[i];
+
+		pthread_join(worker->thread, NULL);
+		worker_release(worker);
+	}
+
+	free(wldbg->workers.workers);
+	wldbg->workers.workers = NULL;
+	wldbg->workers.num = 0;
+}
+
+static struct wldbg_worker *
+pick_worker(struct wldbg *wldbg)
+{
+	struct wldbg_worker *worker, *best = NULL;
+	int num, best_num = 0;
+	unsigned int i;
+
+	if (!wldbg->workers.least_loaded) {
+		worker = &wldbg->workers.workers[wldbg->workers.next];
+		wldbg->workers.next
+			= (wldbg->workers.next + 1) % wldbg->workers.num;
+		return worker;
+	}
+
+	for (i = 0; i < wldbg->workers.num; ++i) {
+		worker = &wldbg->workers.workers[i];
+		num = __atomic_load_n(&worker->connections_num,
+				      __ATOMIC_RELAXED);
+
+		if (!best || num < best_num) {
+			best = worker;
+			best_num = num;
+		}
+	}
+
+	return best;
+}
+
+int
+wldbg_workers_add_connection(struct wldbg *wldbg,
+			     struct wldbg_connection *conn)
+{
+	struct wldbg_worker *worker;
+
+	assert(wldbg->workers.num > 0);
+
+	worker = pick_worker(wldbg);
+	conn->worker = worker;
+
+	/* count the connection right now, so that
+	 * the next one does not go to the same worker */
+	__atomic_add_fetch(&worker->connections_num, 1, __ATOMIC_RELAXED);
+
+	pthread_mutex_lock(&worker->lock);
+	wl_list_insert(worker->incoming.prev, &conn->link);
+	pthread_mutex_unlock(&worker->lock);
+
+	dbg("Handing connection [%p] to worker %u\n", conn, worker->id);
+
+	/* if this fails, the worker takes the connection
+	 * with the next one or when exiting */
+	worker_wake(worker);
+
+	return 0;
+}
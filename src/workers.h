@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2015 Marek Chalupa
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial
+ * portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _WLDBG_WORKERS_H_
+#define _WLDBG_WORKERS_H_
+
+#include <pthread.h>
+#include <sys/epoll.h>
+
+#include "wldbg.h"
+#include "wldbg-private.h"
+#include "wayland/wayland-util.h"
+
+/*
+ * Worker thread that serves a part of connections in server mode.
+ * Every worker has its own epoll and buffers, so the connections
+ * of one worker do not wait for connections of other workers.
+ */
+struct wldbg_worker {
+	struct wldbg *wldbg;
+	pthread_t thread;
+	unsigned int id;
+
+	/* the same backend as wldbg's poller */
+	struct wldbg_poller *poller;
+	/* wakes the worker up when there are new
+	 * connections or when it should exit */
+	int event_fd;
+
+	pthread_mutex_t lock;
+	/* connections handed over by the main thread
+	 * that the worker did not take yet */
+	struct wl_list incoming;
+	/* the worker should exit */
+	int quit;
+	/* the worker should write flight recorders of its connections */
+	int dump_flight_recorders;
+
+	/* connections served by the worker and their
+	 * callbacks. Touched only by the worker */
+	struct wl_list connections;
+	struct wl_list monitored_fds;
+	/* read by the main thread when balancing,
+	 * use atomic operations */
+	int connections_num;
+
+	/* what wldbg has for the main loop */
+	struct wldbg_message message;
+	struct wldbg_frames frames;
+	char *buffer;
+	struct wldbg_observers *observers;
+
+	struct {
+		struct epoll_event events[WLDBG_MAX_EVENTS];
+		int num;
+		int current;
+	} dispatch;
+
+	struct {
+		unsigned long loop_iterations;
+		unsigned long ready_events;
+		unsigned long reads;
+		unsigned long messages;
+		unsigned long connections;
+	} statistics;
+};
+
+int
+wldbg_workers_create(struct wldbg *wldbg, unsigned int num, int least_loaded);
+
+void
+wldbg_workers_destroy(struct wldbg *wldbg);
+
+/* hand the connection over to one of the workers */
+int
+wldbg_workers_add_connection(struct wldbg *wldbg,
+			     struct wldbg_connection *conn);
+
+/* write flight recorders of all connections (SIGUSR1) */
+void
+wldbg_workers_dump_flight_recorders(struct wldbg *wldbg);
+
+/* defined in wldbg.c */
+int
+wldbg_dispatch_messages(int fd, void *data);
+
+void
+wldbg_connection_destroy(struct wldbg_connection *conn);
+
+void
+wldbg_connection_use_poller_io(struct wldbg_connection *conn,
+			       struct wldbg_poller *poller);
+
+#endif /* _WLDBG_WORKERS_H_ */
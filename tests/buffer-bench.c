@@ -0,0 +1,172 @@
+/*
+ * Throughput of forwarding messages through wl_connection
+ * with different sizes of buffers. Run it with 'make bench'.
+ *
+ * A producer thread writes messages into one socket as fast
+ * as it can, we read them with wl_connection_read and forward them
+ * into another socket (like wldbg does) and a consumer thread
+ * reads them from there. We count reads and writes (syscalls)
+ * that the forwarding needed.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "wayland-private.h"
+
+#define MESSAGES	200000
+
+struct bench {
+	int in[2];
+	int out[2];
+	size_t message_size;
+};
+
+static void *
+producer(void *data)
+{
+	struct bench *bench = data;
+	char *chunk;
+	size_t size, written;
+	ssize_t ret;
+	int i, per_chunk = 64;
+
+	size = bench->message_size * per_chunk;
+	chunk = calloc(1, size);
+	assert(chunk);
+
+	for (i = 0; i < MESSAGES / per_chunk; ++i) {
+		written = 0;
+		while (written < size) {
+			ret = write(bench->in[1], chunk + written,
+				    size - written);
+			assert(ret > 0);
+			written += ret;
+		}
+	}
+
+	free(chunk);
+	close(bench->in[1]);
+
+	return NULL;
+}
+
+static void *
+consumer(void *data)
+{
+	struct bench *bench = data;
+	char buf[65536];
+
+	while (read(bench->out[1], buf, sizeof buf) > 0)
+		;
+
+	return NULL;
+}
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+wait_for(int fd, short events)
+{
+	struct pollfd pfd = { fd, events, 0 };
+
+	while (poll(&pfd, 1, -1) < 0 && errno == EINTR)
+		;
+}
+
+static void
+run(size_t message_size, uint32_t max_size)
+{
+	struct bench bench;
+	struct wl_connection *in, *out;
+	pthread_t prod, cons;
+	unsigned long reads = 0, writes = 0, bytes = 0;
+	double start, time;
+	int len;
+
+	bench.message_size = message_size;
+	assert(socketpair(AF_UNIX, SOCK_STREAM, 0, bench.in) == 0);
+	assert(socketpair(AF_UNIX, SOCK_STREAM, 0, bench.out) == 0);
+
+	in = wl_connection_create_sized(bench.in[0], WL_BUFFER_DEFAULT_SIZE,
+					max_size);
+	out = wl_connection_create_sized(bench.out[0], WL_BUFFER_DEFAULT_SIZE,
+					 max_size);
+	assert(in && out);
+
+	start = now();
+	pthread_create(&prod, NULL, producer, &bench);
+	pthread_create(&cons, NULL, consumer, &bench);
+
+	for (;;) {
+		len = wl_connection_read(in);
+		if (len == 0)
+			break;
+
+		if (len < 0) {
+			assert(errno == EAGAIN);
+			wait_for(bench.in[0], POLLIN);
+			continue;
+		}
+
+		++reads;
+		bytes += len;
+
+		++writes;
+		assert(wl_connection_forward(in, 0, len, out) == 0);
+		while (wl_connection_flush(out) < 0) {
+			assert(errno == EAGAIN);
+			wait_for(bench.out[0], POLLOUT);
+			++writes;
+		}
+
+		wl_connection_consume(in, len);
+	}
+
+	pthread_join(prod, NULL);
+	wl_connection_destroy(out);
+	pthread_join(cons, NULL);
+	time = now() - start;
+
+	printf("%6zu %8u %10.2f %10lu %12.0f %10.1f\n",
+	       message_size, max_size,
+	       (double) bytes / message_size / reads,
+	       reads + writes, (reads + writes) / time,
+	       bytes / time / (1024 * 1024));
+
+	wl_connection_destroy(in);
+	close(bench.out[1]);
+}
+
+int
+main(void)
+{
+	size_t message_sizes[] = { 32, 256, 2048 };
+	uint32_t max_sizes[] = { 4096, 16384, 65536, 262144 };
+	unsigned int i, j;
+
+	printf("%d messages\n", MESSAGES);
+	printf("%6s %8s %10s %10s %12s %10s\n", "msg", "max buf",
+	       "msgs/read", "syscalls", "syscalls/s", "MB/s");
+
+	for (i = 0; i < sizeof message_sizes / sizeof *message_sizes; ++i)
+		for (j = 0; j < sizeof max_sizes / sizeof *max_sizes; ++j)
+			run(message_sizes[i], max_sizes[j]);
+
+	return 0;
+}
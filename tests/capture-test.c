@@ -0,0 +1,284 @@
+#include <assert.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "test-runner.h"
+#include "wldbg.h"
+#include "wldbg-private.h"
+#include "wldbg-capture.h"
+
+/* write a message with given size (in bytes) into data */
+static size_t
+message(uint32_t *data, uint32_t id, uint32_t size)
+{
+	data[0] = id;
+	data[1] = size << 16;
+
+	return size / sizeof(uint32_t);
+}
+
+static char *
+capture_path(void)
+{
+	static char dir[] = "/tmp/wldbg-capture-test-XXXXXX";
+	static char path[64];
+
+	assert(mkdtemp(dir));
+	snprintf(path, sizeof path, "%s/capture", dir);
+
+	return path;
+}
+
+static void
+remove_capture(const char *path)
+{
+	char dir[64];
+
+	unlink(path);
+	strcpy(dir, path);
+	*strrchr(dir, '/') = '\0';
+	rmdir(dir);
+}
+
+TEST(write_and_read_records)
+{
+	struct wldbg_connection conn;
+	struct wldbg_message msg;
+	struct wldbg_capture *capture;
+	struct wldbg_capture_file file;
+	const struct wldbg_capture_record *rec;
+	const void *data;
+	uint32_t buf[64];
+	struct wldbg_frame frames[2];
+	struct wldbg_capture_cursor cursor;
+	char *path = capture_path();
+
+	memset(&cursor, 0, sizeof cursor);
+	memset(&conn, 0, sizeof conn);
+	conn.id = 7;
+
+	capture = wldbg_capture_create(path);
+	assert(capture);
+	/* the file must not be overwritten */
+	assert(wldbg_capture_create(path) == NULL);
+
+	memset(&msg, 0, sizeof msg);
+	msg.connection = &conn;
+	msg.data = buf;
+
+	/* 12 bytes are padded to 16 in the file */
+	msg.from = CLIENT;
+	msg.size = message(buf, 1, 12) * 4;
+	buf[2] = 0xdeadbeef;
+	assert(wldbg_capture_write(capture, &msg) == 0);
+
+	/* with pass_whole_buffer messages get own records */
+	msg.from = SERVER;
+	msg.size = message(buf, 2, 8) * 4;
+	msg.size += message(buf + 2, 3, 16) * 4;
+	frames[0].offset = 0;
+	frames[0].size = 8;
+	frames[1].offset = 8;
+	frames[1].size = 16;
+	msg.frames = frames;
+	msg.frames_num = 2;
+	assert(wldbg_capture_write(capture, &msg) == 0);
+
+	wldbg_capture_destroy(capture);
+
+	assert(wldbg_capture_file_open(&file, path) == 0);
+
+	assert(wldbg_capture_file_next(&file, &cursor, &rec, &data) == 1);
+	assert(rec->connection == 7 && rec->from == CLIENT);
+	assert(rec->size == 12 && rec->fds == 0 && rec->time > 0);
+	assert(((const uint32_t *) data)[2] == 0xdeadbeef);
+	assert(cursor.offset % 8 == 0);
+
+	assert(wldbg_capture_file_next(&file, &cursor, &rec, &data) == 1);
+	assert(rec->from == SERVER && rec->size == 8);
+	assert(((const uint32_t *) data)[0] == 2);
+
+	assert(wldbg_capture_file_next(&file, &cursor, &rec, &data) == 1);
+	assert(rec->from == SERVER && rec->size == 16);
+	assert(((const uint32_t *) data)[0] == 3);
+
+	assert(wldbg_capture_file_next(&file, &cursor, &rec, &data) == 0);
+
+	wldbg_capture_file_close(&file);
+	remove_capture(path);
+}
+
+/* write messages of two connections, so that they take several chunks.
+ * Messages of the second connection are only in the first half */
+static void
+write_many(const char *path, unsigned int num)
+{
+	struct wldbg_connection conn[2];
+	struct wldbg_message msg;
+	struct wldbg_capture *capture;
+	uint32_t buf[16];
+	unsigned int i;
+
+	memset(conn, 0, sizeof conn);
+	conn[0].id = 1;
+	conn[1].id = 2;
+
+	capture = wldbg_capture_create(path);
+	assert(capture);
+
+	memset(&msg, 0, sizeof msg);
+	msg.data = buf;
+	msg.size = message(buf, 1, 64) * 4;
+
+	for (i = 0; i < num; ++i) {
+		msg.connection = &conn[i < num / 2 ? i % 2 : 0];
+		msg.from = i % 3 ? CLIENT : SERVER;
+		buf[2] = i;
+		assert(wldbg_capture_write(capture, &msg) == 0);
+	}
+
+	wldbg_capture_destroy(capture);
+}
+
+TEST(index_finds_chunks)
+{
+	struct wldbg_capture_file file;
+	struct wldbg_capture_cursor cursor, found;
+	const struct wldbg_capture_record *rec;
+	const uint32_t *chunks;
+	const void *data;
+	unsigned int i, num = 10000;
+	uint64_t time = 0;
+	uint32_t n;
+	char *path = capture_path();
+
+	write_many(path, num);
+	assert(wldbg_capture_file_open(&file, path) == 0);
+	assert(!file.unfinished);
+	assert(file.chunks_num > 4);
+	assert(file.connections_num == 2);
+
+	/* all records are there in order */
+	memset(&cursor, 0, sizeof cursor);
+	for (i = 0; i < num; ++i) {
+		assert(wldbg_capture_file_next(&file, &cursor,
+					       &rec, &data) == 1);
+		assert(((const uint32_t *) data)[2] == i);
+		assert(rec->time >= time);
+		time = rec->time;
+
+		if (i == num * 3 / 4)
+			found = cursor;
+	}
+	assert(wldbg_capture_file_next(&file, &cursor, &rec, &data) == 0);
+
+	/* seeking gets to the first record with the time */
+	assert(wldbg_capture_file_next(&file, &found, &rec, &data) == 1);
+	time = rec->time;
+	assert(wldbg_capture_file_seek(&file, &cursor, time) == 0);
+	assert(wldbg_capture_file_next(&file, &cursor, &rec, &data) == 1);
+	assert(rec->time == time);
+	assert(((const uint32_t *) data)[2] <= num * 3 / 4 + 1);
+
+	/* the second connection is only in the first half */
+	n = wldbg_capture_file_connection_chunks(&file, 2, &chunks);
+	assert(n > 0 && n < file.chunks_num);
+	assert(chunks[0] == 0);
+	for (i = 0; i < n; ++i) {
+		memset(&cursor, 0, sizeof cursor);
+		cursor.chunk = chunks[i];
+		assert(wldbg_capture_file_next(&file, &cursor,
+					       &rec, &data) == 1);
+		assert(((const uint32_t *) data)[2] < num / 2);
+	}
+
+	n = wldbg_capture_file_connection_chunks(&file, 1, &chunks);
+	assert(n == file.chunks_num);
+	assert(wldbg_capture_file_connection_chunks(&file, 3, &chunks) == 0);
+
+	/* past the end */
+	assert(wldbg_capture_file_seek(&file, &cursor, time * 2) == 0);
+	assert(wldbg_capture_file_next(&file, &cursor, &rec, &data) == 0);
+
+	wldbg_capture_file_close(&file);
+	remove_capture(path);
+}
+
+TEST(unfinished_capture_keeps_whole_chunks)
+{
+	struct wldbg_capture_file file;
+	struct wldbg_capture_cursor cursor;
+	const struct wldbg_capture_record *rec;
+	const void *data;
+	uint32_t chunks_num, records = 0, i;
+	const uint32_t *chunks;
+	char *path = capture_path();
+	off_t size;
+
+	write_many(path, 5000);
+
+	assert(wldbg_capture_file_open(&file, path) == 0);
+	chunks_num = file.chunks_num;
+	assert(chunks_num > 2);
+	/* cut the file in the middle of the last but one chunk */
+	size = file.chunks[chunks_num - 2].offset + 100;
+	for (i = 0; i < chunks_num - 2; ++i)
+		records += file.chunks[i].records;
+	wldbg_capture_file_close(&file);
+
+	assert(truncate(path, size) == 0);
+
+	assert(wldbg_capture_file_open(&file, path) == 0);
+	assert(file.unfinished);
+	assert(file.chunks_num == chunks_num - 2);
+	assert(wldbg_capture_file_connection_chunks(&file, 2, &chunks)
+	       == file.chunks_num);
+	assert(chunks == NULL);
+
+	memset(&cursor, 0, sizeof cursor);
+	for (i = 0; i < records; ++i) {
+		assert(wldbg_capture_file_next(&file, &cursor,
+					       &rec, &data) == 1);
+		assert(((const uint32_t *) data)[2] == i);
+	}
+	assert(wldbg_capture_file_next(&file, &cursor, &rec, &data) == 0);
+
+	wldbg_capture_file_close(&file);
+	remove_capture(path);
+}
+
+TEST(corrupted_record)
+{
+	struct wldbg_capture_file file;
+	struct wldbg_capture_cursor cursor;
+	const struct wldbg_capture_record *rec;
+	const void *data;
+	uint16_t size = 6;
+	size_t off;
+	int fd;
+	char *path = capture_path();
+
+	write_many(path, 10);
+
+	/* the size of the second record */
+	off = sizeof(struct wldbg_capture_header)
+		+ sizeof(struct wldbg_capture_chunk)
+		+ sizeof *rec + 64
+		+ offsetof(struct wldbg_capture_record, size);
+	fd = open(path, O_WRONLY);
+	assert(fd >= 0);
+	assert(pwrite(fd, &size, sizeof size, off) == sizeof size);
+	close(fd);
+
+	assert(wldbg_capture_file_open(&file, path) == 0);
+	memset(&cursor, 0, sizeof cursor);
+	assert(wldbg_capture_file_next(&file, &cursor, &rec, &data) == 1);
+	assert(wldbg_capture_file_next(&file, &cursor, &rec, &data) == -1);
+	wldbg_capture_file_close(&file);
+
+	remove_capture(path);
+}
@@ -0,0 +1,279 @@
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "test-runner.h"
+#include "wayland-private.h"
+
+static void
+fill(char *data, size_t size, char start)
+{
+	size_t i;
+
+	for (i = 0; i < size; ++i)
+		data[i] = start + i % 64;
+}
+
+/* read size bytes into the input buffer of conn,
+ * writing them into the other end of the socketpair */
+static void
+push(struct wl_connection *conn, int fd, const char *data, size_t size)
+{
+	assert(write(fd, data, size) == (ssize_t) size);
+	assert(wl_connection_read(conn) == (int) size);
+}
+
+TEST(peek_contiguous_and_wrapped)
+{
+	int s[2];
+	char data[4096], scratch[4096];
+	struct wl_connection *conn;
+	char *p;
+
+	assert(socketpair(AF_UNIX, SOCK_STREAM, 0, s) == 0);
+	conn = wl_connection_create(s[0]);
+	assert(conn);
+
+	fill(data, 4000, 'a');
+	push(conn, s[1], data, 4000);
+
+	/* contiguous data point right into the buffer */
+	p = wl_connection_peek(conn, 8, 100, scratch);
+	assert(p != scratch);
+	assert(memcmp(p, data + 8, 100) == 0);
+
+	wl_connection_consume(conn, 4000);
+
+	/* these wrap around the end of the buffer */
+	fill(data, 200, 'A');
+	push(conn, s[1], data, 200);
+
+	p = wl_connection_peek(conn, 0, 200, scratch);
+	assert(p == scratch);
+	assert(memcmp(p, data, 200) == 0);
+
+	/* the part before the end is still contiguous */
+	p = wl_connection_peek(conn, 0, 96, scratch);
+	assert(p != scratch);
+	assert(memcmp(p, data, 96) == 0);
+
+	wl_connection_destroy(conn);
+	close(s[1]);
+}
+
+TEST(forward_keeps_order)
+{
+	int s[2], t[2];
+	char data[4096], out[4096];
+	struct wl_connection *in, *to;
+
+	assert(socketpair(AF_UNIX, SOCK_STREAM, 0, s) == 0);
+	assert(socketpair(AF_UNIX, SOCK_STREAM, 0, t) == 0);
+	in = wl_connection_create(s[0]);
+	to = wl_connection_create(t[0]);
+	assert(in && to);
+
+	/* wrap the input buffer, so that forward must use two chunks */
+	fill(data, 4000, 'a');
+	push(in, s[1], data, 4000);
+	wl_connection_consume(in, 4000);
+
+	fill(data, 200, 'A');
+	push(in, s[1], data, 200);
+
+	/* nothing is queued - sent right from the input buffer */
+	assert(wl_connection_forward(in, 0, 100, to) == 0);
+	assert(read(t[1], out, sizeof out) == 100);
+	assert(memcmp(out, data, 100) == 0);
+
+	/* something is queued - the data must go behind it */
+	assert(wl_connection_write(to, "queued", 6) == 0);
+	assert(wl_connection_forward(in, 100, 100, to) == 0);
+	assert(wl_connection_flush(to) == 106);
+	assert(read(t[1], out, sizeof out) == 106);
+	assert(memcmp(out, "queued", 6) == 0);
+	assert(memcmp(out + 6, data + 100, 100) == 0);
+
+	wl_connection_destroy(in);
+	wl_connection_destroy(to);
+	close(s[1]);
+	close(t[1]);
+}
+
+TEST(buffer_grows_up_to_max_size)
+{
+	int s[2];
+	char data[16384], out[16384];
+	struct wl_connection *conn;
+
+	assert(socketpair(AF_UNIX, SOCK_STREAM, 0, s) == 0);
+	conn = wl_connection_create_sized(s[0], 4096, 16384);
+	assert(conn);
+
+	/* the first read fills the buffer, the next ones
+	 * must grow it to get the rest of the data */
+	fill(data, sizeof data, 'a');
+	assert(write(s[1], data, sizeof data) == sizeof data);
+	while (wl_connection_read(conn) < (int) sizeof data)
+		;
+
+	wl_connection_copy(conn, out, sizeof out);
+	assert(memcmp(out, data, sizeof data) == 0);
+
+	/* full and can not grow anymore */
+	assert(write(s[1], data, 1) == 1);
+	assert(wl_connection_read(conn) == -1);
+	assert(errno == EOVERFLOW);
+
+	wl_connection_consume(conn, sizeof data);
+	assert(wl_connection_read(conn) == 1);
+
+	wl_connection_destroy(conn);
+	close(s[1]);
+}
+
+TEST(output_stays_queued_when_peer_is_full)
+{
+	int s[2], size = 4096;
+	char data[4096], out[4096];
+	struct wl_connection *conn;
+	uint32_t pending;
+
+	assert(socketpair(AF_UNIX, SOCK_STREAM, 0, s) == 0);
+	assert(setsockopt(s[0], SOL_SOCKET, SO_SNDBUF,
+			  &size, sizeof size) == 0);
+	conn = wl_connection_create_sized(s[0], 4096, 65536);
+	assert(conn);
+
+	/* fill the socket until the flush can not send everything */
+	fill(data, sizeof data, 'a');
+	do {
+		assert(wl_connection_write(conn, data, sizeof data) == 0);
+	} while (wl_connection_flush(conn) >= 0);
+
+	assert(errno == EAGAIN);
+	pending = wl_connection_pending_output(conn);
+	assert(pending > 0);
+
+	/* once the peer reads, the rest goes out */
+	while (wl_connection_pending_output(conn) > 0) {
+		assert(read(s[1], out, sizeof out) > 0);
+		if (wl_connection_flush(conn) < 0)
+			assert(errno == EAGAIN);
+	}
+
+	wl_connection_destroy(conn);
+	close(s[1]);
+}
+
+static void
+send_fds(int fd, int pass, int num)
+{
+	char cmsg[CMSG_SPACE(20 * sizeof(int))], data[8] = "message";
+	struct iovec iov = { data, sizeof data };
+	struct msghdr msg;
+	struct cmsghdr *c;
+	int i;
+
+	assert(num <= 20);
+	memset(&msg, 0, sizeof msg);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = cmsg;
+	msg.msg_controllen = CMSG_SPACE(num * sizeof(int));
+
+	c = CMSG_FIRSTHDR(&msg);
+	c->cmsg_level = SOL_SOCKET;
+	c->cmsg_type = SCM_RIGHTS;
+	c->cmsg_len = CMSG_LEN(num * sizeof(int));
+	for (i = 0; i < num; ++i)
+		((int *) CMSG_DATA(c))[i] = pass;
+
+	assert(sendmsg(fd, &msg, 0) == sizeof data);
+}
+
+/* receive until size bytes came, returns the number of fds */
+static int
+receive_fds(int fd, size_t size)
+{
+	char cmsg[CMSG_SPACE(64 * sizeof(int))], data[4096];
+	struct iovec iov = { data, sizeof data };
+	struct msghdr msg;
+	struct cmsghdr *c;
+	int fds = 0, i, n;
+	ssize_t len;
+
+	while (size > 0) {
+		memset(&msg, 0, sizeof msg);
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = cmsg;
+		msg.msg_controllen = sizeof cmsg;
+
+		len = recvmsg(fd, &msg, 0);
+		assert(len > 0 && (size_t) len <= size);
+		assert(!(msg.msg_flags & MSG_CTRUNC));
+		size -= len;
+
+		for (c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c)) {
+			n = (c->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+			for (i = 0; i < n; ++i)
+				close(((int *) CMSG_DATA(c))[i]);
+			fds += n;
+		}
+	}
+
+	return fds;
+}
+
+/* 60 fds in three messages go through a connection that has
+ * something queued or not. None may get lost */
+static void
+pass_fds(int queue)
+{
+	int s[2], t[2], p[2], i, len = 0;
+	struct wl_connection *in, *to;
+
+	assert(socketpair(AF_UNIX, SOCK_STREAM, 0, s) == 0);
+	assert(socketpair(AF_UNIX, SOCK_STREAM, 0, t) == 0);
+	assert(pipe(p) == 0);
+	in = wl_connection_create(s[0]);
+	to = wl_connection_create(t[0]);
+	assert(in && to);
+
+	/* more fds than one sendmsg can take wait for the peer */
+	for (i = 0; i < 3; ++i) {
+		send_fds(s[1], p[0], 20);
+		while (len < 8 * (i + 1))
+			len = wl_connection_read(in);
+		assert(wl_connection_copy_fds(in, to) == 0);
+	}
+
+	if (queue)
+		assert(wl_connection_write(to, "queued", 6) == 0);
+
+	assert(wl_connection_forward(in, 0, len, to) == 0);
+	assert(wl_connection_flush(to) >= 0);
+	assert(wl_connection_pending_fds(to) == 0);
+
+	assert(receive_fds(t[1], (queue ? 6 : 0) + len) == 60);
+
+	wl_connection_destroy(in);
+	wl_connection_destroy(to);
+	close(s[1]);
+	close(t[1]);
+	close(p[0]);
+	close(p[1]);
+}
+
+TEST(fds_are_not_lost)
+{
+	pass_fds(0);
+}
+
+TEST(fds_are_not_lost_with_queued_output)
+{
+	pass_fds(1);
+}
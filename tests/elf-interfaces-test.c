@@ -0,0 +1,121 @@
+#define _GNU_SOURCE
+#include <assert.h>
+#include <dirent.h>
+#include <ftw.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "test-runner.h"
+#include "wayland-util.h"
+#include "wldbg.h"
+#include "wldbg-protocols.h"
+#include "interfaces.h"
+
+/* what wayland-scanner would generate, the test reads it
+ * back from its own binary */
+extern const struct wl_interface test_parent_interface;
+extern const struct wl_interface test_child_interface;
+
+static const struct wl_interface *test_types[] = {
+	NULL,
+	NULL,
+	&test_child_interface,
+	&test_parent_interface,
+};
+
+static const struct wl_message test_parent_requests[] = {
+	{ "set_size", "2ii", test_types + 0 },
+	{ "create_child", "n", test_types + 2 },
+};
+
+static const struct wl_message test_parent_events[] = {
+	{ "done", "u", test_types + 0 },
+};
+
+static const struct wl_message test_child_events[] = {
+	{ "parent", "?o", test_types + 3 },
+};
+
+const struct wl_interface test_parent_interface = {
+	"test_parent", 3,
+	2, test_parent_requests,
+	1, test_parent_events,
+};
+
+const struct wl_interface test_child_interface = {
+	"test_child", 1,
+	0, NULL,
+	1, test_child_events,
+};
+
+static char dir[] = "/tmp/wldbg-elf-test-XXXXXX";
+
+static int
+remove_entry(const char *path, const struct stat *st, int flag,
+	     struct FTW *ftw)
+{
+	return remove(path);
+}
+
+static void
+check_loaded(void)
+{
+	const struct wl_interface *parent, *child;
+
+	assert(wldbg_protocols_load_binary("/proc/self/exe") == 2);
+
+	parent = wldbg_interface_lookup("test_parent");
+	child = wldbg_interface_lookup("test_child");
+	assert(parent && child);
+
+	/* copies, not the interfaces of the binary */
+	assert(parent != &test_parent_interface);
+	assert(parent->version == 3);
+	assert(parent->method_count == 2 && parent->event_count == 1);
+	assert(strcmp(parent->methods[0].name, "set_size") == 0);
+	assert(strcmp(parent->methods[0].signature, "2ii") == 0);
+	assert(parent->methods[0].types[0] == NULL);
+	assert(parent->methods[1].types[0] == child);
+	assert(strcmp(parent->events[0].signature, "u") == 0);
+	assert(child->method_count == 0);
+	assert(strcmp(child->events[0].signature, "?o") == 0);
+	assert(child->events[0].types[0] == parent);
+
+	wldbg_interfaces_clear();
+	wldbg_protocols_release();
+}
+
+TEST(load_binary)
+{
+	struct dirent **entries;
+	int i, num;
+
+	assert(mkdtemp(dir));
+	wldbg_protocols_set_cache_dir(dir);
+
+	/* read from the binary and then from the cache */
+	check_loaded();
+	check_loaded();
+
+	num = scandir(dir, &entries, NULL, alphasort);
+	for (i = 0; i < num; ++i)
+		free(entries[i]);
+	free(entries);
+	/* ., .. and the cache */
+	assert(num == 3);
+
+	wldbg_protocols_set_cache_dir(NULL);
+	assert(nftw(dir, remove_entry, 8, FTW_DEPTH | FTW_PHYS) == 0);
+}
+
+TEST(load_not_elf)
+{
+	/* not found or not an ELF, we just do not know anything */
+	assert(wldbg_protocols_load_binary("/nonexistent/program") == 0);
+	assert(wldbg_protocols_load_binary("/etc/passwd") == 0);
+	assert(wldbg_interface_lookup("test_parent") == NULL);
+
+	wldbg_protocols_release();
+}
@@ -0,0 +1,192 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "test-runner.h"
+#include "wldbg.h"
+#include "wldbg-private.h"
+#include "wldbg-capture.h"
+#include "flight-recorder.h"
+
+/* put message number n of given size (in bytes) into the ring */
+static void
+record(struct wldbg_flight_recorder *recorder,
+       struct wldbg_message *msg, uint32_t n, uint16_t size)
+{
+	uint32_t *data;
+
+	data = wldbg_flight_recorder_reserve(recorder, size);
+	assert(data);
+
+	memset(data, 0, size);
+	data[0] = n;
+	data[1] = size << 16;
+	wldbg_flight_recorder_commit(recorder, msg, n);
+}
+
+/* write the ring into a capture and check that it has
+ * the messages from first to last in order */
+static uint32_t
+check_ring(struct wldbg_flight_recorder *recorder, uint32_t last)
+{
+	static char dir[] = "/tmp/wldbg-flight-test-XXXXXX";
+	struct wldbg_capture *capture;
+	struct wldbg_capture_file file;
+	struct wldbg_capture_cursor cursor;
+	const struct wldbg_capture_record *rec;
+	const void *data;
+	uint32_t num = 0, expected = 0;
+	char path[64];
+
+	assert(mkdtemp(dir));
+	snprintf(path, sizeof path, "%s/ring", dir);
+
+	capture = wldbg_capture_create(path);
+	assert(capture);
+	assert(wldbg_flight_recorder_write(recorder, capture) == 0);
+	wldbg_capture_destroy(capture);
+
+	assert(wldbg_capture_file_open(&file, path) == 0);
+	memset(&cursor, 0, sizeof cursor);
+	while (wldbg_capture_file_next(&file, &cursor, &rec, &data) > 0) {
+		if (num == 0)
+			expected = rec->time;
+
+		assert(rec->time == expected);
+		assert(((const uint32_t *) data)[0] == expected);
+		assert(rec->connection == 3);
+		++expected;
+		++num;
+	}
+
+	assert(num == recorder->records);
+	if (num > 0)
+		assert(expected == last + 1);
+
+	wldbg_capture_file_close(&file);
+	unlink(path);
+	rmdir(dir);
+	/* mkdtemp needs the template back */
+	strcpy(dir + strlen(dir) - 6, "XXXXXX");
+
+	return num;
+}
+
+TEST(ring_keeps_last_messages)
+{
+	struct wldbg_flight_recorder *recorder;
+	struct wldbg_connection conn;
+	struct wldbg_message msg;
+	uint32_t n, num;
+
+	memset(&conn, 0, sizeof conn);
+	conn.id = 3;
+	memset(&msg, 0, sizeof msg);
+	msg.connection = &conn;
+	msg.from = SERVER;
+
+	recorder = wldbg_flight_recorder_create(1000);
+	assert(recorder);
+	assert(recorder->size == 1000);
+
+	/* different sizes, so that the end of the ring is
+	 * skipped at different places */
+	for (n = 0; n < 500; ++n) {
+		record(recorder, &msg, n, 8 + (n % 7) * 12);
+
+		num = check_ring(recorder, n);
+		assert(num > 0);
+		/* at most the ring size, and once it is full, not less
+		 * than the ring without the skipped end and the space
+		 * for the next message (96 bytes at most) */
+		assert(num * (16 + 8) <= 1000);
+		if (n >= 100)
+			assert(num * 96 >= 1000 - 2 * 96);
+	}
+
+	/* bigger than the whole ring */
+	num = recorder->records;
+	assert(wldbg_flight_recorder_reserve(recorder, 2000) == NULL);
+	assert(recorder->dropped == 1);
+	assert(recorder->records == num);
+	assert(check_ring(recorder, 499) == num);
+
+	wldbg_flight_recorder_clear(recorder);
+	assert(check_ring(recorder, 0) == 0);
+
+	record(recorder, &msg, 7, 32);
+	assert(check_ring(recorder, 7) == 1);
+
+	wldbg_flight_recorder_destroy(recorder);
+}
+
+TEST(message_of_ring_size)
+{
+	struct wldbg_flight_recorder *recorder;
+	struct wldbg_connection conn;
+	struct wldbg_message msg;
+	uint32_t n;
+
+	memset(&conn, 0, sizeof conn);
+	conn.id = 3;
+	memset(&msg, 0, sizeof msg);
+	msg.connection = &conn;
+
+	recorder = wldbg_flight_recorder_create(16 + 64);
+	assert(recorder);
+
+	/* every message takes the whole ring */
+	for (n = 0; n < 10; ++n) {
+		record(recorder, &msg, n, 64);
+		assert(check_ring(recorder, n) == 1);
+	}
+
+	wldbg_flight_recorder_destroy(recorder);
+}
+
+TEST(trigger_writes_capture_file)
+{
+	struct wldbg wldbg;
+	struct wldbg_connection conn;
+	struct wldbg_message msg;
+	struct wldbg_capture_file file;
+	char dir[] = "/tmp/wldbg-flight-test-XXXXXX";
+	char path[64];
+
+	memset(&wldbg, 0, sizeof wldbg);
+	memset(&conn, 0, sizeof conn);
+	conn.wldbg = &wldbg;
+	conn.id = 3;
+	memset(&msg, 0, sizeof msg);
+	msg.connection = &conn;
+
+	/* without the recorder it does nothing */
+	assert(wldbg_flight_recorder_trigger(&conn, "test") == 0);
+	assert(wldbg.flight_recorder.dumps == 0);
+
+	conn.flight_recorder = wldbg_flight_recorder_create(4096);
+	assert(conn.flight_recorder);
+	record(conn.flight_recorder, &msg, 1, 8);
+	record(conn.flight_recorder, &msg, 2, 8);
+
+	/* files are written into the current directory */
+	assert(mkdtemp(dir));
+	assert(chdir(dir) == 0);
+	assert(wldbg_flight_recorder_trigger(&conn, "test") == 0);
+	assert(conn.flight_recorder->records == 0);
+
+	snprintf(path, sizeof path, "wldbg-flight-%d-3-1.cap", getpid());
+	assert(wldbg_capture_file_open(&file, path) == 0);
+	assert(file.chunks_num == 1);
+	assert(file.chunks[0].records == 2);
+	wldbg_capture_file_close(&file);
+
+	unlink(path);
+	assert(chdir("/") == 0);
+	rmdir(dir);
+
+	wldbg_flight_recorder_destroy(conn.flight_recorder);
+}
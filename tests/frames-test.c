@@ -0,0 +1,138 @@
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "test-runner.h"
+#include "wayland-private.h"
+#include "frames.h"
+
+/* write a message with given size (in bytes) into data */
+static size_t
+message(uint32_t *data, uint32_t id, uint32_t size)
+{
+	data[0] = id;
+	data[1] = size << 16;
+
+	return size / sizeof(uint32_t);
+}
+
+TEST(partial_message_stays_in_buffer)
+{
+	int s[2];
+	uint32_t data[64];
+	size_t n = 0;
+	struct wl_connection *conn;
+	struct wldbg_frames frames;
+
+	assert(socketpair(AF_UNIX, SOCK_STREAM, 0, s) == 0);
+	conn = wl_connection_create(s[0]);
+	assert(conn);
+	wldbg_frames_init(&frames);
+
+	n += message(data + n, 1, 8);
+	n += message(data + n, 2, 16);
+	n += message(data + n, 3, 24);
+
+	/* the third message and the header of the second one are split */
+	assert(write(s[1], data, 12) == 12);
+	assert(wl_connection_read(conn) == 12);
+	assert(wldbg_frames_scan(&frames, conn, 12, 4096) == 1);
+	assert(frames.length == 8);
+	assert(wldbg_frames_get(&frames, 0)->offset == 0);
+	assert(wldbg_frames_get(&frames, 0)->size == 8);
+
+	wl_connection_consume(conn, frames.length);
+
+	assert(write(s[1], (char *) data + 12, 20) == 20);
+	assert(wl_connection_read(conn) == 24);
+	assert(wldbg_frames_scan(&frames, conn, 24, 4096) == 1);
+	assert(frames.length == 16);
+	assert(wldbg_frames_get(&frames, 0)->size == 16);
+
+	wl_connection_consume(conn, frames.length);
+
+	assert(write(s[1], (char *) data + 32, 16) == 16);
+	assert(wl_connection_read(conn) == 24);
+	assert(wldbg_frames_scan(&frames, conn, 24, 4096) == 1);
+	assert(wldbg_frames_get(&frames, 0)->size == 24);
+
+	wldbg_frames_release(&frames);
+	wl_connection_destroy(conn);
+	close(s[1]);
+}
+
+TEST(index_many_messages)
+{
+	int s[2], i;
+	uint32_t data[1024];
+	size_t n = 0;
+	struct wl_connection *conn;
+	struct wldbg_frames frames;
+
+	assert(socketpair(AF_UNIX, SOCK_STREAM, 0, s) == 0);
+	conn = wl_connection_create(s[0]);
+	assert(conn);
+	wldbg_frames_init(&frames);
+
+	for (i = 0; i < 100; ++i)
+		n += message(data + n, i, 8 + (i % 3) * 4);
+
+	n *= sizeof(uint32_t);
+	assert(write(s[1], data, n) == (ssize_t) n);
+	assert(wl_connection_read(conn) == (int) n);
+	assert(wldbg_frames_scan(&frames, conn, n, 4096) == 100);
+	assert(frames.length == n);
+
+	for (i = 0; i < 100; ++i) {
+		assert(wldbg_frames_get(&frames, i)->size == 8 + (i % 3) * 4u);
+		if (i > 0)
+			assert(wldbg_frames_get(&frames, i)->offset
+			       == wldbg_frames_get(&frames, i - 1)->offset
+				  + wldbg_frames_get(&frames, i - 1)->size);
+	}
+
+	wldbg_frames_release(&frames);
+	wl_connection_destroy(conn);
+	close(s[1]);
+}
+
+TEST(invalid_sizes)
+{
+	int s[2];
+	uint32_t data[4];
+	struct wl_connection *conn;
+	struct wldbg_frames frames;
+
+	assert(socketpair(AF_UNIX, SOCK_STREAM, 0, s) == 0);
+	conn = wl_connection_create(s[0]);
+	assert(conn);
+	wldbg_frames_init(&frames);
+
+	/* smaller than the header */
+	message(data, 1, 4);
+	assert(write(s[1], data, 8) == 8);
+	assert(wl_connection_read(conn) == 8);
+	assert(wldbg_frames_scan(&frames, conn, 8, 4096) == -1);
+	assert(errno == EINVAL);
+	wl_connection_consume(conn, 8);
+
+	/* not aligned */
+	message(data, 1, 10);
+	assert(write(s[1], data, 8) == 8);
+	assert(wl_connection_read(conn) == 8);
+	assert(wldbg_frames_scan(&frames, conn, 8, 4096) == -1);
+	wl_connection_consume(conn, 8);
+
+	/* would never fit into the buffer */
+	message(data, 1, 8192);
+	assert(write(s[1], data, 8) == 8);
+	assert(wl_connection_read(conn) == 8);
+	assert(wldbg_frames_scan(&frames, conn, 8, 4096) == -1);
+
+	wldbg_frames_release(&frames);
+	wl_connection_destroy(conn);
+	close(s[1]);
+}
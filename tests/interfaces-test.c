@@ -0,0 +1,183 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test-runner.h"
+#include "wayland-util.h"
+#include "wldbg.h"
+#include "interfaces.h"
+#include "wldbg-parse-message.h"
+
+static const struct wl_interface foo_interface = {
+	"foo", 1, 0, NULL, 0, NULL
+};
+
+static const struct wl_interface bar_interface = {
+	"bar", 3, 0, NULL, 0, NULL
+};
+
+/* the same interface from some other library */
+static const struct wl_interface foo_copy_interface = {
+	"foo", 1, 0, NULL, 0, NULL
+};
+
+TEST(dense_ids)
+{
+	uint32_t foo, bar;
+
+	assert(wldbg_interface_lookup("foo") == NULL);
+	assert(wldbg_interface_id(&foo_interface) == 0);
+
+	foo = wldbg_interfaces_add(&foo_interface);
+	bar = wldbg_interfaces_add(&bar_interface);
+	assert(foo == 1 && bar == 2);
+	assert(wldbg_interfaces_count() == 3);
+
+	/* adding it again does not change anything */
+	assert(wldbg_interfaces_add(&bar_interface) == bar);
+	assert(wldbg_interfaces_count() == 3);
+
+	assert(wldbg_interface_id(&foo_interface) == foo);
+	assert(wldbg_interface_get(bar) == &bar_interface);
+	assert(wldbg_interface_get(0) == NULL);
+	assert(wldbg_interface_get(3) == NULL);
+	assert(wldbg_interface_lookup("bar") == &bar_interface);
+	assert(wldbg_interface_lookup("baz") == NULL);
+
+	wldbg_interfaces_clear();
+	assert(wldbg_interfaces_count() == 0);
+	assert(wldbg_interface_lookup("foo") == NULL);
+}
+
+TEST(copies_have_the_same_id)
+{
+	uint32_t foo;
+
+	foo = wldbg_interfaces_add(&foo_interface);
+
+	/* not added yet, but the name is known */
+	assert(wldbg_interface_id(&foo_copy_interface) == foo);
+
+	assert(wldbg_interfaces_add(&foo_copy_interface) == foo);
+	assert(wldbg_interface_id(&foo_copy_interface) == foo);
+	/* the name has the first interface */
+	assert(wldbg_interface_lookup("foo") == &foo_interface);
+	assert(wldbg_interfaces_count() == 2);
+
+	wldbg_interfaces_clear();
+}
+
+TEST(many_interfaces)
+{
+	struct wl_interface *intfs;
+	char (*names)[16];
+	unsigned int i, num = 1000;
+
+	intfs = calloc(num, sizeof *intfs);
+	names = calloc(num, sizeof *names);
+	assert(intfs && names);
+
+	for (i = 0; i < num; ++i) {
+		snprintf(names[i], sizeof *names, "intf_%u", i);
+		intfs[i].name = names[i];
+		assert(wldbg_interfaces_add(&intfs[i]) == i + 1);
+	}
+
+	for (i = 0; i < num; ++i) {
+		assert(wldbg_interface_lookup(names[i]) == &intfs[i]);
+		assert(wldbg_interface_id(&intfs[i]) == i + 1);
+		assert(wldbg_interface_get(i + 1) == &intfs[i]);
+	}
+
+	wldbg_interfaces_clear();
+	free(intfs);
+	free(names);
+}
+
+TEST(compile_signature)
+{
+	struct wldbg_signature sig;
+
+	assert(wldbg_signature_compile(&sig, "2?ousn?ah") == 0);
+	assert(sig.args_num == 6);
+	assert(memcmp(sig.types, "ousnah", 6) == 0);
+	assert(sig.nullable == ((1 << 0) | (1 << 4)));
+	assert(sig.varlen == ((1 << 2) | (1 << 4)));
+	assert(sig.first_varlen == 2);
+	assert(sig.new_ids_num == 1 && sig.new_ids[0] == 3);
+	assert(sig.fds_num == 1);
+	assert(sig.since == 2);
+	assert(!WLDBG_SIGNATURE_FIXED_SIZE(&sig));
+
+	assert(wldbg_signature_compile(&sig, "iuf") == 0);
+	assert(WLDBG_SIGNATURE_FIXED_SIZE(&sig));
+	assert(sig.since == 1);
+
+	assert(wldbg_signature_compile(&sig, "12u") == 0);
+	assert(sig.since == 12 && sig.args_num == 1);
+
+	assert(wldbg_signature_compile(&sig, "") == 0);
+	assert(sig.args_num == 0);
+
+	assert(wldbg_signature_compile(&sig, "ix") < 0);
+}
+
+static const struct wl_interface child_interface;
+
+static const struct wl_interface *parent_types[] = {
+	NULL,
+	&child_interface,
+	NULL,
+};
+
+static const struct wl_message parent_requests[] = {
+	{ "create", "sn", parent_types },
+	{ "broken", "q", parent_types },
+};
+
+static const struct wl_message parent_events[] = {
+	{ "done", "2u", parent_types },
+};
+
+static const struct wl_interface parent_interface = {
+	"parent", 1, 2, parent_requests, 1, parent_events
+};
+
+static const struct wl_message child_events[] = {
+	{ "fd", "hh", NULL },
+};
+
+static const struct wl_interface child_interface = {
+	"child", 1, 0, NULL, 1, child_events
+};
+
+TEST(registered_signatures)
+{
+	const struct wldbg_signature *sig;
+
+	wldbg_interfaces_add(&parent_interface);
+
+	/* types of new_id arguments are registered with it */
+	assert(wldbg_interface_id(&child_interface) != 0);
+
+	sig = wldbg_interface_get_signature(&parent_interface, SERVER, 0);
+	assert(sig && sig->args_num == 1 && sig->types[0] == 'u');
+
+	sig = wldbg_interface_get_signature(&parent_interface, CLIENT, 0);
+	assert(sig && sig->new_ids_num == 1 && sig->new_ids[0] == 1);
+
+	/* invalid signature and opcodes out of range */
+	assert(!wldbg_interface_get_signature(&parent_interface, CLIENT, 1));
+	assert(!wldbg_interface_get_signature(&parent_interface, CLIENT, 2));
+	assert(!wldbg_interface_get_signature(&parent_interface, SERVER, 1));
+
+	sig = wldbg_interface_get_signature(&child_interface, SERVER, 0);
+	assert(sig && sig->fds_num == 2);
+
+	/* not registered */
+	assert(!wldbg_interface_get_signature(&foo_interface, SERVER, 0));
+
+	wldbg_interfaces_clear();
+	assert(!wldbg_interface_get_signature(&parent_interface, SERVER, 0));
+}
@@ -0,0 +1,46 @@
+#include <assert.h>
+#include <string.h>
+
+#include "test-runner.h"
+#include "latency.h"
+
+TEST(histogram_percentiles)
+{
+	static struct wldbg_histogram h;
+	uint64_t i, v;
+
+	memset(&h, 0, sizeof h);
+	assert(wldbg_histogram_percentile(&h, 0.5) == 0);
+
+	/* 1 us - 1000 us */
+	for (i = 1; i <= 1000; ++i)
+		wldbg_histogram_add(&h, i * 1000, 1);
+
+	assert(h.count == 1000);
+	assert(h.max == 1000000);
+
+	/* the error is at most 1/32 of the value */
+	v = wldbg_histogram_percentile(&h, 0.5);
+	assert(v >= 500000 && v <= 500000 + 500000 / 32);
+	v = wldbg_histogram_percentile(&h, 0.99);
+	assert(v >= 990000 && v <= 990000 + 990000 / 32);
+	assert(wldbg_histogram_percentile(&h, 1.0) == 1000000);
+}
+
+TEST(histogram_small_and_huge_values)
+{
+	static struct wldbg_histogram h;
+
+	memset(&h, 0, sizeof h);
+
+	/* small values are exact */
+	wldbg_histogram_add(&h, 7, 10);
+	assert(wldbg_histogram_percentile(&h, 0.5) == 7);
+
+	/* values out of range go to the last bucket,
+	 * but max is still right */
+	wldbg_histogram_add(&h, (uint64_t) 1 << 50, 90);
+	assert(h.count == 100);
+	assert(wldbg_histogram_percentile(&h, 0.999) == (uint64_t) 1 << 50);
+	assert(wldbg_histogram_percentile(&h, 0.05) == 7);
+}
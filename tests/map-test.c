@@ -1,4 +1,9 @@
 #include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
 #include "wldbg-ids-map.h"
 #include "test-runner.h"
 
@@ -39,3 +44,260 @@ TEST(map_insert)
 
 	wldbg_ids_map_release(&m);
 }
+
+TEST(map_versions)
+{
+	struct wldbg_ids_map m;
+
+	wldbg_ids_map_init(&m);
+	assert(wldbg_ids_map_get_version(&m, 3) == 0);
+
+	wldbg_ids_map_insert_version(&m, 3, (void *) 0x3, 4);
+	assert(wldbg_ids_map_get(&m, 3) == (void *) 0x3);
+	assert(wldbg_ids_map_get_version(&m, 3) == 4);
+	/* the gap has nothing */
+	assert(wldbg_ids_map_get_version(&m, 2) == 0);
+
+	/* without a version it is not known anymore */
+	wldbg_ids_map_insert(&m, 3, (void *) 0x4);
+	assert(wldbg_ids_map_get_version(&m, 3) == 0);
+
+	wldbg_ids_map_release(&m);
+}
+
+TEST(map_pages)
+{
+	struct wldbg_ids_map m;
+	uint32_t i;
+
+	wldbg_ids_map_init(&m);
+
+	/* the whole range before the id is not allocated */
+	wldbg_ids_map_insert(&m, 0xfeeeeeee, (void *) 0x1);
+	wldbg_ids_map_insert(&m, 0x80000000, (void *) 0x2);
+	wldbg_ids_map_insert(&m, 0x90000000, (void *) 0x3);
+	assert(m.pages_num == 3);
+	assert(m.direct_size == 0);
+	assert(wldbg_ids_map_get(&m, 0xfeeeeeee) == (void *) 0x1);
+	assert(wldbg_ids_map_get(&m, 0x80000000) == (void *) 0x2);
+	assert(wldbg_ids_map_get(&m, 0x90000000) == (void *) 0x3);
+	assert(wldbg_ids_map_get(&m, 0xfeeeeeef) == NULL);
+	assert(wldbg_ids_map_get(&m, 0x7fffffff) == NULL);
+
+	/* pages of dense ids are allocated when needed... */
+	for (i = 1; i <= 3 * WLDBG_IDS_MAP_PAGE_SIZE; ++i)
+		wldbg_ids_map_insert(&m, i, (void *) (uintptr_t) i);
+	assert(m.pages_num == 3 + 4);
+	for (i = 1; i <= 3 * WLDBG_IDS_MAP_PAGE_SIZE; ++i)
+		assert(wldbg_ids_map_get(&m, i) == (void *) (uintptr_t) i);
+
+	/* ...and freed when they are empty */
+	for (i = WLDBG_IDS_MAP_PAGE_SIZE; i < 2 * WLDBG_IDS_MAP_PAGE_SIZE; ++i)
+		wldbg_ids_map_remove(&m, i);
+	assert(m.pages_num == 3 + 3);
+	assert(wldbg_ids_map_get(&m, WLDBG_IDS_MAP_PAGE_SIZE) == NULL);
+
+	wldbg_ids_map_remove(&m, 0x80000000);
+	wldbg_ids_map_insert(&m, 0x90000000, NULL);
+	assert(m.pages_num == 1 + 3);
+	assert(wldbg_ids_map_get(&m, 0xfeeeeeee) == (void *) 0x1);
+
+	/* removing what is not there does not allocate */
+	wldbg_ids_map_remove(&m, 0xa0000000);
+	assert(m.pages_num == 1 + 3);
+
+	wldbg_ids_map_release(&m);
+}
+
+static void
+collect_id(uint32_t id, void *data, void *user_data)
+{
+	uint32_t **ids = user_data;
+
+	assert(data == (void *) (uintptr_t) (id + 1));
+	*(*ids)++ = id;
+}
+
+TEST(map_for_each)
+{
+	static const uint32_t inserted[] = {
+		0, 5, 300, 0x40000, 0x50000, 0xff000000
+	};
+	struct wldbg_ids_map m;
+	uint32_t ids[16], *p = ids;
+	unsigned int i;
+
+	wldbg_ids_map_init(&m);
+
+	for (i = sizeof inserted / sizeof *inserted; i > 0; --i)
+		wldbg_ids_map_insert(&m, inserted[i - 1],
+				     (void *) (uintptr_t) (inserted[i - 1] + 1));
+	wldbg_ids_map_insert(&m, 7, (void *) 0x8);
+	wldbg_ids_map_remove(&m, 7);
+
+	wldbg_ids_map_for_each(&m, collect_id, &p);
+	assert(p - ids == sizeof inserted / sizeof *inserted);
+	assert(memcmp(ids, inserted, sizeof inserted) == 0);
+
+	wldbg_ids_map_release(&m);
+}
+
+TEST(map_generations)
+{
+	struct wldbg_ids_map m;
+	struct wldbg_ids_map_entry *e;
+	const struct wldbg_ids_map_entry *c;
+	uint32_t first;
+
+	wldbg_ids_map_init(&m);
+	assert(wldbg_ids_map_get_entry(&m, 3) == NULL);
+
+	/* something else in the page */
+	wldbg_ids_map_insert(&m, 1, (void *) 0x1);
+
+	e = wldbg_ids_map_insert_version(&m, 3, (void *) 0x1, 1);
+	assert(e && e->generation != 0);
+	e->created = 10;
+	first = e->generation;
+
+	/* the destroyed object is still known... */
+	wldbg_ids_map_destroy(&m, 3, 20);
+	assert(wldbg_ids_map_get(&m, 3) == NULL);
+	assert(wldbg_ids_map_get_version(&m, 3) == 0);
+	c = wldbg_ids_map_get_entry(&m, 3);
+	assert(c && c->generation == first);
+	assert(c->created == 10 && c->destroyed == 20);
+
+	/* ...until the id is used again */
+	e = wldbg_ids_map_insert_version(&m, 3, (void *) 0x2, 1);
+	assert(e->generation != first);
+	assert(e->created == 0 && e->destroyed == 0);
+
+	/* destroyed entries do not keep pages, only the last one is kept */
+	wldbg_ids_map_insert(&m, 5000, (void *) 0x3);
+	assert(m.pages_num == 2);
+	wldbg_ids_map_destroy(&m, 5000, 30);
+	assert(m.pages_num == 1);
+	c = wldbg_ids_map_get_entry(&m, 5000);
+	assert(c && c->destroyed == 30);
+
+	wldbg_ids_map_insert(&m, 4, (void *) 0x5);
+	wldbg_ids_map_destroy(&m, 4, 40);
+	assert(wldbg_ids_map_get_entry(&m, 5000) == NULL);
+	assert(wldbg_ids_map_get_entry(&m, 4)->destroyed == 40);
+
+	/* and the generation is not given again with a new page */
+	e = wldbg_ids_map_insert_version(&m, 5000, (void *) 0x4, 1);
+	assert(e->generation > first + 1);
+
+	wldbg_ids_map_release(&m);
+}
+
+/*
+ * Micro-benchmarks against the flat array that the map was before.
+ * They only print the times, use ./map-test map_bench to run them alone
+ */
+
+struct flat_map {
+	uint32_t count;
+	struct wl_array data;
+};
+
+static void
+flat_map_insert(struct flat_map *map, uint32_t id, void *data)
+{
+	struct wldbg_ids_map_entry *p;
+	size_t size;
+
+	if (id >= map->count) {
+		size = (id - map->count + 1) * sizeof *p;
+		p = wl_array_add(&map->data, size);
+		assert(p);
+		memset(p, 0, size);
+		map->count = map->data.size / sizeof *p;
+	}
+
+	p = ((struct wldbg_ids_map_entry *) map->data.data) + id;
+	p->data = data;
+}
+
+static void *
+flat_map_get(struct flat_map *map, uint32_t id)
+{
+	if (id < map->count)
+		return ((struct wldbg_ids_map_entry *) map->data.data)[id].data;
+
+	return NULL;
+}
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* ids like in a real connection, most of them are low */
+#define BENCH_IDS	4096
+#define BENCH_LOOKUPS	(1 << 22)
+
+TEST(map_bench)
+{
+	struct wldbg_ids_map m;
+	struct flat_map f = { 0, { 0, 0, NULL } };
+	uint32_t *ids, i;
+	uintptr_t sum = 0;
+	double start, t_map, t_flat;
+
+	ids = malloc(BENCH_LOOKUPS * sizeof *ids);
+	assert(ids);
+	srand(1);
+	for (i = 0; i < BENCH_LOOKUPS; ++i)
+		ids[i] = 1 + rand() % BENCH_IDS;
+
+	wldbg_ids_map_init(&m);
+	wl_array_init(&f.data);
+
+	start = now();
+	for (i = 1; i <= BENCH_IDS; ++i)
+		wldbg_ids_map_insert(&m, i, (void *) (uintptr_t) i);
+	t_map = now() - start;
+
+	start = now();
+	for (i = 1; i <= BENCH_IDS; ++i)
+		flat_map_insert(&f, i, (void *) (uintptr_t) i);
+	t_flat = now() - start;
+
+	fprintf(stderr, "insert:         map %6.1f ns, flat %6.1f ns\n",
+		t_map / BENCH_IDS, t_flat / BENCH_IDS);
+
+	start = now();
+	for (i = 0; i < BENCH_LOOKUPS; ++i)
+		sum += (uintptr_t) wldbg_ids_map_get(&m, ids[i]);
+	t_map = now() - start;
+
+	start = now();
+	for (i = 0; i < BENCH_LOOKUPS; ++i)
+		sum -= (uintptr_t) flat_map_get(&f, ids[i]);
+	t_flat = now() - start;
+
+	fprintf(stderr, "lookup:         map %6.1f ns, flat %6.1f ns\n",
+		t_map / BENCH_LOOKUPS, t_flat / BENCH_LOOKUPS);
+	assert(sum == 0);
+
+	/* one broken id */
+	start = now();
+	wldbg_ids_map_insert(&m, 0xfe000000, (void *) 0x1);
+	t_map = now() - start;
+
+	fprintf(stderr, "id 0xfe000000:  map %6.1f us and %u pages "
+		"of %zu bytes, flat would need %zu MB\n",
+		t_map / 1000, m.pages_num, sizeof(struct wldbg_ids_map_page),
+		(size_t) 0xfe000000 * sizeof(struct wldbg_ids_map_entry) >> 20);
+
+	wldbg_ids_map_release(&m);
+	wl_array_release(&f.data);
+	free(ids);
+}
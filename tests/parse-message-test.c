@@ -66,6 +66,7 @@ TEST(resolved_message_iterator_types)
 		.wl_interface = &dummy_interface,
 		.wl_message = &dummy_requests[0],
 		.base.data = data,
+		.base.size = 8 + sizeof data,
 	};
 
 	wldbg_resolved_message_reset_iterator(&rm);
@@ -108,7 +109,8 @@ TEST(resolved_iterator_test)
 	struct wldbg_resolved_message rm = {
 		.wl_interface = &dummy_interface,
 		.wl_message = &dummy_events[0],
-		.base.data = data
+		.base.data = data,
+		.base.size = 8 + sizeof data,
 	};
 
 	wldbg_resolved_message_reset_iterator(&rm);
@@ -196,12 +198,13 @@ TEST(resolve_message_test2)
 	/* { "foo2", "1usu", NULL } */
 	uint32_t data[] = { 123,
 			    17 /* string size */,
-			    0xdee1, 0xdee2, 0xdee3, 0xdee4, 0xdee5,
+			    0xdee1, 0xdee2, 0xdee3, 0xdee4, 0xde00,
 			    12 };
 	struct wldbg_resolved_message rm = {
 		.wl_interface = &dummy_interface,
 		.wl_message = &dummy_events[1],
-		.base.data = data
+		.base.data = data,
+		.base.size = 8 + sizeof data,
 	};
 
 	wldbg_resolved_message_reset_iterator(&rm);
@@ -250,3 +253,163 @@ TEST(message_no_arguments)
 	arg = wldbg_resolved_message_next_argument(&rm);
 	assert(arg == NULL);
 }
+
+TEST(signature_arg_offset)
+{
+	/* "usau" - a string of 5 bytes and an array of 8 bytes */
+	uint32_t data[] = { 1, 5, 0, 0, 8, 0, 0, 2 };
+	struct wldbg_signature sig;
+
+	assert(wldbg_signature_compile(&sig, "usau") == 0);
+	assert(wldbg_signature_arg_offset(&sig, data, 8, 0) == 0);
+	assert(wldbg_signature_arg_offset(&sig, data, 8, 1) == 1);
+	assert(wldbg_signature_arg_offset(&sig, data, 8, 2) == 4);
+	assert(wldbg_signature_arg_offset(&sig, data, 8, 3) == 7);
+
+	/* the last argument is not in the message */
+	assert(wldbg_signature_arg_offset(&sig, data, 7, 3) == -1);
+
+	/* the array is longer than the message */
+	data[4] = 0xfffffffc;
+	assert(wldbg_signature_arg_offset(&sig, data, 8, 3) == -1);
+	data[4] = 13;
+	assert(wldbg_signature_arg_offset(&sig, data, 8, 3) == -1);
+}
+
+TEST(message_args_random_access)
+{
+	/* { "foo", "1s?a?sa?2s", NULL } */
+	uint32_t data[] = { 16 /* string size */,
+			    0xdee1, 0xdee2, 0xdee3, 0xdee4,
+			    0 /* array size */,
+			    0 /* string size */,
+			    12 /* array size */,
+			    0xaaa1, 0xaaa2, 0xaaa3,
+			    0};
+	struct wldbg_resolved_message rm = {
+		.wl_interface = &dummy_interface,
+		.wl_message = &dummy_events[0],
+		.base.data = data,
+		.base.size = 8 + sizeof data,
+	};
+	struct wldbg_message_args args;
+	const struct wldbg_message_arg *arg;
+
+	assert(wldbg_resolved_message_get_args(&rm, &args) == 0);
+	assert(args.num == 5);
+
+	/* in any order */
+	arg = wldbg_message_args_get(&args, 3);
+	assert(arg->type == 'a');
+	assert(!arg->nullable);
+	assert(arg->data == data + 8);
+	assert(arg->length == 12);
+
+	arg = wldbg_message_args_get(&args, 0);
+	assert(arg->type == 's');
+	assert(arg->data == data + 1);
+	assert(arg->length == 16);
+
+	arg = wldbg_message_args_get(&args, 4);
+	assert(arg->type == 's');
+	assert(arg->nullable);
+	assert(arg->data == NULL);
+	assert(arg->length == 0);
+
+	arg = wldbg_message_args_get(&args, 1);
+	assert(arg->type == 'a');
+	assert(arg->data == NULL);
+
+	assert(wldbg_message_args_get(&args, 5) == NULL);
+}
+
+TEST(message_args_malformed)
+{
+	/* { "foo2", "1usu", NULL } */
+	uint32_t data[] = { 123,
+			    8 /* string size */,
+			    0x64636261, 0x00676665,
+			    12 };
+	struct wldbg_resolved_message rm = {
+		.wl_interface = &dummy_interface,
+		.wl_message = &dummy_events[1],
+		.base.data = data,
+		.base.size = 8 + sizeof data,
+	};
+	struct wldbg_message_args args;
+
+	assert(wldbg_resolved_message_get_args(&rm, &args) == 0);
+	assert(args.num == 3);
+	assert(*args.args[2].data == 12);
+
+	/* the last argument is missing */
+	rm.base.size -= 4;
+	assert(wldbg_resolved_message_get_args(&rm, &args) == -1);
+	rm.base.size += 4;
+
+	/* the string is longer than the message */
+	data[1] = 0xfffffffe;
+	assert(wldbg_resolved_message_get_args(&rm, &args) == -1);
+	data[1] = 8;
+
+	/* the string is not terminated */
+	data[3] = 0x68676665;
+	assert(wldbg_resolved_message_get_args(&rm, &args) == -1);
+}
+
+TEST(message_args_fds)
+{
+	/* fds are not in the data */
+	static const struct wl_message fds = { "fds", "hih", NULL };
+	uint32_t data[] = { 42 };
+	struct wldbg_resolved_message rm = {
+		.wl_interface = &dummy_interface,
+		.wl_message = &fds,
+		.base.data = data,
+		.base.size = 8 + sizeof data,
+	};
+	struct wldbg_message_args args;
+
+	assert(wldbg_resolved_message_get_args(&rm, &args) == 0);
+	assert(args.num == 3);
+	assert(args.args[0].type == 'h');
+	assert(args.args[0].data == NULL);
+	assert(args.args[1].data == data);
+	assert(args.args[2].data == NULL);
+
+	/* the same for the iterator and offsets */
+	wldbg_resolved_message_reset_iterator(&rm);
+	assert(wldbg_resolved_message_next_argument(&rm)->data == NULL);
+	assert(wldbg_resolved_message_next_argument(&rm)->data == data);
+	assert(wldbg_signature_arg_offset(&rm.compiled, data, 1, 1) == 0);
+}
+
+TEST(iterator_stops_at_message_end)
+{
+	/* { "foo2", "1usu", NULL } */
+	uint32_t data[] = { 123,
+			    8 /* string size */,
+			    0x64636261, 0x00676665,
+			    12 };
+	struct wldbg_resolved_message rm = {
+		.wl_interface = &dummy_interface,
+		.wl_message = &dummy_events[1],
+		.base.data = data,
+		.base.size = 8 + sizeof data - 4,
+	};
+
+	/* the last argument is not in the message */
+	wldbg_resolved_message_reset_iterator(&rm);
+	assert(wldbg_resolved_message_next_argument(&rm) != NULL);
+	assert(wldbg_resolved_message_next_argument(&rm) != NULL);
+	assert(wldbg_resolved_message_next_argument(&rm) == NULL);
+	assert(wldbg_resolved_message_next_argument(&rm) == NULL);
+
+	/* the string is longer than the message */
+	rm.base.size += 4;
+	data[1] = 0xfffffffe;
+	wldbg_resolved_message_reset_iterator(&rm);
+	assert(wldbg_resolved_message_next_argument(&rm) != NULL);
+	assert(wldbg_resolved_message_next_argument(&rm) == NULL);
+	assert(wldbg_resolved_message_next_argument(&rm) == NULL);
+}
@@ -0,0 +1,336 @@
+#include "config.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "test-runner.h"
+#include "poller.h"
+#include "wayland-private.h"
+
+static void
+level_triggered_and_modify(enum wldbg_poller_backend backend)
+{
+	struct wldbg_poller *poller;
+	struct epoll_event ev[4];
+	int s[2], t[2], a, b;
+	char c;
+
+	assert(socketpair(AF_UNIX, SOCK_STREAM, 0, s) == 0);
+	assert(socketpair(AF_UNIX, SOCK_STREAM, 0, t) == 0);
+
+	poller = wldbg_poller_create(backend);
+	assert(poller);
+	assert(wldbg_poller_get_backend(poller) == backend);
+
+	assert(wldbg_poller_add(poller, s[0], EPOLLIN, &a) == 0);
+	assert(write(s[1], "x", 1) == 1);
+
+	/* reported again until it is read */
+	assert(wldbg_poller_wait(poller, ev, 4) == 1);
+	assert(ev[0].events == EPOLLIN && ev[0].data.ptr == &a);
+	assert(wldbg_poller_wait(poller, ev, 4) == 1);
+	assert(ev[0].events == EPOLLIN && ev[0].data.ptr == &a);
+
+	/* not interested in reading, only in writing */
+	assert(wldbg_poller_modify(poller, s[0], EPOLLOUT, &b) == 0);
+	assert(wldbg_poller_wait(poller, ev, 4) == 1);
+	assert(ev[0].events == EPOLLOUT && ev[0].data.ptr == &b);
+
+	/* removed fd is not reported anymore */
+	assert(wldbg_poller_remove(poller, s[0]) == 0);
+	assert(wldbg_poller_add(poller, t[0], EPOLLIN, &b) == 0);
+	assert(write(t[1], "y", 1) == 1);
+	assert(wldbg_poller_wait(poller, ev, 4) == 1);
+	assert(ev[0].data.ptr == &b);
+
+	assert(read(t[0], &c, 1) == 1 && c == 'y');
+
+	/* hangup is reported even without events */
+	assert(wldbg_poller_modify(poller, t[0], 0, &a) == 0);
+	close(t[1]);
+	assert(wldbg_poller_wait(poller, ev, 4) == 1);
+	assert(ev[0].events & EPOLLHUP);
+	assert(ev[0].data.ptr == &a);
+
+	wldbg_poller_destroy(poller);
+	close(s[0]);
+	close(s[1]);
+	close(t[0]);
+}
+
+TEST(epoll_backend)
+{
+	level_triggered_and_modify(WLDBG_POLLER_EPOLL);
+}
+
+#ifdef HAVE_IO_URING
+TEST(io_uring_backend)
+{
+	level_triggered_and_modify(WLDBG_POLLER_IO_URING);
+}
+
+/* a wl_connection whose socket is read and written by the ring */
+static struct wl_connection *
+ring_connection(struct wldbg_poller *poller, int fd, void *data)
+{
+	struct wl_connection *conn;
+	struct wl_connection_io *io;
+
+	assert(wldbg_poller_add(poller, fd, EPOLLIN, data) == 0);
+	io = wldbg_poller_get_io(poller, fd);
+	assert(io);
+
+	conn = wl_connection_create(fd);
+	assert(conn);
+	wl_connection_set_io(conn, io);
+
+	return conn;
+}
+
+/* the ring can wake up without events to report */
+static int
+wait_events(struct wldbg_poller *poller, struct epoll_event *ev, int max)
+{
+	int n;
+
+	do {
+		n = wldbg_poller_wait(poller, ev, max);
+		assert(n >= 0);
+	} while (n == 0);
+
+	return n;
+}
+
+static void
+send_fds(int fd, int pass, int num)
+{
+	char cmsg[CMSG_SPACE(20 * sizeof(int))], data[8] = "message";
+	struct iovec iov = { data, sizeof data };
+	struct msghdr msg;
+	struct cmsghdr *c;
+	int i;
+
+	assert(num <= 20);
+	memset(&msg, 0, sizeof msg);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = cmsg;
+	msg.msg_controllen = CMSG_SPACE(num * sizeof(int));
+
+	c = CMSG_FIRSTHDR(&msg);
+	c->cmsg_level = SOL_SOCKET;
+	c->cmsg_type = SCM_RIGHTS;
+	c->cmsg_len = CMSG_LEN(num * sizeof(int));
+	for (i = 0; i < num; ++i)
+		((int *) CMSG_DATA(c))[i] = pass;
+
+	assert(sendmsg(fd, &msg, 0) == sizeof data);
+}
+
+/* receive until size bytes came, returns the number of fds */
+static int
+receive_fds(int fd, char *data, size_t size)
+{
+	char cmsg[CMSG_SPACE(64 * sizeof(int))];
+	struct iovec iov;
+	struct msghdr msg;
+	struct cmsghdr *c;
+	int fds = 0, i, n;
+	ssize_t len;
+
+	while (size > 0) {
+		iov.iov_base = data;
+		iov.iov_len = size;
+
+		memset(&msg, 0, sizeof msg);
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = cmsg;
+		msg.msg_controllen = sizeof cmsg;
+
+		len = recvmsg(fd, &msg, 0);
+		assert(len > 0);
+		assert(!(msg.msg_flags & MSG_CTRUNC));
+		data += len;
+		size -= len;
+
+		for (c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c)) {
+			n = (c->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+			for (i = 0; i < n; ++i)
+				close(((int *) CMSG_DATA(c))[i]);
+			fds += n;
+		}
+	}
+
+	return fds;
+}
+
+/* 60 fds are received by multishot RECVMSG and go out
+ * in a batch of linked SENDMSGs (one takes only 28 fds) */
+TEST(io_uring_forwards_data_and_fds)
+{
+	struct wldbg_poller *poller;
+	struct wl_connection *in, *to;
+	struct epoll_event ev[4];
+	int s[2], t[2], p[2], a, b, i, len = 0, ret;
+	char out[64];
+
+	assert(socketpair(AF_UNIX, SOCK_STREAM, 0, s) == 0);
+	assert(socketpair(AF_UNIX, SOCK_STREAM, 0, t) == 0);
+	assert(pipe(p) == 0);
+
+	poller = wldbg_poller_create(WLDBG_POLLER_IO_URING);
+	assert(poller);
+	in = ring_connection(poller, s[0], &a);
+	to = ring_connection(poller, t[0], &b);
+
+	for (i = 0; i < 3; ++i)
+		send_fds(s[1], p[0], 20);
+
+	while (len < 24) {
+		assert(wait_events(poller, ev, 4) == 1);
+		assert(ev[0].events == EPOLLIN && ev[0].data.ptr == &a);
+
+		ret = wl_connection_read(in);
+		if (ret < 0)
+			assert(errno == EAGAIN);
+		else
+			len = ret;
+
+		assert(wl_connection_copy_fds(in, to) == 0);
+	}
+
+	assert(len == 24);
+	assert(wl_connection_forward(in, 0, len, to) == 0);
+	assert(wl_connection_flush(to) >= 0);
+	assert(wl_connection_pending_fds(to) == 0);
+	assert(wl_connection_pending_output(to) == 0);
+
+	/* the batch is submitted with the wait, writable
+	 * is reported when all of it was sent */
+	assert(wldbg_poller_modify(poller, t[0], EPOLLOUT, &b) == 0);
+	assert(wait_events(poller, ev, 4) == 1);
+	assert(ev[0].events == EPOLLOUT && ev[0].data.ptr == &b);
+
+	assert(receive_fds(t[1], out, len) == 60);
+	for (i = 0; i < 3; ++i)
+		assert(strcmp(out + 8 * i, "message") == 0);
+
+	wl_connection_destroy(in);
+	wl_connection_destroy(to);
+	wldbg_poller_destroy(poller);
+	close(s[1]);
+	close(t[1]);
+	close(p[0]);
+	close(p[1]);
+}
+
+/* output of the last iteration goes out when the poller is destroyed */
+TEST(io_uring_sends_on_destroy)
+{
+	struct wldbg_poller *poller;
+	struct wl_connection *in, *to;
+	struct epoll_event ev[4];
+	int s[2], t[2], p[2], a, b, len = 0, ret;
+	char out[8];
+
+	assert(socketpair(AF_UNIX, SOCK_STREAM, 0, s) == 0);
+	assert(socketpair(AF_UNIX, SOCK_STREAM, 0, t) == 0);
+	assert(pipe(p) == 0);
+
+	poller = wldbg_poller_create(WLDBG_POLLER_IO_URING);
+	assert(poller);
+	in = ring_connection(poller, s[0], &a);
+	to = ring_connection(poller, t[0], &b);
+
+	send_fds(s[1], p[0], 3);
+	while (len < 8) {
+		assert(wait_events(poller, ev, 4) == 1);
+		ret = wl_connection_read(in);
+		if (ret < 0)
+			assert(errno == EAGAIN);
+		else
+			len = ret;
+	}
+
+	assert(wl_connection_copy_fds(in, to) == 0);
+	assert(wl_connection_forward(in, 0, len, to) == 0);
+	assert(wl_connection_pending_output(to) == 0);
+
+	/* the batch was not submitted yet */
+	wldbg_poller_destroy(poller);
+	wl_connection_destroy(in);
+	wl_connection_destroy(to);
+
+	assert(receive_fds(t[1], out, len) == 3);
+	assert(strcmp(out, "message") == 0);
+
+	close(s[1]);
+	close(t[1]);
+	close(p[0]);
+	close(p[1]);
+}
+
+TEST(io_uring_paused_socket_and_hangup)
+{
+	struct wldbg_poller *poller;
+	struct wl_connection *conn;
+	struct epoll_event ev[4];
+	int s[2], q[2], a, c, i, n, found = 0;
+	char data;
+
+	assert(socketpair(AF_UNIX, SOCK_STREAM, 0, s) == 0);
+	assert(pipe(q) == 0);
+
+	poller = wldbg_poller_create(WLDBG_POLLER_IO_URING);
+	assert(poller);
+	conn = ring_connection(poller, s[0], &a);
+
+	/* always readable, so that waiting does not block */
+	assert(write(q[1], "q", 1) == 1);
+	assert(wldbg_poller_add(poller, q[0], EPOLLIN, &c) == 0);
+
+	/* received data of a paused socket are not reported */
+	assert(wldbg_poller_modify(poller, s[0], 0, &a) == 0);
+	assert(write(s[1], "x", 1) == 1);
+	for (i = 0; i < 10; ++i) {
+		n = wait_events(poller, ev, 4);
+		assert(n == 1 && ev[0].data.ptr == &c);
+	}
+
+	/* until it is resumed */
+	assert(wldbg_poller_modify(poller, s[0], EPOLLIN, &a) == 0);
+	for (i = 0; i < 1000 && !found; ++i) {
+		n = wait_events(poller, ev, 4);
+		while (n-- > 0)
+			found |= ev[n].data.ptr == &a;
+	}
+	assert(found);
+	assert(wl_connection_read(conn) == 1);
+	wl_connection_copy(conn, &data, 1);
+	assert(data == 'x');
+
+	assert(wldbg_poller_remove(poller, q[0]) == 0);
+
+	/* hangup is reported until the socket is removed */
+	close(s[1]);
+	for (i = 0; i < 2; ++i) {
+		assert(wait_events(poller, ev, 4) == 1);
+		assert(ev[0].data.ptr == &a);
+		assert(ev[0].events & (EPOLLHUP | EPOLLIN));
+	}
+	assert(wl_connection_read(conn) == 0);
+
+	assert(wait_events(poller, ev, 4) == 1);
+	assert(ev[0].events & EPOLLHUP);
+
+	assert(wldbg_poller_remove(poller, s[0]) == 0);
+	wl_connection_destroy(conn);
+	wldbg_poller_destroy(poller);
+	close(q[0]);
+	close(q[1]);
+}
+#endif
@@ -0,0 +1,276 @@
+#define _GNU_SOURCE
+#include <assert.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "test-runner.h"
+#include "wayland-util.h"
+#include "wldbg.h"
+#include "wldbg-protocols.h"
+#include "interfaces.h"
+
+static const char base_xml[] =
+	"<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+	"<protocol name=\"base\">\n"
+	"  <interface name=\"base\" version=\"3\">\n"
+	"    <description summary=\"the base\">text</description>\n"
+	"    <enum name=\"mode\" bitfield=\"true\">\n"
+	"      <entry name=\"none\" value=\"0\"/>\n"
+	"      <entry name=\"fast\" value=\"0x1\"/>\n"
+	"      <entry name=\"slow\" value=\"2\"/>\n"
+	"    </enum>\n"
+	"    <request name=\"create\">\n"
+	"      <arg name=\"id\" type=\"new_id\" interface=\"child\"/>\n"
+	"      <arg name=\"mode\" type=\"uint\" enum=\"mode\"/>\n"
+	"    </request>\n"
+	"    <request name=\"bind\" since=\"2\">\n"
+	"      <arg name=\"id\" type=\"new_id\"/>\n"
+	"      <arg name=\"title\" type=\"string\" allow-null=\"true\"/>\n"
+	"    </request>\n"
+	"    <event name=\"done\"/>\n"
+	"  </interface>\n"
+	"</protocol>\n";
+
+static const char child_xml[] =
+	"<protocol name=\"child\">\n"
+	"  <interface name=\"child\" version=\"1\">\n"
+	"    <event name=\"mode\" since=\"2\">\n"
+	"      <arg name=\"fd\" type=\"fd\"/>\n"
+	"      <arg name=\"mode\" type=\"uint\" enum=\"base.mode\"/>\n"
+	"    </event>\n"
+	"  </interface>\n"
+	"  <interface name=\"known\" version=\"1\">\n"
+	"    <enum name=\"error\">\n"
+	"      <entry name=\"oops\" value=\"7\"/>\n"
+	"    </enum>\n"
+	"  </interface>\n"
+	"</protocol>\n";
+
+static const char broken_xml[] =
+	"<protocol name=\"broken\">\n"
+	"  <interface name=\"broken\" version=\"1\">\n"
+	"    <request name=\"foo\"><arg name=\"x\" type=\"what\"/></request>\n"
+	"  </interface>\n"
+	"</protocol>\n";
+
+static const struct wl_interface known_interface = {
+	"known", 1, 0, NULL, 0, NULL
+};
+
+static char dir[] = "/tmp/wldbg-protocols-test-XXXXXX";
+static char cache_dir[64];
+
+/* protocols are in dir/protocols, the cache in dir/cache */
+static void
+setup(void)
+{
+	char path[128];
+
+	assert(mkdtemp(dir));
+	snprintf(path, sizeof path, "%s/protocols", dir);
+	assert(mkdir(path, 0700) == 0);
+	snprintf(cache_dir, sizeof cache_dir, "%s/cache", dir);
+	assert(mkdir(cache_dir, 0700) == 0);
+	wldbg_protocols_set_cache_dir(cache_dir);
+}
+
+static int
+remove_entry(const char *path, const struct stat *st, int flag,
+	     struct FTW *ftw)
+{
+	return remove(path);
+}
+
+static void
+cleanup(void)
+{
+	wldbg_protocols_set_cache_dir(NULL);
+	assert(nftw(dir, remove_entry, 8, FTW_DEPTH | FTW_PHYS) == 0);
+}
+
+static const char *
+protocol_path(const char *name)
+{
+	static char path[128];
+
+	snprintf(path, sizeof path, "%s/protocols/%s", dir, name);
+	return path;
+}
+
+static void
+write_file(const char *name, const char *content)
+{
+	FILE *f;
+
+	f = fopen(protocol_path(name), "w");
+	assert(f);
+	assert(fputs(content, f) >= 0);
+	fclose(f);
+}
+
+TEST(load_protocols)
+{
+	const struct wl_interface *base, *child;
+	const struct wldbg_enum *e;
+	char path[128];
+
+	setup();
+	assert(mkdir(protocol_path("sub"), 0700) == 0);
+	write_file("base.xml", base_xml);
+	write_file("sub/child.xml", child_xml);
+	write_file("sub/broken.xml", broken_xml);
+	write_file("notes.txt", "not a protocol");
+
+	wldbg_interfaces_add(&known_interface);
+
+	/* broken files are skipped and known interfaces are not added */
+	assert(wldbg_protocols_load(protocol_path("")) == 2);
+	assert(wldbg_interface_lookup("broken") == NULL);
+	assert(wldbg_interface_lookup("known") == &known_interface);
+
+	base = wldbg_interface_lookup("base");
+	child = wldbg_interface_lookup("child");
+	assert(base && child);
+	assert(base->version == 3);
+	assert(base->method_count == 2 && base->event_count == 1);
+	assert(strcmp(base->methods[0].signature, "nu") == 0);
+	assert(base->methods[0].types[0] == child);
+	assert(base->methods[0].types[1] == NULL);
+	assert(strcmp(base->methods[1].signature, "2sun?s") == 0);
+	assert(strcmp(base->events[0].signature, "") == 0);
+	assert(strcmp(child->events[0].signature, "2hu") == 0);
+
+	e = wldbg_interface_get_enum(base, "mode");
+	assert(e && e->bitfield && e->entries_num == 3);
+	assert(strcmp(wldbg_enum_get_name(e, 1), "fast") == 0);
+	assert(wldbg_enum_get_name(e, 4) == NULL);
+
+	/* arguments with enums, also from other interfaces */
+	assert(wldbg_message_get_arg_enum(base, CLIENT, 0, 1) == e);
+	assert(wldbg_message_get_arg_enum(base, CLIENT, 0, 0) == NULL);
+	assert(wldbg_message_get_arg_enum(base, SERVER, 0, 0) == NULL);
+	assert(wldbg_message_get_arg_enum(child, SERVER, 0, 1) == e);
+	assert(wldbg_message_get_arg_enum(child, SERVER, 1, 1) == NULL);
+
+	/* enums of interfaces that were known before */
+	e = wldbg_interface_get_enum(&known_interface, "error");
+	assert(e && !e->bitfield);
+	assert(strcmp(wldbg_enum_get_name(e, 7), "oops") == 0);
+
+	/* paths that do not exist are skipped */
+	snprintf(path, sizeof path, "%s/nothing:%s/protocols/sub", dir, dir);
+	assert(wldbg_protocols_load_path(path) == 0);
+
+	wldbg_interfaces_clear();
+	wldbg_protocols_release();
+	assert(wldbg_interface_get_enum(&known_interface, "error") == NULL);
+
+	cleanup();
+}
+
+static const char *
+slow_name(void)
+{
+	const struct wldbg_enum *e;
+
+	e = wldbg_interface_get_enum(wldbg_interface_lookup("base"), "mode");
+	assert(e);
+
+	return wldbg_enum_get_name(e, 2);
+}
+
+static void
+check_loaded(const char *slow)
+{
+	const struct wl_interface *base, *child;
+
+	/* base, child and known */
+	assert(wldbg_protocols_load(protocol_path("")) == 3);
+
+	base = wldbg_interface_lookup("base");
+	child = wldbg_interface_lookup("child");
+	assert(base && child);
+	assert(strcmp(base->methods[1].name, "bind") == 0);
+	assert(strcmp(base->methods[1].signature, "2sun?s") == 0);
+	assert(base->methods[0].types[0] == child);
+	assert(strcmp(child->events[0].signature, "2hu") == 0);
+	assert(wldbg_message_get_arg_enum(child, SERVER, 0, 1)
+	       == wldbg_interface_get_enum(base, "mode"));
+	assert(strcmp(slow_name(), slow) == 0);
+
+	wldbg_interfaces_clear();
+	wldbg_protocols_release();
+}
+
+static void
+set_mtime(const char *name, time_t sec)
+{
+	struct timespec times[2] = { { sec, 0 }, { sec, 0 } };
+
+	assert(utimensat(AT_FDCWD, protocol_path(name), times, 0) == 0);
+}
+
+/* the cache files in the cache dir */
+static int
+cache_file(char *path, size_t size)
+{
+	struct dirent **entries;
+	int i, num;
+
+	num = scandir(cache_dir, &entries, NULL, alphasort);
+	assert(num >= 2);
+	for (i = 0; i < num; ++i) {
+		if (entries[i]->d_name[0] != '.')
+			snprintf(path, size, "%s/%s", cache_dir,
+				 entries[i]->d_name);
+		free(entries[i]);
+	}
+
+	free(entries);
+
+	/* without . and .. */
+	return num - 2;
+}
+
+TEST(protocols_cache)
+{
+	char path[128], xml[sizeof base_xml];
+
+	setup();
+	write_file("base.xml", base_xml);
+	write_file("child.xml", child_xml);
+	set_mtime("base.xml", 1000);
+
+	/* parsed and the cache is written */
+	check_loaded("slow");
+
+	/* the cache does not look at the content... */
+	memcpy(xml, base_xml, sizeof xml);
+	memcpy(strstr(xml, "slow"), "slox", 4);
+	write_file("base.xml", xml);
+	set_mtime("base.xml", 1000);
+	check_loaded("slow");
+
+	/* ...but at mtimes */
+	set_mtime("base.xml", 2000);
+	check_loaded("slox");
+	check_loaded("slox");
+
+	/* broken cache is written again */
+	assert(cache_file(path, sizeof path) == 1);
+	assert(truncate(path, 100) == 0);
+	check_loaded("slox");
+	assert(truncate(path, 100) == 0);
+	write_file("base.xml", base_xml);
+	check_loaded("slow");
+	check_loaded("slow");
+	assert(cache_file(path, sizeof path) == 1);
+
+	cleanup();
+}
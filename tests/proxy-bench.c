@@ -0,0 +1,933 @@
+/*
+ * End-to-end benchmark of wldbg. Run it with 'make bench'.
+ *
+ * We are a stand-in compositor that listens on a wayland socket
+ * and we spawn wldbg with ourselves as the client (--client),
+ * so the messages go through the real wldbg binary. The client binds
+ * a few real objects (wl_surface, wl_pointer, wl_keyboard), so wldbg
+ * resolves the messages like with any other client, and then one side
+ * floods the other with a mix of messages:
+ *
+ *   pointer - wl_pointer.motion events
+ *   commit  - wl_surface.attach, damage and commit requests
+ *   arrays  - wl_keyboard.keymap events with an fd and
+ *             wl_keyboard.enter events with a big array
+ *
+ * The wire format is written by hand instead of using libwayland,
+ * so that we control exactly what is sent and how it is batched.
+ * That means the numbers do not contain the cost of marshalling and
+ * dispatching in libwayland on either side, they are the cost of
+ * wldbg on top of raw sockets. Every timed message carries the time when it was sent in its last
+ * 8 bytes, the receiver computes latency from it. With --direct the
+ * client connects right to us, which is the baseline.
+ */
+
+#define _GNU_SOURCE
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#include "latency.h"
+
+#define BUFFER_SIZE	65536
+/* libwayland does not send more fds in one message either */
+#define MAX_FDS		28
+
+/* ids of objects that the client creates */
+#define DISPLAY_ID	1
+#define REGISTRY_ID	2
+#define COMPOSITOR_ID	3
+#define SURFACE_ID	4
+#define SEAT_ID		5
+#define POINTER_ID	6
+#define KEYBOARD_ID	7
+
+enum mix {
+	MIX_POINTER,
+	MIX_COMMIT,
+	MIX_ARRAYS,
+	MIX_NUM
+};
+
+static const char *mix_names[] = { "pointer", "commit", "arrays" };
+
+struct options {
+	const char *wldbg;
+	/* arguments for wldbg (passes and options) */
+	char **wldbg_argv;
+	int wldbg_argc;
+	const char *json;
+	unsigned int mixes;
+	unsigned long messages;
+	unsigned int array_size;
+	unsigned int batch;
+	int direct;
+	int verbose;
+};
+
+struct result {
+	unsigned long messages;
+	unsigned long bytes;
+	/* send time of the first timed message and
+	 * receive time of the last message */
+	uint64_t first_ns;
+	uint64_t last_ns;
+	struct wldbg_histogram latency;
+};
+
+/* what the receiver needs to know about the mix */
+struct mix_info {
+	int from_server;
+	uint32_t object;
+	uint32_t timed_opcode;
+};
+
+static const struct mix_info mix_infos[] = {
+	[MIX_POINTER] = { 1, POINTER_ID, 2 /* motion */ },
+	[MIX_COMMIT] = { 0, SURFACE_ID, 2 /* damage */ },
+	[MIX_ARRAYS] = { 1, KEYBOARD_ID, 1 /* enter */ },
+};
+
+/* messages waiting for sendmsg */
+struct out {
+	int fd;
+	char data[BUFFER_SIZE];
+	size_t size;
+	int fds[MAX_FDS];
+	int fds_num;
+	unsigned int messages;
+};
+
+static void
+out_flush(struct out *out)
+{
+	char cmsg[CMSG_SPACE(MAX_FDS * sizeof(int))];
+	struct cmsghdr *c;
+	struct msghdr msg;
+	struct iovec iov;
+	size_t sent = 0;
+	ssize_t len;
+
+	while (sent < out->size) {
+		memset(&msg, 0, sizeof msg);
+		iov.iov_base = out->data + sent;
+		iov.iov_len = out->size - sent;
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+
+		/* fds go with the first chunk */
+		if (out->fds_num > 0) {
+			msg.msg_control = cmsg;
+			msg.msg_controllen = CMSG_SPACE(out->fds_num
+							* sizeof(int));
+			c = CMSG_FIRSTHDR(&msg);
+			c->cmsg_level = SOL_SOCKET;
+			c->cmsg_type = SCM_RIGHTS;
+			c->cmsg_len = CMSG_LEN(out->fds_num * sizeof(int));
+			memcpy(CMSG_DATA(c), out->fds,
+			       out->fds_num * sizeof(int));
+		}
+
+		len = sendmsg(out->fd, &msg, MSG_NOSIGNAL);
+		if (len < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("sendmsg");
+			exit(1);
+		}
+
+		sent += len;
+		out->fds_num = 0;
+	}
+
+	out->size = 0;
+	out->messages = 0;
+}
+
+static uint32_t *
+out_add(struct out *out, uint32_t id, uint32_t opcode, size_t size)
+{
+	uint32_t *p;
+
+	assert(size % 4 == 0 && size <= BUFFER_SIZE);
+	if (out->size + size > BUFFER_SIZE)
+		out_flush(out);
+
+	p = (uint32_t *)(out->data + out->size);
+	memset(p, 0, size);
+	p[0] = id;
+	p[1] = (size << 16) | opcode;
+
+	out->size += size;
+	++out->messages;
+
+	return p;
+}
+
+static void
+out_add_fd(struct out *out, int fd)
+{
+	if (out->fds_num == MAX_FDS)
+		out_flush(out);
+
+	out->fds[out->fds_num++] = fd;
+}
+
+static void
+put_time(uint32_t *msg, size_t size)
+{
+	uint64_t now = wldbg_time_ns();
+
+	memcpy((char *) msg + size - sizeof now, &now, sizeof now);
+}
+
+static void
+bind_global(struct out *out, uint32_t name, const char *interface,
+	    uint32_t version, uint32_t id)
+{
+	size_t len = strlen(interface) + 1;
+	size_t padded = (len + 3) & ~3;
+	uint32_t *p;
+
+	/* wl_registry.bind: name, interface, version, new_id */
+	p = out_add(out, REGISTRY_ID, 0, 8 + 4 + 4 + padded + 4 + 4);
+	p[2] = name;
+	p[3] = len;
+	memcpy(p + 4, interface, len);
+	p[4 + padded / 4] = version;
+	p[5 + padded / 4] = id;
+}
+
+/* create the objects that the mixes use */
+static void
+build_setup(struct out *out)
+{
+	uint32_t *p;
+
+	/* wl_display.get_registry */
+	p = out_add(out, DISPLAY_ID, 1, 12);
+	p[2] = REGISTRY_ID;
+
+	bind_global(out, 1, "wl_compositor", 3, COMPOSITOR_ID);
+	/* wl_compositor.create_surface */
+	p = out_add(out, COMPOSITOR_ID, 0, 12);
+	p[2] = SURFACE_ID;
+
+	bind_global(out, 2, "wl_seat", 3, SEAT_ID);
+	/* wl_seat.get_pointer and get_keyboard */
+	p = out_add(out, SEAT_ID, 0, 12);
+	p[2] = POINTER_ID;
+	p = out_add(out, SEAT_ID, 1, 12);
+	p[2] = KEYBOARD_ID;
+}
+
+static size_t
+setup_size(void)
+{
+	static struct out out;
+
+	out.size = 0;
+	build_setup(&out);
+
+	return out.size;
+}
+
+static void
+send_traffic(int fd, enum mix mix, const struct options *opts)
+{
+	static struct out out;
+	unsigned long i;
+	uint32_t *p;
+	size_t size;
+	int null_fd = -1;
+
+	out.fd = fd;
+	out.size = 0;
+	out.fds_num = 0;
+
+	if (mix == MIX_ARRAYS) {
+		null_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+		assert(null_fd >= 0);
+	}
+
+	for (i = 0; i < opts->messages; ++i) {
+		switch (mix) {
+		case MIX_POINTER:
+			/* wl_pointer.motion: time, x, y */
+			p = out_add(&out, POINTER_ID, 2, 20);
+			p[2] = i;
+			put_time(p, 20);
+			break;
+		case MIX_COMMIT:
+			if (i % 3 == 0) {
+				/* wl_surface.attach: buffer, x, y */
+				out_add(&out, SURFACE_ID, 1, 20);
+			} else if (i % 3 == 1) {
+				/* wl_surface.damage: x, y, width, height */
+				p = out_add(&out, SURFACE_ID, 2, 24);
+				put_time(p, 24);
+			} else {
+				/* wl_surface.commit */
+				out_add(&out, SURFACE_ID, 6, 8);
+			}
+			break;
+		case MIX_ARRAYS:
+			if (i % 2 == 0) {
+				/* wl_keyboard.keymap: format, fd, size.
+				 * The fd must not come after the message */
+				out_add_fd(&out, null_fd);
+				p = out_add(&out, KEYBOARD_ID, 0, 16);
+				p[2] = 1;
+				p[3] = 0;
+			} else {
+				/* wl_keyboard.enter: serial, surface, keys */
+				size = 8 + 4 + 4 + 4 + opts->array_size;
+				p = out_add(&out, KEYBOARD_ID, 1, size);
+				p[2] = i;
+				p[3] = SURFACE_ID;
+				p[4] = opts->array_size;
+				put_time(p, size);
+			}
+			break;
+		default:
+			assert(0 && "Unknown mix");
+		}
+
+		if (out.messages >= opts->batch)
+			out_flush(&out);
+	}
+
+	out_flush(&out);
+
+	if (null_fd >= 0)
+		close(null_fd);
+}
+
+static void
+close_fds(struct msghdr *msg)
+{
+	struct cmsghdr *c;
+	int *fds, n, i;
+
+	for (c = CMSG_FIRSTHDR(msg); c; c = CMSG_NXTHDR(msg, c)) {
+		if (c->cmsg_level != SOL_SOCKET || c->cmsg_type != SCM_RIGHTS)
+			continue;
+
+		fds = (int *) CMSG_DATA(c);
+		n = (c->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+		for (i = 0; i < n; ++i)
+			close(fds[i]);
+	}
+}
+
+/* read messages until we have all of them */
+static void
+receive_traffic(int fd, enum mix mix, const struct options *opts,
+		struct result *result)
+{
+	static char data[BUFFER_SIZE];
+	char cmsg[CMSG_SPACE(MAX_FDS * sizeof(int))];
+	const struct mix_info *info = &mix_infos[mix];
+	struct msghdr msg;
+	struct iovec iov;
+	size_t have = 0, off, size;
+	uint32_t *p;
+	uint64_t sent, now;
+	ssize_t len;
+
+	memset(result, 0, sizeof *result);
+
+	while (result->messages < opts->messages) {
+		memset(&msg, 0, sizeof msg);
+		iov.iov_base = data + have;
+		iov.iov_len = sizeof data - have;
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = cmsg;
+		msg.msg_controllen = sizeof cmsg;
+
+		len = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC);
+		if (len < 0 && errno == EINTR)
+			continue;
+		if (len <= 0) {
+			fprintf(stderr, "Connection closed after %lu messages\n",
+				result->messages);
+			exit(1);
+		}
+
+		now = wldbg_time_ns();
+		close_fds(&msg);
+		have += len;
+		off = 0;
+
+		while (have - off >= 8) {
+			p = (uint32_t *)(data + off);
+			size = p[1] >> 16;
+			assert(size >= 8 && size <= BUFFER_SIZE);
+			if (have - off < size)
+				break;
+
+			if (p[0] == info->object) {
+				++result->messages;
+				result->bytes += size;
+
+				if ((p[1] & 0xffff) == info->timed_opcode) {
+					memcpy(&sent, (char *) p + size
+					       - sizeof sent, sizeof sent);
+					if (result->first_ns == 0)
+						result->first_ns = sent;
+					wldbg_histogram_add(&result->latency,
+							    now - sent, 1);
+				}
+			}
+
+			off += size;
+		}
+
+		memmove(data, data + off, have - off);
+		have -= off;
+		result->last_ns = now;
+	}
+}
+
+static void
+write_all(int fd, const void *data, size_t size)
+{
+	ssize_t len;
+
+	while (size > 0) {
+		len = write(fd, data, size);
+		if (len < 0 && errno == EINTR)
+			continue;
+		assert(len > 0);
+
+		data = (const char *) data + len;
+		size -= len;
+	}
+}
+
+static int
+read_all(int fd, void *data, size_t size)
+{
+	ssize_t len;
+
+	while (size > 0) {
+		len = read(fd, data, size);
+		if (len < 0 && errno == EINTR)
+			continue;
+		if (len <= 0)
+			return -1;
+
+		data = (char *) data + len;
+		size -= len;
+	}
+
+	return 0;
+}
+
+/* we are the client spawned by wldbg */
+static int
+run_client(int argc, char *argv[])
+{
+	static struct out out;
+	struct options opts;
+	struct result result;
+	const char *env;
+	enum mix mix;
+	char c;
+	int fd, result_fd;
+
+	if (argc != 6) {
+		fprintf(stderr, "Client needs mix, messages, "
+				"array size and batch\n");
+		return 1;
+	}
+
+	memset(&opts, 0, sizeof opts);
+	mix = atoi(argv[2]);
+	opts.messages = strtoul(argv[3], NULL, 10);
+	opts.array_size = atoi(argv[4]);
+	opts.batch = atoi(argv[5]);
+
+	env = getenv("WAYLAND_SOCKET");
+	if (!env) {
+		fprintf(stderr, "Client: WAYLAND_SOCKET is not set\n");
+		return 1;
+	}
+	fd = atoi(env);
+
+	env = getenv("WLDBG_BENCH_RESULT_FD");
+	if (!env) {
+		fprintf(stderr, "Client: WLDBG_BENCH_RESULT_FD is not set\n");
+		return 1;
+	}
+	result_fd = atoi(env);
+
+	out.fd = fd;
+	build_setup(&out);
+	out_flush(&out);
+
+	if (mix_infos[mix].from_server) {
+		receive_traffic(fd, mix, &opts, &result);
+		write_all(result_fd, &result, sizeof result);
+	} else {
+		send_traffic(fd, mix, &opts);
+		/* wait until the compositor has everything,
+		 * it closes the connection then */
+		while (read(fd, &c, 1) > 0)
+			;
+	}
+
+	close(result_fd);
+	close(fd);
+
+	return 0;
+}
+
+/* CPU time (user + system) of a process in nanoseconds. The CPU
+ * clock of the process has the precision of the scheduler, unlike
+ * the tick counters in /proc/PID/stat. It does not contain the time
+ * of the client, which is a child of wldbg */
+static uint64_t
+process_cpu_ns(clockid_t clock)
+{
+	struct timespec ts;
+
+	if (clock_gettime(clock, &ts) < 0)
+		return 0;
+
+	return (uint64_t) ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+
+static int
+create_socket(struct sockaddr_un *addr)
+{
+	const char *runtime_dir;
+	char *dir;
+	int fd;
+
+	runtime_dir = getenv("XDG_RUNTIME_DIR");
+	if (!runtime_dir) {
+		dir = strdup("/tmp/wldbg-bench-XXXXXX");
+		if (!dir || !mkdtemp(dir)) {
+			perror("Creating runtime dir");
+			return -1;
+		}
+
+		setenv("XDG_RUNTIME_DIR", dir, 1);
+		runtime_dir = dir;
+	}
+
+	memset(addr, 0, sizeof *addr);
+	addr->sun_family = AF_UNIX;
+	snprintf(addr->sun_path, sizeof addr->sun_path,
+		 "%s/wldbg-bench-%d", runtime_dir, getpid());
+	unlink(addr->sun_path);
+
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0) {
+		perror("socket");
+		return -1;
+	}
+
+	if (bind(fd, (struct sockaddr *) addr, sizeof *addr) < 0
+	    || listen(fd, 1) < 0) {
+		perror("Binding bench socket");
+		close(fd);
+		return -1;
+	}
+
+	setenv("WAYLAND_DISPLAY", strrchr(addr->sun_path, '/') + 1, 1);
+
+	return fd;
+}
+
+static void
+exec_client(const struct options *opts, enum mix mix,
+	    const struct sockaddr_un *addr, int result_fd)
+{
+	char self[4096], mix_str[16], messages[32], array_size[16], batch[16];
+	char fd_str[16], **argv;
+	ssize_t len;
+	int fd, n = 0, i;
+
+	len = readlink("/proc/self/exe", self, sizeof self - 1);
+	if (len < 0) {
+		perror("readlink");
+		exit(1);
+	}
+	self[len] = '\0';
+
+	snprintf(mix_str, sizeof mix_str, "%d", mix);
+	snprintf(messages, sizeof messages, "%lu", opts->messages);
+	snprintf(array_size, sizeof array_size, "%u", opts->array_size);
+	snprintf(batch, sizeof batch, "%u", opts->batch);
+	snprintf(fd_str, sizeof fd_str, "%d", result_fd);
+	setenv("WLDBG_BENCH_RESULT_FD", fd_str, 1);
+
+	/* dump and friends would flood the terminal */
+	if (!opts->verbose) {
+		fd = open("/dev/null", O_WRONLY);
+		if (fd >= 0) {
+			dup2(fd, STDOUT_FILENO);
+			close(fd);
+		}
+	}
+
+	argv = calloc(opts->wldbg_argc + 8, sizeof *argv);
+	assert(argv);
+
+	if (opts->direct) {
+		fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (fd < 0 || connect(fd, (const struct sockaddr *) addr,
+				      sizeof *addr) < 0) {
+			perror("Connecting to bench socket");
+			exit(1);
+		}
+
+		snprintf(fd_str, sizeof fd_str, "%d", fd);
+		setenv("WAYLAND_SOCKET", fd_str, 1);
+	} else {
+		argv[n++] = (char *) opts->wldbg;
+		for (i = 0; i < opts->wldbg_argc; ++i)
+			argv[n++] = opts->wldbg_argv[i];
+		argv[n++] = "--";
+	}
+
+	argv[n++] = self;
+	argv[n++] = "--client";
+	argv[n++] = mix_str;
+	argv[n++] = messages;
+	argv[n++] = array_size;
+	argv[n++] = batch;
+	argv[n] = NULL;
+
+	execvp(argv[0], argv);
+	fprintf(stderr, "Executing %s: %s\n", argv[0], strerror(errno));
+	exit(1);
+}
+
+/* returns CPU time of wldbg or -1 on error */
+static int64_t
+run_mix(const struct options *opts, enum mix mix, struct result *result)
+{
+	static char setup[BUFFER_SIZE];
+	struct sockaddr_un addr;
+	struct pollfd pfd;
+	uint64_t cpu_start = 0, cpu_end = 0;
+	int listen_fd, fd, status, ret = -1, pipe_fds[2];
+	clockid_t clock;
+	pid_t pid;
+
+	listen_fd = create_socket(&addr);
+	if (listen_fd < 0)
+		return -1;
+
+	if (pipe2(pipe_fds, O_CLOEXEC) < 0) {
+		perror("pipe");
+		goto out_socket;
+	}
+
+	pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		close(pipe_fds[0]);
+		close(pipe_fds[1]);
+		goto out_socket;
+	}
+
+	if (pid == 0) {
+		/* the write end must survive exec */
+		close(pipe_fds[0]);
+		fcntl(pipe_fds[1], F_SETFD, 0);
+		exec_client(opts, mix, &addr, pipe_fds[1]);
+	}
+
+	close(pipe_fds[1]);
+
+	/* do not wait forever if wldbg did not start */
+	pfd.fd = listen_fd;
+	pfd.events = POLLIN;
+	if (poll(&pfd, 1, 10000) != 1) {
+		fprintf(stderr, "Nobody connected\n");
+		kill(pid, SIGTERM);
+		goto out_child;
+	}
+
+	fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+	if (fd < 0) {
+		perror("accept");
+		goto out_child;
+	}
+
+	/* wldbg is connected, so its start-up is not measured */
+	if (!opts->direct) {
+		if (clock_getcpuclockid(pid, &clock) != 0) {
+			fprintf(stderr, "No CPU clock for wldbg\n");
+			close(fd);
+			goto out_child;
+		}
+
+		cpu_start = process_cpu_ns(clock);
+	}
+
+	/* the events must not come before the client
+	 * created the objects, or wldbg would not know them */
+	if (read_all(fd, setup, setup_size()) < 0) {
+		fprintf(stderr, "Client did not create objects\n");
+		close(fd);
+		goto out_child;
+	}
+
+	if (mix_infos[mix].from_server) {
+		send_traffic(fd, mix, opts);
+
+		if (read_all(pipe_fds[0], result, sizeof *result) < 0) {
+			fprintf(stderr, "Client did not send the results\n");
+			close(fd);
+			goto out_child;
+		}
+	} else {
+		receive_traffic(fd, mix, opts, result);
+	}
+
+	if (!opts->direct)
+		cpu_end = process_cpu_ns(clock);
+
+	close(fd);
+	ret = 0;
+
+out_child:
+	close(pipe_fds[0]);
+	waitpid(pid, &status, 0);
+out_socket:
+	close(listen_fd);
+	unlink(addr.sun_path);
+
+	if (ret < 0)
+		return -1;
+
+	return cpu_end - cpu_start;
+}
+
+static void
+print_result(enum mix mix, const struct result *r, int64_t cpu_ns)
+{
+	double seconds = (r->last_ns - r->first_ns) / 1e9;
+
+	printf("%-8s %10lu %12.0f %10.1f", mix_names[mix], r->messages,
+	       r->messages / seconds, r->bytes / seconds / (1024 * 1024));
+
+	if (cpu_ns > 0)
+		printf(" %10.0f", (double) cpu_ns / r->messages);
+	else
+		printf(" %10s", "-");
+
+	printf(" %10lu %10lu %10lu %10lu\n",
+	       wldbg_histogram_percentile(&r->latency, 0.5),
+	       wldbg_histogram_percentile(&r->latency, 0.99),
+	       wldbg_histogram_percentile(&r->latency, 0.999),
+	       r->latency.max);
+}
+
+static void
+json_result(FILE *f, enum mix mix, const struct result *r, int64_t cpu_ns,
+	    int last)
+{
+	double seconds = (r->last_ns - r->first_ns) / 1e9;
+
+	fprintf(f, "    {\n");
+	fprintf(f, "      \"mix\": \"%s\",\n", mix_names[mix]);
+	fprintf(f, "      \"messages\": %lu,\n", r->messages);
+	fprintf(f, "      \"bytes\": %lu,\n", r->bytes);
+	fprintf(f, "      \"seconds\": %.6f,\n", seconds);
+	fprintf(f, "      \"messages_per_second\": %.0f,\n",
+		r->messages / seconds);
+	fprintf(f, "      \"bytes_per_second\": %.0f,\n", r->bytes / seconds);
+	if (cpu_ns > 0)
+		fprintf(f, "      \"wldbg_cpu_ns_per_message\": %.1f,\n",
+			(double) cpu_ns / r->messages);
+	else
+		fprintf(f, "      \"wldbg_cpu_ns_per_message\": null,\n");
+	fprintf(f, "      \"latency_ns\": { \"p50\": %lu, \"p99\": %lu, "
+		   "\"p999\": %lu, \"max\": %lu }\n",
+		wldbg_histogram_percentile(&r->latency, 0.5),
+		wldbg_histogram_percentile(&r->latency, 0.99),
+		wldbg_histogram_percentile(&r->latency, 0.999),
+		r->latency.max);
+	fprintf(f, "    }%s\n", last ? "" : ",");
+}
+
+static void
+usage(void)
+{
+	fprintf(stderr,
+		"Usage: proxy-bench [OPTIONS] [-- WLDBG ARGUMENTS]\n"
+		"\n"
+		"  --wldbg=PATH        wldbg binary (default: wldbg)\n"
+		"  --direct            do not run wldbg, measure the baseline\n"
+		"  --mix=NAME          pointer, commit, arrays or all (default)\n"
+		"  --messages=N        messages per mix (default: 200000)\n"
+		"  --array-size=N      size of arrays in bytes (default: 2048)\n"
+		"  --batch=N           messages sent at once (default: 16)\n"
+		"  --json=FILE         write results as JSON\n"
+		"  --verbose           do not hide output of wldbg\n"
+		"\n"
+		"WLDBG ARGUMENTS are passes and options for wldbg "
+		"(default: dump)\n");
+}
+
+static int
+parse_options(struct options *opts, int argc, char *argv[])
+{
+	static char *default_args[] = { "dump", NULL };
+	const char *arg;
+	int i, m;
+
+	memset(opts, 0, sizeof *opts);
+	opts->wldbg = "wldbg";
+	opts->messages = 200000;
+	opts->array_size = 2048;
+	opts->batch = 16;
+	opts->wldbg_argv = default_args;
+	opts->wldbg_argc = 1;
+
+	for (i = 1; i < argc; ++i) {
+		arg = argv[i];
+
+		if (strcmp(arg, "--") == 0) {
+			opts->wldbg_argv = argv + i + 1;
+			opts->wldbg_argc = argc - i - 1;
+			break;
+		} else if (strncmp(arg, "--wldbg=", 8) == 0) {
+			opts->wldbg = arg + 8;
+		} else if (strcmp(arg, "--direct") == 0) {
+			opts->direct = 1;
+		} else if (strcmp(arg, "--verbose") == 0) {
+			opts->verbose = 1;
+		} else if (strncmp(arg, "--mix=", 6) == 0) {
+			if (strcmp(arg + 6, "all") == 0) {
+				opts->mixes = (1 << MIX_NUM) - 1;
+				continue;
+			}
+
+			for (m = 0; m < MIX_NUM; ++m) {
+				if (strcmp(arg + 6, mix_names[m]) == 0)
+					opts->mixes |= 1 << m;
+			}
+
+			if (!opts->mixes) {
+				fprintf(stderr, "Unknown mix: %s\n", arg + 6);
+				return -1;
+			}
+		} else if (strncmp(arg, "--messages=", 11) == 0) {
+			opts->messages = strtoul(arg + 11, NULL, 10);
+		} else if (strncmp(arg, "--array-size=", 13) == 0) {
+			opts->array_size = atoi(arg + 13);
+		} else if (strncmp(arg, "--batch=", 8) == 0) {
+			opts->batch = atoi(arg + 8);
+		} else if (strncmp(arg, "--json=", 7) == 0) {
+			opts->json = arg + 7;
+		} else {
+			usage();
+			return -1;
+		}
+	}
+
+	if (!opts->mixes)
+		opts->mixes = (1 << MIX_NUM) - 1;
+
+	/* arrays are padded to 32 bits and carry the timestamp */
+	opts->array_size = (opts->array_size + 3) & ~3;
+	if (opts->array_size < 8)
+		opts->array_size = 8;
+	if (opts->array_size > BUFFER_SIZE / 2) {
+		fprintf(stderr, "Array size can be at most %d\n",
+			BUFFER_SIZE / 2);
+		return -1;
+	}
+
+	if (opts->messages == 0 || opts->batch == 0) {
+		usage();
+		return -1;
+	}
+
+	return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+	struct options opts;
+	struct result results[MIX_NUM];
+	int64_t cpu[MIX_NUM];
+	FILE *json;
+	int m, i, last = -1;
+
+	if (argc > 1 && strcmp(argv[1], "--client") == 0)
+		return run_client(argc, argv);
+
+	if (parse_options(&opts, argc, argv) < 0)
+		return 1;
+
+	printf("%lu messages, %s", opts.messages,
+	       opts.direct ? "direct" : opts.wldbg);
+	for (i = 0; !opts.direct && i < opts.wldbg_argc; ++i)
+		printf(" %s", opts.wldbg_argv[i]);
+	printf(", raw wire client\n");
+	printf("%-8s %10s %12s %10s %10s %10s %10s %10s %10s\n",
+	       "mix", "messages", "msgs/s", "MB/s", "wldbg ns/m",
+	       "p50 ns", "p99 ns", "p999 ns", "max ns");
+
+	for (m = 0; m < MIX_NUM; ++m) {
+		if (!(opts.mixes & (1 << m)))
+			continue;
+
+		cpu[m] = run_mix(&opts, m, &results[m]);
+		if (cpu[m] < 0)
+			return 1;
+
+		print_result(m, &results[m], cpu[m]);
+		last = m;
+	}
+
+	if (!opts.json)
+		return 0;
+
+	json = fopen(opts.json, "w");
+	if (!json) {
+		perror(opts.json);
+		return 1;
+	}
+
+	/* the client does not use libwayland, see the top of the file */
+	fprintf(json, "{\n  \"client\": \"raw-wire\",\n"
+		      "  \"direct\": %s,\n  \"wldbg_args\": [",
+		opts.direct ? "true" : "false");
+	for (i = 0; !opts.direct && i < opts.wldbg_argc; ++i)
+		fprintf(json, "%s\"%s\"", i ? ", " : "", opts.wldbg_argv[i]);
+	fprintf(json, "],\n  \"messages\": %lu,\n  \"array_size\": %u,\n"
+		      "  \"batch\": %u,\n  \"results\": [\n",
+		opts.messages, opts.array_size, opts.batch);
+
+	for (m = 0; m < MIX_NUM; ++m) {
+		if (opts.mixes & (1 << m))
+			json_result(json, m, &results[m], cpu[m], m == last);
+	}
+
+	fprintf(json, "  ]\n}\n");
+	fclose(json);
+
+	return 0;
+}
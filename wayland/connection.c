@@ -44,11 +44,15 @@
 #define DIV_ROUNDUP(n, a) ( ((n) + ((a) - 1)) / (a) )
 
 struct wl_buffer {
-	char data[4096];
+	char *data;
+	/* size of data, always a power of two */
+	uint32_t size;
+	/* the buffer can grow up to this size */
+	uint32_t max_size;
 	uint32_t head, tail;
 };
 
-#define MASK(i) ((i) & 4095)
+#define MASK(b, i) ((i) & ((b)->size - 1))
 
 #define MAX_FDS_OUT	28
 #define CLEN		(CMSG_LEN(MAX_FDS_OUT * sizeof(int32_t)))
@@ -58,25 +62,93 @@ struct wl_connection {
 	struct wl_buffer fds_in, fds_out;
 	int fd;
 	int want_flush;
+	/* receives and sends instead of the socket calls */
+	struct wl_connection_io *io;
 };
 
+static void
+wl_buffer_copy(struct wl_buffer *b, void *data, size_t count);
+
+static uint32_t
+wl_buffer_size(struct wl_buffer *b);
+
+static int
+wl_buffer_init(struct wl_buffer *b, uint32_t size, uint32_t max_size)
+{
+	assert(size > 0 && (size & (size - 1)) == 0);
+	assert(max_size >= size);
+
+	b->data = malloc(size);
+	if (!b->data)
+		return -1;
+
+	b->size = size;
+	b->max_size = max_size;
+	b->head = b->tail = 0;
+
+	return 0;
+}
+
+static void
+wl_buffer_release(struct wl_buffer *b)
+{
+	free(b->data);
+	b->data = NULL;
+}
+
+/* make the buffer at least size bytes big (up to max_size),
+ * the data in the buffer are kept */
+static int
+wl_buffer_grow(struct wl_buffer *b, size_t size)
+{
+	uint32_t new_size = b->size, len;
+	char *data;
+
+	while (new_size < size && new_size < b->max_size)
+		new_size *= 2;
+
+	if (new_size < size || new_size > b->max_size) {
+		errno = E2BIG;
+		return -1;
+	}
+
+	if (new_size == b->size)
+		return 0;
+
+	data = malloc(new_size);
+	if (!data)
+		return -1;
+
+	len = wl_buffer_size(b);
+	wl_buffer_copy(b, data, len);
+	free(b->data);
+
+	b->data = data;
+	b->size = new_size;
+	b->tail = 0;
+	b->head = len;
+
+	return 0;
+}
+
 static int
 wl_buffer_put(struct wl_buffer *b, const void *data, size_t count)
 {
 	uint32_t head, size;
 
-	if (count > sizeof(b->data)) {
-		wl_log("Data too big for buffer (%d > %d).\n",
-		       count, sizeof(b->data));
+	if (wl_buffer_size(b) + count > b->size
+	    && wl_buffer_grow(b, wl_buffer_size(b) + count) < 0) {
+		wl_log("Data too big for buffer (%d + %d > %d).\n",
+		       wl_buffer_size(b), count, b->max_size);
 		errno = E2BIG;
 		return -1;
 	}
 
-	head = MASK(b->head);
-	if (head + count <= sizeof b->data) {
+	head = MASK(b, b->head);
+	if (head + count <= b->size) {
 		memcpy(b->data + head, data, count);
 	} else {
-		size = sizeof b->data - head;
+		size = b->size - head;
 		memcpy(b->data + head, data, size);
 		memcpy(b->data, (const char *) data + size, count - size);
 	}
@@ -91,19 +163,19 @@ wl_buffer_put_iov(struct wl_buffer *b, struct iovec *iov, int *count)
 {
 	uint32_t head, tail;
 
-	head = MASK(b->head);
-	tail = MASK(b->tail);
+	head = MASK(b, b->head);
+	tail = MASK(b, b->tail);
 	if (head < tail) {
 		iov[0].iov_base = b->data + head;
 		iov[0].iov_len = tail - head;
 		*count = 1;
 	} else if (tail == 0) {
 		iov[0].iov_base = b->data + head;
-		iov[0].iov_len = sizeof b->data - head;
+		iov[0].iov_len = b->size - head;
 		*count = 1;
 	} else {
 		iov[0].iov_base = b->data + head;
-		iov[0].iov_len = sizeof b->data - head;
+		iov[0].iov_len = b->size - head;
 		iov[1].iov_base = b->data;
 		iov[1].iov_len = tail;
 		*count = 2;
@@ -115,19 +187,19 @@ wl_buffer_get_iov(struct wl_buffer *b, struct iovec *iov, int *count)
 {
 	uint32_t head, tail;
 
-	head = MASK(b->head);
-	tail = MASK(b->tail);
+	head = MASK(b, b->head);
+	tail = MASK(b, b->tail);
 	if (tail < head) {
 		iov[0].iov_base = b->data + tail;
 		iov[0].iov_len = head - tail;
 		*count = 1;
 	} else if (head == 0) {
 		iov[0].iov_base = b->data + tail;
-		iov[0].iov_len = sizeof b->data - tail;
+		iov[0].iov_len = b->size - tail;
 		*count = 1;
 	} else {
 		iov[0].iov_base = b->data + tail;
-		iov[0].iov_len = sizeof b->data - tail;
+		iov[0].iov_len = b->size - tail;
 		iov[1].iov_base = b->data;
 		iov[1].iov_len = head;
 		*count = 2;
@@ -139,11 +211,11 @@ wl_buffer_copy(struct wl_buffer *b, void *data, size_t count)
 {
 	uint32_t tail, size;
 
-	tail = MASK(b->tail);
-	if (tail + count <= sizeof b->data) {
+	tail = MASK(b, b->tail);
+	if (tail + count <= b->size) {
 		memcpy(data, b->data + tail, count);
 	} else {
-		size = sizeof b->data - tail;
+		size = b->size - tail;
 		memcpy(data, b->data + tail, size);
 		memcpy((char *) data + size, b->data, count - size);
 	}
@@ -155,8 +227,50 @@ wl_buffer_size(struct wl_buffer *b)
 	return b->head - b->tail;
 }
 
+/* get (at most two) chunks of memory that contain count bytes
+ * starting offset bytes after the tail of the buffer */
+static void
+wl_buffer_get_iov_at(struct wl_buffer *b, size_t offset, size_t count,
+		     struct iovec *iov, int *iovcnt)
+{
+	uint32_t start, size;
+
+	start = MASK(b, b->tail + offset);
+	if (start + count <= b->size) {
+		iov[0].iov_base = b->data + start;
+		iov[0].iov_len = count;
+		*iovcnt = 1;
+	} else {
+		size = b->size - start;
+		iov[0].iov_base = b->data + start;
+		iov[0].iov_len = size;
+		iov[1].iov_base = b->data;
+		iov[1].iov_len = count - size;
+		*iovcnt = 2;
+	}
+}
+
+/* round size up to a power of two */
+uint32_t
+wl_buffer_size_round(size_t size)
+{
+	uint32_t ret = 1;
+
+	while (ret < size && ret < (1U << 31))
+		ret <<= 1;
+
+	return ret;
+}
+
+/*
+ * Create connection with data buffers size bytes big that can grow
+ * up to max_size bytes. Both sizes must be powers of two.
+ * The output buffer can grow up to twice as much, so that data
+ * from a whole input buffer fit there even when some data wait
+ * for the peer already. Buffers for fds have always the default size.
+ */
 struct wl_connection *
-wl_connection_create(int fd)
+wl_connection_create_sized(int fd, uint32_t size, uint32_t max_size)
 {
 	struct wl_connection *connection;
 
@@ -164,28 +278,63 @@ wl_connection_create(int fd)
 	if (connection == NULL)
 		return NULL;
 	memset(connection, 0, sizeof *connection);
+
+	if (wl_buffer_init(&connection->in, size, max_size) < 0)
+		goto err;
+	if (wl_buffer_init(&connection->out, size, 2 * max_size) < 0)
+		goto err;
+	if (wl_buffer_init(&connection->fds_in, WL_BUFFER_DEFAULT_SIZE,
+			   WL_BUFFER_DEFAULT_SIZE) < 0)
+		goto err;
+	/* fds wait for the peer together with the data */
+	if (wl_buffer_init(&connection->fds_out, WL_BUFFER_DEFAULT_SIZE,
+			   2 * max_size) < 0)
+		goto err;
+
 	connection->fd = fd;
 
 	return connection;
+
+err:
+	wl_buffer_release(&connection->in);
+	wl_buffer_release(&connection->out);
+	wl_buffer_release(&connection->fds_in);
+	wl_buffer_release(&connection->fds_out);
+	free(connection);
+	return NULL;
+}
+
+struct wl_connection *
+wl_connection_create(int fd)
+{
+	return wl_connection_create_sized(fd, WL_BUFFER_DEFAULT_SIZE,
+					  WL_BUFFER_DEFAULT_SIZE);
 }
 
 static void
 close_fds(struct wl_buffer *buffer, int max)
 {
-	int32_t fds[sizeof(buffer->data) / sizeof(int32_t)], i, count;
+	int32_t fds[WL_BUFFER_DEFAULT_SIZE / sizeof(int32_t)], i, count;
 	size_t size;
 
-	size = buffer->head - buffer->tail;
-	if (size == 0)
-		return;
-
-	wl_buffer_copy(buffer, fds, size);
-	count = size / sizeof fds[0];
-	if (max > 0 && max < count)
-		count = max;
-	for (i = 0; i < count; i++)
-		close(fds[i]);
-	buffer->tail += size;
+	/* fds_out can grow, so go in chunks. Only the closed
+	 * fds are removed, the rest waits for the next sendmsg */
+	while ((size = buffer->head - buffer->tail) > 0 && max != 0) {
+		if (size > sizeof fds)
+			size = sizeof fds;
+
+		count = size / sizeof fds[0];
+		if (max > 0 && max < count)
+			count = max;
+
+		wl_buffer_copy(buffer, fds, count * sizeof fds[0]);
+		for (i = 0; i < count; i++)
+			close(fds[i]);
+		buffer->tail += count * sizeof fds[0];
+
+		if (max > 0)
+			max -= count;
+	}
 }
 
 void
@@ -194,9 +343,20 @@ wl_connection_destroy(struct wl_connection *connection)
 	close_fds(&connection->fds_out, -1);
 	close_fds(&connection->fds_in, -1);
 	close(connection->fd);
+	wl_buffer_release(&connection->in);
+	wl_buffer_release(&connection->out);
+	wl_buffer_release(&connection->fds_in);
+	wl_buffer_release(&connection->fds_out);
 	free(connection);
 }
 
+void
+wl_connection_set_io(struct wl_connection *connection,
+		     struct wl_connection_io *io)
+{
+	connection->io = io;
+}
+
 void
 wl_connection_copy(struct wl_connection *connection, void *data, size_t size)
 {
@@ -209,6 +369,33 @@ wl_connection_consume(struct wl_connection *connection, size_t size)
 	connection->in.tail += size;
 }
 
+/*
+ * Return pointer to size bytes that are offset bytes after the tail
+ * of the input buffer. If the data are contiguous in the buffer,
+ * the returned pointer points right into the buffer. If they wrap around
+ * the end of the buffer, they are copied into scratch (that must be big
+ * enough) and scratch is returned.
+ */
+void *
+wl_connection_peek(struct wl_connection *connection, size_t offset,
+		   size_t size, void *scratch)
+{
+	struct iovec iov[2];
+	int count;
+
+	assert(offset + size <= wl_buffer_size(&connection->in));
+
+	wl_buffer_get_iov_at(&connection->in, offset, size, iov, &count);
+	if (count == 1)
+		return iov[0].iov_base;
+
+	memcpy(scratch, iov[0].iov_base, iov[0].iov_len);
+	memcpy((char *) scratch + iov[0].iov_len,
+	       iov[1].iov_base, iov[1].iov_len);
+
+	return scratch;
+}
+
 static void
 build_cmsg(struct wl_buffer *buffer, char *data, int *clen)
 {
@@ -245,7 +432,7 @@ decode_cmsg(struct wl_buffer *buffer, struct msghdr *msg)
 			continue;
 
 		size = cmsg->cmsg_len - CMSG_LEN(0);
-		max = sizeof(buffer->data) - wl_buffer_size(buffer);
+		max = buffer->size - wl_buffer_size(buffer);
 		if (size > max || overflow) {
 			overflow = 1;
 			size /= sizeof(int32_t);
@@ -264,6 +451,31 @@ decode_cmsg(struct wl_buffer *buffer, struct msghdr *msg)
 	return 0;
 }
 
+/* sendmsg() the message built by build_cmsg(). The fds that went out
+ * are closed (the peer has its own copies) or the io owns them now */
+static int
+connection_sendmsg(struct wl_connection *connection, struct msghdr *msg)
+{
+	int len;
+
+	if (connection->io) {
+		len = connection->io->sendmsg(connection->io, msg);
+		if (len >= 0 && msg->msg_controllen > 0)
+			connection->fds_out.tail +=
+				msg->msg_controllen - CMSG_LEN(0);
+		return len;
+	}
+
+	do {
+		len = sendmsg(connection->fd, msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+	} while (len == -1 && errno == EINTR);
+
+	if (len >= 0)
+		close_fds(&connection->fds_out, MAX_FDS_OUT);
+
+	return len;
+}
+
 int
 wl_connection_flush(struct wl_connection *connection)
 {
@@ -280,6 +492,15 @@ wl_connection_flush(struct wl_connection *connection)
 	while (connection->out.head - connection->out.tail > 0) {
 		wl_buffer_get_iov(&connection->out, iov, &count);
 
+		/* one sendmsg takes MAX_FDS_OUT fds. If there are more,
+		 * send the data byte by byte until the rest fits, so that
+		 * no fd comes after the bytes of its message */
+		if (wl_buffer_size(&connection->fds_out)
+		    > MAX_FDS_OUT * sizeof(int32_t)) {
+			iov[0].iov_len = 1;
+			count = 1;
+		}
+
 		build_cmsg(&connection->fds_out, cmsg, &clen);
 
 		msg.msg_name = NULL;
@@ -290,16 +511,10 @@ wl_connection_flush(struct wl_connection *connection)
 		msg.msg_controllen = clen;
 		msg.msg_flags = 0;
 
-		do {
-			len = sendmsg(connection->fd, &msg,
-				      MSG_NOSIGNAL | MSG_DONTWAIT);
-		} while (len == -1 && errno == EINTR);
-
+		len = connection_sendmsg(connection, &msg);
 		if (len == -1)
 			return -1;
 
-		close_fds(&connection->fds_out, MAX_FDS_OUT);
-
 		connection->out.tail += len;
 	}
 
@@ -308,6 +523,75 @@ wl_connection_flush(struct wl_connection *connection)
 	return connection->out.head - tail;
 }
 
+/*
+ * Send count bytes that are offset bytes after the tail of conn1's input
+ * buffer to conn2. If conn2 has nothing queued, the data are sent right
+ * from the input buffer (together with queued fds) and only what the socket
+ * did not take is queued. Otherwise the data are queued behind the data
+ * that are waiting in conn2, so that the order is kept, and it is up to the
+ * caller to flush conn2. The input buffer is not consumed.
+ */
+int
+wl_connection_forward(struct wl_connection *conn1, size_t offset,
+		      size_t count, struct wl_connection *conn2)
+{
+	struct iovec iov[2];
+	struct msghdr msg;
+	char cmsg[CLEN];
+	int len, iovcnt, clen, i;
+
+	assert(offset + count <= wl_buffer_size(&conn1->in));
+
+	wl_buffer_get_iov_at(&conn1->in, offset, count, iov, &iovcnt);
+
+	/* more fds than one sendmsg takes go through flush */
+	if (wl_buffer_size(&conn2->out) > 0
+	    || wl_buffer_size(&conn2->fds_out)
+		> MAX_FDS_OUT * sizeof(int32_t)) {
+		for (i = 0; i < iovcnt; ++i) {
+			if (wl_connection_write(conn2, iov[i].iov_base,
+						iov[i].iov_len) < 0)
+				return -1;
+		}
+
+		return 0;
+	}
+
+	build_cmsg(&conn2->fds_out, cmsg, &clen);
+
+	msg.msg_name = NULL;
+	msg.msg_namelen = 0;
+	msg.msg_iov = iov;
+	msg.msg_iovlen = iovcnt;
+	msg.msg_control = cmsg;
+	msg.msg_controllen = clen;
+	msg.msg_flags = 0;
+
+	len = connection_sendmsg(conn2, &msg);
+	if (len == -1) {
+		if (errno != EAGAIN)
+			return -1;
+
+		/* queue everything, fds are still in fds_out */
+		len = 0;
+	}
+
+	/* queue the rest that the socket did not take */
+	for (i = 0; i < iovcnt; ++i) {
+		if ((size_t) len >= iov[i].iov_len) {
+			len -= iov[i].iov_len;
+			continue;
+		}
+
+		if (wl_connection_write(conn2, (char *) iov[i].iov_base + len,
+					iov[i].iov_len - len) < 0)
+			return -1;
+		len = 0;
+	}
+
+	return 0;
+}
+
 int
 wl_connection_read(struct wl_connection *connection)
 {
@@ -315,12 +599,16 @@ wl_connection_read(struct wl_connection *connection)
 	struct msghdr msg;
 	char cmsg[CLEN];
 	int len, count, ret;
+	uint32_t space;
 
-	if (wl_buffer_size(&connection->in) >= sizeof(connection->in.data)) {
+	if (wl_buffer_size(&connection->in) >= connection->in.size
+	    && wl_buffer_grow(&connection->in, connection->in.size * 2) < 0) {
 		errno = EOVERFLOW;
 		return -1;
 	}
 
+	space = connection->in.size - wl_buffer_size(&connection->in);
+
 	wl_buffer_put_iov(&connection->in, iov, &count);
 
 	msg.msg_name = NULL;
@@ -332,7 +620,11 @@ wl_connection_read(struct wl_connection *connection)
 	msg.msg_flags = 0;
 
 	do {
-		len = wl_os_recvmsg_cloexec(connection->fd, &msg, MSG_DONTWAIT);
+		if (connection->io)
+			len = connection->io->recvmsg(connection->io, &msg);
+		else
+			len = wl_os_recvmsg_cloexec(connection->fd, &msg,
+						    MSG_DONTWAIT);
 	} while (len < 0 && errno == EINTR);
 
 	if (len <= 0)
@@ -344,15 +636,38 @@ wl_connection_read(struct wl_connection *connection)
 
 	connection->in.head += len;
 
+	/* we filled the whole buffer, so there are probably more data
+	 * waiting in the socket. Grow for the next time (if we can),
+	 * so that we get them with less reads */
+	if ((uint32_t) len == space
+	    && connection->in.size < connection->in.max_size)
+		wl_buffer_grow(&connection->in, connection->in.size * 2);
+
 	return connection->in.head - connection->in.tail;
 }
 
+/* how many bytes wait for sending */
+uint32_t
+wl_connection_pending_output(struct wl_connection *connection)
+{
+	return wl_buffer_size(&connection->out);
+}
+
+/* how many fds wait for sending */
+uint32_t
+wl_connection_pending_fds(struct wl_connection *connection)
+{
+	return wl_buffer_size(&connection->fds_out) / sizeof(int32_t);
+}
+
 int
 wl_connection_write(struct wl_connection *connection,
 		    const void *data, size_t count)
 {
-	if (connection->out.head - connection->out.tail +
-	    count > ARRAY_LENGTH(connection->out.data)) {
+	if (wl_buffer_size(&connection->out) + count > connection->out.size
+	    && wl_buffer_grow(&connection->out,
+			      wl_buffer_size(&connection->out) + count) < 0) {
+		/* can not grow anymore, make some space */
 		connection->want_flush = 1;
 		if (wl_connection_flush(connection) < 0)
 			return -1;
@@ -370,8 +685,9 @@ int
 wl_connection_queue(struct wl_connection *connection,
 		    const void *data, size_t count)
 {
-	if (connection->out.head - connection->out.tail +
-	    count > ARRAY_LENGTH(connection->out.data)) {
+	if (wl_buffer_size(&connection->out) + count > connection->out.size
+	    && wl_buffer_grow(&connection->out,
+			      wl_buffer_size(&connection->out) + count) < 0) {
 		connection->want_flush = 1;
 		if (wl_connection_flush(connection) < 0)
 			return -1;
@@ -413,28 +729,30 @@ int
 wl_connection_copy_fds(struct wl_connection *conn1, struct wl_connection *conn2)
 {
 	uint32_t size = wl_buffer_size(&conn1->fds_in);
-	void *data = conn1->fds_in.data;
-	int ret;
+	int32_t fds[WL_BUFFER_DEFAULT_SIZE / sizeof(int32_t)];
 
 	if (size == 0)
 		return 0;
 
+	/* the peer may not take the data now, then the fds
+	 * wait in fds_out with them */
 	if (size + wl_buffer_size(&conn2->fds_out)
 		>= MAX_FDS_OUT * sizeof(int32_t)) {
 		conn2->want_flush = 1;
-		if (wl_connection_flush(conn2) < 0)
+		if (wl_connection_flush(conn2) < 0 && errno != EAGAIN)
 			return -1;
 	}
 
-
-	/* copy fds from conn1 to conn2 */
-	ret = wl_buffer_put(&conn2->fds_out,
-			    ((char *) data) + conn1->fds_in.tail, size);
+	/* copy fds from conn1 to conn2. If they do not fit,
+	 * they stay in conn1 and are closed with it */
+	wl_buffer_copy(&conn1->fds_in, fds, size);
+	if (wl_buffer_put(&conn2->fds_out, fds, size) < 0)
+		return -1;
 
 	/* remove copied fds from conn1 */
 	conn1->fds_in.tail += size;
 
-	return ret;
+	return 0;
 }
 
 const char *
@@ -85,10 +85,25 @@ struct wl_proxy;
 int wl_interface_equal(const struct wl_interface *iface1,
 		       const struct wl_interface *iface2);
 
+/* default size of connection buffers and how much
+ * they can grow by default (see --max-buffer-size) */
+#define WL_BUFFER_DEFAULT_SIZE		4096
+#define WL_BUFFER_DEFAULT_MAX_SIZE	(64 * 1024)
+
+uint32_t wl_buffer_size_round(size_t size);
+
 struct wl_connection *wl_connection_create(int fd);
+struct wl_connection *wl_connection_create_sized(int fd, uint32_t size,
+						 uint32_t max_size);
 void wl_connection_destroy(struct wl_connection *connection);
 void wl_connection_copy(struct wl_connection *connection, void *data, size_t size);
 void wl_connection_consume(struct wl_connection *connection, size_t size);
+void *wl_connection_peek(struct wl_connection *connection, size_t offset,
+			 size_t size, void *scratch);
+uint32_t wl_connection_pending_output(struct wl_connection *connection);
+uint32_t wl_connection_pending_fds(struct wl_connection *connection);
+int wl_connection_forward(struct wl_connection *conn1, size_t offset,
+			  size_t count, struct wl_connection *conn2);
 int wl_connection_copy_fds(struct wl_connection *conn1, struct wl_connection *conn2);
 
 int wl_connection_flush(struct wl_connection *connection);
@@ -98,6 +113,20 @@ int wl_connection_write(struct wl_connection *connection, const void *data, size
 int wl_connection_queue(struct wl_connection *connection,
 			const void *data, size_t count);
 
+struct msghdr;
+
+/* something else than the socket calls receives and sends the data
+ * of a connection (the io_uring loop of wldbg). The functions work like
+ * recvmsg() and sendmsg() with MSG_DONTWAIT, fds of a message that
+ * sendmsg took are owned by the io from then on */
+struct wl_connection_io {
+	int (*recvmsg)(struct wl_connection_io *io, struct msghdr *msg);
+	int (*sendmsg)(struct wl_connection_io *io, const struct msghdr *msg);
+};
+
+void wl_connection_set_io(struct wl_connection *connection,
+			  struct wl_connection_io *io);
+
 struct wl_closure {
 	int count;
 	const struct wl_message *message;